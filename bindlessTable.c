@@ -0,0 +1,400 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bindlessTable.h"
+#include "growArray.h"
+
+#define BINDLESS_MAX_FRAMES 4
+
+typedef enum bindlessKind
+{
+	BINDLESS_TEXTURE,
+	BINDLESS_BUFFER
+} bindlessKind;
+
+// A descriptor write still to be replayed into the frame sets that have not seen it.
+typedef struct bindlessWrite
+{
+	uint64_t sequence;
+	bindlessKind kind;
+	uint32_t index;
+	VkDescriptorImageInfo image;
+	VkDescriptorBufferInfo buffer;
+} bindlessWrite;
+
+// A removed handle, reusable once every frame that could still index it has finished.
+typedef struct bindlessRetired
+{
+	bindlessKind kind;
+	uint32_t index;
+	uint64_t frame;
+} bindlessRetired;
+
+typedef struct bindlessIndices
+{
+	uint32_t *free;
+	uint32_t freeCount;
+	uint32_t next, max;
+} bindlessIndices;
+
+struct bindlessTable
+{
+	VkDevice device;
+	bool bindless, storageBuffers;
+	uint32_t framesInFlight;
+
+	VkDescriptorSetLayout layout;
+	VkDescriptorPool pool;
+
+	VkDescriptorSet frameSets[BINDLESS_MAX_FRAMES];
+	uint64_t applied[BINDLESS_MAX_FRAMES];
+
+	bindlessWrite *writes;
+	uint32_t writeCount, writeCapacity;
+	uint64_t nextSequence;
+
+	VkDescriptorSet *textureSets;        // classic mode, one per texture handle
+
+	bindlessIndices textures, buffers;
+
+	bindlessRetired *retired;
+	uint32_t retiredCount, retiredCapacity;
+	uint64_t frame;
+
+	VkWriteDescriptorSet *scratch;
+	uint32_t scratchCapacity;
+};
+
+static uint32_t takeIndex(bindlessIndices *indices)
+{
+	if ((*indices).freeCount > 0) return (*indices).free[--(*indices).freeCount];
+	if ((*indices).next == (*indices).max) return BINDLESS_INVALID;
+	return (*indices).next++;
+}
+
+static VkResult createBindlessLayout(bindlessTable *table, const bindlessTableCreateInfo *createInfo)
+{
+	VkDescriptorSetLayoutBinding bindings[2] = {0};
+	VkDescriptorBindingFlagsEXT bindingFlags[2] = {0};
+	uint32_t bindingCount = (*table).storageBuffers ? 2 : 1;
+
+	// Update-after-bind is what lifts the per-stage descriptor limits to array sizes;
+	// partially bound lets most of the array stay empty.
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = (*createInfo).maxTextures;
+	bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+	bindingFlags[0] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT;
+
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[1].descriptorCount = (*createInfo).maxBuffers;
+	bindings[1].stageFlags = bindings[0].stageFlags;
+	bindingFlags[1] = bindingFlags[0];
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo = {0};
+	flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	flagsInfo.bindingCount = bindingCount;
+	flagsInfo.pBindingFlags = bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &flagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	layoutInfo.bindingCount = bindingCount;
+	layoutInfo.pBindings = bindings;
+
+	(*table).layout = descriptorLayoutGet((*createInfo).layouts, &layoutInfo);
+	VkResult res = (*table).layout != VK_NULL_HANDLE ? VK_SUCCESS : VK_ERROR_INITIALIZATION_FAILED;
+
+	if (res == VK_SUCCESS)
+	{
+		VkDescriptorPoolSize poolSizes[2] = {
+			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, (*createInfo).maxTextures * (*table).framesInFlight},
+			{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, (*createInfo).maxBuffers * (*table).framesInFlight}
+		};
+
+		VkDescriptorPoolCreateInfo poolInfo = {0};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+		poolInfo.maxSets = (*table).framesInFlight;
+		poolInfo.poolSizeCount = bindingCount;
+		poolInfo.pPoolSizes = poolSizes;
+
+		res = vkCreateDescriptorPool((*table).device, &poolInfo, NULL, &(*table).pool);
+	}
+
+	if (res == VK_SUCCESS)
+	{
+		VkDescriptorSetLayout layouts[BINDLESS_MAX_FRAMES];
+		for (uint32_t i = 0; i < (*table).framesInFlight; i++) layouts[i] = (*table).layout;
+
+		VkDescriptorSetAllocateInfo setInfo = {0};
+		setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		setInfo.descriptorPool = (*table).pool;
+		setInfo.descriptorSetCount = (*table).framesInFlight;
+		setInfo.pSetLayouts = layouts;
+
+		res = vkAllocateDescriptorSets((*table).device, &setInfo, (*table).frameSets);
+	}
+
+	return res;
+}
+
+static VkResult createClassicLayout(bindlessTable *table, const bindlessTableCreateInfo *createInfo)
+{
+	VkDescriptorSetLayoutBinding binding = {0};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+
+	(*table).layout = descriptorLayoutGet((*createInfo).layouts, &layoutInfo);
+	VkResult res = (*table).layout != VK_NULL_HANDLE ? VK_SUCCESS : VK_ERROR_INITIALIZATION_FAILED;
+
+	if (res == VK_SUCCESS)
+	{
+		VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, (*createInfo).maxTextures};
+
+		VkDescriptorPoolCreateInfo poolInfo = {0};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+		poolInfo.maxSets = (*createInfo).maxTextures;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+
+		res = vkCreateDescriptorPool((*table).device, &poolInfo, NULL, &(*table).pool);
+	}
+
+	(*table).textureSets = calloc((*createInfo).maxTextures, sizeof(VkDescriptorSet));
+	return res;
+}
+
+bindlessTable *bindlessCreate(const bindlessTableCreateInfo *createInfo)
+{
+	bindlessTable *table = calloc(1, sizeof(bindlessTable));
+	(*table).device = (*createInfo).device;
+	(*table).bindless = (*createInfo).descriptorIndexing;
+	(*table).storageBuffers = (*table).bindless && (*createInfo).storageBuffers && (*createInfo).maxBuffers > 0;
+	(*table).framesInFlight = (*createInfo).framesInFlight < BINDLESS_MAX_FRAMES ? (*createInfo).framesInFlight : BINDLESS_MAX_FRAMES;
+	(*table).nextSequence = 1;
+
+	(*table).textures.max = (*createInfo).maxTextures;
+	(*table).textures.free = malloc((*createInfo).maxTextures * sizeof(uint32_t));
+	(*table).buffers.max = (*table).storageBuffers ? (*createInfo).maxBuffers : 0;
+	(*table).buffers.free = malloc(((*table).buffers.max + 1) * sizeof(uint32_t));
+
+	VkResult res = (*table).bindless ? createBindlessLayout(table, createInfo) : createClassicLayout(table, createInfo);
+	if (res != VK_SUCCESS)
+	{
+		printf("failed to create %s descriptor table (%d)\n", (*table).bindless ? "bindless" : "classic", res);
+		bindlessDestroy(table);
+		return NULL;
+	}
+
+	return table;
+}
+
+// The device must be idle.
+void bindlessDestroy(bindlessTable *table)
+{
+	if (table == NULL) return;
+
+	// Destroying the pool frees every set allocated from it.
+	// The layout belongs to the layout cache.
+	vkDestroyDescriptorPool((*table).device, (*table).pool, NULL);
+
+	free((*table).writes);
+	free((*table).textureSets);
+	free((*table).textures.free);
+	free((*table).buffers.free);
+	free((*table).retired);
+	free((*table).scratch);
+	free(table);
+}
+
+bool bindlessIsBindless(bindlessTable *table)
+{
+	return (*table).bindless;
+}
+
+VkDescriptorSetLayout bindlessSetLayout(bindlessTable *table)
+{
+	return (*table).layout;
+}
+
+static void logWrite(bindlessTable *table, bindlessWrite write)
+{
+	GROW((*table).writes, (*table).writeCount, (*table).writeCapacity, 32);
+	write.sequence = (*table).nextSequence++;
+	(*table).writes[(*table).writeCount++] = write;
+}
+
+uint32_t bindlessAddTexture(bindlessTable *table, VkImageView view, VkSampler sampler, VkImageLayout layout)
+{
+	uint32_t texture = takeIndex(&(*table).textures);
+	if (texture == BINDLESS_INVALID)
+	{
+		printf("descriptor table is out of texture slots\n");
+		return BINDLESS_INVALID;
+	}
+
+	VkDescriptorImageInfo image = {sampler, view, layout};
+
+	if ((*table).bindless)
+	{
+		bindlessWrite write = {0};
+		write.kind = BINDLESS_TEXTURE;
+		write.index = texture;
+		write.image = image;
+		logWrite(table, write);
+		return texture;
+	}
+
+	VkDescriptorSetAllocateInfo setInfo = {0};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setInfo.descriptorPool = (*table).pool;
+	setInfo.descriptorSetCount = 1;
+	setInfo.pSetLayouts = &(*table).layout;
+
+	VkResult res = vkAllocateDescriptorSets((*table).device, &setInfo, &(*table).textureSets[texture]);
+	if (res != VK_SUCCESS)
+	{
+		printf("vkAllocateDescriptorSets() for texture %u failed (%d)\n", texture, res);
+		(*table).textures.free[(*table).textures.freeCount++] = texture;
+		return BINDLESS_INVALID;
+	}
+
+	// A fresh set is not referenced by any command buffer yet, so it is written right away.
+	VkWriteDescriptorSet write = {0};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = (*table).textureSets[texture];
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &image;
+	vkUpdateDescriptorSets((*table).device, 1, &write, 0, NULL);
+
+	return texture;
+}
+
+uint32_t bindlessAddBuffer(bindlessTable *table, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	uint32_t index = takeIndex(&(*table).buffers);
+	if (index == BINDLESS_INVALID) return BINDLESS_INVALID;
+
+	bindlessWrite write = {0};
+	write.kind = BINDLESS_BUFFER;
+	write.index = index;
+	write.buffer = (VkDescriptorBufferInfo){buffer, offset, range};
+	logWrite(table, write);
+	return index;
+}
+
+static void retire(bindlessTable *table, bindlessKind kind, uint32_t index)
+{
+	GROW((*table).retired, (*table).retiredCount, (*table).retiredCapacity, 16);
+	(*table).retired[(*table).retiredCount++] = (bindlessRetired){kind, index, (*table).frame};
+}
+
+void bindlessRemoveTexture(bindlessTable *table, uint32_t texture)
+{
+	if (texture != BINDLESS_INVALID) retire(table, BINDLESS_TEXTURE, texture);
+}
+
+void bindlessRemoveBuffer(bindlessTable *table, uint32_t buffer)
+{
+	if (buffer != BINDLESS_INVALID) retire(table, BINDLESS_BUFFER, buffer);
+}
+
+void bindlessBeginFrame(bindlessTable *table, uint32_t frameSlot)
+{
+	(*table).frame++;
+
+	// Slot fences signal in order, so framesInFlight frames later nothing submitted
+	// before the removal can still be reading the handle.
+	uint32_t kept = 0;
+	for (uint32_t i = 0; i < (*table).retiredCount; i++)
+	{
+		bindlessRetired entry = (*table).retired[i];
+		if (entry.frame + (*table).framesInFlight > (*table).frame)
+		{
+			(*table).retired[kept++] = entry;
+			continue;
+		}
+
+		bindlessIndices *indices = entry.kind == BINDLESS_TEXTURE ? &(*table).textures : &(*table).buffers;
+		(*indices).free[(*indices).freeCount++] = entry.index;
+
+		if (!(*table).bindless)
+		{
+			vkFreeDescriptorSets((*table).device, (*table).pool, 1, &(*table).textureSets[entry.index]);
+			(*table).textureSets[entry.index] = VK_NULL_HANDLE;
+		}
+	}
+	(*table).retiredCount = kept;
+
+	if (!(*table).bindless) return;
+
+	uint32_t pending = 0;
+	if ((*table).scratchCapacity < (*table).writeCount)
+	{
+		(*table).scratchCapacity = (*table).writeCount;
+		(*table).scratch = realloc((*table).scratch, (*table).scratchCapacity * sizeof(VkWriteDescriptorSet));
+	}
+
+	for (uint32_t i = 0; i < (*table).writeCount; i++)
+	{
+		const bindlessWrite *entry = &(*table).writes[i];
+		if ((*entry).sequence <= (*table).applied[frameSlot]) continue;
+
+		VkWriteDescriptorSet *write = &(*table).scratch[pending++];
+		memset(write, 0, sizeof(VkWriteDescriptorSet));
+		(*write).sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		(*write).dstSet = (*table).frameSets[frameSlot];
+		(*write).dstArrayElement = (*entry).index;
+		(*write).descriptorCount = 1;
+
+		if ((*entry).kind == BINDLESS_TEXTURE)
+		{
+			(*write).dstBinding = 0;
+			(*write).descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			(*write).pImageInfo = &(*entry).image;
+		} else
+		{
+			(*write).dstBinding = 1;
+			(*write).descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			(*write).pBufferInfo = &(*entry).buffer;
+		}
+	}
+
+	if (pending > 0) vkUpdateDescriptorSets((*table).device, pending, (*table).scratch, 0, NULL);
+	(*table).applied[frameSlot] = (*table).nextSequence - 1;
+
+	// Drop the writes every slot has seen.
+	uint64_t oldest = (*table).applied[0];
+	for (uint32_t i = 1; i < (*table).framesInFlight; i++)
+		if ((*table).applied[i] < oldest) oldest = (*table).applied[i];
+
+	kept = 0;
+	for (uint32_t i = 0; i < (*table).writeCount; i++)
+		if ((*table).writes[i].sequence > oldest) (*table).writes[kept++] = (*table).writes[i];
+	(*table).writeCount = kept;
+}
+
+VkDescriptorSet bindlessFrameSet(bindlessTable *table, uint32_t frameSlot)
+{
+	return (*table).bindless ? (*table).frameSets[frameSlot] : VK_NULL_HANDLE;
+}
+
+VkDescriptorSet bindlessTextureSet(bindlessTable *table, uint32_t texture)
+{
+	if ((*table).bindless || texture == BINDLESS_INVALID) return VK_NULL_HANDLE;
+	return (*table).textureSets[texture];
+}
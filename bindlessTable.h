@@ -0,0 +1,61 @@
+#ifndef BINDLESS_TABLE_H
+#define BINDLESS_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "descriptorAllocator.h"
+
+// Texture and storage buffer handles for shaders. With descriptor indexing every
+// texture lives in one large update-after-bind array (binding 0, sampler2DArray)
+// and storage buffers in a second one (binding 1); shaders index them with the
+// handle, so draws never rebind descriptors. Each frame slot has its own copy of
+// the set and writes are replayed into a slot once its fence has signalled, so a
+// set is never written while the GPU may read it. Without descriptor indexing the
+// same handles map to one classic single-texture set each.
+// Views must be VK_IMAGE_VIEW_TYPE_2D_ARRAY. Not thread safe.
+
+#define BINDLESS_INVALID UINT32_MAX
+
+typedef struct bindlessTable bindlessTable;
+
+typedef struct bindlessTableCreateInfo
+{
+	VkDevice device;
+	descriptorLayoutCache *layouts;      // owns the set layout
+	bool descriptorIndexing;             // sampled image arrays with non-uniform indexing and update-after-bind
+	bool storageBuffers;                 // the same for storage buffers, bindless path only
+	uint32_t maxTextures;
+	uint32_t maxBuffers;
+	uint32_t framesInFlight;
+} bindlessTableCreateInfo;
+
+bindlessTable *bindlessCreate(const bindlessTableCreateInfo *createInfo);
+void bindlessDestroy(bindlessTable *table);
+
+bool bindlessIsBindless(bindlessTable *table);
+
+// Set 0 of every pipeline that samples through the table. Bindless: the arrays;
+// classic: one combined image sampler at binding 0.
+VkDescriptorSetLayout bindlessSetLayout(bindlessTable *table);
+
+// layout is the one the image is in whenever it is sampled.
+uint32_t bindlessAddTexture(bindlessTable *table, VkImageView view, VkSampler sampler, VkImageLayout layout);
+void bindlessRemoveTexture(bindlessTable *table, uint32_t texture);
+
+// BINDLESS_INVALID in classic mode or when storage buffers are unavailable.
+uint32_t bindlessAddBuffer(bindlessTable *table, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+void bindlessRemoveBuffer(bindlessTable *table, uint32_t buffer);
+
+// Call once the slot's fence has signalled, before recording into it.
+void bindlessBeginFrame(bindlessTable *table, uint32_t frameSlot);
+
+// Bindless: the slot's set, bound once per command buffer.
+VkDescriptorSet bindlessFrameSet(bindlessTable *table, uint32_t frameSlot);
+
+// Classic: the texture's own set.
+VkDescriptorSet bindlessTextureSet(bindlessTable *table, uint32_t texture);
+
+#endif
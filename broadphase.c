@@ -0,0 +1,365 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "broadphase.h"
+#include "growArray.h"
+#include "vectorMath.h"
+
+#define CELL_NONE UINT32_MAX
+#define CELL_INLINE_BODIES 6
+#define CELLS_PER_JOB 64
+#define LOCAL_PAIRS 256
+
+// Most cells hold a few bodies, kept inline so the pair pass touches one line per cell.
+typedef struct bpCell
+{
+	int32_t x, y;
+	uint32_t count, capacity;
+	uint32_t crowdedSlot;                // in crowded, CELL_NONE below two bodies
+	union
+	{
+		uint32_t local[CELL_INLINE_BODIES];
+		uint32_t *heap;
+	};
+} bpCell;
+
+typedef struct bpRange
+{
+	int32_t x0, y0, x1, y1;              // inclusive cell coordinates
+} bpRange;
+
+struct broadphase
+{
+	float cellSize, inverseCellSize;
+	uint32_t maxBodies;
+	jobSystem *jobs;
+
+	bpBox *boxes;
+	bpRange *ranges;
+	bool *present;
+	uint32_t bodyCount;
+
+	// Cells are never freed; an emptied cell stays hashed for the next body.
+	bpCell *cells;
+	uint32_t cellCount, cellCapacity;
+	uint32_t *slots;                     // open addressing into cells
+	uint32_t slotMask;
+
+	// Only cells with two or more bodies can hold a pair.
+	uint32_t *crowded;
+	uint32_t crowdedCount, crowdedCapacity;
+	uint32_t occupiedCount;
+
+	uint32_t cellChanges, lastCellChanges;
+
+	// Current pair pass.
+	bpPair *pairs;
+	uint32_t capacity;
+	atomic_uint pairCount;
+	uint32_t lastPairCount, droppedPairs;
+};
+
+static inline uint32_t *cellBodies(bpCell *cell)
+{
+	return (*cell).capacity > CELL_INLINE_BODIES ? (*cell).heap : (*cell).local;
+}
+
+static inline int32_t floorToCell(float v)
+{
+	int32_t i = (int32_t)v;
+	return i - (v < (float)i);
+}
+
+static inline bool inRange(bpRange range, int32_t x, int32_t y)
+{
+	return x >= range.x0 && x <= range.x1 && y >= range.y0 && y <= range.y1;
+}
+
+static inline uint32_t hashCell(int32_t x, int32_t y)
+{
+	uint64_t key = ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+	key *= 0x9E3779B97F4A7C15ull;
+	return (uint32_t)(key >> 32);
+}
+
+static void rehash(broadphase *bp, uint32_t slotCount)
+{
+	free((*bp).slots);
+	(*bp).slots = malloc(slotCount * sizeof(uint32_t));
+	for (uint32_t i = 0; i < slotCount; i++) (*bp).slots[i] = CELL_NONE;
+	(*bp).slotMask = slotCount - 1;
+
+	for (uint32_t c = 0; c < (*bp).cellCount; c++)
+	{
+		uint32_t slot = hashCell((*bp).cells[c].x, (*bp).cells[c].y) & (*bp).slotMask;
+		while ((*bp).slots[slot] != CELL_NONE) slot = (slot + 1) & (*bp).slotMask;
+		(*bp).slots[slot] = c;
+	}
+}
+
+static bpCell *findCell(broadphase *bp, int32_t x, int32_t y)
+{
+	uint32_t slot = hashCell(x, y) & (*bp).slotMask;
+	while ((*bp).slots[slot] != CELL_NONE)
+	{
+		bpCell *cell = &(*bp).cells[(*bp).slots[slot]];
+		if ((*cell).x == x && (*cell).y == y) return cell;
+		slot = (slot + 1) & (*bp).slotMask;
+	}
+
+	// Keep the table at most half full.
+	if (2 * ((*bp).cellCount + 1) > (*bp).slotMask + 1)
+	{
+		rehash(bp, 2 * ((*bp).slotMask + 1));
+		slot = hashCell(x, y) & (*bp).slotMask;
+		while ((*bp).slots[slot] != CELL_NONE) slot = (slot + 1) & (*bp).slotMask;
+	}
+
+	GROW((*bp).cells, (*bp).cellCount, (*bp).cellCapacity, 256);
+	(*bp).slots[slot] = (*bp).cellCount;
+	bpCell *cell = &(*bp).cells[(*bp).cellCount++];
+	*cell = (bpCell){x, y, 0, CELL_INLINE_BODIES, CELL_NONE, {{0}}};
+	return cell;
+}
+
+static void setCrowded(broadphase *bp, bpCell *cell, bool crowded)
+{
+	if (crowded)
+	{
+		GROW((*bp).crowded, (*bp).crowdedCount, (*bp).crowdedCapacity, 256);
+		(*cell).crowdedSlot = (*bp).crowdedCount;
+		(*bp).crowded[(*bp).crowdedCount++] = (uint32_t)(cell - (*bp).cells);
+	} else
+	{
+		uint32_t moved = (*bp).crowded[--(*bp).crowdedCount];
+		(*bp).crowded[(*cell).crowdedSlot] = moved;
+		(*bp).cells[moved].crowdedSlot = (*cell).crowdedSlot;
+		(*cell).crowdedSlot = CELL_NONE;
+	}
+}
+
+// Cells of range that are not in keep.
+static void insertBody(broadphase *bp, uint32_t body, bpRange range, bpRange keep)
+{
+	for (int32_t y = range.y0; y <= range.y1; y++)
+		for (int32_t x = range.x0; x <= range.x1; x++)
+		{
+			if (inRange(keep, x, y)) continue;
+
+			bpCell *cell = findCell(bp, x, y);
+			if ((*cell).count == (*cell).capacity)
+			{
+				uint32_t *heap = malloc(2 * (*cell).capacity * sizeof(uint32_t));
+				memcpy(heap, cellBodies(cell), (*cell).count * sizeof(uint32_t));
+				if ((*cell).capacity > CELL_INLINE_BODIES) free((*cell).heap);
+				(*cell).heap = heap;
+				(*cell).capacity *= 2;
+			}
+
+			cellBodies(cell)[(*cell).count++] = body;
+			if ((*cell).count == 1) (*bp).occupiedCount++;
+			if ((*cell).count == 2) setCrowded(bp, cell, true);
+		}
+}
+
+static void removeBody(broadphase *bp, uint32_t body, bpRange range, bpRange keep)
+{
+	for (int32_t y = range.y0; y <= range.y1; y++)
+		for (int32_t x = range.x0; x <= range.x1; x++)
+		{
+			if (inRange(keep, x, y)) continue;
+
+			bpCell *cell = findCell(bp, x, y);
+			uint32_t *bodies = cellBodies(cell);
+			uint32_t i = 0;
+			while (bodies[i] != body) i++;
+			bodies[i] = bodies[--(*cell).count];
+
+			if ((*cell).count == 0) (*bp).occupiedCount--;
+			if ((*cell).count == 1) setCrowded(bp, cell, false);
+		}
+}
+
+broadphase *broadphaseCreate(const broadphaseCreateInfo *createInfo)
+{
+	if ((*createInfo).cellSize <= 0.0f)
+	{
+		printf("broadphase cell size must be positive\n");
+		return NULL;
+	}
+
+	broadphase *bp = calloc(1, sizeof(broadphase));
+	(*bp).cellSize = (*createInfo).cellSize;
+	(*bp).inverseCellSize = 1.0f / (*createInfo).cellSize;
+	(*bp).maxBodies = (*createInfo).maxBodies;
+	(*bp).jobs = (*createInfo).jobs;
+
+	(*bp).boxes = malloc((*bp).maxBodies * sizeof(bpBox));
+	(*bp).ranges = malloc((*bp).maxBodies * sizeof(bpRange));
+	(*bp).present = calloc((*bp).maxBodies, sizeof(bool));
+	rehash(bp, 1024);
+	return bp;
+}
+
+void broadphaseDestroy(broadphase *bp)
+{
+	if (bp == NULL) return;
+
+	for (uint32_t c = 0; c < (*bp).cellCount; c++)
+		if ((*bp).cells[c].capacity > CELL_INLINE_BODIES) free((*bp).cells[c].heap);
+	free((*bp).cells);
+	free((*bp).slots);
+	free((*bp).crowded);
+	free((*bp).boxes);
+	free((*bp).ranges);
+	free((*bp).present);
+	free(bp);
+}
+
+static inline void setBody(broadphase *bp, uint32_t body, const bpBox *box)
+{
+	bpRange range;
+	range.x0 = floorToCell((*box).minX * (*bp).inverseCellSize);
+	range.y0 = floorToCell((*box).minY * (*bp).inverseCellSize);
+	range.x1 = floorToCell((*box).maxX * (*bp).inverseCellSize);
+	range.y1 = floorToCell((*box).maxY * (*bp).inverseCellSize);
+	(*bp).boxes[body] = *box;
+
+	// Moves only touch the cells entered and left.
+	bpRange old = {0, 0, -1, -1};
+	if ((*bp).present[body])
+	{
+		old = (*bp).ranges[body];
+		if (old.x0 == range.x0 && old.y0 == range.y0 && old.x1 == range.x1 && old.y1 == range.y1) return;
+
+		removeBody(bp, body, old, range);
+		(*bp).cellChanges++;
+	} else
+	{
+		(*bp).present[body] = true;
+		(*bp).bodyCount++;
+	}
+
+	(*bp).ranges[body] = range;
+	insertBody(bp, body, range, old);
+}
+
+void broadphaseSet(broadphase *bp, uint32_t body, const bpBox *box)
+{
+	if (body >= (*bp).maxBodies)
+	{
+		printf("broadphase body %u is out of range (max %u)\n", body, (*bp).maxBodies);
+		return;
+	}
+
+	setBody(bp, body, box);
+}
+
+void broadphaseSetRange(broadphase *bp, uint32_t first, uint32_t count, const bpBox *boxes)
+{
+	if (first > (*bp).maxBodies || count > (*bp).maxBodies - first)
+	{
+		printf("broadphase bodies %u..%u are out of range (max %u)\n", first, first + count, (*bp).maxBodies);
+		return;
+	}
+
+	for (uint32_t i = 0; i < count; i++) setBody(bp, first + i, &boxes[i]);
+}
+
+void broadphaseRemove(broadphase *bp, uint32_t body)
+{
+	if (body >= (*bp).maxBodies)
+	{
+		printf("broadphase body %u is out of range (max %u)\n", body, (*bp).maxBodies);
+		return;
+	}
+
+	if (!(*bp).present[body]) return;
+
+	removeBody(bp, body, (*bp).ranges[body], (bpRange){0, 0, -1, -1});
+	(*bp).present[body] = false;
+	(*bp).bodyCount--;
+}
+
+static void flushPairs(broadphase *bp, const bpPair *local, uint32_t count)
+{
+	uint32_t first = atomic_fetch_add_explicit(&(*bp).pairCount, count, memory_order_relaxed);
+	if (first >= (*bp).capacity) return;
+
+	uint32_t fit = mathMin(count, (*bp).capacity - first);
+	for (uint32_t i = 0; i < fit; i++) (*bp).pairs[first + i] = local[i];
+}
+
+// Job: pairs within crowded cells [begin, end).
+static void findCellPairs(void *data, uint32_t begin, uint32_t end)
+{
+	broadphase *bp = data;
+	const bpBox *boxes = (*bp).boxes;
+	const bpRange *ranges = (*bp).ranges;
+	bpPair local[LOCAL_PAIRS];
+	uint32_t localCount = 0;
+
+	for (uint32_t c = begin; c < end; c++)
+	{
+		bpCell *cell = &(*bp).cells[(*bp).crowded[c]];
+		const uint32_t *bodies = cellBodies(cell);
+		for (uint32_t i = 0; i < (*cell).count; i++)
+		{
+			uint32_t a = bodies[i];
+			bpBox boxA = boxes[a];
+			for (uint32_t j = i + 1; j < (*cell).count; j++)
+			{
+				uint32_t b = bodies[j];
+				const bpBox *boxB = &boxes[b];
+				if (boxA.maxX < (*boxB).minX || (*boxB).maxX < boxA.minX || boxA.maxY < (*boxB).minY || (*boxB).maxY < boxA.minY) continue;
+
+				// Bodies sharing several cells meet in each; only the lowest shared cell reports.
+				if (mathMax(ranges[a].x0, ranges[b].x0) != (*cell).x || mathMax(ranges[a].y0, ranges[b].y0) != (*cell).y) continue;
+
+				local[localCount++] = a < b ? (bpPair){a, b} : (bpPair){b, a};
+				if (localCount == LOCAL_PAIRS)
+				{
+					flushPairs(bp, local, localCount);
+					localCount = 0;
+				}
+			}
+		}
+	}
+
+	if (localCount > 0) flushPairs(bp, local, localCount);
+}
+
+uint32_t broadphaseFindPairs(broadphase *bp, bpPair *pairs, uint32_t capacity)
+{
+	(*bp).pairs = pairs;
+	(*bp).capacity = capacity;
+	atomic_store_explicit(&(*bp).pairCount, 0, memory_order_relaxed);
+
+	if ((*bp).jobs != NULL && (*bp).crowdedCount > CELLS_PER_JOB)
+	{
+		jobCounter counter = {0};
+		jobParallelFor((*bp).jobs, findCellPairs, bp, (*bp).crowdedCount, CELLS_PER_JOB, &counter);
+		jobWait((*bp).jobs, &counter);
+	} else findCellPairs(bp, 0, (*bp).crowdedCount);
+
+	uint32_t found = atomic_load_explicit(&(*bp).pairCount, memory_order_relaxed);
+	(*bp).lastPairCount = found;
+	(*bp).droppedPairs = found > capacity ? found - capacity : 0;
+	(*bp).lastCellChanges = (*bp).cellChanges;
+	(*bp).cellChanges = 0;
+	return mathMin(found, capacity);
+}
+
+broadphaseStats broadphaseGetStats(broadphase *bp)
+{
+	broadphaseStats stats = {0};
+	stats.bodyCount = (*bp).bodyCount;
+	stats.occupiedCells = (*bp).occupiedCount;
+	stats.cellChanges = (*bp).lastCellChanges;
+	stats.pairCount = (*bp).lastPairCount;
+	stats.droppedPairs = (*bp).droppedPairs;
+	return stats;
+}
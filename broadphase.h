@@ -0,0 +1,60 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <stdint.h>
+
+#include "jobSystem.h"
+
+// Uniform grid spatial hash for dynamic bodies. Bodies are dense ids below
+// maxBodies and keep their cells between ticks: setting a body whose box still
+// covers the same cells only stores the box, so a tick costs one insert/remove
+// per body that crossed a cell edge. Pairs are found per occupied cell, spread
+// over the job system, and written to a buffer the caller preallocates. A pair
+// is reported once, by the lowest cell the two boxes share.
+// Cells cover cellSize squared; about the size of the largest common body works
+// best. Not thread safe except for the internal parallel pair pass.
+
+typedef struct broadphase broadphase;
+
+typedef struct bpBox
+{
+	float minX, minY, maxX, maxY;
+} bpBox;
+
+typedef struct bpPair
+{
+	uint32_t a, b;                       // a < b
+} bpPair;
+
+typedef struct broadphaseCreateInfo
+{
+	float cellSize;
+	uint32_t maxBodies;
+	jobSystem *jobs;                     // NULL finds pairs on the calling thread
+} broadphaseCreateInfo;
+
+typedef struct broadphaseStats
+{
+	uint32_t bodyCount;
+	uint32_t occupiedCells;
+	uint32_t cellChanges;                // bodies that changed cells before the last pair pass
+	uint32_t pairCount;                  // found by the last pair pass, including dropped
+	uint32_t droppedPairs;               // did not fit the caller's buffer
+} broadphaseStats;
+
+broadphase *broadphaseCreate(const broadphaseCreateInfo *createInfo);
+void broadphaseDestroy(broadphase *bp);
+
+// Inserts the body or moves it to a new box.
+void broadphaseSet(broadphase *bp, uint32_t body, const bpBox *box);
+
+// broadphaseSet for bodies [first, first + count), boxes[0] going to first.
+void broadphaseSetRange(broadphase *bp, uint32_t first, uint32_t count, const bpBox *boxes);
+void broadphaseRemove(broadphase *bp, uint32_t body);
+
+// Overlapping pairs in no particular order. Returns how many were written.
+uint32_t broadphaseFindPairs(broadphase *bp, bpPair *pairs, uint32_t capacity);
+
+broadphaseStats broadphaseGetStats(broadphase *bp);
+
+#endif
@@ -0,0 +1,133 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdalign.h>
+
+#include "commandRecorder.h"
+
+#define RECORDER_MAX_FRAMES 4
+
+// One per (thread, slot); cache line aligned so threads do not share lines.
+typedef struct recorderPool
+{
+	alignas(64) VkCommandPool pool;
+	VkCommandBuffer *buffers;
+	uint32_t used, count, capacity;
+} recorderPool;
+
+struct commandRecorder
+{
+	VkDevice device;
+	uint32_t threadCount;
+	uint32_t framesInFlight;
+	recorderPool *pools;                 // [thread * framesInFlight + slot]
+};
+
+commandRecorder *commandRecorderCreate(const commandRecorderCreateInfo *createInfo)
+{
+	commandRecorder *recorder = calloc(1, sizeof(commandRecorder));
+	(*recorder).device = (*createInfo).device;
+	(*recorder).threadCount = (*createInfo).threadCount ? (*createInfo).threadCount : 1;
+	(*recorder).framesInFlight = (*createInfo).framesInFlight < RECORDER_MAX_FRAMES ? (*createInfo).framesInFlight : RECORDER_MAX_FRAMES;
+
+	uint32_t poolCount = (*recorder).threadCount * (*recorder).framesInFlight;
+	(*recorder).pools = aligned_alloc(alignof(recorderPool), poolCount * sizeof(recorderPool));
+	memset((*recorder).pools, 0, poolCount * sizeof(recorderPool));
+
+	// Transient without RESET_COMMAND_BUFFER: only whole pools are ever reset.
+	VkCommandPoolCreateInfo poolInfo = {0};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = (*createInfo).queueFamily;
+
+	for (uint32_t i = 0; i < poolCount; i++)
+	{
+		VkResult res = vkCreateCommandPool((*recorder).device, &poolInfo, NULL, &(*recorder).pools[i].pool);
+		if (res != VK_SUCCESS)
+		{
+			printf("failed to create recording command pool %u (%d)\n", i, res);
+			commandRecorderDestroy(recorder);
+			return NULL;
+		}
+	}
+
+	return recorder;
+}
+
+// The device must be idle.
+void commandRecorderDestroy(commandRecorder *recorder)
+{
+	if (recorder == NULL) return;
+
+	// Destroying a pool frees its command buffers.
+	for (uint32_t i = 0; i < (*recorder).threadCount * (*recorder).framesInFlight; i++)
+	{
+		vkDestroyCommandPool((*recorder).device, (*recorder).pools[i].pool, NULL);
+		free((*recorder).pools[i].buffers);
+	}
+
+	free((*recorder).pools);
+	free(recorder);
+}
+
+void commandRecorderBeginFrame(commandRecorder *recorder, uint32_t frameSlot)
+{
+	for (uint32_t thread = 0; thread < (*recorder).threadCount; thread++)
+	{
+		recorderPool *pool = &(*recorder).pools[thread * (*recorder).framesInFlight + frameSlot];
+		if ((*pool).used == 0) continue;
+
+		vkResetCommandPool((*recorder).device, (*pool).pool, 0);
+		(*pool).used = 0;
+	}
+}
+
+VkCommandBuffer commandRecorderBegin(commandRecorder *recorder, uint32_t frameSlot, uint32_t thread, const VkCommandBufferInheritanceInfo *inheritance)
+{
+	if (thread >= (*recorder).threadCount)
+	{
+		printf("command recorder has no pool for thread %u\n", thread);
+		return VK_NULL_HANDLE;
+	}
+
+	recorderPool *pool = &(*recorder).pools[thread * (*recorder).framesInFlight + frameSlot];
+
+	if ((*pool).used == (*pool).count)
+	{
+		if ((*pool).count == (*pool).capacity)
+		{
+			(*pool).capacity = (*pool).capacity ? 2 * (*pool).capacity : 8;
+			(*pool).buffers = realloc((*pool).buffers, (*pool).capacity * sizeof(VkCommandBuffer));
+		}
+
+		VkCommandBufferAllocateInfo allocInfo = {0};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = (*pool).pool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkResult res = vkAllocateCommandBuffers((*recorder).device, &allocInfo, &(*pool).buffers[(*pool).count]);
+		if (res != VK_SUCCESS)
+		{
+			printf("vkAllocateCommandBuffers() failed (%d)\n", res);
+			return VK_NULL_HANDLE;
+		}
+		(*pool).count++;
+	}
+
+	VkCommandBuffer commandBuffer = (*pool).buffers[(*pool).used++];
+
+	VkCommandBufferBeginInfo beginInfo = {0};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if ((*inheritance).renderPass != VK_NULL_HANDLE) beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = inheritance;
+
+	VkResult res = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	if (res != VK_SUCCESS)
+	{
+		printf("vkBeginCommandBuffer() failed (%d)\n", res);
+		return VK_NULL_HANDLE;
+	}
+	return commandBuffer;
+}
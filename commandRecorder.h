@@ -0,0 +1,38 @@
+#ifndef COMMAND_RECORDER_H
+#define COMMAND_RECORDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+// Secondary command buffers for recording on several threads. Every (thread,
+// frame slot) pair owns a transient command pool, so threads never share a pool
+// and a whole slot is recycled with one vkResetCommandPool per thread once its
+// fence has signalled; buffers are never reset one by one. Buffers handed out in
+// a frame stay valid until the slot's next commandRecorderBeginFrame.
+// commandRecorderBegin is safe to call concurrently as long as every thread
+// passes its own index, e.g. jobWorkerIndex().
+
+typedef struct commandRecorder commandRecorder;
+
+typedef struct commandRecorderCreateInfo
+{
+	VkDevice device;
+	uint32_t queueFamily;
+	uint32_t threadCount;
+	uint32_t framesInFlight;
+} commandRecorderCreateInfo;
+
+commandRecorder *commandRecorderCreate(const commandRecorderCreateInfo *createInfo);
+void commandRecorderDestroy(commandRecorder *recorder);
+
+// Call from one thread once the slot's fence has signalled, before any Begin for it.
+void commandRecorderBeginFrame(commandRecorder *recorder, uint32_t frameSlot);
+
+// A begun secondary command buffer; the caller ends it. With a render pass in the
+// inheritance info it continues that render pass. VK_NULL_HANDLE when it could
+// not be allocated or begun.
+VkCommandBuffer commandRecorderBegin(commandRecorder *recorder, uint32_t frameSlot, uint32_t thread, const VkCommandBufferInheritanceInfo *inheritance);
+
+#endif
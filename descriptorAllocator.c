@@ -0,0 +1,363 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "descriptorAllocator.h"
+
+#define DESCRIPTOR_MAX_FRAMES 4
+#define DESCRIPTOR_MAX_POOL_GROWTH 3
+
+static const descriptorPoolRatio defaultRatios[] =
+{
+	{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
+	{VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f},
+	{VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f},
+	{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f},
+	{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f},
+	{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+	{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f}
+};
+
+typedef struct descriptorSlot
+{
+	VkDescriptorPool *pools;
+	uint32_t poolCount, poolCapacity;
+	uint32_t current;                    // pool sets are taken from
+	uint32_t currentSets;                // sets taken from it this frame
+	uint32_t setCount;
+} descriptorSlot;
+
+struct descriptorAllocator
+{
+	VkDevice device;
+	uint32_t framesInFlight;
+	uint32_t setsPerPool;
+	descriptorPoolRatio *ratios;
+	uint32_t ratioCount;
+
+	descriptorSlot slots[DESCRIPTOR_MAX_FRAMES];
+	uint32_t lastSlot;
+	uint32_t spillCount;
+};
+
+// Canonical form of one binding: what makes two layouts interchangeable.
+typedef struct layoutKeyBinding
+{
+	uint32_t binding;
+	VkDescriptorType type;
+	uint32_t count;
+	VkShaderStageFlags stages;
+	VkDescriptorBindingFlagsEXT flags;
+	const VkSampler *immutableSamplers;
+} layoutKeyBinding;
+
+typedef struct layoutEntry
+{
+	uint64_t hash;
+	VkDescriptorSetLayoutCreateFlags flags;
+	layoutKeyBinding *bindings;
+	VkSampler *samplers;                 // copies, bindings point into this
+	uint32_t bindingCount;
+	VkDescriptorSetLayout layout;
+} layoutEntry;
+
+struct descriptorLayoutCache
+{
+	VkDevice device;
+
+	layoutEntry *entries;
+	uint32_t entryCount, entryCapacity;
+
+	// Open addressing over entry indices, UINT32_MAX marks an empty bucket.
+	uint32_t *buckets;
+	uint32_t bucketCount;
+};
+
+descriptorAllocator *descriptorAllocatorCreate(const descriptorAllocatorCreateInfo *createInfo)
+{
+	descriptorAllocator *allocator = calloc(1, sizeof(descriptorAllocator));
+	(*allocator).device = (*createInfo).device;
+	(*allocator).framesInFlight = (*createInfo).framesInFlight < DESCRIPTOR_MAX_FRAMES ? (*createInfo).framesInFlight : DESCRIPTOR_MAX_FRAMES;
+	(*allocator).setsPerPool = (*createInfo).setsPerPool ? (*createInfo).setsPerPool : 64;
+
+	const descriptorPoolRatio *ratios = (*createInfo).ratios ? (*createInfo).ratios : defaultRatios;
+	(*allocator).ratioCount = (*createInfo).ratios ? (*createInfo).ratioCount : sizeof(defaultRatios) / sizeof(defaultRatios[0]);
+	(*allocator).ratios = malloc((*allocator).ratioCount * sizeof(descriptorPoolRatio));
+	memcpy((*allocator).ratios, ratios, (*allocator).ratioCount * sizeof(descriptorPoolRatio));
+
+	return allocator;
+}
+
+// The device must be idle.
+void descriptorAllocatorDestroy(descriptorAllocator *allocator)
+{
+	if (allocator == NULL) return;
+
+	for (uint32_t i = 0; i < DESCRIPTOR_MAX_FRAMES; i++)
+	{
+		descriptorSlot *slot = &(*allocator).slots[i];
+		for (uint32_t p = 0; p < (*slot).poolCount; p++) vkDestroyDescriptorPool((*allocator).device, (*slot).pools[p], NULL);
+		free((*slot).pools);
+	}
+
+	free((*allocator).ratios);
+	free(allocator);
+}
+
+void descriptorAllocatorBeginFrame(descriptorAllocator *allocator, uint32_t frameSlot)
+{
+	descriptorSlot *slot = &(*allocator).slots[frameSlot];
+
+	// Pools past current were not touched since the last reset.
+	for (uint32_t p = 0; p <= (*slot).current && p < (*slot).poolCount; p++)
+		vkResetDescriptorPool((*allocator).device, (*slot).pools[p], 0);
+
+	(*slot).current = 0;
+	(*slot).currentSets = 0;
+	(*slot).setCount = 0;
+	(*allocator).lastSlot = frameSlot;
+}
+
+static VkResult addPool(descriptorAllocator *allocator, descriptorSlot *slot)
+{
+	uint32_t growth = (*slot).poolCount < DESCRIPTOR_MAX_POOL_GROWTH ? (*slot).poolCount : DESCRIPTOR_MAX_POOL_GROWTH;
+	uint32_t sets = (*allocator).setsPerPool << growth;
+
+	VkDescriptorPoolSize sizes[16];
+	uint32_t sizeCount = (*allocator).ratioCount < 16 ? (*allocator).ratioCount : 16;
+	for (uint32_t i = 0; i < sizeCount; i++)
+	{
+		uint32_t count = (uint32_t)((*allocator).ratios[i].ratio * (float)sets + 0.5f);
+		sizes[i] = (VkDescriptorPoolSize){(*allocator).ratios[i].type, count ? count : 1};
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo = {0};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = sets;
+	poolInfo.poolSizeCount = sizeCount;
+	poolInfo.pPoolSizes = sizes;
+
+	VkDescriptorPool pool;
+	VkResult res = vkCreateDescriptorPool((*allocator).device, &poolInfo, NULL, &pool);
+	if (res != VK_SUCCESS)
+	{
+		printf("vkCreateDescriptorPool() failed (%d)\n", res);
+		return res;
+	}
+
+	if ((*slot).poolCount == (*slot).poolCapacity)
+	{
+		(*slot).poolCapacity = (*slot).poolCapacity ? 2 * (*slot).poolCapacity : 4;
+		(*slot).pools = realloc((*slot).pools, (*slot).poolCapacity * sizeof(VkDescriptorPool));
+	}
+	(*slot).pools[(*slot).poolCount++] = pool;
+	return VK_SUCCESS;
+}
+
+VkDescriptorSet descriptorAllocate(descriptorAllocator *allocator, uint32_t frameSlot, VkDescriptorSetLayout layout)
+{
+	descriptorSlot *slot = &(*allocator).slots[frameSlot];
+
+	for (;;)
+	{
+		if ((*slot).current == (*slot).poolCount && addPool(allocator, slot) != VK_SUCCESS) return VK_NULL_HANDLE;
+
+		VkDescriptorSetAllocateInfo setInfo = {0};
+		setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		setInfo.descriptorPool = (*slot).pools[(*slot).current];
+		setInfo.descriptorSetCount = 1;
+		setInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet set;
+		VkResult res = vkAllocateDescriptorSets((*allocator).device, &setInfo, &set);
+		if (res == VK_SUCCESS)
+		{
+			(*slot).currentSets++;
+			(*slot).setCount++;
+			return set;
+		}
+
+		if ((res != VK_ERROR_OUT_OF_POOL_MEMORY && res != VK_ERROR_FRAGMENTED_POOL) || (*slot).currentSets == 0)
+		{
+			printf("vkAllocateDescriptorSets() failed (%d)\n", res);
+			return VK_NULL_HANDLE;
+		}
+
+		(*slot).current++;
+		(*slot).currentSets = 0;
+		(*allocator).spillCount++;
+	}
+}
+
+descriptorAllocatorStats descriptorAllocatorGetStats(descriptorAllocator *allocator)
+{
+	descriptorAllocatorStats stats = {0};
+	for (uint32_t i = 0; i < (*allocator).framesInFlight; i++) stats.poolCount += (*allocator).slots[i].poolCount;
+	stats.setCount = (*allocator).slots[(*allocator).lastSlot].setCount;
+	stats.spillCount = (*allocator).spillCount;
+	return stats;
+}
+
+descriptorLayoutCache *descriptorLayoutCacheCreate(VkDevice device)
+{
+	descriptorLayoutCache *cache = calloc(1, sizeof(descriptorLayoutCache));
+	(*cache).device = device;
+	(*cache).bucketCount = 64;
+	(*cache).buckets = malloc((*cache).bucketCount * sizeof(uint32_t));
+	memset((*cache).buckets, 0xFF, (*cache).bucketCount * sizeof(uint32_t));
+	return cache;
+}
+
+// The device must be idle.
+void descriptorLayoutCacheDestroy(descriptorLayoutCache *cache)
+{
+	if (cache == NULL) return;
+
+	for (uint32_t i = 0; i < (*cache).entryCount; i++)
+	{
+		vkDestroyDescriptorSetLayout((*cache).device, (*cache).entries[i].layout, NULL);
+		free((*cache).entries[i].bindings);
+		free((*cache).entries[i].samplers);
+	}
+
+	free((*cache).entries);
+	free((*cache).buckets);
+	free(cache);
+}
+
+static int compareBindings(const void *a, const void *b)
+{
+	const layoutKeyBinding *left = a, *right = b;
+	return (*left).binding < (*right).binding ? -1 : (*left).binding > (*right).binding;
+}
+
+static inline uint64_t hashWord(uint64_t hash, uint64_t word)
+{
+	// FNV-1a over the 8 bytes of the word.
+	for (uint32_t i = 0; i < 8; i++)
+	{
+		hash ^= (word >> (8 * i)) & 0xFF;
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+static uint64_t hashKey(VkDescriptorSetLayoutCreateFlags flags, const layoutKeyBinding *bindings, uint32_t count)
+{
+	uint64_t hash = hashWord(0xCBF29CE484222325ull, flags);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		hash = hashWord(hash, (uint64_t)bindings[i].binding << 32 | (uint32_t)bindings[i].type);
+		hash = hashWord(hash, (uint64_t)bindings[i].count << 32 | bindings[i].stages);
+		hash = hashWord(hash, bindings[i].flags);
+
+		if (bindings[i].immutableSamplers != NULL)
+			for (uint32_t s = 0; s < bindings[i].count; s++) hash = hashWord(hash, (uint64_t)bindings[i].immutableSamplers[s]);
+	}
+	return hash;
+}
+
+static bool keysEqual(const layoutEntry *entry, VkDescriptorSetLayoutCreateFlags flags, const layoutKeyBinding *bindings, uint32_t count)
+{
+	if ((*entry).flags != flags || (*entry).bindingCount != count) return false;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const layoutKeyBinding *a = &(*entry).bindings[i], *b = &bindings[i];
+		if ((*a).binding != (*b).binding || (*a).type != (*b).type || (*a).count != (*b).count
+			|| (*a).stages != (*b).stages || (*a).flags != (*b).flags) return false;
+
+		if (((*a).immutableSamplers == NULL) != ((*b).immutableSamplers == NULL)) return false;
+		if ((*a).immutableSamplers != NULL && memcmp((*a).immutableSamplers, (*b).immutableSamplers, (*a).count * sizeof(VkSampler)) != 0) return false;
+	}
+	return true;
+}
+
+static void insertBucket(descriptorLayoutCache *cache, uint32_t entryIndex)
+{
+	uint32_t mask = (*cache).bucketCount - 1;
+	uint32_t bucket = (uint32_t)(*cache).entries[entryIndex].hash & mask;
+	while ((*cache).buckets[bucket] != UINT32_MAX) bucket = (bucket + 1) & mask;
+	(*cache).buckets[bucket] = entryIndex;
+}
+
+VkDescriptorSetLayout descriptorLayoutGet(descriptorLayoutCache *cache, const VkDescriptorSetLayoutCreateInfo *createInfo)
+{
+	const VkDescriptorSetLayoutBindingFlagsCreateInfoEXT *bindingFlags = NULL;
+	for (const VkBaseInStructure *next = (*createInfo).pNext; next != NULL; next = (*next).pNext)
+		if ((*next).sType == VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT)
+			bindingFlags = (const VkDescriptorSetLayoutBindingFlagsCreateInfoEXT *)next;
+
+	uint32_t count = (*createInfo).bindingCount;
+	layoutKeyBinding *bindings = malloc((count ? count : 1) * sizeof(layoutKeyBinding));
+	uint32_t samplerCount = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const VkDescriptorSetLayoutBinding *binding = &(*createInfo).pBindings[i];
+		bool immutable = (*binding).pImmutableSamplers != NULL
+			&& ((*binding).descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER || (*binding).descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+
+		bindings[i].binding = (*binding).binding;
+		bindings[i].type = (*binding).descriptorType;
+		bindings[i].count = (*binding).descriptorCount;
+		bindings[i].stages = (*binding).stageFlags;
+		bindings[i].flags = bindingFlags != NULL && i < (*bindingFlags).bindingCount ? (*bindingFlags).pBindingFlags[i] : 0;
+		bindings[i].immutableSamplers = immutable ? (*binding).pImmutableSamplers : NULL;
+		if (immutable) samplerCount += (*binding).descriptorCount;
+	}
+	qsort(bindings, count, sizeof(layoutKeyBinding), compareBindings);
+
+	uint64_t hash = hashKey((*createInfo).flags, bindings, count);
+	uint32_t mask = (*cache).bucketCount - 1;
+
+	for (uint32_t bucket = (uint32_t)hash & mask; (*cache).buckets[bucket] != UINT32_MAX; bucket = (bucket + 1) & mask)
+	{
+		const layoutEntry *entry = &(*cache).entries[(*cache).buckets[bucket]];
+		if ((*entry).hash == hash && keysEqual(entry, (*createInfo).flags, bindings, count))
+		{
+			free(bindings);
+			return (*entry).layout;
+		}
+	}
+
+	VkDescriptorSetLayout layout;
+	VkResult res = vkCreateDescriptorSetLayout((*cache).device, createInfo, NULL, &layout);
+	if (res != VK_SUCCESS)
+	{
+		printf("vkCreateDescriptorSetLayout() failed (%d)\n", res);
+		free(bindings);
+		return VK_NULL_HANDLE;
+	}
+
+	// Keep our own copy of the immutable samplers; the caller's array may not outlive the call.
+	VkSampler *samplers = samplerCount ? malloc(samplerCount * sizeof(VkSampler)) : NULL;
+	for (uint32_t i = 0, s = 0; i < count; i++)
+	{
+		if (bindings[i].immutableSamplers == NULL) continue;
+		memcpy(samplers + s, bindings[i].immutableSamplers, bindings[i].count * sizeof(VkSampler));
+		bindings[i].immutableSamplers = samplers + s;
+		s += bindings[i].count;
+	}
+
+	if ((*cache).entryCount == (*cache).entryCapacity)
+	{
+		(*cache).entryCapacity = (*cache).entryCapacity ? 2 * (*cache).entryCapacity : 16;
+		(*cache).entries = realloc((*cache).entries, (*cache).entryCapacity * sizeof(layoutEntry));
+	}
+	(*cache).entries[(*cache).entryCount++] = (layoutEntry){hash, (*createInfo).flags, bindings, samplers, count, layout};
+
+	// Stay at most half full so probes stay short.
+	if (2 * (*cache).entryCount > (*cache).bucketCount)
+	{
+		(*cache).bucketCount *= 2;
+		(*cache).buckets = realloc((*cache).buckets, (*cache).bucketCount * sizeof(uint32_t));
+		memset((*cache).buckets, 0xFF, (*cache).bucketCount * sizeof(uint32_t));
+		for (uint32_t i = 0; i < (*cache).entryCount; i++) insertBucket(cache, i);
+	} else
+	{
+		insertBucket(cache, (*cache).entryCount - 1);
+	}
+
+	return layout;
+}
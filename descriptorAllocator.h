@@ -0,0 +1,60 @@
+#ifndef DESCRIPTOR_ALLOCATOR_H
+#define DESCRIPTOR_ALLOCATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+// Descriptor sets for the non-bindless paths. Every frame slot owns a growing list
+// of pools; sets are bump allocated from the current pool, spill into the next one
+// when it runs dry and are never freed one by one. The whole slot is recycled with
+// vkResetDescriptorPool once its fence has signalled. The layout cache makes sure
+// every distinct binding list becomes exactly one VkDescriptorSetLayout.
+// Neither is thread safe: give each recording thread its own allocator.
+
+typedef struct descriptorAllocator descriptorAllocator;
+typedef struct descriptorLayoutCache descriptorLayoutCache;
+
+// Descriptors of a type per set, on average; pools are sized setsPerPool * ratio.
+typedef struct descriptorPoolRatio
+{
+	VkDescriptorType type;
+	float ratio;
+} descriptorPoolRatio;
+
+typedef struct descriptorAllocatorCreateInfo
+{
+	VkDevice device;
+	uint32_t framesInFlight;
+	uint32_t setsPerPool;                // first pool of a slot, later ones double up to 8x
+	const descriptorPoolRatio *ratios;   // NULL for a general purpose mix
+	uint32_t ratioCount;
+} descriptorAllocatorCreateInfo;
+
+typedef struct descriptorAllocatorStats
+{
+	uint32_t poolCount;                  // over every slot
+	uint32_t setCount;                   // allocated in the most recent frame
+	uint32_t spillCount;                 // pools that ran dry, since creation
+} descriptorAllocatorStats;
+
+descriptorAllocator *descriptorAllocatorCreate(const descriptorAllocatorCreateInfo *createInfo);
+void descriptorAllocatorDestroy(descriptorAllocator *allocator);
+
+// Call once the slot's fence has signalled; every set handed out for it becomes invalid.
+void descriptorAllocatorBeginFrame(descriptorAllocator *allocator, uint32_t frameSlot);
+
+// VK_NULL_HANDLE only when a brand new pool cannot hold the layout either.
+VkDescriptorSet descriptorAllocate(descriptorAllocator *allocator, uint32_t frameSlot, VkDescriptorSetLayout layout);
+descriptorAllocatorStats descriptorAllocatorGetStats(descriptorAllocator *allocator);
+
+descriptorLayoutCache *descriptorLayoutCacheCreate(VkDevice device);
+void descriptorLayoutCacheDestroy(descriptorLayoutCache *cache);
+
+// Bindings may come in any order. Layout flags, binding flags from a chained
+// VkDescriptorSetLayoutBindingFlagsCreateInfoEXT and immutable samplers are part
+// of the key. The cache owns the returned layout.
+VkDescriptorSetLayout descriptorLayoutGet(descriptorLayoutCache *cache, const VkDescriptorSetLayoutCreateInfo *createInfo);
+
+#endif
@@ -0,0 +1,466 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ecs.h"
+#include "growArray.h"
+
+#define ECS_NONE UINT32_MAX
+#define ECS_COLUMN_ALIGNMENT 64
+
+typedef struct ecsChunk
+{
+	uint8_t *data;                       // entity handles, then one column per component
+	uint32_t count;
+} ecsChunk;
+
+typedef struct ecsArchetype
+{
+	ecsMask mask;
+	uint32_t capacity;                   // entities per chunk
+	size_t chunkBytes;
+	uint32_t offsets[ECS_MAX_COMPONENTS];
+	ecsComponent columns[ECS_MAX_COMPONENTS];
+	uint32_t columnCount;
+
+	// Every chunk below chunkCount is full except the last; the ones past it are
+	// empty spares kept for reuse.
+	ecsChunk *chunks;
+	uint32_t chunkCount, chunkCapacity;
+	uint32_t entityCount;
+
+	// Archetype reached by adding or removing one component, ECS_NONE until first used.
+	uint32_t addEdges[ECS_MAX_COMPONENTS];
+	uint32_t removeEdges[ECS_MAX_COMPONENTS];
+} ecsArchetype;
+
+// Free records chain through row with archetype ECS_NONE.
+typedef struct ecsRecord
+{
+	uint32_t generation;
+	uint32_t archetype;
+	uint32_t chunk, row;
+} ecsRecord;
+
+struct ecsQuery
+{
+	ecsMask all, none;
+	uint32_t *archetypes;
+	uint32_t archetypeCount, archetypeCapacity;
+	uint32_t scanned;                    // archetypes already tested
+	ecsView *views;
+	uint32_t viewCapacity;
+};
+
+struct ecsWorld
+{
+	uint32_t componentSizes[ECS_MAX_COMPONENTS];
+	const char *componentNames[ECS_MAX_COMPONENTS];
+	uint32_t componentCount;
+
+	ecsArchetype *archetypes;
+	uint32_t archetypeCount, archetypeCapacity;
+	uint32_t *archetypeMap;              // open addressing on the mask
+	uint32_t mapCapacity;
+
+	ecsRecord *records;
+	uint32_t recordCount, recordCapacity;
+	uint32_t freeRecord;
+	uint32_t entityCount;
+
+	ecsQuery **queries;
+	uint32_t queryCount, queryCapacity;
+};
+
+static inline uint32_t entityIndex(ecsEntity entity)
+{
+	return (uint32_t)entity;
+}
+
+static inline uint32_t hashMask(ecsMask mask)
+{
+	return (uint32_t)((mask * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+static inline size_t alignColumn(size_t offset)
+{
+	return (offset + ECS_COLUMN_ALIGNMENT - 1) & ~(size_t)(ECS_COLUMN_ALIGNMENT - 1);
+}
+
+ecsWorld *ecsWorldCreate(void)
+{
+	ecsWorld *world = calloc(1, sizeof(ecsWorld));
+	(*world).freeRecord = ECS_NONE;
+	(*world).mapCapacity = 64;
+	(*world).archetypeMap = malloc((*world).mapCapacity * sizeof(uint32_t));
+	memset((*world).archetypeMap, 0xFF, (*world).mapCapacity * sizeof(uint32_t));
+	return world;
+}
+
+void ecsWorldDestroy(ecsWorld *world)
+{
+	if (world == NULL) return;
+
+	for (uint32_t i = 0; i < (*world).archetypeCount; i++)
+	{
+		ecsArchetype *archetype = &(*world).archetypes[i];
+		for (uint32_t c = 0; c < (*archetype).chunkCapacity; c++) free((*archetype).chunks[c].data);
+		free((*archetype).chunks);
+	}
+
+	for (uint32_t i = 0; i < (*world).queryCount; i++)
+	{
+		free((*(*world).queries[i]).archetypes);
+		free((*(*world).queries[i]).views);
+		free((*world).queries[i]);
+	}
+
+	free((*world).queries);
+	free((*world).records);
+	free((*world).archetypeMap);
+	free((*world).archetypes);
+	free(world);
+}
+
+ecsComponent ecsRegisterComponent(ecsWorld *world, const char *name, uint32_t size)
+{
+	if ((*world).componentCount == ECS_MAX_COMPONENTS)
+	{
+		printf("too many ECS components, %s not registered\n", name);
+		return ECS_INVALID_COMPONENT;
+	}
+
+	ecsComponent component = (*world).componentCount++;
+	(*world).componentSizes[component] = size;
+	(*world).componentNames[component] = name;
+	return component;
+}
+
+// Most entities per chunk such that every column, 64-byte aligned, still fits.
+static void layoutArchetype(ecsWorld *world, ecsArchetype *archetype)
+{
+	size_t rowBytes = sizeof(ecsEntity);
+	for (uint32_t i = 0; i < (*archetype).columnCount; i++) rowBytes += (*world).componentSizes[(*archetype).columns[i]];
+
+	uint32_t capacity = (uint32_t)(ECS_CHUNK_SIZE / rowBytes);
+	size_t end = 0;
+	for (; capacity > 1; capacity--)
+	{
+		end = alignColumn(sizeof(ecsEntity) * capacity);
+		for (uint32_t i = 0; i < (*archetype).columnCount; i++)
+			end = alignColumn(end + (size_t)(*world).componentSizes[(*archetype).columns[i]] * capacity);
+		if (end <= ECS_CHUNK_SIZE) break;
+	}
+	if (capacity < 1) capacity = 1;
+
+	// Columns are laid out for the capacity found; oversized rows get a bigger chunk.
+	size_t offset = alignColumn(sizeof(ecsEntity) * capacity);
+	for (uint32_t i = 0; i < (*archetype).columnCount; i++)
+	{
+		ecsComponent component = (*archetype).columns[i];
+		(*archetype).offsets[component] = (uint32_t)offset;
+		offset = alignColumn(offset + (size_t)(*world).componentSizes[component] * capacity);
+	}
+
+	(*archetype).capacity = capacity;
+	(*archetype).chunkBytes = offset > ECS_CHUNK_SIZE ? offset : ECS_CHUNK_SIZE;
+}
+
+static void insertArchetype(ecsWorld *world, uint32_t index)
+{
+	uint32_t mask = (*world).mapCapacity - 1;
+	uint32_t slot = hashMask((*world).archetypes[index].mask) & mask;
+	while ((*world).archetypeMap[slot] != ECS_NONE) slot = (slot + 1) & mask;
+	(*world).archetypeMap[slot] = index;
+}
+
+static uint32_t findArchetype(ecsWorld *world, ecsMask components)
+{
+	uint32_t mask = (*world).mapCapacity - 1;
+	for (uint32_t slot = hashMask(components) & mask; (*world).archetypeMap[slot] != ECS_NONE; slot = (slot + 1) & mask)
+		if ((*world).archetypes[(*world).archetypeMap[slot]].mask == components) return (*world).archetypeMap[slot];
+
+	GROW((*world).archetypes, (*world).archetypeCount, (*world).archetypeCapacity, 16);
+	uint32_t index = (*world).archetypeCount++;
+
+	ecsArchetype *archetype = &(*world).archetypes[index];
+	memset(archetype, 0, sizeof(ecsArchetype));
+	(*archetype).mask = components;
+	memset((*archetype).offsets, 0xFF, sizeof((*archetype).offsets));
+	memset((*archetype).addEdges, 0xFF, sizeof((*archetype).addEdges));
+	memset((*archetype).removeEdges, 0xFF, sizeof((*archetype).removeEdges));
+
+	for (ecsComponent component = 0; component < ECS_MAX_COMPONENTS; component++)
+		if ((components & ECS_MASK(component)) && (*world).componentSizes[component] > 0) (*archetype).columns[(*archetype).columnCount++] = component;
+	layoutArchetype(world, archetype);
+
+	// Stay at most half full.
+	if (2 * (*world).archetypeCount > (*world).mapCapacity)
+	{
+		(*world).mapCapacity *= 2;
+		(*world).archetypeMap = realloc((*world).archetypeMap, (*world).mapCapacity * sizeof(uint32_t));
+		memset((*world).archetypeMap, 0xFF, (*world).mapCapacity * sizeof(uint32_t));
+		for (uint32_t i = 0; i < (*world).archetypeCount; i++) insertArchetype(world, i);
+	} else
+	{
+		insertArchetype(world, index);
+	}
+
+	return index;
+}
+
+// Appends a zeroed row for the entity and points its record there.
+static void appendRow(ecsWorld *world, uint32_t archetypeIndex, ecsEntity entity)
+{
+	ecsArchetype *archetype = &(*world).archetypes[archetypeIndex];
+
+	if ((*archetype).chunkCount == 0 || (*archetype).chunks[(*archetype).chunkCount - 1].count == (*archetype).capacity)
+	{
+		if ((*archetype).chunkCount == (*archetype).chunkCapacity)
+		{
+			GROW((*archetype).chunks, (*archetype).chunkCapacity, (*archetype).chunkCapacity, 4);
+			for (uint32_t c = (*archetype).chunkCount; c < (*archetype).chunkCapacity; c++) (*archetype).chunks[c] = (ecsChunk){NULL, 0};
+		}
+
+		ecsChunk *chunk = &(*archetype).chunks[(*archetype).chunkCount];
+		if ((*chunk).data == NULL) (*chunk).data = aligned_alloc(ECS_COLUMN_ALIGNMENT, (*archetype).chunkBytes);
+		(*chunk).count = 0;
+		(*archetype).chunkCount++;
+	}
+
+	uint32_t chunkIndex = (*archetype).chunkCount - 1;
+	ecsChunk *chunk = &(*archetype).chunks[chunkIndex];
+	uint32_t row = (*chunk).count++;
+
+	((ecsEntity *)(*chunk).data)[row] = entity;
+	for (uint32_t i = 0; i < (*archetype).columnCount; i++)
+	{
+		ecsComponent component = (*archetype).columns[i];
+		uint32_t size = (*world).componentSizes[component];
+		memset((*chunk).data + (*archetype).offsets[component] + (size_t)row * size, 0, size);
+	}
+
+	(*archetype).entityCount++;
+
+	ecsRecord *record = &(*world).records[entityIndex(entity)];
+	(*record).archetype = archetypeIndex;
+	(*record).chunk = chunkIndex;
+	(*record).row = row;
+}
+
+// Fills the hole with the archetype's last row so chunks stay dense.
+static void removeRow(ecsWorld *world, uint32_t archetypeIndex, uint32_t chunkIndex, uint32_t row)
+{
+	ecsArchetype *archetype = &(*world).archetypes[archetypeIndex];
+	uint32_t lastChunkIndex = (*archetype).chunkCount - 1;
+	ecsChunk *lastChunk = &(*archetype).chunks[lastChunkIndex];
+	uint32_t lastRow = (*lastChunk).count - 1;
+
+	if (chunkIndex != lastChunkIndex || row != lastRow)
+	{
+		ecsChunk *chunk = &(*archetype).chunks[chunkIndex];
+		ecsEntity moved = ((ecsEntity *)(*lastChunk).data)[lastRow];
+		((ecsEntity *)(*chunk).data)[row] = moved;
+
+		for (uint32_t i = 0; i < (*archetype).columnCount; i++)
+		{
+			ecsComponent component = (*archetype).columns[i];
+			uint32_t size = (*world).componentSizes[component];
+			uint32_t offset = (*archetype).offsets[component];
+			memcpy((*chunk).data + offset + (size_t)row * size, (*lastChunk).data + offset + (size_t)lastRow * size, size);
+		}
+
+		ecsRecord *record = &(*world).records[entityIndex(moved)];
+		(*record).chunk = chunkIndex;
+		(*record).row = row;
+	}
+
+	if (--(*lastChunk).count == 0) (*archetype).chunkCount--;
+	(*archetype).entityCount--;
+}
+
+ecsEntity ecsCreate(ecsWorld *world, ecsMask components)
+{
+	uint32_t index = (*world).freeRecord;
+	if (index != ECS_NONE)
+	{
+		(*world).freeRecord = (*world).records[index].row;
+	} else
+	{
+		GROW((*world).records, (*world).recordCount, (*world).recordCapacity, 1024);
+		index = (*world).recordCount++;
+		(*world).records[index].generation = 1;
+	}
+
+	ecsEntity entity = (ecsEntity)(*world).records[index].generation << 32 | index;
+	appendRow(world, findArchetype(world, components), entity);
+	(*world).entityCount++;
+	return entity;
+}
+
+bool ecsAlive(ecsWorld *world, ecsEntity entity)
+{
+	uint32_t index = entityIndex(entity);
+	return index < (*world).recordCount && (*world).records[index].archetype != ECS_NONE
+		&& (*world).records[index].generation == (uint32_t)(entity >> 32);
+}
+
+void ecsDestroy(ecsWorld *world, ecsEntity entity)
+{
+	if (!ecsAlive(world, entity)) return;
+
+	uint32_t index = entityIndex(entity);
+	ecsRecord *record = &(*world).records[index];
+	removeRow(world, (*record).archetype, (*record).chunk, (*record).row);
+
+	// Generation 0 is never handed out, so ECS_NULL_ENTITY never matches.
+	if (++(*record).generation == 0) (*record).generation = 1;
+	(*record).archetype = ECS_NONE;
+	(*record).row = (*world).freeRecord;
+	(*world).freeRecord = index;
+	(*world).entityCount--;
+}
+
+static void moveEntity(ecsWorld *world, ecsEntity entity, uint32_t target)
+{
+	ecsRecord source = (*world).records[entityIndex(entity)];
+	if (source.archetype == target) return;
+
+	appendRow(world, target, entity);
+	const ecsRecord *moved = &(*world).records[entityIndex(entity)];
+
+	// Components both archetypes have keep their data; column sizes match by component.
+	const ecsArchetype *from = &(*world).archetypes[source.archetype];
+	const ecsArchetype *to = &(*world).archetypes[target];
+	const uint8_t *src = (*from).chunks[source.chunk].data;
+	uint8_t *dst = (*to).chunks[(*moved).chunk].data;
+
+	for (uint32_t i = 0; i < (*to).columnCount; i++)
+	{
+		ecsComponent component = (*to).columns[i];
+		if ((*from).offsets[component] == ECS_NONE) continue;
+
+		uint32_t size = (*world).componentSizes[component];
+		memcpy(dst + (*to).offsets[component] + (size_t)(*moved).row * size, src + (*from).offsets[component] + (size_t)source.row * size, size);
+	}
+
+	removeRow(world, source.archetype, source.chunk, source.row);
+}
+
+void ecsMigrate(ecsWorld *world, ecsEntity entity, ecsMask components)
+{
+	if (!ecsAlive(world, entity)) return;
+	moveEntity(world, entity, findArchetype(world, components));
+}
+
+void ecsAdd(ecsWorld *world, ecsEntity entity, ecsComponent component)
+{
+	if (component >= (*world).componentCount || !ecsAlive(world, entity)) return;
+
+	uint32_t source = (*world).records[entityIndex(entity)].archetype;
+	uint32_t target = (*world).archetypes[source].addEdges[component];
+	if (target == ECS_NONE)
+	{
+		target = findArchetype(world, (*world).archetypes[source].mask | ECS_MASK(component));
+		(*world).archetypes[source].addEdges[component] = target;
+	}
+
+	moveEntity(world, entity, target);
+}
+
+void ecsRemove(ecsWorld *world, ecsEntity entity, ecsComponent component)
+{
+	if (component >= (*world).componentCount || !ecsAlive(world, entity)) return;
+
+	uint32_t source = (*world).records[entityIndex(entity)].archetype;
+	uint32_t target = (*world).archetypes[source].removeEdges[component];
+	if (target == ECS_NONE)
+	{
+		target = findArchetype(world, (*world).archetypes[source].mask & ~ECS_MASK(component));
+		(*world).archetypes[source].removeEdges[component] = target;
+	}
+
+	moveEntity(world, entity, target);
+}
+
+ecsMask ecsGetMask(ecsWorld *world, ecsEntity entity)
+{
+	if (!ecsAlive(world, entity)) return 0;
+	return (*world).archetypes[(*world).records[entityIndex(entity)].archetype].mask;
+}
+
+void *ecsGet(ecsWorld *world, ecsEntity entity, ecsComponent component)
+{
+	if (component >= (*world).componentCount || !ecsAlive(world, entity)) return NULL;
+
+	const ecsRecord *record = &(*world).records[entityIndex(entity)];
+	const ecsArchetype *archetype = &(*world).archetypes[(*record).archetype];
+	uint32_t offset = (*archetype).offsets[component];
+	if (offset == ECS_NONE) return NULL;
+
+	return (*archetype).chunks[(*record).chunk].data + offset + (size_t)(*record).row * (*world).componentSizes[component];
+}
+
+ecsQuery *ecsQueryCreate(ecsWorld *world, ecsMask all, ecsMask none)
+{
+	ecsQuery *query = calloc(1, sizeof(ecsQuery));
+	(*query).all = all;
+	(*query).none = none;
+
+	GROW((*world).queries, (*world).queryCount, (*world).queryCapacity, 16);
+	(*world).queries[(*world).queryCount++] = query;
+	return query;
+}
+
+// Tests archetypes created since the last call.
+static void refreshQuery(ecsWorld *world, ecsQuery *query)
+{
+	for (; (*query).scanned < (*world).archetypeCount; (*query).scanned++)
+	{
+		ecsMask mask = (*world).archetypes[(*query).scanned].mask;
+		if ((mask & (*query).all) != (*query).all || (mask & (*query).none) != 0) continue;
+
+		GROW((*query).archetypes, (*query).archetypeCount, (*query).archetypeCapacity, 8);
+		(*query).archetypes[(*query).archetypeCount++] = (*query).scanned;
+	}
+}
+
+uint32_t ecsQueryViews(ecsWorld *world, ecsQuery *query, const ecsView **views)
+{
+	refreshQuery(world, query);
+
+	uint32_t viewCount = 0;
+	for (uint32_t i = 0; i < (*query).archetypeCount; i++)
+	{
+		const ecsArchetype *archetype = &(*world).archetypes[(*query).archetypes[i]];
+
+		for (uint32_t c = 0; c < (*archetype).chunkCount; c++)
+		{
+			GROW((*query).views, viewCount, (*query).viewCapacity, 16);
+
+			const ecsChunk *chunk = &(*archetype).chunks[c];
+			(*query).views[viewCount++] = (ecsView){(*chunk).count, (const ecsEntity *)(*chunk).data, (*chunk).data, (*archetype).offsets};
+		}
+	}
+
+	*views = (*query).views;
+	return viewCount;
+}
+
+uint32_t ecsQueryCount(ecsWorld *world, ecsQuery *query)
+{
+	refreshQuery(world, query);
+
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < (*query).archetypeCount; i++) count += (*world).archetypes[(*query).archetypes[i]].entityCount;
+	return count;
+}
+
+ecsStats ecsGetStats(ecsWorld *world)
+{
+	ecsStats stats = {0};
+	stats.entityCount = (*world).entityCount;
+	stats.archetypeCount = (*world).archetypeCount;
+	for (uint32_t i = 0; i < (*world).archetypeCount; i++) stats.chunkCount += (*world).archetypes[i].chunkCount;
+	return stats;
+}
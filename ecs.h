@@ -0,0 +1,90 @@
+#ifndef ECS_H
+#define ECS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Archetype entity-component store. Every distinct set of components is an
+// archetype; its entities live in fixed-size chunks (ECS_CHUNK_SIZE, sized for L1
+// and L2) holding one tightly packed column per component, so a query walks plain
+// arrays that the compiler can vectorize. Chunks stay dense: removing an entity
+// moves the archetype's last entity into the hole. Adding or removing a component
+// migrates the entity to another archetype; the archetype graph caches those
+// moves so repeated migrations are a lookup.
+// Component data is plain old data and moves with memcpy. Any structural change
+// (create, destroy, add, remove) invalidates views and component pointers.
+// Not thread safe for structural changes; queries may run concurrently.
+
+#define ECS_MAX_COMPONENTS 64
+#define ECS_CHUNK_SIZE (16 * 1024)
+#define ECS_NULL_ENTITY 0
+#define ECS_INVALID_COMPONENT UINT32_MAX
+
+#define ECS_MASK(component) ((ecsMask)1 << (component))
+
+typedef uint64_t ecsEntity;              // index in the low half, generation in the high half
+typedef uint32_t ecsComponent;
+typedef uint64_t ecsMask;
+
+typedef struct ecsWorld ecsWorld;
+typedef struct ecsQuery ecsQuery;
+
+// One chunk of a matching archetype.
+typedef struct ecsView
+{
+	uint32_t count;
+	const ecsEntity *entities;
+	uint8_t *base;
+	const uint32_t *offsets;             // per component, UINT32_MAX when absent
+} ecsView;
+
+typedef struct ecsStats
+{
+	uint32_t entityCount;
+	uint32_t archetypeCount;
+	uint32_t chunkCount;
+} ecsStats;
+
+ecsWorld *ecsWorldCreate(void);
+void ecsWorldDestroy(ecsWorld *world);
+
+// size 0 makes a tag: part of the mask, no column. Up to ECS_MAX_COMPONENTS, after
+// that ECS_INVALID_COMPONENT, which add, remove, get and ecsViewColumn ignore and
+// ECS_MASK must not see.
+ecsComponent ecsRegisterComponent(ecsWorld *world, const char *name, uint32_t size);
+
+// New components are zeroed.
+ecsEntity ecsCreate(ecsWorld *world, ecsMask components);
+void ecsDestroy(ecsWorld *world, ecsEntity entity);
+bool ecsAlive(ecsWorld *world, ecsEntity entity);
+
+void ecsAdd(ecsWorld *world, ecsEntity entity, ecsComponent component);
+void ecsRemove(ecsWorld *world, ecsEntity entity, ecsComponent component);
+
+// Moves the entity to the archetype of exactly these components.
+void ecsMigrate(ecsWorld *world, ecsEntity entity, ecsMask components);
+
+ecsMask ecsGetMask(ecsWorld *world, ecsEntity entity);
+
+// NULL when the entity lacks the component or it is a tag.
+void *ecsGet(ecsWorld *world, ecsEntity entity, ecsComponent component);
+
+// Entities with every component of all and none of none. The query is owned by
+// the world and picks up archetypes created later.
+ecsQuery *ecsQueryCreate(ecsWorld *world, ecsMask all, ecsMask none);
+
+// Non-empty chunks of matching archetypes, valid until the next call on this
+// query or the next structural change. Different queries may be used concurrently.
+uint32_t ecsQueryViews(ecsWorld *world, ecsQuery *query, const ecsView **views);
+uint32_t ecsQueryCount(ecsWorld *world, ecsQuery *query);
+
+static inline void *ecsViewColumn(const ecsView *view, ecsComponent component)
+{
+	if (component >= ECS_MAX_COMPONENTS) return NULL;
+	uint32_t offset = (*view).offsets[component];
+	return offset == UINT32_MAX ? NULL : (*view).base + offset;
+}
+
+ecsStats ecsGetStats(ecsWorld *world);
+
+#endif
@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+#include "ecsScheduler.h"
+#include "vectorMath.h"
+
+typedef struct ecsSystemJob
+{
+	ecsScheduler *scheduler;
+	uint32_t system;
+} ecsSystemJob;
+
+typedef struct ecsSystemState
+{
+	ecsSystemDecl decl;
+	ecsQuery *query;
+	ecsSystemJob job;
+	bool enabled;
+
+	// Per run.
+	uint64_t dependents;                 // systems waiting on this one
+	atomic_uint pendingDependencies;
+	atomic_uint pendingJobs;
+	const ecsView *views;
+	uint32_t viewCount;
+} ecsSystemState;
+
+struct ecsScheduler
+{
+	ecsWorld *world;
+	jobSystem *jobs;
+
+	ecsSystemState systems[ECS_MAX_SYSTEMS];
+	uint32_t systemCount;
+
+	jobCounter finished;                 // systems of the current run still to finish
+	ecsSchedulerStats stats;
+};
+
+ecsScheduler *ecsSchedulerCreate(ecsWorld *world, jobSystem *jobs)
+{
+	ecsScheduler *scheduler = calloc(1, sizeof(ecsScheduler));
+	(*scheduler).world = world;
+	(*scheduler).jobs = jobs;
+	return scheduler;
+}
+
+void ecsSchedulerDestroy(ecsScheduler *scheduler)
+{
+	// Queries belong to the world.
+	free(scheduler);
+}
+
+ecsSystem ecsSchedulerAdd(ecsScheduler *scheduler, const ecsSystemDecl *decl)
+{
+	if ((*scheduler).systemCount == ECS_MAX_SYSTEMS)
+	{
+		printf("too many ECS systems, %s not added\n", (*decl).name);
+		return ECS_INVALID_SYSTEM;
+	}
+
+	ecsSystem system = (*scheduler).systemCount++;
+	ecsSystemState *state = &(*scheduler).systems[system];
+	(*state).decl = *decl;
+	(*state).job = (ecsSystemJob){scheduler, system};
+	(*state).enabled = true;
+
+	ecsMask query = (*decl).query ? (*decl).query : (*decl).read | (*decl).write;
+	(*state).query = ecsQueryCreate((*scheduler).world, query, (*decl).none);
+	return system;
+}
+
+void ecsSchedulerSetEnabled(ecsScheduler *scheduler, ecsSystem system, bool enabled)
+{
+	if (system >= (*scheduler).systemCount) return;
+	(*scheduler).systems[system].enabled = enabled;
+}
+
+static inline bool conflicts(const ecsSystemDecl *a, const ecsSystemDecl *b)
+{
+	return ((*a).write & ((*b).read | (*b).write)) != 0 || ((*b).write & (*a).read) != 0;
+}
+
+static void launchSystem(ecsScheduler *scheduler, uint32_t system);
+
+static void finishSystem(ecsScheduler *scheduler, uint32_t system)
+{
+	uint64_t dependents = (*scheduler).systems[system].dependents;
+	while (dependents != 0)
+	{
+		uint32_t next = (uint32_t)__builtin_ctzll(dependents);
+		dependents &= dependents - 1;
+
+		if (atomic_fetch_sub(&(*scheduler).systems[next].pendingDependencies, 1) == 1) launchSystem(scheduler, next);
+	}
+
+	atomic_fetch_sub_explicit(&(*scheduler).finished.pending, 1, memory_order_acq_rel);
+}
+
+static void runSystemJob(void *data, uint32_t begin, uint32_t end)
+{
+	const ecsSystemJob *job = data;
+	ecsScheduler *scheduler = (*job).scheduler;
+	ecsSystemState *state = &(*scheduler).systems[(*job).system];
+
+	(*state).decl.function((*scheduler).world, (*state).views, begin, end, (*state).decl.userData);
+
+	// The last job of a system releases its dependents.
+	if (atomic_fetch_sub(&(*state).pendingJobs, 1) == 1) finishSystem(scheduler, (*job).system);
+}
+
+static void launchSystem(ecsScheduler *scheduler, uint32_t system)
+{
+	ecsSystemState *state = &(*scheduler).systems[system];
+	if ((*state).viewCount == 0)
+	{
+		finishSystem(scheduler, system);
+		return;
+	}
+
+	uint32_t grain = (*state).decl.chunksPerJob ? (*state).decl.chunksPerJob : (*state).viewCount;
+	atomic_store(&(*state).pendingJobs, ((*state).viewCount + grain - 1) / grain);
+	jobParallelFor((*scheduler).jobs, runSystemJob, &(*state).job, (*state).viewCount, grain, NULL);
+}
+
+void ecsSchedulerRun(ecsScheduler *scheduler)
+{
+	ecsSchedulerStats stats = {0};
+	uint32_t depth[ECS_MAX_SYSTEMS];
+
+	// Views and the DAG are settled up front; nothing below changes the world.
+	for (uint32_t i = 0; i < (*scheduler).systemCount; i++)
+	{
+		ecsSystemState *state = &(*scheduler).systems[i];
+		(*state).dependents = 0;
+		atomic_store(&(*state).pendingDependencies, 0);
+		if (!(*state).enabled) continue;
+
+		(*state).viewCount = ecsQueryViews((*scheduler).world, (*state).query, &(*state).views);
+
+		depth[i] = 1;
+		for (uint32_t j = 0; j < i; j++)
+		{
+			ecsSystemState *earlier = &(*scheduler).systems[j];
+			if (!(*earlier).enabled || !conflicts(&(*earlier).decl, &(*state).decl)) continue;
+
+			(*earlier).dependents |= (uint64_t)1 << i;
+			atomic_fetch_add(&(*state).pendingDependencies, 1);
+			depth[i] = mathMax(depth[i], depth[j] + 1);
+			stats.edgeCount++;
+		}
+
+		uint32_t grain = (*state).decl.chunksPerJob ? (*state).decl.chunksPerJob : mathMax((*state).viewCount, 1u);
+		stats.systemCount++;
+		stats.depth = mathMax(stats.depth, depth[i]);
+		stats.jobCount += ((*state).viewCount + grain - 1) / grain;
+	}
+
+	(*scheduler).stats = stats;
+	if (stats.systemCount == 0) return;
+
+	// Roots are picked before any system starts, since a finishing system
+	// launches its own dependents.
+	uint64_t roots = 0;
+	for (uint32_t i = 0; i < (*scheduler).systemCount; i++)
+		if ((*scheduler).systems[i].enabled && atomic_load(&(*scheduler).systems[i].pendingDependencies) == 0) roots |= (uint64_t)1 << i;
+
+	atomic_store(&(*scheduler).finished.pending, stats.systemCount);
+	while (roots != 0)
+	{
+		launchSystem(scheduler, (uint32_t)__builtin_ctzll(roots));
+		roots &= roots - 1;
+	}
+
+	jobWait((*scheduler).jobs, &(*scheduler).finished);
+}
+
+ecsSchedulerStats ecsSchedulerGetStats(ecsScheduler *scheduler)
+{
+	return (*scheduler).stats;
+}
@@ -0,0 +1,60 @@
+#ifndef ECS_SCHEDULER_H
+#define ECS_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ecs.h"
+#include "jobSystem.h"
+
+// Runs ECS systems on the job system. Every system declares the components it
+// reads and writes; each run derives a dependency DAG from those sets, where a
+// system waits for every earlier-added system it conflicts with (write/write or
+// read/write on a component), and starts as soon as those have finished, so
+// independent systems overlap. A system's query is split into jobs of
+// chunksPerJob chunks spread over the workers.
+// No structural changes are allowed while systems run.
+
+#define ECS_MAX_SYSTEMS 64
+#define ECS_INVALID_SYSTEM UINT32_MAX
+
+typedef struct ecsScheduler ecsScheduler;
+typedef uint32_t ecsSystem;
+
+// Processes views [begin, end) of the system's query. Index views by position to
+// line up with other systems that use the same query mask.
+typedef void (*ecsSystemFunction)(ecsWorld *world, const ecsView *views, uint32_t begin, uint32_t end, void *userData);
+
+typedef struct ecsSystemDecl
+{
+	const char *name;
+	ecsMask read, write;
+	ecsMask query;                       // components entities must have, 0 for read | write
+	ecsMask none;                        // components they must not have
+	uint32_t chunksPerJob;               // 0 runs the whole query as one job
+	ecsSystemFunction function;
+	void *userData;
+} ecsSystemDecl;
+
+typedef struct ecsSchedulerStats
+{
+	uint32_t systemCount;                // enabled
+	uint32_t edgeCount;
+	uint32_t depth;                      // systems on the longest dependency chain
+	uint32_t jobCount;                   // in the last run
+} ecsSchedulerStats;
+
+ecsScheduler *ecsSchedulerCreate(ecsWorld *world, jobSystem *jobs);
+void ecsSchedulerDestroy(ecsScheduler *scheduler);
+
+// Systems run in dependency order; among conflicting systems, in the order added.
+// Up to ECS_MAX_SYSTEMS, after that ECS_INVALID_SYSTEM, which SetEnabled ignores.
+ecsSystem ecsSchedulerAdd(ecsScheduler *scheduler, const ecsSystemDecl *decl);
+void ecsSchedulerSetEnabled(ecsScheduler *scheduler, ecsSystem system, bool enabled);
+
+// Runs every enabled system once; the calling thread helps until all are done.
+void ecsSchedulerRun(ecsScheduler *scheduler);
+
+ecsSchedulerStats ecsSchedulerGetStats(ecsScheduler *scheduler);
+
+#endif
@@ -0,0 +1,1115 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <threads.h>
+
+#include "gpuAllocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define GPU_NODE_NONE UINT32_MAX
+
+#define GPU_DEFAULT_BLOCK_SIZE ((VkDeviceSize)64 * 1024 * 1024)
+#define GPU_SMALL_HEAP_SIZE ((VkDeviceSize)1024 * 1024 * 1024)
+
+// TLSF: first level is log2 of the size, second level splits each power of two
+// into 16 linear classes. Everything below TLSF_MIN_SIZE shares first level 0.
+#define TLSF_SL_LOG2 4
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_MIN_SIZE 256
+#define TLSF_FL_OFFSET 8
+#define TLSF_FL_COUNT 41
+#define TLSF_GRANULARITY 16
+
+#define BUDDY_MIN_SIZE 4096
+
+typedef enum buddyNodeState
+{
+	BUDDY_NONE,
+	BUDDY_FREE,
+	BUDDY_SPLIT,
+	BUDDY_USED
+} buddyNodeState;
+
+typedef struct tlsfNode
+{
+	VkDeviceSize offset, size;
+	VkDeviceSize allocOffset, allocSize, alignment;
+	uint32_t prevPhys, nextPhys;
+	uint32_t prevFree, nextFree;
+	bool inUse;
+	bool free;
+	bool optimalImage;
+	bool pendingMove;
+	void *userData;
+} tlsfNode;
+
+typedef struct tlsfState
+{
+	tlsfNode *nodes;
+	uint32_t nodeCount, nodeCapacity;
+	uint32_t unusedNodes;
+
+	uint64_t flBitmap;
+	uint32_t slBitmap[TLSF_FL_COUNT];
+	uint32_t heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+} tlsfState;
+
+typedef struct buddyState
+{
+	uint32_t levelCount;
+	uint8_t *state;
+	int32_t *next, *prev;
+	int32_t *heads;
+} buddyState;
+
+typedef struct linearState
+{
+	VkDeviceSize head;
+} linearState;
+
+struct gpuBlock
+{
+	gpuPool *pool;
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	VkDeviceSize usedBytes;
+	uint32_t allocationCount;
+	void *mapped;
+
+	tlsfState tlsf;
+	buddyState buddy;
+	linearState linear;
+};
+
+struct gpuPool
+{
+	gpuAllocStrategy strategy;
+	uint32_t memoryTypeIndex;
+	VkDeviceSize blockSize;
+	uint32_t maxBlockCount;
+
+	gpuBlock **blocks;
+	uint32_t blockCount, blockCapacity;
+};
+
+struct gpuAllocator
+{
+	VkPhysicalDevice physicalDevice;
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	VkDeviceSize bufferImageGranularity;
+	uint32_t maxMemoryAllocationCount;
+	uint32_t memoryAllocationCount;
+	VkDeviceSize preferredBlockSize;
+	bool useMemoryRequirements2;
+
+	gpuPool *defaultPools[VK_MAX_MEMORY_TYPES];
+	gpuPool **customPools;
+	uint32_t customPoolCount, customPoolCapacity;
+
+	gpuHeapStats heapStats[VK_MAX_MEMORY_HEAPS];
+	mtx_t lock;
+};
+
+static inline uint32_t bitScanForward(uint64_t v)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, v);
+	return (uint32_t)index;
+#else
+	return (uint32_t)__builtin_ctzll(v);
+#endif
+}
+
+static inline uint32_t bitScanReverse(uint64_t v)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, v);
+	return (uint32_t)index;
+#else
+	return 63u - (uint32_t)__builtin_clzll(v);
+#endif
+}
+
+static inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static inline VkDeviceSize nextPowerOfTwo(VkDeviceSize value)
+{
+	return value <= 1 ? 1 : (VkDeviceSize)1 << (bitScanReverse(value - 1) + 1);
+}
+
+static inline uint32_t heapOf(gpuAllocator *allocator, uint32_t memoryTypeIndex)
+{
+	return (*allocator).memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+}
+
+/* ---- TLSF ---- */
+
+static void tlsfMapping(VkDeviceSize size, uint32_t *fl, uint32_t *sl)
+{
+	if (size < TLSF_MIN_SIZE)
+	{
+		*fl = 0;
+		*sl = (uint32_t)(size / TLSF_GRANULARITY);
+		return;
+	}
+
+	uint32_t log2Size = bitScanReverse(size);
+	*sl = (uint32_t)(size >> (log2Size - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+	*fl = log2Size - TLSF_FL_OFFSET + 1;
+}
+
+static uint32_t tlsfNewNode(tlsfState *t)
+{
+	if ((*t).unusedNodes != GPU_NODE_NONE)
+	{
+		uint32_t node = (*t).unusedNodes;
+		(*t).unusedNodes = (*t).nodes[node].nextFree;
+		return node;
+	}
+
+	if ((*t).nodeCount == (*t).nodeCapacity)
+	{
+		(*t).nodeCapacity = (*t).nodeCapacity ? 2 * (*t).nodeCapacity : 64;
+		(*t).nodes = realloc((*t).nodes, (*t).nodeCapacity * sizeof(tlsfNode));
+	}
+
+	return (*t).nodeCount++;
+}
+
+static void tlsfReleaseNode(tlsfState *t, uint32_t node)
+{
+	(*t).nodes[node].inUse = false;
+	(*t).nodes[node].nextFree = (*t).unusedNodes;
+	(*t).unusedNodes = node;
+}
+
+static void tlsfInsertFree(tlsfState *t, uint32_t node)
+{
+	uint32_t fl, sl;
+	tlsfMapping((*t).nodes[node].size, &fl, &sl);
+
+	tlsfNode *n = &(*t).nodes[node];
+	(*n).free = true;
+	(*n).prevFree = GPU_NODE_NONE;
+	(*n).nextFree = (*t).heads[fl][sl];
+	if ((*n).nextFree != GPU_NODE_NONE) (*t).nodes[(*n).nextFree].prevFree = node;
+
+	(*t).heads[fl][sl] = node;
+	(*t).flBitmap |= 1ull << fl;
+	(*t).slBitmap[fl] |= 1u << sl;
+}
+
+static void tlsfRemoveFree(tlsfState *t, uint32_t node)
+{
+	uint32_t fl, sl;
+	tlsfMapping((*t).nodes[node].size, &fl, &sl);
+
+	tlsfNode *n = &(*t).nodes[node];
+	if ((*n).prevFree != GPU_NODE_NONE) (*t).nodes[(*n).prevFree].nextFree = (*n).nextFree;
+	else (*t).heads[fl][sl] = (*n).nextFree;
+	if ((*n).nextFree != GPU_NODE_NONE) (*t).nodes[(*n).nextFree].prevFree = (*n).prevFree;
+
+	if ((*t).heads[fl][sl] == GPU_NODE_NONE)
+	{
+		(*t).slBitmap[fl] &= ~(1u << sl);
+		if ((*t).slBitmap[fl] == 0) (*t).flBitmap &= ~(1ull << fl);
+	}
+
+	(*n).free = false;
+}
+
+static void tlsfInit(tlsfState *t, VkDeviceSize size)
+{
+	memset(t, 0, sizeof(tlsfState));
+	memset((*t).heads, 0xff, sizeof((*t).heads));
+	(*t).unusedNodes = GPU_NODE_NONE;
+
+	uint32_t node = tlsfNewNode(t);
+	tlsfNode *n = &(*t).nodes[node];
+	memset(n, 0, sizeof(tlsfNode));
+	(*n).offset = 0;
+	(*n).size = size & ~(VkDeviceSize)(TLSF_GRANULARITY - 1);
+	(*n).prevPhys = (*n).nextPhys = GPU_NODE_NONE;
+	(*n).inUse = true;
+	tlsfInsertFree(t, node);
+}
+
+// Good-fit: rounds the request up to the next class so any block found fits.
+static uint32_t tlsfFindFree(tlsfState *t, VkDeviceSize size)
+{
+	if (size >= TLSF_MIN_SIZE) size += ((VkDeviceSize)1 << (bitScanReverse(size) - TLSF_SL_LOG2)) - 1;
+
+	uint32_t fl, sl;
+	tlsfMapping(size, &fl, &sl);
+	if (fl >= TLSF_FL_COUNT) return GPU_NODE_NONE;
+
+	uint32_t slMap = (*t).slBitmap[fl] & (~0u << sl);
+	if (slMap == 0)
+	{
+		uint64_t flMap = (fl + 1 < 64) ? (*t).flBitmap & (~0ull << (fl + 1)) : 0;
+		if (flMap == 0) return GPU_NODE_NONE;
+
+		fl = bitScanForward(flMap);
+		slMap = (*t).slBitmap[fl];
+	}
+
+	return (*t).heads[fl][bitScanForward(slMap)];
+}
+
+static bool tlsfAlloc(tlsfState *t, VkDeviceSize size, VkDeviceSize alignment, bool optimalImage, void *userData, VkDeviceSize *offset, uint32_t *nodeOut)
+{
+	// Node offsets are multiples of TLSF_GRANULARITY, so at most alignment - 16 bytes of padding.
+	VkDeviceSize padding = alignment > TLSF_GRANULARITY ? alignment - TLSF_GRANULARITY : 0;
+	VkDeviceSize needed = alignUp(size, TLSF_GRANULARITY) + padding;
+
+	uint32_t node = tlsfFindFree(t, needed);
+	if (node == GPU_NODE_NONE) return false;
+
+	tlsfRemoveFree(t, node);
+
+	VkDeviceSize aligned = alignUp((*t).nodes[node].offset, alignment);
+	VkDeviceSize used = alignUp(aligned + size - (*t).nodes[node].offset, TLSF_GRANULARITY);
+
+	if ((*t).nodes[node].size - used >= TLSF_MIN_SIZE)
+	{
+		uint32_t rest = tlsfNewNode(t);
+		tlsfNode *n = &(*t).nodes[node];
+		tlsfNode *r = &(*t).nodes[rest];
+
+		memset(r, 0, sizeof(tlsfNode));
+		(*r).inUse = true;
+		(*r).offset = (*n).offset + used;
+		(*r).size = (*n).size - used;
+		(*r).prevPhys = node;
+		(*r).nextPhys = (*n).nextPhys;
+		if ((*n).nextPhys != GPU_NODE_NONE) (*t).nodes[(*n).nextPhys].prevPhys = rest;
+
+		(*n).nextPhys = rest;
+		(*n).size = used;
+		tlsfInsertFree(t, rest);
+	}
+
+	tlsfNode *n = &(*t).nodes[node];
+	(*n).allocOffset = aligned;
+	(*n).allocSize = size;
+	(*n).alignment = alignment;
+	(*n).optimalImage = optimalImage;
+	(*n).pendingMove = false;
+	(*n).userData = userData;
+
+	*offset = aligned;
+	*nodeOut = node;
+	return true;
+}
+
+static void tlsfFree(tlsfState *t, uint32_t node)
+{
+	uint32_t prev = (*t).nodes[node].prevPhys;
+	if (prev != GPU_NODE_NONE && (*t).nodes[prev].free)
+	{
+		tlsfRemoveFree(t, prev);
+		(*t).nodes[prev].size += (*t).nodes[node].size;
+		(*t).nodes[prev].nextPhys = (*t).nodes[node].nextPhys;
+		if ((*t).nodes[node].nextPhys != GPU_NODE_NONE) (*t).nodes[(*t).nodes[node].nextPhys].prevPhys = prev;
+
+		tlsfReleaseNode(t, node);
+		node = prev;
+	}
+
+	uint32_t next = (*t).nodes[node].nextPhys;
+	if (next != GPU_NODE_NONE && (*t).nodes[next].free)
+	{
+		tlsfRemoveFree(t, next);
+		(*t).nodes[node].size += (*t).nodes[next].size;
+		(*t).nodes[node].nextPhys = (*t).nodes[next].nextPhys;
+		if ((*t).nodes[next].nextPhys != GPU_NODE_NONE) (*t).nodes[(*t).nodes[next].nextPhys].prevPhys = node;
+
+		tlsfReleaseNode(t, next);
+	}
+
+	tlsfInsertFree(t, node);
+}
+
+/* ---- Buddy ---- */
+
+static inline uint32_t buddyLevelOf(uint32_t node)
+{
+	return bitScanReverse((uint64_t)node + 1);
+}
+
+static void buddyPush(buddyState *b, int32_t node, uint32_t level)
+{
+	(*b).state[node] = BUDDY_FREE;
+	(*b).prev[node] = -1;
+	(*b).next[node] = (*b).heads[level];
+	if ((*b).heads[level] >= 0) (*b).prev[(*b).heads[level]] = node;
+	(*b).heads[level] = node;
+}
+
+static void buddyRemove(buddyState *b, int32_t node, uint32_t level)
+{
+	if ((*b).prev[node] >= 0) (*b).next[(*b).prev[node]] = (*b).next[node];
+	else (*b).heads[level] = (*b).next[node];
+	if ((*b).next[node] >= 0) (*b).prev[(*b).next[node]] = (*b).prev[node];
+}
+
+static void buddyInit(buddyState *b, VkDeviceSize blockSize)
+{
+	(*b).levelCount = bitScanReverse(blockSize / BUDDY_MIN_SIZE) + 1;
+
+	uint32_t nodeCount = (1u << (*b).levelCount) - 1;
+	(*b).state = calloc(nodeCount, sizeof(uint8_t));
+	(*b).next = malloc(nodeCount * sizeof(int32_t));
+	(*b).prev = malloc(nodeCount * sizeof(int32_t));
+	(*b).heads = malloc((*b).levelCount * sizeof(int32_t));
+
+	for (uint32_t i = 0; i < (*b).levelCount; i++) (*b).heads[i] = -1;
+	buddyPush(b, 0, 0);
+}
+
+static bool buddyAlloc(buddyState *b, VkDeviceSize blockSize, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset, uint32_t *nodeOut, VkDeviceSize *nodeSize)
+{
+	// Nodes are aligned to their own size, which covers any alignment up to it.
+	VkDeviceSize wanted = nextPowerOfTwo(size > alignment ? size : alignment);
+	if (wanted < BUDDY_MIN_SIZE) wanted = BUDDY_MIN_SIZE;
+	if (wanted > blockSize) return false;
+
+	uint32_t target = (*b).levelCount - 1 - bitScanReverse(wanted / BUDDY_MIN_SIZE);
+
+	int32_t level = (int32_t)target;
+	while (level >= 0 && (*b).heads[level] < 0) level--;
+	if (level < 0) return false;
+
+	int32_t node = (*b).heads[level];
+	buddyRemove(b, node, (uint32_t)level);
+
+	while ((uint32_t)level < target)
+	{
+		(*b).state[node] = BUDDY_SPLIT;
+		buddyPush(b, 2 * node + 2, (uint32_t)level + 1);
+		node = 2 * node + 1;
+		level++;
+	}
+
+	(*b).state[node] = BUDDY_USED;
+
+	uint32_t firstAtLevel = (1u << level) - 1;
+	*nodeSize = blockSize >> level;
+	*offset = (VkDeviceSize)((uint32_t)node - firstAtLevel) * *nodeSize;
+	*nodeOut = (uint32_t)node;
+	return true;
+}
+
+static void buddyFree(buddyState *b, uint32_t node)
+{
+	int32_t n = (int32_t)node;
+	uint32_t level = buddyLevelOf(node);
+
+	while (n > 0)
+	{
+		int32_t buddy = (n & 1) ? n + 1 : n - 1;
+		if ((*b).state[buddy] != BUDDY_FREE) break;
+
+		buddyRemove(b, buddy, level);
+		(*b).state[buddy] = BUDDY_NONE;
+		(*b).state[n] = BUDDY_NONE;
+
+		n = (n - 1) / 2;
+		level--;
+	}
+
+	buddyPush(b, n, level);
+}
+
+/* ---- Blocks and pools ---- */
+
+static VkResult createBlock(gpuAllocator *allocator, gpuPool *pool, gpuBlock **created)
+{
+	if ((*allocator).memoryAllocationCount >= (*allocator).maxMemoryAllocationCount) return VK_ERROR_TOO_MANY_OBJECTS;
+	if ((*pool).maxBlockCount != 0 && (*pool).blockCount >= (*pool).maxBlockCount) return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+	VkMemoryAllocateInfo allocInfo = {0};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = (*pool).blockSize;
+	allocInfo.memoryTypeIndex = (*pool).memoryTypeIndex;
+
+	VkDeviceMemory memory;
+	VkResult res = vkAllocateMemory((*allocator).device, &allocInfo, NULL, &memory);
+	if (res != VK_SUCCESS) return res;
+
+	// Host-visible blocks are mapped once for their whole lifetime.
+	void *mapped = NULL;
+	VkMemoryPropertyFlags flags = (*allocator).memoryProperties.memoryTypes[(*pool).memoryTypeIndex].propertyFlags;
+	if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		res = vkMapMemory((*allocator).device, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+		if (res != VK_SUCCESS)
+		{
+			vkFreeMemory((*allocator).device, memory, NULL);
+			return res;
+		}
+	}
+	(*allocator).memoryAllocationCount++;
+
+	gpuBlock *block = calloc(1, sizeof(gpuBlock));
+	(*block).pool = pool;
+	(*block).memory = memory;
+	(*block).size = (*pool).blockSize;
+	(*block).mapped = mapped;
+
+	switch ((*pool).strategy)
+	{
+		case GPU_ALLOC_STRATEGY_TLSF:   tlsfInit(&(*block).tlsf, (*block).size); break;
+		case GPU_ALLOC_STRATEGY_BUDDY:  buddyInit(&(*block).buddy, (*block).size); break;
+		case GPU_ALLOC_STRATEGY_LINEAR: (*block).linear.head = 0; break;
+	}
+
+	if ((*pool).blockCount == (*pool).blockCapacity)
+	{
+		(*pool).blockCapacity = (*pool).blockCapacity ? 2 * (*pool).blockCapacity : 4;
+		(*pool).blocks = realloc((*pool).blocks, (*pool).blockCapacity * sizeof(gpuBlock *));
+	}
+	(*pool).blocks[(*pool).blockCount++] = block;
+
+	gpuHeapStats *stats = &(*allocator).heapStats[heapOf(allocator, (*pool).memoryTypeIndex)];
+	(*stats).blockCount++;
+	(*stats).blockBytes += (*block).size;
+
+	*created = block;
+	return VK_SUCCESS;
+}
+
+static void destroyBlock(gpuAllocator *allocator, gpuPool *pool, gpuBlock *block)
+{
+	for (uint32_t i = 0; i < (*pool).blockCount; i++)
+	{
+		if ((*pool).blocks[i] == block)
+		{
+			(*pool).blocks[i] = (*pool).blocks[--(*pool).blockCount];
+			break;
+		}
+	}
+
+	gpuHeapStats *stats = &(*allocator).heapStats[heapOf(allocator, (*pool).memoryTypeIndex)];
+	(*stats).blockCount--;
+	(*stats).blockBytes -= (*block).size;
+	(*stats).allocationCount -= (*block).allocationCount;
+	(*stats).allocatedBytes -= (*block).usedBytes;
+
+	if ((*block).mapped != NULL) vkUnmapMemory((*allocator).device, (*block).memory);
+	vkFreeMemory((*allocator).device, (*block).memory, NULL);
+	(*allocator).memoryAllocationCount--;
+
+	free((*block).tlsf.nodes);
+	free((*block).buddy.state);
+	free((*block).buddy.next);
+	free((*block).buddy.prev);
+	free((*block).buddy.heads);
+	free(block);
+}
+
+static gpuPool *newPool(gpuAllocator *allocator, uint32_t memoryTypeIndex, gpuAllocStrategy strategy, VkDeviceSize blockSize, uint32_t maxBlockCount)
+{
+	gpuPool *pool = calloc(1, sizeof(gpuPool));
+	(*pool).strategy = strategy;
+	(*pool).memoryTypeIndex = memoryTypeIndex;
+	(*pool).maxBlockCount = maxBlockCount;
+
+	if (blockSize == 0)
+	{
+		VkDeviceSize heapSize = (*allocator).memoryProperties.memoryHeaps[heapOf(allocator, memoryTypeIndex)].size;
+		blockSize = (*allocator).preferredBlockSize;
+		if (heapSize <= GPU_SMALL_HEAP_SIZE && blockSize > heapSize / 8) blockSize = heapSize / 8;
+	}
+
+	if (strategy == GPU_ALLOC_STRATEGY_BUDDY)
+	{
+		blockSize = nextPowerOfTwo(blockSize);
+		if (blockSize < BUDDY_MIN_SIZE) blockSize = BUDDY_MIN_SIZE;
+	}
+	(*pool).blockSize = blockSize;
+
+	return pool;
+}
+
+static void releaseEmptyBlock(gpuAllocator *allocator, gpuPool *pool, gpuBlock *block)
+{
+	if ((*block).allocationCount != 0) return;
+
+	// Keep one empty block around so alloc/free churn doesn't hit vkAllocateMemory.
+	for (uint32_t i = 0; i < (*pool).blockCount; i++)
+	{
+		gpuBlock *other = (*pool).blocks[i];
+		if (other != block && (*other).allocationCount == 0)
+		{
+			destroyBlock(allocator, pool, block);
+			return;
+		}
+	}
+}
+
+static bool blockAlloc(gpuBlock *block, VkDeviceSize size, VkDeviceSize alignment, bool optimalImage, void *userData, gpuAllocation *allocation)
+{
+	VkDeviceSize offset = 0, footprint = size;
+	uint32_t node = 0;
+
+	switch ((*(*block).pool).strategy)
+	{
+		case GPU_ALLOC_STRATEGY_TLSF:
+			if (!tlsfAlloc(&(*block).tlsf, size, alignment, optimalImage, userData, &offset, &node)) return false;
+			footprint = (*block).tlsf.nodes[node].size;
+			break;
+
+		case GPU_ALLOC_STRATEGY_BUDDY:
+			if (!buddyAlloc(&(*block).buddy, (*block).size, size, alignment, &offset, &node, &footprint)) return false;
+			break;
+
+		case GPU_ALLOC_STRATEGY_LINEAR:
+			offset = alignUp((*block).linear.head, alignment);
+			if (offset + size > (*block).size) return false;
+			footprint = offset + size - (*block).linear.head;
+			(*block).linear.head = offset + size;
+			break;
+	}
+
+	(*block).allocationCount++;
+	(*block).usedBytes += footprint;
+
+	(*allocation).memory = (*block).memory;
+	(*allocation).offset = offset;
+	(*allocation).size = size;
+	(*allocation).mapped = (*block).mapped ? (uint8_t *)(*block).mapped + offset : NULL;
+	(*allocation).memoryTypeIndex = (*(*block).pool).memoryTypeIndex;
+	(*allocation).pool = (*block).pool;
+	(*allocation).block = block;
+	(*allocation).node = node;
+	return true;
+}
+
+static VkResult poolAlloc(gpuAllocator *allocator, gpuPool *pool, VkDeviceSize size, VkDeviceSize alignment, bool optimalImage, void *userData, gpuAllocation *allocation)
+{
+	bool placed = false;
+	for (uint32_t i = 0; i < (*pool).blockCount && !placed; i++)
+		placed = blockAlloc((*pool).blocks[i], size, alignment, optimalImage, userData, allocation);
+
+	if (!placed)
+	{
+		gpuBlock *block;
+		VkResult res = createBlock(allocator, pool, &block);
+		if (res != VK_SUCCESS) return res;
+
+		if (!blockAlloc(block, size, alignment, optimalImage, userData, allocation))
+		{
+			destroyBlock(allocator, pool, block);
+			return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+		}
+	}
+
+	gpuHeapStats *stats = &(*allocator).heapStats[heapOf(allocator, (*pool).memoryTypeIndex)];
+	(*stats).allocationCount++;
+	(*stats).allocatedBytes += size;
+	return VK_SUCCESS;
+}
+
+static void freeAllocation(gpuAllocator *allocator, gpuAllocation *allocation)
+{
+	if ((*allocation).memory == VK_NULL_HANDLE) return;
+
+	gpuHeapStats *stats = &(*allocator).heapStats[heapOf(allocator, (*allocation).memoryTypeIndex)];
+
+	if ((*allocation).pool == NULL)
+	{
+		if ((*allocation).mapped != NULL) vkUnmapMemory((*allocator).device, (*allocation).memory);
+		vkFreeMemory((*allocator).device, (*allocation).memory, NULL);
+		(*allocator).memoryAllocationCount--;
+
+		(*stats).dedicatedCount--;
+		(*stats).dedicatedBytes -= (*allocation).size;
+		memset(allocation, 0, sizeof(gpuAllocation));
+		return;
+	}
+
+	gpuPool *pool = (*allocation).pool;
+	gpuBlock *block = (*allocation).block;
+	VkDeviceSize footprint = (*allocation).size;
+
+	switch ((*pool).strategy)
+	{
+		case GPU_ALLOC_STRATEGY_TLSF:
+			footprint = (*block).tlsf.nodes[(*allocation).node].size;
+			tlsfFree(&(*block).tlsf, (*allocation).node);
+			break;
+
+		case GPU_ALLOC_STRATEGY_BUDDY:
+			footprint = (*block).size >> buddyLevelOf((*allocation).node);
+			buddyFree(&(*block).buddy, (*allocation).node);
+			break;
+
+		case GPU_ALLOC_STRATEGY_LINEAR:
+			footprint = 0;
+			break;
+	}
+
+	(*block).allocationCount--;
+	(*block).usedBytes -= footprint;
+	(*stats).allocationCount--;
+	(*stats).allocatedBytes -= (*allocation).size;
+
+	// Linear blocks rewind once everything in them is gone.
+	if ((*pool).strategy == GPU_ALLOC_STRATEGY_LINEAR && (*block).allocationCount == 0)
+	{
+		(*block).linear.head = 0;
+		(*block).usedBytes = 0;
+	}
+
+	releaseEmptyBlock(allocator, pool, block);
+	memset(allocation, 0, sizeof(gpuAllocation));
+}
+
+static VkResult allocateDedicated(gpuAllocator *allocator, const VkMemoryRequirements *requirements, uint32_t memoryTypeIndex, bool mapped, VkBuffer buffer, VkImage image, gpuAllocation *allocation)
+{
+	if ((*allocator).memoryAllocationCount >= (*allocator).maxMemoryAllocationCount) return VK_ERROR_TOO_MANY_OBJECTS;
+
+	VkMemoryAllocateInfo allocInfo = {0};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = (*requirements).size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VkMemoryDedicatedAllocateInfo dedicatedInfo = {0};
+	if ((*allocator).useMemoryRequirements2 && (buffer != VK_NULL_HANDLE || image != VK_NULL_HANDLE))
+	{
+		dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+		dedicatedInfo.buffer = buffer;
+		dedicatedInfo.image = image;
+		allocInfo.pNext = &dedicatedInfo;
+	}
+
+	memset(allocation, 0, sizeof(gpuAllocation));
+	VkResult res = vkAllocateMemory((*allocator).device, &allocInfo, NULL, &(*allocation).memory);
+	if (res != VK_SUCCESS) return res;
+	(*allocator).memoryAllocationCount++;
+
+	(*allocation).size = (*requirements).size;
+	(*allocation).memoryTypeIndex = memoryTypeIndex;
+	if (mapped)
+	{
+		res = vkMapMemory((*allocator).device, (*allocation).memory, 0, VK_WHOLE_SIZE, 0, &(*allocation).mapped);
+		if (res != VK_SUCCESS)
+		{
+			vkFreeMemory((*allocator).device, (*allocation).memory, NULL);
+			(*allocator).memoryAllocationCount--;
+			memset(allocation, 0, sizeof(gpuAllocation));
+			return res;
+		}
+	}
+
+	gpuHeapStats *stats = &(*allocator).heapStats[heapOf(allocator, memoryTypeIndex)];
+	(*stats).dedicatedCount++;
+	(*stats).dedicatedBytes += (*requirements).size;
+	return VK_SUCCESS;
+}
+
+static VkResult allocate(gpuAllocator *allocator, const VkMemoryRequirements *requirements, const gpuAllocationCreateInfo *createInfo, bool prefersDedicated, VkBuffer buffer, VkImage image, gpuAllocation *allocation)
+{
+	VkMemoryPropertyFlags requiredFlags = (*createInfo).requiredFlags;
+	if ((*createInfo).flags & GPU_ALLOCATION_MAPPED) requiredFlags |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+	gpuPool *pool = (*createInfo).pool;
+	uint32_t memoryTypeIndex = pool ? (*pool).memoryTypeIndex : gpuFindMemoryType(allocator, (*requirements).memoryTypeBits, requiredFlags, (*createInfo).preferredFlags);
+	if (memoryTypeIndex == UINT32_MAX || !((*requirements).memoryTypeBits & (1u << memoryTypeIndex))) return VK_ERROR_FEATURE_NOT_PRESENT;
+
+	bool hostVisible = ((*allocator).memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+
+	if (pool == NULL)
+	{
+		if ((*allocator).defaultPools[memoryTypeIndex] == NULL)
+			(*allocator).defaultPools[memoryTypeIndex] = newPool(allocator, memoryTypeIndex, GPU_ALLOC_STRATEGY_TLSF, 0, 0);
+		pool = (*allocator).defaultPools[memoryTypeIndex];
+
+		// Anything bigger than half a block would mostly waste the block it lands in.
+		if (((*createInfo).flags & GPU_ALLOCATION_DEDICATED) || prefersDedicated || (*requirements).size > (*pool).blockSize / 2)
+			return allocateDedicated(allocator, requirements, memoryTypeIndex, hostVisible, buffer, image, allocation);
+	}
+
+	VkDeviceSize size = (*requirements).size;
+	VkDeviceSize alignment = (*requirements).alignment ? (*requirements).alignment : 1;
+	bool optimalImage = ((*createInfo).flags & GPU_ALLOCATION_OPTIMAL_IMAGE) != 0;
+
+	// Give optimal images whole bufferImageGranularity pages so no linear
+	// resource can ever share a page with them.
+	if (optimalImage && (*allocator).bufferImageGranularity > alignment)
+	{
+		alignment = (*allocator).bufferImageGranularity;
+		size = alignUp(size, alignment);
+	}
+
+	return poolAlloc(allocator, pool, size, alignment, optimalImage, (*createInfo).userData, allocation);
+}
+
+/* ---- Public API ---- */
+
+gpuAllocator *gpuAllocatorCreate(const gpuAllocatorCreateInfo *createInfo)
+{
+	gpuAllocator *allocator = calloc(1, sizeof(gpuAllocator));
+	(*allocator).physicalDevice = (*createInfo).physicalDevice;
+	(*allocator).device = (*createInfo).device;
+	(*allocator).memoryProperties = (*createInfo).memoryProperties;
+	(*allocator).bufferImageGranularity = (*createInfo).bufferImageGranularity ? (*createInfo).bufferImageGranularity : 1;
+	(*allocator).maxMemoryAllocationCount = (*createInfo).maxMemoryAllocationCount ? (*createInfo).maxMemoryAllocationCount : 4096;
+	(*allocator).preferredBlockSize = (*createInfo).preferredBlockSize ? (*createInfo).preferredBlockSize : GPU_DEFAULT_BLOCK_SIZE;
+	(*allocator).useMemoryRequirements2 = (*createInfo).useMemoryRequirements2;
+
+	mtx_init(&(*allocator).lock, mtx_plain);
+	return allocator;
+}
+
+static void destroyPoolBlocks(gpuAllocator *allocator, gpuPool *pool)
+{
+	while ((*pool).blockCount > 0)
+		destroyBlock(allocator, pool, (*pool).blocks[(*pool).blockCount - 1]);
+
+	free((*pool).blocks);
+	free(pool);
+}
+
+void gpuAllocatorDestroy(gpuAllocator *allocator)
+{
+	if (allocator == NULL) return;
+
+	for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++)
+		if ((*allocator).defaultPools[i] != NULL) destroyPoolBlocks(allocator, (*allocator).defaultPools[i]);
+
+	for (uint32_t i = 0; i < (*allocator).customPoolCount; i++)
+		destroyPoolBlocks(allocator, (*allocator).customPools[i]);
+	free((*allocator).customPools);
+
+	mtx_destroy(&(*allocator).lock);
+	free(allocator);
+}
+
+gpuPool *gpuPoolCreate(gpuAllocator *allocator, const gpuPoolCreateInfo *createInfo)
+{
+	mtx_lock(&(*allocator).lock);
+
+	gpuPool *pool = newPool(allocator, (*createInfo).memoryTypeIndex, (*createInfo).strategy, (*createInfo).blockSize, (*createInfo).maxBlockCount);
+
+	if ((*allocator).customPoolCount == (*allocator).customPoolCapacity)
+	{
+		(*allocator).customPoolCapacity = (*allocator).customPoolCapacity ? 2 * (*allocator).customPoolCapacity : 4;
+		(*allocator).customPools = realloc((*allocator).customPools, (*allocator).customPoolCapacity * sizeof(gpuPool *));
+	}
+	(*allocator).customPools[(*allocator).customPoolCount++] = pool;
+
+	mtx_unlock(&(*allocator).lock);
+	return pool;
+}
+
+void gpuPoolDestroy(gpuAllocator *allocator, gpuPool *pool)
+{
+	mtx_lock(&(*allocator).lock);
+
+	for (uint32_t i = 0; i < (*allocator).customPoolCount; i++)
+	{
+		if ((*allocator).customPools[i] == pool)
+		{
+			(*allocator).customPools[i] = (*allocator).customPools[--(*allocator).customPoolCount];
+			break;
+		}
+	}
+	destroyPoolBlocks(allocator, pool);
+
+	mtx_unlock(&(*allocator).lock);
+}
+
+// Linear pools only: forgets every allocation at once. The caller guarantees the
+// GPU is done with all of them (e.g. the pool belongs to a frame slot whose fence signalled).
+void gpuPoolReset(gpuAllocator *allocator, gpuPool *pool)
+{
+	if ((*pool).strategy != GPU_ALLOC_STRATEGY_LINEAR) return;
+
+	mtx_lock(&(*allocator).lock);
+
+	gpuHeapStats *stats = &(*allocator).heapStats[heapOf(allocator, (*pool).memoryTypeIndex)];
+	for (uint32_t i = 0; i < (*pool).blockCount; i++)
+	{
+		gpuBlock *block = (*pool).blocks[i];
+		(*stats).allocationCount -= (*block).allocationCount;
+		(*stats).allocatedBytes -= (*block).usedBytes;
+
+		(*block).allocationCount = 0;
+		(*block).usedBytes = 0;
+		(*block).linear.head = 0;
+	}
+
+	mtx_unlock(&(*allocator).lock);
+}
+
+uint32_t gpuFindMemoryType(gpuAllocator *allocator, uint32_t memoryTypeBits, VkMemoryPropertyFlags requiredFlags, VkMemoryPropertyFlags preferredFlags)
+{
+	uint32_t best = UINT32_MAX;
+	int bestScore = -1;
+
+	for (uint32_t i = 0; i < (*allocator).memoryProperties.memoryTypeCount; i++)
+	{
+		VkMemoryPropertyFlags flags = (*allocator).memoryProperties.memoryTypes[i].propertyFlags;
+		if (!(memoryTypeBits & (1u << i)) || (flags & requiredFlags) != requiredFlags) continue;
+
+		int score = 0;
+		for (VkMemoryPropertyFlags bits = flags & preferredFlags; bits != 0; bits &= bits - 1) score++;
+		if (score > bestScore)
+		{
+			bestScore = score;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+VkResult gpuAllocateMemory(gpuAllocator *allocator, const VkMemoryRequirements *requirements, const gpuAllocationCreateInfo *createInfo, gpuAllocation *allocation)
+{
+	mtx_lock(&(*allocator).lock);
+	VkResult res = allocate(allocator, requirements, createInfo, false, VK_NULL_HANDLE, VK_NULL_HANDLE, allocation);
+	mtx_unlock(&(*allocator).lock);
+	return res;
+}
+
+void gpuFreeMemory(gpuAllocator *allocator, gpuAllocation *allocation)
+{
+	mtx_lock(&(*allocator).lock);
+	freeAllocation(allocator, allocation);
+	mtx_unlock(&(*allocator).lock);
+}
+
+VkResult gpuCreateBuffer(gpuAllocator *allocator, const VkBufferCreateInfo *bufferInfo, const gpuAllocationCreateInfo *createInfo, VkBuffer *buffer, gpuAllocation *allocation)
+{
+	VkResult res = vkCreateBuffer((*allocator).device, bufferInfo, NULL, buffer);
+	if (res != VK_SUCCESS) return res;
+
+	VkMemoryRequirements requirements;
+	bool prefersDedicated = false;
+
+	if ((*allocator).useMemoryRequirements2)
+	{
+		VkMemoryDedicatedRequirements dedicated = {0};
+		dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+		VkMemoryRequirements2 requirements2 = {0};
+		requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		requirements2.pNext = &dedicated;
+
+		VkBufferMemoryRequirementsInfo2 info = {0};
+		info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+		info.buffer = *buffer;
+
+		vkGetBufferMemoryRequirements2((*allocator).device, &info, &requirements2);
+		requirements = requirements2.memoryRequirements;
+		prefersDedicated = dedicated.prefersDedicatedAllocation || dedicated.requiresDedicatedAllocation;
+	} else
+	{
+		vkGetBufferMemoryRequirements((*allocator).device, *buffer, &requirements);
+	}
+
+	mtx_lock(&(*allocator).lock);
+	res = allocate(allocator, &requirements, createInfo, prefersDedicated, *buffer, VK_NULL_HANDLE, allocation);
+	mtx_unlock(&(*allocator).lock);
+
+	if (res == VK_SUCCESS) res = vkBindBufferMemory((*allocator).device, *buffer, (*allocation).memory, (*allocation).offset);
+	if (res != VK_SUCCESS)
+	{
+		gpuFreeMemory(allocator, allocation);
+		vkDestroyBuffer((*allocator).device, *buffer, NULL);
+		*buffer = VK_NULL_HANDLE;
+	}
+
+	return res;
+}
+
+void gpuDestroyBuffer(gpuAllocator *allocator, VkBuffer buffer, gpuAllocation *allocation)
+{
+	vkDestroyBuffer((*allocator).device, buffer, NULL);
+	gpuFreeMemory(allocator, allocation);
+}
+
+VkResult gpuCreateImage(gpuAllocator *allocator, const VkImageCreateInfo *imageInfo, const gpuAllocationCreateInfo *createInfo, VkImage *image, gpuAllocation *allocation)
+{
+	VkResult res = vkCreateImage((*allocator).device, imageInfo, NULL, image);
+	if (res != VK_SUCCESS) return res;
+
+	VkMemoryRequirements requirements;
+	bool prefersDedicated = false;
+
+	if ((*allocator).useMemoryRequirements2)
+	{
+		VkMemoryDedicatedRequirements dedicated = {0};
+		dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+		VkMemoryRequirements2 requirements2 = {0};
+		requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		requirements2.pNext = &dedicated;
+
+		VkImageMemoryRequirementsInfo2 info = {0};
+		info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+		info.image = *image;
+
+		vkGetImageMemoryRequirements2((*allocator).device, &info, &requirements2);
+		requirements = requirements2.memoryRequirements;
+		prefersDedicated = dedicated.prefersDedicatedAllocation || dedicated.requiresDedicatedAllocation;
+	} else
+	{
+		vkGetImageMemoryRequirements((*allocator).device, *image, &requirements);
+	}
+
+	gpuAllocationCreateInfo imageCreateInfo = *createInfo;
+	if ((*imageInfo).tiling == VK_IMAGE_TILING_OPTIMAL) imageCreateInfo.flags |= GPU_ALLOCATION_OPTIMAL_IMAGE;
+
+	mtx_lock(&(*allocator).lock);
+	res = allocate(allocator, &requirements, &imageCreateInfo, prefersDedicated, VK_NULL_HANDLE, *image, allocation);
+	mtx_unlock(&(*allocator).lock);
+
+	if (res == VK_SUCCESS) res = vkBindImageMemory((*allocator).device, *image, (*allocation).memory, (*allocation).offset);
+	if (res != VK_SUCCESS)
+	{
+		gpuFreeMemory(allocator, allocation);
+		vkDestroyImage((*allocator).device, *image, NULL);
+		*image = VK_NULL_HANDLE;
+	}
+
+	return res;
+}
+
+void gpuDestroyImage(gpuAllocator *allocator, VkImage image, gpuAllocation *allocation)
+{
+	vkDestroyImage((*allocator).device, image, NULL);
+	gpuFreeMemory(allocator, allocation);
+}
+
+static int compareBlockUsage(const void *a, const void *b)
+{
+	VkDeviceSize usedA = (**(gpuBlock *const *)a).usedBytes;
+	VkDeviceSize usedB = (**(gpuBlock *const *)b).usedBytes;
+	return (usedA > usedB) - (usedA < usedB);
+}
+
+static uint32_t planPoolMoves(gpuAllocator *allocator, gpuPool *pool, gpuDefragMove *moves, uint32_t maxMoves)
+{
+	if ((*pool).strategy != GPU_ALLOC_STRATEGY_TLSF || (*pool).blockCount < 2) return 0;
+
+	gpuBlock **order = malloc((*pool).blockCount * sizeof(gpuBlock *));
+	memcpy(order, (*pool).blocks, (*pool).blockCount * sizeof(gpuBlock *));
+	qsort(order, (*pool).blockCount, sizeof(gpuBlock *), compareBlockUsage);
+
+	uint32_t moveCount = 0, lowestDst = (*pool).blockCount;
+
+	// Empty the least used blocks into the fullest ones that still have room. Once a
+	// block has received a move it is never drained itself, so the sources stop
+	// below the lowest destination.
+	for (uint32_t src = 0; src + 1 < lowestDst && moveCount < maxMoves; src++)
+	{
+		gpuBlock *block = order[src];
+
+		for (uint32_t node = 0; node < (*block).tlsf.nodeCount && moveCount < maxMoves; node++)
+		{
+			tlsfNode n = (*block).tlsf.nodes[node];
+			if (!n.inUse || n.free || n.pendingMove) continue;
+
+			for (uint32_t dst = (*pool).blockCount - 1; dst > src; dst--)
+			{
+				gpuDefragMove *move = &moves[moveCount];
+				if (!blockAlloc(order[dst], n.allocSize, n.alignment, n.optimalImage, n.userData, &(*move).dst)) continue;
+
+				(*order[dst]).tlsf.nodes[(*move).dst.node].pendingMove = true;
+				(*block).tlsf.nodes[node].pendingMove = true;
+
+				(*move).userData = n.userData;
+				(*move).src.memory = (*block).memory;
+				(*move).src.offset = n.allocOffset;
+				(*move).src.size = n.allocSize;
+				(*move).src.mapped = (*block).mapped ? (uint8_t *)(*block).mapped + n.allocOffset : NULL;
+				(*move).src.memoryTypeIndex = (*pool).memoryTypeIndex;
+				(*move).src.pool = pool;
+				(*move).src.block = block;
+				(*move).src.node = node;
+
+				gpuHeapStats *stats = &(*allocator).heapStats[heapOf(allocator, (*pool).memoryTypeIndex)];
+				(*stats).allocationCount++;
+				(*stats).allocatedBytes += n.allocSize;
+
+				if (dst < lowestDst) lowestDst = dst;
+				moveCount++;
+				break;
+			}
+		}
+	}
+
+	free(order);
+	return moveCount;
+}
+
+uint32_t gpuDefragmentPlan(gpuAllocator *allocator, gpuPool *pool, gpuDefragMove *moves, uint32_t maxMoves)
+{
+	mtx_lock(&(*allocator).lock);
+
+	uint32_t moveCount = 0;
+	if (pool != NULL)
+	{
+		moveCount = planPoolMoves(allocator, pool, moves, maxMoves);
+	} else
+	{
+		for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES && moveCount < maxMoves; i++)
+		{
+			if ((*allocator).defaultPools[i] != NULL)
+				moveCount += planPoolMoves(allocator, (*allocator).defaultPools[i], &moves[moveCount], maxMoves - moveCount);
+		}
+	}
+
+	mtx_unlock(&(*allocator).lock);
+	return moveCount;
+}
+
+void gpuDefragmentCommit(gpuAllocator *allocator, gpuDefragMove *moves, uint32_t moveCount)
+{
+	mtx_lock(&(*allocator).lock);
+
+	for (uint32_t i = 0; i < moveCount; i++)
+	{
+		gpuBlock *dstBlock = moves[i].dst.block;
+		(*dstBlock).tlsf.nodes[moves[i].dst.node].pendingMove = false;
+
+		freeAllocation(allocator, &moves[i].src);
+	}
+
+	mtx_unlock(&(*allocator).lock);
+}
+
+void gpuGetHeapStats(gpuAllocator *allocator, gpuHeapStats stats[VK_MAX_MEMORY_HEAPS])
+{
+	mtx_lock(&(*allocator).lock);
+	memcpy(stats, (*allocator).heapStats, sizeof((*allocator).heapStats));
+	mtx_unlock(&(*allocator).lock);
+}
+
+void gpuPrintStats(gpuAllocator *allocator)
+{
+	gpuHeapStats stats[VK_MAX_MEMORY_HEAPS];
+	gpuGetHeapStats(allocator, stats);
+
+	for (uint32_t i = 0; i < (*allocator).memoryProperties.memoryHeapCount; i++)
+	{
+		if (stats[i].blockCount == 0 && stats[i].dedicatedCount == 0) continue;
+
+		printf("heap %u: %u blocks (%.1f MiB), %u allocations (%.1f MiB), %u dedicated (%.1f MiB)\n", i,
+			stats[i].blockCount, stats[i].blockBytes / 1048576.0,
+			stats[i].allocationCount, stats[i].allocatedBytes / 1048576.0,
+			stats[i].dedicatedCount, stats[i].dedicatedBytes / 1048576.0);
+	}
+}
@@ -0,0 +1,118 @@
+#ifndef GPU_ALLOCATOR_H
+#define GPU_ALLOCATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+// Sub-allocates VkDeviceMemory out of large blocks so resources never cost a
+// vkAllocateMemory each. Every memory type gets a lazily created TLSF pool;
+// custom pools can pick the buddy or linear strategy instead. All entry points
+// are thread safe (one lock per allocator).
+
+typedef enum gpuAllocStrategy
+{
+	GPU_ALLOC_STRATEGY_TLSF,   // general purpose, O(1) good-fit, supports defragmentation
+	GPU_ALLOC_STRATEGY_BUDDY,  // power-of-two nodes, cheap merging, for uniformly sized resources
+	GPU_ALLOC_STRATEGY_LINEAR  // bump pointer, freed in bulk by gpuPoolReset or when a block drains
+} gpuAllocStrategy;
+
+typedef enum gpuAllocationFlags
+{
+	GPU_ALLOCATION_DEDICATED     = 1 << 0, // own VkDeviceMemory, for big render targets
+	GPU_ALLOCATION_MAPPED        = 1 << 1, // requires HOST_VISIBLE; pointer stays valid for the allocation's life
+	GPU_ALLOCATION_OPTIMAL_IMAGE = 1 << 2  // tiling-optimal image, kept bufferImageGranularity apart from buffers
+} gpuAllocationFlags;
+
+typedef struct gpuAllocator gpuAllocator;
+typedef struct gpuPool gpuPool;
+typedef struct gpuBlock gpuBlock;
+
+typedef struct gpuAllocatorCreateInfo
+{
+	VkPhysicalDevice physicalDevice;
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	VkDeviceSize bufferImageGranularity;
+	uint32_t maxMemoryAllocationCount;
+	VkDeviceSize preferredBlockSize;     // 0 picks one from the heap size
+	bool useMemoryRequirements2;         // device is 1.1+, dedicated hints are queried
+} gpuAllocatorCreateInfo;
+
+typedef struct gpuPoolCreateInfo
+{
+	uint32_t memoryTypeIndex;
+	gpuAllocStrategy strategy;
+	VkDeviceSize blockSize;              // rounded up to a power of two for buddy pools
+	uint32_t maxBlockCount;              // 0 = unlimited
+} gpuPoolCreateInfo;
+
+typedef struct gpuAllocationCreateInfo
+{
+	VkMemoryPropertyFlags requiredFlags;
+	VkMemoryPropertyFlags preferredFlags;
+	uint32_t flags;                      // gpuAllocationFlags
+	gpuPool *pool;                       // NULL uses the default pool of the chosen memory type
+	void *userData;                      // handed back in defragmentation moves
+} gpuAllocationCreateInfo;
+
+typedef struct gpuAllocation
+{
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	void *mapped;
+	uint32_t memoryTypeIndex;
+
+	gpuPool *pool;                       // NULL for dedicated allocations
+	gpuBlock *block;
+	uint32_t node;
+} gpuAllocation;
+
+typedef struct gpuHeapStats
+{
+	uint32_t blockCount;
+	uint32_t allocationCount;
+	uint32_t dedicatedCount;
+	VkDeviceSize blockBytes;             // memory held in pooled blocks
+	VkDeviceSize allocatedBytes;         // bytes handed out of those blocks
+	VkDeviceSize dedicatedBytes;
+} gpuHeapStats;
+
+typedef struct gpuDefragMove
+{
+	void *userData;
+	gpuAllocation src;
+	gpuAllocation dst;
+} gpuDefragMove;
+
+gpuAllocator *gpuAllocatorCreate(const gpuAllocatorCreateInfo *createInfo);
+void gpuAllocatorDestroy(gpuAllocator *allocator);
+
+gpuPool *gpuPoolCreate(gpuAllocator *allocator, const gpuPoolCreateInfo *createInfo);
+void gpuPoolDestroy(gpuAllocator *allocator, gpuPool *pool);
+void gpuPoolReset(gpuAllocator *allocator, gpuPool *pool);
+
+uint32_t gpuFindMemoryType(gpuAllocator *allocator, uint32_t memoryTypeBits, VkMemoryPropertyFlags requiredFlags, VkMemoryPropertyFlags preferredFlags);
+
+VkResult gpuAllocateMemory(gpuAllocator *allocator, const VkMemoryRequirements *requirements, const gpuAllocationCreateInfo *createInfo, gpuAllocation *allocation);
+void gpuFreeMemory(gpuAllocator *allocator, gpuAllocation *allocation);
+
+VkResult gpuCreateBuffer(gpuAllocator *allocator, const VkBufferCreateInfo *bufferInfo, const gpuAllocationCreateInfo *createInfo, VkBuffer *buffer, gpuAllocation *allocation);
+void gpuDestroyBuffer(gpuAllocator *allocator, VkBuffer buffer, gpuAllocation *allocation);
+
+VkResult gpuCreateImage(gpuAllocator *allocator, const VkImageCreateInfo *imageInfo, const gpuAllocationCreateInfo *createInfo, VkImage *image, gpuAllocation *allocation);
+void gpuDestroyImage(gpuAllocator *allocator, VkImage image, gpuAllocation *allocation);
+
+// Plans up to maxMoves relocations that drain the emptiest blocks of TLSF pools
+// (pool == NULL covers every default pool). The caller copies src to dst, rebinds
+// its resource to dst and, once the GPU copies have finished, calls
+// gpuDefragmentCommit so the sources are freed and empty blocks released.
+uint32_t gpuDefragmentPlan(gpuAllocator *allocator, gpuPool *pool, gpuDefragMove *moves, uint32_t maxMoves);
+void gpuDefragmentCommit(gpuAllocator *allocator, gpuDefragMove *moves, uint32_t moveCount);
+
+void gpuGetHeapStats(gpuAllocator *allocator, gpuHeapStats stats[VK_MAX_MEMORY_HEAPS]);
+void gpuPrintStats(gpuAllocator *allocator);
+
+#endif
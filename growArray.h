@@ -0,0 +1,27 @@
+#ifndef GROW_ARRAY_H
+#define GROW_ARRAY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Makes room for one more element in a heap array that doubles whenever count
+// reaches capacity, starting at initial. Running out of memory is reported and
+// aborts: none of the callers could carry on with the element they are adding.
+#define GROW(array, count, capacity, initial) \
+	do \
+	{ \
+		if ((count) == (capacity)) \
+		{ \
+			size_t grownCapacity = (capacity) ? 2 * (size_t)(capacity) : (size_t)(initial); \
+			void *grown = realloc((array), grownCapacity * sizeof(*(array))); \
+			if (grown == NULL) \
+			{ \
+				printf("out of memory growing " #array " to %zu elements\n", grownCapacity); \
+				abort(); \
+			} \
+			(array) = grown; \
+			(capacity) = grownCapacity; \
+		} \
+	} while (0)
+
+#endif
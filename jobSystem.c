@@ -0,0 +1,416 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdalign.h>
+#include <threads.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "jobSystem.h"
+#include "growArray.h"
+
+#define JOB_DEQUE_SIZE 4096              // power of two
+#define JOB_MAX_WORKERS 64
+#define JOB_SPIN_ROUNDS 64               // failed searches before a worker sleeps
+
+typedef struct job
+{
+	jobFunction function;
+	void *data;
+	uint32_t begin, end;
+	jobCounter *counter;
+} job;
+
+// A thief may read a cell while the owner rewrites it; the failed CAS on top
+// throws such a read away, but the fields still have to be atomics.
+typedef struct jobCell
+{
+	_Atomic(jobFunction) function;
+	_Atomic(void *) data;
+	atomic_uint begin, end;
+	_Atomic(jobCounter *) counter;
+} jobCell;
+
+typedef struct jobWorker
+{
+	alignas(64) atomic_llong top;        // thieves
+	alignas(64) atomic_llong bottom;     // owner
+	jobCell cells[JOB_DEQUE_SIZE];
+
+	alignas(64) atomic_ullong executed, stolen, inlined;
+	jobSystem *system;
+	uint32_t index;
+	uint32_t seed;
+	thrd_t thread;
+} jobWorker;
+
+struct jobSystem
+{
+	jobWorker *workers;
+	uint32_t workerCount;
+
+	alignas(64) atomic_uint queued;      // submitted, not yet picked up
+	atomic_uint sleepers;
+	atomic_bool quit;
+	mtx_t sleepLock;
+	cnd_t wake;
+
+	// Submissions from threads without a deque.
+	mtx_t injectLock;
+	atomic_uint injectedCount;
+	job *injected;
+	uint32_t injectedHead, injectedEnd, injectedCapacity;
+	atomic_ullong foreignExecuted;
+};
+
+static _Thread_local jobSystem *currentSystem;
+static _Thread_local uint32_t currentIndex;
+
+static uint32_t coreCount(void)
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (uint32_t)info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (uint32_t)count : 1;
+#endif
+}
+
+static inline uint32_t nextRandom(uint32_t *seed)
+{
+	uint32_t x = *seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *seed = x;
+}
+
+static inline void storeCell(jobCell *cell, const job *item)
+{
+	atomic_store_explicit(&(*cell).function, (*item).function, memory_order_relaxed);
+	atomic_store_explicit(&(*cell).data, (*item).data, memory_order_relaxed);
+	atomic_store_explicit(&(*cell).begin, (*item).begin, memory_order_relaxed);
+	atomic_store_explicit(&(*cell).end, (*item).end, memory_order_relaxed);
+	atomic_store_explicit(&(*cell).counter, (*item).counter, memory_order_relaxed);
+}
+
+static inline void loadCell(jobCell *cell, job *item)
+{
+	(*item).function = atomic_load_explicit(&(*cell).function, memory_order_relaxed);
+	(*item).data = atomic_load_explicit(&(*cell).data, memory_order_relaxed);
+	(*item).begin = atomic_load_explicit(&(*cell).begin, memory_order_relaxed);
+	(*item).end = atomic_load_explicit(&(*cell).end, memory_order_relaxed);
+	(*item).counter = atomic_load_explicit(&(*cell).counter, memory_order_relaxed);
+}
+
+// Chase-Lev, after Le et al., "Correct and Efficient Work-Stealing for Weak
+// Memory Models", with the standalone fences folded into seq_cst accesses so
+// thread sanitizers can follow them. Fixed size: a full deque is reported to
+// the caller, which then runs the job itself.
+static bool dequePush(jobWorker *worker, const job *item)
+{
+	long long bottom = atomic_load_explicit(&(*worker).bottom, memory_order_relaxed);
+	long long top = atomic_load_explicit(&(*worker).top, memory_order_acquire);
+	if (bottom - top >= JOB_DEQUE_SIZE) return false;
+
+	storeCell(&(*worker).cells[bottom & (JOB_DEQUE_SIZE - 1)], item);
+	atomic_store_explicit(&(*worker).bottom, bottom + 1, memory_order_release);
+	return true;
+}
+
+static bool dequeTake(jobWorker *worker, job *item)
+{
+	long long bottom = atomic_load_explicit(&(*worker).bottom, memory_order_relaxed) - 1;
+	atomic_store_explicit(&(*worker).bottom, bottom, memory_order_seq_cst);
+	long long top = atomic_load_explicit(&(*worker).top, memory_order_seq_cst);
+
+	if (top > bottom)
+	{
+		atomic_store_explicit(&(*worker).bottom, bottom + 1, memory_order_relaxed);
+		return false;
+	}
+
+	loadCell(&(*worker).cells[bottom & (JOB_DEQUE_SIZE - 1)], item);
+	if (top < bottom) return true;
+
+	// Last job: race the thieves for it.
+	bool won = atomic_compare_exchange_strong_explicit(&(*worker).top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+	atomic_store_explicit(&(*worker).bottom, bottom + 1, memory_order_relaxed);
+	return won;
+}
+
+static bool dequeSteal(jobWorker *worker, job *item)
+{
+	long long top = atomic_load_explicit(&(*worker).top, memory_order_seq_cst);
+	long long bottom = atomic_load_explicit(&(*worker).bottom, memory_order_seq_cst);
+	if (top >= bottom) return false;
+
+	loadCell(&(*worker).cells[top & (JOB_DEQUE_SIZE - 1)], item);
+	return atomic_compare_exchange_strong_explicit(&(*worker).top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+}
+
+static bool takeInjected(jobSystem *jobs, job *item)
+{
+	if (atomic_load_explicit(&(*jobs).injectedCount, memory_order_relaxed) == 0) return false;
+
+	bool found = false;
+	mtx_lock(&(*jobs).injectLock);
+	if ((*jobs).injectedHead < (*jobs).injectedEnd)
+	{
+		*item = (*jobs).injected[(*jobs).injectedHead++];
+		if ((*jobs).injectedHead == (*jobs).injectedEnd) (*jobs).injectedHead = (*jobs).injectedEnd = 0;
+		atomic_fetch_sub_explicit(&(*jobs).injectedCount, 1, memory_order_relaxed);
+		found = true;
+	}
+	mtx_unlock(&(*jobs).injectLock);
+	return found;
+}
+
+static bool findJob(jobSystem *jobs, uint32_t index, job *item)
+{
+	bool found = false;
+	if (index != JOB_NOT_A_WORKER) found = dequeTake(&(*jobs).workers[index], item);
+	if (!found) found = takeInjected(jobs, item);
+
+	// One pass over the other workers, starting at a random one. Threads outside
+	// the system never steal: a worker's jobs may rely on running on a worker.
+	if (index != JOB_NOT_A_WORKER)
+	{
+		uint32_t start = nextRandom(&(*jobs).workers[index].seed) % (*jobs).workerCount;
+		for (uint32_t i = 0; i < (*jobs).workerCount && !found; i++)
+		{
+			uint32_t victim = (start + i) % (*jobs).workerCount;
+			if (victim == index) continue;
+
+			found = dequeSteal(&(*jobs).workers[victim], item);
+			if (found) atomic_fetch_add_explicit(&(*jobs).workers[index].stolen, 1, memory_order_relaxed);
+		}
+	}
+
+	if (found) atomic_fetch_sub_explicit(&(*jobs).queued, 1, memory_order_relaxed);
+	return found;
+}
+
+static void runJob(jobSystem *jobs, uint32_t index, const job *item)
+{
+	(*item).function((*item).data, (*item).begin, (*item).end);
+	if ((*item).counter != NULL) atomic_fetch_sub_explicit(&(*(*item).counter).pending, 1, memory_order_acq_rel);
+
+	atomic_ullong *executed = index != JOB_NOT_A_WORKER ? &(*jobs).workers[index].executed : &(*jobs).foreignExecuted;
+	atomic_fetch_add_explicit(executed, 1, memory_order_relaxed);
+}
+
+static int workerMain(void *argument)
+{
+	jobWorker *worker = argument;
+	jobSystem *jobs = (*worker).system;
+	currentSystem = jobs;
+	currentIndex = (*worker).index;
+
+	uint32_t idle = 0;
+	for (;;)
+	{
+		job item;
+		if (findJob(jobs, (*worker).index, &item))
+		{
+			runJob(jobs, (*worker).index, &item);
+			idle = 0;
+			continue;
+		}
+
+		if (atomic_load(&(*jobs).quit)) break;
+
+		if (++idle < JOB_SPIN_ROUNDS)
+		{
+			thrd_yield();
+			continue;
+		}
+
+		// Announce the sleep before checking for work; submitters check for
+		// sleepers after publishing work, so one of the two sees the other.
+		atomic_fetch_add(&(*jobs).sleepers, 1);
+		mtx_lock(&(*jobs).sleepLock);
+		while (atomic_load(&(*jobs).queued) == 0 && !atomic_load(&(*jobs).quit)) cnd_wait(&(*jobs).wake, &(*jobs).sleepLock);
+		mtx_unlock(&(*jobs).sleepLock);
+		atomic_fetch_sub(&(*jobs).sleepers, 1);
+		idle = 0;
+	}
+
+	return 0;
+}
+
+jobSystem *jobSystemCreate(uint32_t workerCount)
+{
+	if (workerCount == 0) workerCount = coreCount();
+	if (workerCount > JOB_MAX_WORKERS) workerCount = JOB_MAX_WORKERS;
+
+	jobSystem *jobs = calloc(1, sizeof(jobSystem));
+	(*jobs).workerCount = workerCount;
+	(*jobs).workers = aligned_alloc(alignof(jobWorker), workerCount * sizeof(jobWorker));
+	memset((*jobs).workers, 0, workerCount * sizeof(jobWorker));
+
+	mtx_init(&(*jobs).sleepLock, mtx_plain);
+	cnd_init(&(*jobs).wake);
+	mtx_init(&(*jobs).injectLock, mtx_plain);
+
+	currentSystem = jobs;
+	currentIndex = 0;
+
+	for (uint32_t i = 0; i < workerCount; i++)
+	{
+		jobWorker *worker = &(*jobs).workers[i];
+		(*worker).system = jobs;
+		(*worker).index = i;
+		(*worker).seed = 0x9E3779B9u * (i + 1);
+	}
+
+	for (uint32_t i = 1; i < workerCount; i++)
+	{
+		if (thrd_create(&(*jobs).workers[i].thread, workerMain, &(*jobs).workers[i]) != thrd_success)
+		{
+			// Run with the workers that did start.
+			printf("failed to start job worker %u\n", i);
+			(*jobs).workerCount = i;
+			break;
+		}
+	}
+
+	return jobs;
+}
+
+void jobSystemDestroy(jobSystem *jobs)
+{
+	if (jobs == NULL) return;
+
+	// Help drain whatever is still queued, then let the workers go.
+	uint32_t index = jobWorkerIndex(jobs);
+	job item;
+	while (atomic_load(&(*jobs).queued) > 0)
+	{
+		if (findJob(jobs, index, &item)) runJob(jobs, index, &item);
+		else thrd_yield();
+	}
+
+	mtx_lock(&(*jobs).sleepLock);
+	atomic_store(&(*jobs).quit, true);
+	cnd_broadcast(&(*jobs).wake);
+	mtx_unlock(&(*jobs).sleepLock);
+
+	for (uint32_t i = 1; i < (*jobs).workerCount; i++) thrd_join((*jobs).workers[i].thread, NULL);
+
+	if (currentSystem == jobs) currentSystem = NULL;
+
+	mtx_destroy(&(*jobs).injectLock);
+	cnd_destroy(&(*jobs).wake);
+	mtx_destroy(&(*jobs).sleepLock);
+	free((*jobs).injected);
+	free((*jobs).workers);
+	free(jobs);
+}
+
+uint32_t jobWorkerCount(jobSystem *jobs)
+{
+	return (*jobs).workerCount;
+}
+
+uint32_t jobWorkerIndex(jobSystem *jobs)
+{
+	return currentSystem == jobs ? currentIndex : JOB_NOT_A_WORKER;
+}
+
+// Does not wake anyone, see wakeWorkers.
+static void submit(jobSystem *jobs, uint32_t index, const job *item)
+{
+	atomic_fetch_add(&(*jobs).queued, 1);
+
+	if (index != JOB_NOT_A_WORKER)
+	{
+		if (dequePush(&(*jobs).workers[index], item)) return;
+
+		atomic_fetch_sub(&(*jobs).queued, 1);
+		atomic_fetch_add_explicit(&(*jobs).workers[index].inlined, 1, memory_order_relaxed);
+		runJob(jobs, index, item);
+		return;
+	}
+
+	mtx_lock(&(*jobs).injectLock);
+	GROW((*jobs).injected, (*jobs).injectedEnd, (*jobs).injectedCapacity, 64);
+	(*jobs).injected[(*jobs).injectedEnd++] = *item;
+	atomic_fetch_add_explicit(&(*jobs).injectedCount, 1, memory_order_relaxed);
+	mtx_unlock(&(*jobs).injectLock);
+}
+
+static void wakeWorkers(jobSystem *jobs, uint32_t count)
+{
+	if (atomic_load(&(*jobs).sleepers) == 0) return;
+
+	mtx_lock(&(*jobs).sleepLock);
+	if (count == 1) cnd_signal(&(*jobs).wake);
+	else cnd_broadcast(&(*jobs).wake);
+	mtx_unlock(&(*jobs).sleepLock);
+}
+
+void jobRun(jobSystem *jobs, const jobDecl *decls, uint32_t count, jobCounter *counter)
+{
+	if (count == 0) return;
+	if (counter != NULL) atomic_fetch_add_explicit(&(*counter).pending, count, memory_order_relaxed);
+
+	uint32_t index = jobWorkerIndex(jobs);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		job item = {decls[i].function, decls[i].data, decls[i].begin, decls[i].end, counter};
+		submit(jobs, index, &item);
+	}
+
+	wakeWorkers(jobs, count);
+}
+
+void jobParallelFor(jobSystem *jobs, jobFunction function, void *data, uint32_t count, uint32_t grain, jobCounter *counter)
+{
+	if (count == 0) return;
+	if (grain == 0) grain = 1;
+
+	uint32_t batches = (count + grain - 1) / grain;
+	if (counter != NULL) atomic_fetch_add_explicit(&(*counter).pending, batches, memory_order_relaxed);
+
+	uint32_t index = jobWorkerIndex(jobs);
+	for (uint32_t begin = 0; begin < count; begin += grain)
+	{
+		job item = {function, data, begin, count - begin < grain ? count : begin + grain, counter};
+		submit(jobs, index, &item);
+	}
+
+	wakeWorkers(jobs, batches);
+}
+
+void jobWait(jobSystem *jobs, jobCounter *counter)
+{
+	uint32_t index = jobWorkerIndex(jobs);
+
+	while (!jobCounterDone(counter))
+	{
+		job item;
+		if (findJob(jobs, index, &item)) runJob(jobs, index, &item);
+		else thrd_yield();
+	}
+}
+
+jobSystemStats jobGetStats(jobSystem *jobs)
+{
+	jobSystemStats stats = {0};
+	stats.executed = atomic_load_explicit(&(*jobs).foreignExecuted, memory_order_relaxed);
+
+	for (uint32_t i = 0; i < (*jobs).workerCount; i++)
+	{
+		stats.executed += atomic_load_explicit(&(*jobs).workers[i].executed, memory_order_relaxed);
+		stats.stolen += atomic_load_explicit(&(*jobs).workers[i].stolen, memory_order_relaxed);
+		stats.inlined += atomic_load_explicit(&(*jobs).workers[i].inlined, memory_order_relaxed);
+	}
+	return stats;
+}
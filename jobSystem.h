@@ -0,0 +1,73 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Work-stealing job system. The creating thread is worker 0 and every other worker
+// owns a thread; each worker pushes to and pops from the bottom of its own
+// Chase-Lev deque (newest first, cache warm) while idle workers steal the oldest
+// job from the top of a random victim. Completion is tracked with counters:
+// jobRun adds to one, finishing a job subtracts, and jobWait keeps the waiting
+// thread busy running jobs until it reaches zero. A job may wait on a counter
+// itself, which is how dependencies are expressed.
+// Threads outside the system (no worker index) may submit too; their jobs go
+// through a locked queue, and while they wait they only help with that queue,
+// so a job pushed by a worker always runs on a worker.
+
+#define JOB_NOT_A_WORKER UINT32_MAX
+
+typedef struct jobSystem jobSystem;
+
+// Runs items [begin, end) of whatever data describes.
+typedef void (*jobFunction)(void *data, uint32_t begin, uint32_t end);
+
+typedef struct jobCounter
+{
+	atomic_uint pending;
+} jobCounter;
+
+typedef struct jobDecl
+{
+	jobFunction function;
+	void *data;
+	uint32_t begin, end;
+} jobDecl;
+
+typedef struct jobSystemStats
+{
+	uint64_t executed;                   // since creation, over every worker
+	uint64_t stolen;
+	uint64_t inlined;                    // ran on submit because a deque was full
+} jobSystemStats;
+
+// workerCount 0 picks one worker per core, the calling thread included.
+jobSystem *jobSystemCreate(uint32_t workerCount);
+
+// Waits for queued jobs to finish, then joins the workers.
+void jobSystemDestroy(jobSystem *jobs);
+
+uint32_t jobWorkerCount(jobSystem *jobs);
+
+// 0 on the creating thread, JOB_NOT_A_WORKER on threads the system does not own.
+uint32_t jobWorkerIndex(jobSystem *jobs);
+
+// counter may be NULL for fire and forget.
+void jobRun(jobSystem *jobs, const jobDecl *decls, uint32_t count, jobCounter *counter);
+
+// Splits [0, count) into jobs of at most grain items.
+void jobParallelFor(jobSystem *jobs, jobFunction function, void *data, uint32_t count, uint32_t grain, jobCounter *counter);
+
+// Runs other jobs until the counter drops to zero; see above for threads outside
+// the system.
+void jobWait(jobSystem *jobs, jobCounter *counter);
+
+static inline bool jobCounterDone(jobCounter *counter)
+{
+	return atomic_load_explicit(&(*counter).pending, memory_order_acquire) == 0;
+}
+
+jobSystemStats jobGetStats(jobSystem *jobs);
+
+#endif
@@ -2,19 +2,81 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <math.h>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
-#define max(a,b) (a>b ? a : b)
-#define min(a,b) (a<b ? a : b)
-#define clamp(x,lo,hi) (min( hi, max(lo,x) ))
+#include "jobSystem.h"
+#include "simulation.h"
+#include "ecs.h"
+#include "ecsScheduler.h"
+#include "broadphase.h"
+#include "tileGrid.h"
+#include "vectorMath.h"
+#include "gpuAllocator.h"
+#include "uploadRing.h"
+#include "commandRecorder.h"
+#include "renderGraph.h"
+#include "descriptorAllocator.h"
+#include "bindlessTable.h"
+#include "spriteBatch.h"
+#include "textureAtlas.h"
+
+#define MAX_FRAMES_IN_FLIGHT 3
+#define DEFAULT_FRAMES_IN_FLIGHT 2
+
+#define MAX_ENABLED_DEVICE_EXTENSIONS 16
+
+#define GPU_CACHE_PATH "gpu_cache.txt"
+#define GPU_OVERRIDE_ENV "MOUSERUN_GPU"
+
+#define HEADLESS_DEFAULT_FRAMES 1000
+#define OFFSCREEN_IMAGE_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+
+#define UPLOAD_RING_SIZE ((VkDeviceSize)32 * 1024 * 1024)
+
+#define SPRITE_SHADER_DIR "shaders"
+#define SPRITE_BATCH_CAPACITY 131072
+#define SIM_TICK_RATE 120.0
+#define SPRITE_BENCH_IMAGES 48
+#define SPRITE_BENCH_CHUNK_GRAIN 8
+
+#define ECS_BENCH_DEFAULT_ENTITIES 50000
+#define ECS_BENCH_PASSES 1000
+#define BROADPHASE_BENCH_DEFAULT_BODIES 20000
+#define BROADPHASE_BENCH_TICKS 240
+#define BROADPHASE_CELL_SIZE 32.0f
+#define TILE_BENCH_DEFAULT_BODIES 20000
+#define TILE_BENCH_TICKS 240
+#define TILE_BENCH_PROBES 100000
+#define MATH_BENCH_COUNT 65536
+#define MATH_BENCH_PASSES 200
+#define DEFRAG_BENCH_BUFFERS 2048
+#define DEFRAG_BENCH_PAGE 4096
+#define DEFRAG_BENCH_BLOCK_SIZE ((VkDeviceSize)1024 * 1024)
+#define SCENE_CHUNKS_PER_WORKER 2
+#define SCENE_MIN_DRAW_SIZE 1024
+#define MAX_RECORD_CHUNKS 128
+
+#define ATLAS_PAGE_SIZE 1024
+
+#define DESCRIPTOR_SETS_PER_POOL 256
+#define ATLAS_MAX_PAGES 4
+
+#define MAX_BINDLESS_TEXTURES 4096
+#define MAX_BINDLESS_BUFFERS 1024
+
+#define MAX_TRACE_EVENTS 32
 
 typedef struct window
 {
 	GLFWwindow *pWindow;
 	char *windowName;
 	uint32_t width, height;
+	bool framebufferResized;
 } window;
 
 typedef struct QueueFamilyIndices 
@@ -30,34 +92,303 @@ typedef struct QueueFamilyIndices
 		uint32_t value;
 		bool hasValue;
 	} presentFamily;
+
+	struct transferFamily
+	{
+		uint32_t value;
+		bool hasValue;
+	} transferFamily;
+
+	struct computeFamily
+	{
+		uint32_t value;
+		bool hasValue;
+	} computeFamily;
 } QueueFamilyIndices;
 
-typedef struct SwapChainSupportDetails 
+typedef enum QueueType
+{
+	QUEUE_TYPE_GRAPHICS,
+	QUEUE_TYPE_TRANSFER,
+	QUEUE_TYPE_COMPUTE
+} QueueType;
+
+// Snapshot of what the surface supports. Formats and present modes only change
+// with the surface; the capabilities (currentExtent) follow the window and are
+// re-read when the swapchain is rebuilt.
+typedef struct SurfaceInfo 
 {
 	VkSurfaceCapabilitiesKHR capabilities;
 	VkSurfaceFormatKHR *formats;
+	uint32_t formatCount;
 	VkPresentModeKHR *presentModes;
-} SwapChainSupportDetails;
+	uint32_t presentModeCount;
+
+	bool valid;
+	bool capabilitiesValid;
+} SurfaceInfo;
+
+typedef struct DeviceFeatureSet
+{
+	bool features2;
+	bool synchronization2;
+	bool timelineSemaphore;
+	bool descriptorIndexing;
+	bool presentId;
+	bool presentWait;
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures;
+
+	uint32_t enabledExtensionCount;
+	const char *enabledExtensions[MAX_ENABLED_DEVICE_EXTENSIONS];
+} DeviceFeatureSet;
+
+// Only required when presenting; offscreen rendering has no surface to present to.
+const char *requiredDeviceExtensions[] = 
+{
+	VK_KHR_SWAPCHAIN_EXTENSION_NAME
+};
+
+const char *optionalDeviceExtensions[] = 
+{
+	VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
+	VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
+	VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+	VK_KHR_PRESENT_ID_EXTENSION_NAME,
+	VK_KHR_PRESENT_WAIT_EXTENSION_NAME,
+	"VK_KHR_portability_subset"
+};
+
+#define ARRAY_COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+typedef enum PresentProfile
+{
+	PRESENT_PROFILE_LOW_LATENCY,
+	PRESENT_PROFILE_BALANCED,
+	PRESENT_PROFILE_POWER_SAVER,
+	PRESENT_PROFILE_COUNT
+} PresentProfile;
+
+typedef struct traceEvent
+{
+	const char *name;
+	double start, end;
+} traceEvent;
+
+// Startup phases as Chrome trace "complete" events (chrome://tracing, ui.perfetto.dev).
+typedef struct startupTrace
+{
+	traceEvent events[MAX_TRACE_EVENTS];
+	uint32_t eventCount;
+	double origin;
+	const char *path;
+} startupTrace;
+
+typedef struct arenaBlock
+{
+	struct arenaBlock *next;
+	size_t size, used;
+} arenaBlock;
+
+// Keeps allocations 16-byte aligned, malloc already aligns the block itself.
+#define ARENA_HEADER_SIZE ((sizeof(arenaBlock) + 15) & ~(size_t)15)
+
+// Bump allocator for data that lives as long as the app; freed all at once.
+typedef struct arena
+{
+	arenaBlock *head;
+	size_t blockSize;
+} arena;
+
+// Everything selection and device creation need to know about a physical device,
+// queried once per launch.
+typedef struct PhysicalDeviceInfo
+{
+	VkPhysicalDevice device;
+	VkPhysicalDeviceProperties properties;
+	VkPhysicalDeviceFeatures features;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+
+	uint8_t deviceUUID[VK_UUID_SIZE];
+	uint32_t driverVersion;
+
+	VkQueueFamilyProperties *queueFamilies;
+	VkBool32 *queueFamilyPresent;
+	uint32_t queueFamilyCount;
+	QueueFamilyIndices queueIndices;
+
+	VkExtensionProperties *extensions;
+	uint32_t extensionCount;
+} PhysicalDeviceInfo;
+
+// Present mode, swapchain depth and frames in flight are picked together; FIFO is
+// always the fallback mode so no profile ever tears. maxQueuedPresents > 0 makes
+// the loop wait (VK_KHR_present_wait) until at most that many presents are pending.
+typedef struct PresentProfileSettings
+{
+	const char *name;
+	VkPresentModeKHR preferredMode;
+	uint32_t extraImages;
+	uint32_t framesInFlight;
+	uint32_t maxQueuedPresents;
+} PresentProfileSettings;
+
+const PresentProfileSettings presentProfiles[PRESENT_PROFILE_COUNT] = 
+{
+	{"low-latency", VK_PRESENT_MODE_MAILBOX_KHR, 1, 2, 1},
+	{"balanced",    VK_PRESENT_MODE_MAILBOX_KHR, 1, 3, 0},
+	{"power-saver", VK_PRESENT_MODE_FIFO_KHR,    0, 2, 0}
+};
+
+typedef struct deferredDestroy
+{
+	VkObjectType type;
+	uint64_t handle;
+} deferredDestroy;
+
+// Components of a benchmark sprite, owned by the simulation thread.
+typedef struct spriteSpin
+{
+	float rotation, spin;
+} spriteSpin;
+
+typedef struct spriteLook
+{
+	float size;
+	uint32_t color;
+	uint16_t layer;
+	uint16_t region;
+} spriteLook;
+
+typedef struct spriteComponents
+{
+	ecsComponent position, velocity, spin, look;
+} spriteComponents;
+
+// Published every tick: the sprite before and after it, for interpolation.
+typedef struct spriteState
+{
+	float prevX, prevY, prevRotation;
+	float x, y, rotation;
+	spriteLook look;
+} spriteState;
+
+typedef struct frameData
+{
+	VkCommandPool commandPool;
+	VkCommandBuffer commandBuffer;
+	VkFence inFlightFence;
+	VkSemaphore imageAvailableSemaphore;
+	uploadWait uploadWait;
+	uint32_t imageIndex;
+
+	// Objects retired while this slot was the latest submission; destroyed once its fence signals.
+	deferredDestroy *deletionQueue;
+	uint32_t deletionCount;
+	uint32_t deletionCapacity;
+} frameData;
 
 typedef struct vulkanApp
 {
 	window windowStruct;
 
+	// Headless runs without GLFW. With VK_EXT_headless_surface the normal swapchain
+	// path is used, otherwise (or with offscreen set) the frame loop renders into
+	// plain images and "present" is a no-op.
+	bool headless;
+	bool offscreen;
+	uint32_t frameCount;
+	const char *dumpFramePath;
+	gpuAllocation *offscreenMemory;
+	uint32_t offscreenNextImage;
+	uint32_t lastImageIndex;
+	VkImageLayout presentLayout;
+
+	bool quiet;
+	startupTrace trace;
+
 	VkInstance instance;
 	VkPhysicalDevice physicalDevice;
+	const char *forcedGPU;
+
+	arena deviceInfoArena;
+	PhysicalDeviceInfo *deviceInfos;
+	uint32_t deviceInfoCount;
+	const PhysicalDeviceInfo *deviceInfo;
 
 	QueueFamilyIndices graphicsQueueFamily;
 	VkDevice device;
+	DeviceFeatureSet enabledFeatures;
+	jobSystem *jobs;
+	uint32_t threadCount;
+	gpuAllocator *allocator;
+	uploadRing *uploads;
+	commandRecorder *recorder;
+	renderGraph *frameGraph;
+	rgResource backbuffer;
+	descriptorLayoutCache *layouts;
+	descriptorAllocator *descriptors;
+	bindlessTable *textures;
+	spriteBatch *sprites;
+	uint32_t spriteDrawCount;
+	textureAtlas *atlas;
+	uint32_t atlasTexture;
+	spriteMaterial atlasMaterial;
+	atlasRegion *spriteRegions;
+
+	// --sprites benchmark: bouncing sprites spread over four layers.
+	ecsWorld *world;
+	spriteComponents components;
+	ecsQuery *spriteQuery;
+	ecsScheduler *spriteSystems;
+	uint32_t *spriteViewOffsets;
+	spriteState *spriteSnapshot;         // being written by the current tick
+	float spriteStep;
+	uint32_t spriteCount;
+	simulation *simulation;
+	float worldWidth, worldHeight;
+	uint64_t spriteDrawTotal;
+	uint64_t spriteInstanceTotal;
+	double recordSeconds;
 
 	VkQueue graphicsQueue;
 	VkSurfaceKHR surface;
 	VkQueue presentQueue;
 
+	// Fall back to the graphics queue/family when the device has no dedicated one.
+	VkQueue transferQueue;
+	uint32_t transferFamily;
+	VkCommandPool transferCommandPool;
+
+	VkQueue computeQueue;
+	uint32_t computeFamily;
+	VkCommandPool computeCommandPool;
+
+	VkCommandPool graphicsCommandPool;
+
+	SurfaceInfo surfaceInfo;
+
 	VkSwapchainKHR swapChain;
 	VkImage *swapChainImages;
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
 	VkImageView *swapChainImageViews;
+	uint32_t swapChainImageCount;
+
+	VkRenderPass renderPass;
+	VkFramebuffer *swapChainFramebuffers;
+	VkFence *imagesInFlight;
+	VkSemaphore *renderFinishedSemaphores;   // per image: a slot's fence does not cover its present
+
+	frameData frames[MAX_FRAMES_IN_FLIGHT];
+	uint32_t framesInFlight;
+	uint32_t currentFrame;
+	uint32_t lastSubmittedFrame;
+	bool swapChainStale;
+
+	PresentProfile presentProfile;
+	PFN_vkWaitForPresentKHR waitForPresent;
+	uint64_t presentId;
 } vulkanApp;
 
 bool indicesIsComplete(QueueFamilyIndices q)
@@ -65,6 +396,87 @@ bool indicesIsComplete(QueueFamilyIndices q)
 	return q.graphicsFamily.hasValue && q.presentFamily.hasValue;
 }
 
+void *arenaAlloc(arena *a, size_t size)
+{
+	size = (size + 15) & ~(size_t)15;
+
+	arenaBlock *block = (*a).head;
+	if (block == NULL || (*block).used + size > (*block).size)
+	{
+		size_t blockSize = mathMax((*a).blockSize, size);
+		block = malloc(ARENA_HEADER_SIZE + blockSize);
+		(*block).next = (*a).head;
+		(*block).size = blockSize;
+		(*block).used = 0;
+		(*a).head = block;
+	}
+
+	void *ptr = (uint8_t *)block + ARENA_HEADER_SIZE + (*block).used;
+	(*block).used += size;
+	return ptr;
+}
+
+void arenaFree(arena *a)
+{
+	while ((*a).head != NULL)
+	{
+		arenaBlock *next = (*(*a).head).next;
+		free((*a).head);
+		(*a).head = next;
+	}
+}
+
+double nowSeconds(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+uint32_t traceBegin(startupTrace *trace, const char *name)
+{
+	if ((*trace).eventCount == MAX_TRACE_EVENTS) return MAX_TRACE_EVENTS;
+
+	traceEvent *event = &(*trace).events[(*trace).eventCount];
+	(*event).name = name;
+	(*event).start = (*event).end = nowSeconds();
+	return (*trace).eventCount++;
+}
+
+void traceEnd(startupTrace *trace, uint32_t event)
+{
+	if (event < (*trace).eventCount) (*trace).events[event].end = nowSeconds();
+}
+
+void writeStartupTrace(startupTrace *trace)
+{
+	FILE *file = fopen((*trace).path, "w");
+	if (file == NULL)
+	{
+		printf("failed to open trace file %s\n", (*trace).path);
+		return;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for (uint32_t i = 0; i < (*trace).eventCount; i++)
+	{
+		traceEvent event = (*trace).events[i];
+		fprintf(file, "\t{\"name\":\"%s\",\"cat\":\"startup\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+			event.name, (event.start - (*trace).origin) * 1e6, (event.end - event.start) * 1e6, (i + 1 < (*trace).eventCount) ? "," : "");
+	}
+	fprintf(file, "]}\n");
+
+	fclose(file);
+}
+
+void framebufferResizeCallback(GLFWwindow *pWindow, int width, int height)
+{
+	window *pWindowStruct = glfwGetWindowUserPointer(pWindow);
+	(*pWindowStruct).width  = width;
+	(*pWindowStruct).height = height;
+	(*pWindowStruct).framebufferResized = true;
+}
+
 void initWindow(window *pWindowStruct, uint32_t width, uint32_t height, char *windowName)
 {
 	(*pWindowStruct).width  = width;
@@ -72,11 +484,24 @@ void initWindow(window *pWindowStruct, uint32_t width, uint32_t height, char *wi
 	(*pWindowStruct).windowName = windowName;
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 	(*pWindowStruct).pWindow = glfwCreateWindow(width, height, windowName, NULL, NULL);
+
+	glfwSetWindowUserPointer((*pWindowStruct).pWindow, pWindowStruct);
+	glfwSetFramebufferSizeCallback((*pWindowStruct).pWindow, framebufferResizeCallback);
+}
+
+bool extensionListContains(VkExtensionProperties *extensions, uint32_t extensionCount, const char *name)
+{
+	for (uint32_t i = 0; i < extensionCount; i++)
+	{
+		if (strcmp(extensions[i].extensionName, name) == 0) return true;
+	}
+
+	return false;
 }
 
-void createInstance(GLFWwindow *window, VkInstance *instance)
+void createInstance(vulkanApp *app)
 {
 	VkApplicationInfo appInfo = {0};
 	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -84,158 +509,315 @@ void createInstance(GLFWwindow *window, VkInstance *instance)
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "MouseRun Vulkan Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_1;
 
 	VkInstanceCreateInfo createInfo = {0};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	createInfo.pApplicationInfo = &appInfo;
 
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
+	// Only needed for the headless probe and the extension dump.
+	uint32_t extensionCount = 0;
+	VkExtensionProperties *extensions = NULL;
+	if ((*app).headless || !(*app).quiet)
+	{
+		vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, NULL);
+
+		extensions = malloc(extensionCount * sizeof(VkExtensionProperties));
+
+		vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, extensions);
+	}
+
+	uint32_t requiredExtensionCount = 0;
+	const char** requiredExtensions;
+	const char *headlessExtensions[] = {VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME};
 
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	if ((*app).headless)
+	{
+		bool hasHeadlessSurface = extensionListContains(extensions, extensionCount, VK_KHR_SURFACE_EXTENSION_NAME)
+			&& extensionListContains(extensions, extensionCount, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+
+		if (!hasHeadlessSurface) (*app).offscreen = true;
+
+		requiredExtensions = headlessExtensions;
+		requiredExtensionCount = (*app).offscreen ? 0 : 2;
+	} else
+	{
+		requiredExtensions = glfwGetRequiredInstanceExtensions(&requiredExtensionCount);
+	}
 
-	createInfo.enabledExtensionCount = glfwExtensionCount;
-	createInfo.ppEnabledExtensionNames = glfwExtensions;
+	createInfo.enabledExtensionCount = requiredExtensionCount;
+	createInfo.ppEnabledExtensionNames = requiredExtensions;
 	createInfo.enabledLayerCount = 0;
 
-	VkResult result = vkCreateInstance(&createInfo, NULL, instance);
+	VkResult result = vkCreateInstance(&createInfo, NULL, &(*app).instance);
 
 	if (result != VK_SUCCESS) 
 	{
 		printf("failed to create instance!");
-		glfwDestroyWindow(window);
+		glfwDestroyWindow((*app).windowStruct.pWindow);
 		glfwTerminate();
 		exit(-1);
 	}
 
-	uint32_t extensionCount = 0;
-	vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, NULL);
-
-	VkExtensionProperties *extensions = malloc(extensionCount * sizeof(VkExtensionProperties));
-
-	vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, extensions);
-
-	printf("available extensions:\n");
-	for (uint32_t i = 0; i < extensionCount; i++) 
+	if (!(*app).quiet)
 	{
-		VkExtensionProperties extension = extensions[i];
-		printf("\t%s\n", extension.extensionName);
+		printf("available extensions:\n");
+		for (uint32_t i = 0; i < extensionCount; i++) 
+		{
+			VkExtensionProperties extension = extensions[i];
+			printf("\t%s\n", extension.extensionName);
+		}
 	}
 
 	free(extensions);
 }
 
-QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface) 
+QueueFamilyIndices findQueueFamilies(const PhysicalDeviceInfo *info) 
 {
-	QueueFamilyIndices indices;
-	
-	uint32_t queueFamilyCount = 0;
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, NULL);
-
-	VkQueueFamilyProperties *queueFamilies = malloc(queueFamilyCount * sizeof(VkQueueFamilyProperties));
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies);
+	QueueFamilyIndices indices = {0};
 
-	for(uint32_t i = 0; i < queueFamilyCount; i++) 
+	// Keep scanning after graphics/present are found: dedicated transfer and
+	// compute families usually sit after the universal one.
+	for(uint32_t i = 0; i < (*info).queueFamilyCount; i++) 
 	{
-		VkQueueFamilyProperties queueFamily = queueFamilies[i];
+		VkQueueFlags flags = (*info).queueFamilies[i].queueFlags;
 
-		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-
-		if(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) 
+		if((flags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily.hasValue) 
 		{
 			indices.graphicsFamily.value = i;
 			indices.graphicsFamily.hasValue = true;
 		}
 
-		if (presentSupport) 
+		if ((*info).queueFamilyPresent[i] && !indices.presentFamily.hasValue) 
 		{
 			indices.presentFamily.value = i;
 			indices.presentFamily.hasValue = true;
 		}
 
-		if(indicesIsComplete(indices)) break;
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && !indices.transferFamily.hasValue)
+		{
+			indices.transferFamily.value = i;
+			indices.transferFamily.hasValue = true;
+		}
+
+		if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !indices.computeFamily.hasValue)
+		{
+			indices.computeFamily.value = i;
+			indices.computeFamily.hasValue = true;
+		}
 	}
 
 	return indices;
 }
 
-bool checkDeviceExtensionSupport(VkPhysicalDevice device) 
+void queryPhysicalDeviceInfo(arena *a, VkPhysicalDevice device, VkSurfaceKHR surface, PhysicalDeviceInfo *info)
 {
-	unsigned int deviceExtensionCount = 0;
-	VkResult res = vkEnumerateDeviceExtensionProperties(device, NULL, &deviceExtensionCount, NULL);
-	if (deviceExtensionCount <= 0 || res != VK_SUCCESS) 
+	(*info).device = device;
+	vkGetPhysicalDeviceProperties(device, &(*info).properties);
+	vkGetPhysicalDeviceFeatures(device, &(*info).features);
+	vkGetPhysicalDeviceMemoryProperties(device, &(*info).memoryProperties);
+
+	(*info).driverVersion = (*info).properties.driverVersion;
+	memset((*info).deviceUUID, 0, VK_UUID_SIZE);
+	if ((*info).properties.apiVersion >= VK_API_VERSION_1_1)
 	{
-		printf("Could not find any Vulkan device extensions (found %d, error %d)\n", deviceExtensionCount, res);
-		return false;
+		VkPhysicalDeviceIDProperties idProperties = {0};
+		idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+		VkPhysicalDeviceProperties2 properties2 = {0};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &idProperties;
+
+		vkGetPhysicalDeviceProperties2(device, &properties2);
+		memcpy((*info).deviceUUID, idProperties.deviceUUID, VK_UUID_SIZE);
+	} else
+	{
+		// 1.0 devices have no UUID, vendor/device ID is the closest stable key
+		memcpy(&(*info).deviceUUID[0], &(*info).properties.vendorID, sizeof(uint32_t));
+		memcpy(&(*info).deviceUUID[4], &(*info).properties.deviceID, sizeof(uint32_t));
 	}
 
-	VkExtensionProperties *deviceExtensionProperties = calloc(deviceExtensionCount, sizeof(VkExtensionProperties));
-	res = vkEnumerateDeviceExtensionProperties(device, NULL, &deviceExtensionCount, deviceExtensionProperties);
-	if (res != VK_SUCCESS) 
+	(*info).queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &(*info).queueFamilyCount, NULL);
+	(*info).queueFamilies = arenaAlloc(a, (*info).queueFamilyCount * sizeof(VkQueueFamilyProperties));
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &(*info).queueFamilyCount, (*info).queueFamilies);
+
+	// Offscreen rendering never presents, the graphics family stands in for present.
+	(*info).queueFamilyPresent = arenaAlloc(a, (*info).queueFamilyCount * sizeof(VkBool32));
+	for (uint32_t i = 0; i < (*info).queueFamilyCount; i++)
+	{
+		(*info).queueFamilyPresent[i] = VK_FALSE;
+		if (surface != VK_NULL_HANDLE) vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &(*info).queueFamilyPresent[i]);
+		else (*info).queueFamilyPresent[i] = ((*info).queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+	}
+	(*info).queueIndices = findQueueFamilies(info);
+
+	(*info).extensionCount = 0;
+	(*info).extensions = NULL;
+	VkResult res = vkEnumerateDeviceExtensionProperties(device, NULL, &(*info).extensionCount, NULL);
+	if (res == VK_SUCCESS && (*info).extensionCount > 0)
+	{
+		(*info).extensions = arenaAlloc(a, (*info).extensionCount * sizeof(VkExtensionProperties));
+		res = vkEnumerateDeviceExtensionProperties(device, NULL, &(*info).extensionCount, (*info).extensions);
+	}
+	if (res != VK_SUCCESS)
 	{
 		printf("vkEnumerateDeviceExtensionProperties() failed (%d)\n", res);
-		return false;
+		(*info).extensionCount = 0;
 	}
+}
+
+bool checkDeviceExtensionSupport(const PhysicalDeviceInfo *info, bool present) 
+{
+	if (!present) return true;
 
-	const char **devExtensions = calloc(deviceExtensionCount, sizeof(void*));
-	for (uint32_t i = 0; i < deviceExtensionCount; i++)
+	for (uint32_t i = 0; i < ARRAY_COUNT(requiredDeviceExtensions); i++)
 	{
-		devExtensions[i] = &deviceExtensionProperties[i].extensionName[0];
+		if (!extensionListContains((*info).extensions, (*info).extensionCount, requiredDeviceExtensions[i])) return false;
 	}
 
 	return true;
 }
 
-SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface) 
+void querySurfaceInfo(VkPhysicalDevice device, VkSurfaceKHR surface, SurfaceInfo *info) 
 {
-	SwapChainSupportDetails details = 
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &(*info).capabilities);
+
+	(*info).formatCount = 0;
+	(*info).formats = NULL;
+	vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &(*info).formatCount, NULL);
+
+	if ((*info).formatCount != 0) 
 	{
-		.presentModes = NULL,
-		.formats = NULL
-	};
+		(*info).formats = malloc((*info).formatCount * sizeof(VkSurfaceFormatKHR));
+		vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &(*info).formatCount, (*info).formats);
+	}
 
-	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
+	(*info).presentModeCount = 0;
+	(*info).presentModes = NULL;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &(*info).presentModeCount, NULL);
 
-	uint32_t formatCount;
-	vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, NULL);
+	if ((*info).presentModeCount != 0) 
+	{
+		(*info).presentModes = malloc((*info).presentModeCount * sizeof(VkPresentModeKHR));
+		vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &(*info).presentModeCount, (*info).presentModes);
+	}
 
-	if (formatCount != 0) 
+	(*info).valid = true;
+	(*info).capabilitiesValid = true;
+}
+
+void freeSurfaceInfo(SurfaceInfo *info)
+{
+	free((*info).formats);
+	free((*info).presentModes);
+	memset(info, 0, sizeof(SurfaceInfo));
+}
+
+bool isDeviceSuitable(const PhysicalDeviceInfo *info, VkSurfaceKHR surface) 
+{
+	bool extensionsSupported = checkDeviceExtensionSupport(info, surface != VK_NULL_HANDLE);
+
+	bool swapChainAdequate = surface == VK_NULL_HANDLE;
+	if (extensionsSupported && !swapChainAdequate) 
 	{
-		details.formats = malloc(formatCount * sizeof(VkSurfaceFormatKHR));
-		vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats);
+		SurfaceInfo surfaceInfo;
+		querySurfaceInfo((*info).device, surface, &surfaceInfo);
+		swapChainAdequate = surfaceInfo.formatCount != 0 && surfaceInfo.presentModeCount != 0;
+
+		freeSurfaceInfo(&surfaceInfo);
 	}
 
-	uint32_t presentModeCount;
-	vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, NULL);
+	return indicesIsComplete((*info).queueIndices) && extensionsSupported && swapChainAdequate;
+}
+
+bool readDeviceCache(uint8_t deviceUUID[VK_UUID_SIZE], uint32_t *driverVersion)
+{
+	FILE *file = fopen(GPU_CACHE_PATH, "r");
+	if (file == NULL) return false;
 
-	if (presentModeCount != 0) 
+	char uuidHex[2 * VK_UUID_SIZE + 1];
+	bool ok = fscanf(file, "%32s %u", uuidHex, driverVersion) == 2 && strlen(uuidHex) == 2 * VK_UUID_SIZE;
+	fclose(file);
+
+	for (uint32_t i = 0; ok && i < VK_UUID_SIZE; i++)
 	{
-		details.presentModes = malloc(presentModeCount * sizeof(VkPresentModeKHR));
-		vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, details.presentModes);
+		unsigned int byte;
+		ok = sscanf(&uuidHex[2 * i], "%2x", &byte) == 1;
+		deviceUUID[i] = (uint8_t)byte;
 	}
 
-	return details;
+	return ok;
+}
+
+void writeDeviceCache(const PhysicalDeviceInfo *info)
+{
+	FILE *file = fopen(GPU_CACHE_PATH, "w");
+	if (file == NULL) return;
+
+	for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+		fprintf(file, "%02x", (*info).deviceUUID[i]);
+	fprintf(file, " %u %s\n", (*info).driverVersion, (*info).properties.deviceName);
+
+	fclose(file);
 }
 
-bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface) 
+// Returns a negative score for devices that cannot run the game at all.
+int64_t rateDevice(const PhysicalDeviceInfo *info, VkSurfaceKHR surface)
 {
-	QueueFamilyIndices indices = findQueueFamilies(device, surface);
+	if (!isDeviceSuitable(info, surface)) return -1;
+
+	int64_t score = 0;
+	switch ((*info).properties.deviceType)
+	{
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   score += 1000000; break;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 500000;  break;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    score += 250000;  break;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU:            score += 0;       break;
+		default:                                     score += 100000;  break;
+	}
+
+	score += (*info).properties.limits.maxImageDimension2D;
 
-	bool extensionsSupported = checkDeviceExtensionSupport(device);
+	VkDeviceSize localHeapSize = 0;
+	for (uint32_t i = 0; i < (*info).memoryProperties.memoryHeapCount; i++)
+	{
+		if ((*info).memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			localHeapSize = mathMax(localHeapSize, (*info).memoryProperties.memoryHeaps[i].size);
+	}
+	score += (int64_t)(localHeapSize / (1024 * 1024));
 
-	bool swapChainAdequate = false;
-	if (extensionsSupported) 
+	bool graphicsCanPresent = false;
+	for (uint32_t i = 0; i < (*info).queueFamilyCount; i++)
 	{
-		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, surface);
-		swapChainAdequate = !(swapChainSupport.formats == NULL) && !(swapChainSupport.presentModes == NULL);
+		if (((*info).queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && (*info).queueFamilyPresent[i]) graphicsCanPresent = true;
+	}
+
+	if (graphicsCanPresent)                       score += 20000;
+	if ((*info).queueIndices.transferFamily.hasValue) score += 10000;
+	if ((*info).queueIndices.computeFamily.hasValue)  score += 10000;
+
+	return score;
+}
 
-		free(swapChainSupport.presentModes);
-		free(swapChainSupport.formats);
+// Case-insensitive substring match, or an exact index when the filter is numeric.
+bool deviceMatchesFilter(const PhysicalDeviceInfo *info, uint32_t index, const char *filter)
+{
+	char *end;
+	unsigned long filterIndex = strtoul(filter, &end, 10);
+	if (*filter != '\0' && *end == '\0') return filterIndex == index;
+
+	const char *name = (*info).properties.deviceName;
+	size_t nameLength = strlen(name);
+	size_t filterLength = strlen(filter);
+	for (size_t start = 0; start + filterLength <= nameLength; start++)
+	{
+		size_t i = 0;
+		while (i < filterLength && tolower((unsigned char)name[start + i]) == tolower((unsigned char)filter[i])) i++;
+		if (i == filterLength) return true;
 	}
 
-	return indicesIsComplete(indices) && extensionsSupported && swapChainAdequate;
+	return false;
 }
 
 void selectGPU(vulkanApp *app)
@@ -254,19 +836,67 @@ void selectGPU(vulkanApp *app)
 	VkPhysicalDevice *devices = malloc(deviceCount * sizeof(VkPhysicalDevice));
 	vkEnumeratePhysicalDevices((*app).instance, &deviceCount, devices);
 
+	(*app).deviceInfoArena.blockSize = 64 * 1024;
+	(*app).deviceInfos = arenaAlloc(&(*app).deviceInfoArena, deviceCount * sizeof(PhysicalDeviceInfo));
+	(*app).deviceInfoCount = deviceCount;
 	for(uint32_t i = 0; i < deviceCount; i++) 
+		queryPhysicalDeviceInfo(&(*app).deviceInfoArena, devices[i], (*app).surface, &(*app).deviceInfos[i]);
+
+	free(devices);
+
+	const PhysicalDeviceInfo *selected = NULL;
+
+	if ((*app).forcedGPU != NULL)
+	{
+		for(uint32_t i = 0; i < deviceCount && selected == NULL; i++) 
+		{
+			if (deviceMatchesFilter(&(*app).deviceInfos[i], i, (*app).forcedGPU) && isDeviceSuitable(&(*app).deviceInfos[i], (*app).surface)) 
+				selected = &(*app).deviceInfos[i];
+		}
+
+		if (selected == NULL)
+			printf("no suitable GPU matches override \"%s\"\n", (*app).forcedGPU);
+	} else
 	{
-		VkPhysicalDevice device = devices[i];
+		uint8_t cachedUUID[VK_UUID_SIZE];
+		uint32_t cachedDriverVersion;
+
+		if (readDeviceCache(cachedUUID, &cachedDriverVersion))
+		{
+			for(uint32_t i = 0; i < deviceCount && selected == NULL; i++) 
+			{
+				const PhysicalDeviceInfo *info = &(*app).deviceInfos[i];
+
+				if ((*info).driverVersion == cachedDriverVersion && memcmp((*info).deviceUUID, cachedUUID, VK_UUID_SIZE) == 0) 
+					selected = info;
+			}
+
+			// The cache may come from a run with a different surface, or none.
+			if (selected != NULL && rateDevice(selected, (*app).surface) < 0)
+			{
+				printf("cached GPU %s cannot be used here, selecting again\n", (*selected).properties.deviceName);
+				selected = NULL;
+			}
+		}
 
-		if (isDeviceSuitable(device, (*app).surface)) 
+		if (selected == NULL)
 		{
-			(*app).physicalDevice = device;
-			printf("Found a suitable GPU\n");
-			break;
+			int64_t bestScore = -1;
+			for(uint32_t i = 0; i < deviceCount; i++) 
+			{
+				int64_t score = rateDevice(&(*app).deviceInfos[i], (*app).surface);
+				if (score > bestScore) 
+				{
+					bestScore = score;
+					selected = &(*app).deviceInfos[i];
+				}
+			}
+
+			if (selected != NULL) writeDeviceCache(selected);
 		}
 	}
 
-	if((*app).physicalDevice == VK_NULL_HANDLE) 
+	if(selected == NULL) 
 	{
 		printf("failed to find a suitable GPU!\n");
 		glfwDestroyWindow((*app).windowStruct.pWindow);
@@ -274,39 +904,133 @@ void selectGPU(vulkanApp *app)
 		exit(-1);
 	}
 
-	free(devices);
+	(*app).deviceInfo = selected;
+	(*app).physicalDevice = (*selected).device;
+	printf("Selected GPU: %s\n", (*selected).properties.deviceName);
 }
 
-void createLogicalDevice(vulkanApp *app)
+void addDeviceExtension(DeviceFeatureSet *enabled, const char *name)
+{
+	if ((*enabled).enabledExtensionCount < MAX_ENABLED_DEVICE_EXTENSIONS)
+		(*enabled).enabledExtensions[(*enabled).enabledExtensionCount++] = name;
+}
+
+// Decides which optional extensions and features get enabled. An optional extension
+// is only turned on when the feature it exists for is supported as well. Feature
+// structs can only be queried on 1.1 devices, a 1.0 device gets none of them.
+void negotiateDeviceFeatures(VkPhysicalDevice device, uint32_t apiVersion, bool present, VkExtensionProperties *available, uint32_t availableCount, DeviceFeatureSet *enabled)
 {
-	QueueFamilyIndices indices = findQueueFamilies((*app).physicalDevice, (*app).surface);
+	for (uint32_t i = 0; present && i < ARRAY_COUNT(requiredDeviceExtensions); i++)
+		addDeviceExtension(enabled, requiredDeviceExtensions[i]);
+
+	// Must be enabled whenever the implementation exposes it (MoltenVK and friends).
+	if (extensionListContains(available, availableCount, "VK_KHR_portability_subset"))
+		addDeviceExtension(enabled, "VK_KHR_portability_subset");
+
+	(*enabled).features2 = apiVersion >= VK_API_VERSION_1_1;
+	if (!(*enabled).features2) return;
 
-	VkDeviceQueueCreateInfo queueCreateInfo = {0};
-	queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-	queueCreateInfo.queueFamilyIndex = indices.graphicsFamily.value;
-	queueCreateInfo.queueCount = 1;
+	bool hasSync2       = extensionListContains(available, availableCount, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+	bool hasTimeline    = extensionListContains(available, availableCount, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+	bool hasIndexing    = extensionListContains(available, availableCount, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+	bool hasPresentId   = present && extensionListContains(available, availableCount, VK_KHR_PRESENT_ID_EXTENSION_NAME);
+	bool hasPresentWait = present && extensionListContains(available, availableCount, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
 
-	float queuePriority = 1.0f;
-	queueCreateInfo.pQueuePriorities = &queuePriority;
+	VkPhysicalDeviceFeatures2 features2 = {0};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
 
+	VkPhysicalDeviceSynchronization2FeaturesKHR sync2Features = {0};
+	sync2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {0};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {0};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {0};
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {0};
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+	void **chainTail = &features2.pNext;
+	if (hasSync2)       { *chainTail = &sync2Features;       chainTail = &sync2Features.pNext; }
+	if (hasTimeline)    { *chainTail = &timelineFeatures;    chainTail = &timelineFeatures.pNext; }
+	if (hasIndexing)    { *chainTail = &indexingFeatures;    chainTail = &indexingFeatures.pNext; }
+	if (hasPresentId)   { *chainTail = &presentIdFeatures;   chainTail = &presentIdFeatures.pNext; }
+	if (hasPresentWait) { *chainTail = &presentWaitFeatures; chainTail = &presentWaitFeatures.pNext; }
+
+	vkGetPhysicalDeviceFeatures2(device, &features2);
+
+	(*enabled).synchronization2 = hasSync2 && sync2Features.synchronization2;
+	if ((*enabled).synchronization2) addDeviceExtension(enabled, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+
+	(*enabled).timelineSemaphore = hasTimeline && timelineFeatures.timelineSemaphore;
+	if ((*enabled).timelineSemaphore) addDeviceExtension(enabled, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+	(*enabled).descriptorIndexing = hasIndexing
+		&& indexingFeatures.runtimeDescriptorArray
+		&& indexingFeatures.descriptorBindingPartiallyBound
+		&& indexingFeatures.shaderSampledImageArrayNonUniformIndexing
+		&& indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+	if ((*enabled).descriptorIndexing)
+	{
+		addDeviceExtension(enabled, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT wanted = {0};
+		wanted.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		wanted.runtimeDescriptorArray = VK_TRUE;
+		wanted.descriptorBindingPartiallyBound = VK_TRUE;
+		wanted.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		wanted.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		wanted.shaderStorageBufferArrayNonUniformIndexing = indexingFeatures.shaderStorageBufferArrayNonUniformIndexing;
+		wanted.descriptorBindingStorageBufferUpdateAfterBind = indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind;
+		wanted.descriptorBindingVariableDescriptorCount = indexingFeatures.descriptorBindingVariableDescriptorCount;
+		wanted.descriptorBindingUpdateUnusedWhilePending = indexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+		(*enabled).descriptorIndexingFeatures = wanted;
+	}
+
+	(*enabled).presentId = hasPresentId && presentIdFeatures.presentId;
+	if ((*enabled).presentId) addDeviceExtension(enabled, VK_KHR_PRESENT_ID_EXTENSION_NAME);
+
+	(*enabled).presentWait = (*enabled).presentId && hasPresentWait && presentWaitFeatures.presentWait;
+	if ((*enabled).presentWait) addDeviceExtension(enabled, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+}
+
+void createLogicalDevice(vulkanApp *app)
+{
 	VkPhysicalDeviceFeatures deviceFeatures = {0};
 
 	VkDeviceCreateInfo createInfo = {0};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-
-	createInfo.pQueueCreateInfos = &queueCreateInfo;
-	createInfo.queueCreateInfoCount = 1;
 	
 	createInfo.pEnabledFeatures = &deviceFeatures;
 	createInfo.enabledLayerCount = 0;
 	
-	QueueFamilyIndices presentIndices = findQueueFamilies((*app).physicalDevice, (*app).surface);
+	const PhysicalDeviceInfo *info = (*app).deviceInfo;
+	QueueFamilyIndices presentIndices = (*info).queueIndices;
+	(*app).graphicsQueueFamily = presentIndices;
+
+	uint32_t wantedQueueFamilies[4] = {presentIndices.graphicsFamily.value, presentIndices.presentFamily.value};
+	uint32_t wantedQueueFamilyCount = 2;
+	if (presentIndices.transferFamily.hasValue) wantedQueueFamilies[wantedQueueFamilyCount++] = presentIndices.transferFamily.value;
+	if (presentIndices.computeFamily.hasValue)  wantedQueueFamilies[wantedQueueFamilyCount++] = presentIndices.computeFamily.value;
+
+	VkDeviceQueueCreateInfo *queueCreateInfos = malloc(4 * sizeof(VkDeviceQueueCreateInfo));
+	uint32_t uniqueQueueFamilies[4];
+	uint32_t uniqueQueueFamilyCount = 0;
+	for (uint32_t i = 0; i < wantedQueueFamilyCount; i++)
+	{
+		bool seen = false;
+		for (uint32_t j = 0; j < uniqueQueueFamilyCount; j++)
+			if (uniqueQueueFamilies[j] == wantedQueueFamilies[i]) seen = true;
 
-	VkDeviceQueueCreateInfo *queueCreateInfos = malloc(2 * sizeof(VkDeviceQueueCreateInfo));
-	uint32_t uniqueQueueFamilies[2] = {presentIndices.graphicsFamily.value, presentIndices.presentFamily.value};
+		if (!seen) uniqueQueueFamilies[uniqueQueueFamilyCount++] = wantedQueueFamilies[i];
+	}
 
 	float queueInfoPriority = 1.0f;
-	for (int i = 0; i < 2; i++)
+	for (uint32_t i = 0; i < uniqueQueueFamilyCount; i++)
 	{
 		uint32_t queueFamily = uniqueQueueFamilies[i];
 
@@ -319,35 +1043,66 @@ void createLogicalDevice(vulkanApp *app)
 		queueCreateInfos[i] = queueCreateInfo;
 	}
 
-	createInfo.queueCreateInfoCount = 2;
+	createInfo.queueCreateInfoCount = uniqueQueueFamilyCount;
 	createInfo.pQueueCreateInfos = queueCreateInfos;
 	
-	unsigned int deviceExtensionCount = 0;
-	VkResult res = vkEnumerateDeviceExtensionProperties((*app).physicalDevice, NULL, &deviceExtensionCount, NULL);
-	if (deviceExtensionCount <= 0 || res != VK_SUCCESS) 
+	bool present = (*app).surface != VK_NULL_HANDLE;
+	for (uint32_t i = 0; present && i < ARRAY_COUNT(requiredDeviceExtensions); i++)
 	{
-		printf("Could not find any Vulkan device extensions (found %d, error %d)\n", deviceExtensionCount, res);
-		return;
+		if (!extensionListContains((*info).extensions, (*info).extensionCount, requiredDeviceExtensions[i]))
+		{
+			printf("required device extension %s is missing!\n", requiredDeviceExtensions[i]);
+			glfwDestroyWindow((*app).windowStruct.pWindow);
+			glfwTerminate();
+			exit(-1);
+		}
 	}
 
-	VkExtensionProperties *deviceExtensionProperties = calloc(deviceExtensionCount, sizeof(VkExtensionProperties));
-	res = vkEnumerateDeviceExtensionProperties((*app).physicalDevice, NULL, &deviceExtensionCount, deviceExtensionProperties);
-	if (res != VK_SUCCESS) 
-	{
-		printf("vkEnumerateDeviceExtensionProperties() failed (%d)\n", res);
-		return;
-	}
+	DeviceFeatureSet *enabled = &(*app).enabledFeatures;
+	memset(enabled, 0, sizeof(DeviceFeatureSet));
+	negotiateDeviceFeatures((*info).device, (*info).properties.apiVersion, present, (*info).extensions, (*info).extensionCount, enabled);
+
+	// Only chain the feature structs we actually turn on; pEnabledFeatures must be
+	// NULL once a VkPhysicalDeviceFeatures2 is in the chain.
+	VkPhysicalDeviceFeatures2 features2 = {0};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features2.features = deviceFeatures;
+
+	VkPhysicalDeviceSynchronization2FeaturesKHR sync2Features = {0};
+	sync2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+	sync2Features.synchronization2 = VK_TRUE;
 
-	const char **deviceExtensions = calloc(deviceExtensionCount, sizeof(void*));
-	for (uint32_t i = 0; i < deviceExtensionCount; i++)
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {0};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = (*enabled).descriptorIndexingFeatures;
+	indexingFeatures.pNext = NULL;
+
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {0};
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	presentIdFeatures.presentId = VK_TRUE;
+
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {0};
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	presentWaitFeatures.presentWait = VK_TRUE;
+
+	void **chainTail = &features2.pNext;
+	if ((*enabled).synchronization2)   { *chainTail = &sync2Features;       chainTail = &sync2Features.pNext; }
+	if ((*enabled).timelineSemaphore)  { *chainTail = &timelineFeatures;    chainTail = &timelineFeatures.pNext; }
+	if ((*enabled).descriptorIndexing) { *chainTail = &indexingFeatures;    chainTail = &indexingFeatures.pNext; }
+	if ((*enabled).presentId)          { *chainTail = &presentIdFeatures;   chainTail = &presentIdFeatures.pNext; }
+	if ((*enabled).presentWait)        { *chainTail = &presentWaitFeatures; chainTail = &presentWaitFeatures.pNext; }
+
+	if ((*enabled).features2)
 	{
-		deviceExtensions[i] = &deviceExtensionProperties[i].extensionName[0];
+		createInfo.pNext = &features2;
+		createInfo.pEnabledFeatures = NULL;
 	}
+	createInfo.enabledExtensionCount = (*enabled).enabledExtensionCount;
+	createInfo.ppEnabledExtensionNames = (*enabled).enabledExtensions;
 
-	createInfo.enabledExtensionCount = deviceExtensionCount;
-	createInfo.ppEnabledExtensionNames = deviceExtensions;
-
-	res = vkCreateDevice((*app).physicalDevice, &createInfo, NULL, &(*app).device);  
+	VkResult res = vkCreateDevice((*app).physicalDevice, &createInfo, NULL, &(*app).device);  
 	if (res != VK_SUCCESS) 
 	{
 		printf("failed to create logical device!\n");
@@ -358,18 +1113,41 @@ void createLogicalDevice(vulkanApp *app)
 	
 	vkGetDeviceQueue((*app).device, presentIndices.presentFamily.value, 0, &(*app).presentQueue);
 
+	(*app).transferFamily = presentIndices.transferFamily.hasValue ? presentIndices.transferFamily.value : presentIndices.graphicsFamily.value;
+	(*app).computeFamily  = presentIndices.computeFamily.hasValue  ? presentIndices.computeFamily.value  : presentIndices.graphicsFamily.value;
+	vkGetDeviceQueue((*app).device, (*app).transferFamily, 0, &(*app).transferQueue);
+	vkGetDeviceQueue((*app).device, (*app).computeFamily, 0, &(*app).computeQueue);
+
+	if (!(*app).quiet)
+	{
+		printf("Enabled device extensions:\n");
+		for (uint32_t i = 0; i < (*enabled).enabledExtensionCount; i++)
+			printf("\t%s\n", (*enabled).enabledExtensions[i]);
+	}
+
 	free(queueCreateInfos);
-	free(deviceExtensions);
 }
 
-VkSurfaceFormatKHR chooseSwapSurfaceFormat(VkSurfaceFormatKHR *availableFormats, VkPhysicalDevice device, VkSurfaceKHR surface) 
+// Builds the snapshot on first use and refreshes only what was invalidated.
+const SurfaceInfo *getSurfaceInfo(vulkanApp *app)
 {
-	uint32_t surfaceFormatCount = 0;
-	vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &surfaceFormatCount, NULL);
+	SurfaceInfo *info = &(*app).surfaceInfo;
+
+	if (!(*info).valid) querySurfaceInfo((*app).physicalDevice, (*app).surface, info);
+	else if (!(*info).capabilitiesValid)
+	{
+		vkGetPhysicalDeviceSurfaceCapabilitiesKHR((*app).physicalDevice, (*app).surface, &(*info).capabilities);
+		(*info).capabilitiesValid = true;
+	}
+
+	return info;
+}
 
-	for(uint32_t i = 0; i < surfaceFormatCount; i++)
+VkSurfaceFormatKHR chooseSwapSurfaceFormat(const SurfaceInfo *surfaceInfo) 
+{
+	for(uint32_t i = 0; i < (*surfaceInfo).formatCount; i++)
 	{
-		VkSurfaceFormatKHR availableFormat = availableFormats[i];
+		VkSurfaceFormatKHR availableFormat = (*surfaceInfo).formats[i];
 
 		if(availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) 
 		{
@@ -377,19 +1155,16 @@ VkSurfaceFormatKHR chooseSwapSurfaceFormat(VkSurfaceFormatKHR *availableFormats,
 		}
 	}
 
-	return availableFormats[0];
+	return (*surfaceInfo).formats[0];
 }
 
-VkPresentModeKHR chooseSwapPresentMode(VkPresentModeKHR *availablePresentModes, VkPhysicalDevice device, VkSurfaceKHR surface) 
+VkPresentModeKHR chooseSwapPresentMode(const SurfaceInfo *surfaceInfo, PresentProfile profile) 
 {
-	uint32_t presentModeCount;
-	vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, NULL);
-
-	for(uint32_t i = 0; i < presentModeCount; i++) 
+	for(uint32_t i = 0; i < (*surfaceInfo).presentModeCount; i++) 
 	{
-		VkPresentModeKHR availablePresentMode = availablePresentModes[i];
+		VkPresentModeKHR availablePresentMode = (*surfaceInfo).presentModes[i];
 
-		if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) 
+		if (availablePresentMode == presentProfiles[profile].preferredMode) 
 		{
 			return availablePresentMode;
 		}
@@ -398,7 +1173,7 @@ VkPresentModeKHR chooseSwapPresentMode(VkPresentModeKHR *availablePresentModes,
 	return VK_PRESENT_MODE_FIFO_KHR;
 }
 
-VkExtent2D chooseSwapExtent(VkSurfaceCapabilitiesKHR *capabilities, GLFWwindow *window) 
+VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR *capabilities, window *pWindowStruct) 
 {
 	uint32_t max = -1;
 
@@ -407,8 +1182,8 @@ VkExtent2D chooseSwapExtent(VkSurfaceCapabilitiesKHR *capabilities, GLFWwindow *
 		return (*capabilities).currentExtent;
 	} else 
 	{
-		int width, height;
-		glfwGetFramebufferSize(window, &width, &height);
+		int width = (*pWindowStruct).width, height = (*pWindowStruct).height;
+		if ((*pWindowStruct).pWindow != NULL) glfwGetFramebufferSize((*pWindowStruct).pWindow, &width, &height);
 		
 		VkExtent2D actualExtent = 
 		{
@@ -416,8 +1191,8 @@ VkExtent2D chooseSwapExtent(VkSurfaceCapabilitiesKHR *capabilities, GLFWwindow *
 			(uint32_t)(height)
 		};
 	
-		actualExtent.width = clamp(actualExtent.width, (*capabilities).minImageExtent.width, (*capabilities).maxImageExtent.width);
-		actualExtent.height = clamp(actualExtent.height, (*capabilities).minImageExtent.height, (*capabilities).maxImageExtent.height);
+		actualExtent.width = mathClamp(actualExtent.width, (*capabilities).minImageExtent.width, (*capabilities).maxImageExtent.width);
+		actualExtent.height = mathClamp(actualExtent.height, (*capabilities).minImageExtent.height, (*capabilities).maxImageExtent.height);
 	
 		return actualExtent;
 	}
@@ -425,20 +1200,20 @@ VkExtent2D chooseSwapExtent(VkSurfaceCapabilitiesKHR *capabilities, GLFWwindow *
 
 void createSwapchain(vulkanApp *app)
 {
-	SwapChainSupportDetails swapChainSupport = querySwapChainSupport((*app).physicalDevice, (*app).surface);
+	const SurfaceInfo *surfaceInfo = getSurfaceInfo(app);
 
-	VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats, (*app).physicalDevice, (*app).surface);
-	VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes, (*app).physicalDevice, (*app).surface);
-	VkExtent2D extent = chooseSwapExtent(&swapChainSupport.capabilities, (*app).windowStruct.pWindow);
+	VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(surfaceInfo);
+	VkPresentModeKHR presentMode = chooseSwapPresentMode(surfaceInfo, (*app).presentProfile);
+	VkExtent2D extent = chooseSwapExtent(&(*surfaceInfo).capabilities, &(*app).windowStruct);
 
 	(*app).swapChainImageFormat = surfaceFormat.format;
 	(*app).swapChainExtent = extent;
 
-	uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+	uint32_t imageCount = (*surfaceInfo).capabilities.minImageCount + presentProfiles[(*app).presentProfile].extraImages;
 
-	if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) 
+	if ((*surfaceInfo).capabilities.maxImageCount > 0 && imageCount > (*surfaceInfo).capabilities.maxImageCount) 
 	{
-		imageCount = swapChainSupport.capabilities.maxImageCount;
+		imageCount = (*surfaceInfo).capabilities.maxImageCount;
 	}
 
 	VkSwapchainCreateInfoKHR createInfo = {0};
@@ -452,7 +1227,7 @@ void createSwapchain(vulkanApp *app)
 	createInfo.imageArrayLayers = 1;
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-	QueueFamilyIndices indices = findQueueFamilies((*app).physicalDevice, (*app).surface);
+	QueueFamilyIndices indices = (*(*app).deviceInfo).queueIndices;
 	uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value, indices.presentFamily.value};
 
 	if (indices.graphicsFamily.value != indices.presentFamily.value) 
@@ -467,11 +1242,11 @@ void createSwapchain(vulkanApp *app)
 		createInfo.pQueueFamilyIndices = NULL; // Optional
 	}
 
-	createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
+	createInfo.preTransform = (*surfaceInfo).capabilities.currentTransform;
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	createInfo.oldSwapchain = (*app).swapChain;
 
 	if (vkCreateSwapchainKHR((*app).device, &createInfo, NULL, &(*app).swapChain) != VK_SUCCESS) 
 	{
@@ -489,21 +1264,17 @@ void createSwapchainImages(vulkanApp *app)
 	
 	(*app).swapChainImages = malloc(imageCount * sizeof(VkImage));
 	vkGetSwapchainImagesKHR((*app).device, (*app).swapChain, &imageCount, (*app).swapChainImages);
+	(*app).swapChainImageCount = imageCount;
 }
 
 void createImageViews(vulkanApp *app) 
 {
-	uint32_t imageCount;
-	vkGetSwapchainImagesKHR((*app).device, (*app).swapChain, &imageCount, NULL);
-
-	uint32_t formatCount;
-	VkSurfaceFormatKHR* colorFormat = malloc(sizeof(VkSurfaceFormatKHR));
-	vkGetPhysicalDeviceSurfaceFormatsKHR((*app).physicalDevice, (*app).surface, &formatCount, colorFormat);
+	uint32_t imageCount = (*app).swapChainImageCount;
 
 	VkImageViewCreateInfo iv_info = {0};
 	iv_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	iv_info.pNext = NULL;
-	iv_info.format = (*colorFormat).format;
+	iv_info.format = (*app).swapChainImageFormat;
 	iv_info.components = (VkComponentMapping){
 		.r = VK_COMPONENT_SWIZZLE_R,
 		.g = VK_COMPONENT_SWIZZLE_G,
@@ -533,64 +1304,2090 @@ void createImageViews(vulkanApp *app)
 	}
 }
 
-void initVulkanApp(vulkanApp *app)
+// Stand-in for the swapchain when there is no surface at all. Images are handed
+// out round-robin by drawFrame() and end each frame in TRANSFER_SRC_OPTIMAL so
+// they can be read back for golden-image comparisons.
+void createOffscreenTargets(vulkanApp *app)
 {
-	createInstance((*app).windowStruct.pWindow, &(*app).instance);
-	
-	VkResult err = glfwCreateWindowSurface((*app).instance, (*app).windowStruct.pWindow, NULL, &(*app).surface);
-	if(err)
-	{
-		printf("Failed to create Window Surface\n");
-		glfwDestroyWindow((*app).windowStruct.pWindow);
-		glfwTerminate();
-		exit(-1);
-	}
+	(*app).swapChainImageFormat = OFFSCREEN_IMAGE_FORMAT;
+	(*app).swapChainExtent = (VkExtent2D){(*app).windowStruct.width, (*app).windowStruct.height};
+	(*app).swapChainImageCount = MAX_FRAMES_IN_FLIGHT;
 
-	selectGPU(app);
-	createLogicalDevice(app);
+	(*app).swapChainImages = calloc((*app).swapChainImageCount, sizeof(VkImage));
+	(*app).offscreenMemory = calloc((*app).swapChainImageCount, sizeof(gpuAllocation));
+
+	for (uint32_t i = 0; i < (*app).swapChainImageCount; i++)
+	{
+		VkImageCreateInfo imageInfo = {0};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = (*app).swapChainImageFormat;
+		imageInfo.extent = (VkExtent3D){(*app).swapChainExtent.width, (*app).swapChainExtent.height, 1};
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		// Render targets get their own memory rather than a slice of a pool block.
+		gpuAllocationCreateInfo allocInfo = {0};
+		allocInfo.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		allocInfo.flags = GPU_ALLOCATION_DEDICATED;
+
+		VkResult res = gpuCreateImage((*app).allocator, &imageInfo, &allocInfo, &(*app).swapChainImages[i], &(*app).offscreenMemory[i]);
+
+		if (res != VK_SUCCESS) 
+		{
+			printf("failed to create offscreen image %d (%d)\n", i, res);
+			exit(res);
+		}
+	}
+}
+
+void createRenderPass(vulkanApp *app)
+{
+	VkAttachmentDescription colorAttachment = {0};
+	colorAttachment.format = (*app).swapChainImageFormat;
+	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	// The frame graph transitions the image around the pass, including the wait
+	// on the acquire semaphore and the final move to presentLayout.
+	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference colorAttachmentRef = {0};
+	colorAttachmentRef.attachment = 0;
+	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {0};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colorAttachmentRef;
+
+	VkRenderPassCreateInfo renderPassInfo = {0};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = 1;
+	renderPassInfo.pAttachments = &colorAttachment;
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+
+	VkResult res = vkCreateRenderPass((*app).device, &renderPassInfo, NULL, &(*app).renderPass);
+	if (res != VK_SUCCESS) 
+	{
+		printf("vkCreateRenderPass() failed (%d)\n", res);
+		glfwDestroyWindow((*app).windowStruct.pWindow);
+		glfwTerminate();
+		exit(res);
+	}
+}
+
+void createFramebuffers(vulkanApp *app)
+{
+	(*app).swapChainFramebuffers = malloc((*app).swapChainImageCount * sizeof(VkFramebuffer));
+
+	for (uint32_t i = 0; i < (*app).swapChainImageCount; i++) 
+	{
+		VkFramebufferCreateInfo framebufferInfo = {0};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = (*app).renderPass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = &(*app).swapChainImageViews[i];
+		framebufferInfo.width = (*app).swapChainExtent.width;
+		framebufferInfo.height = (*app).swapChainExtent.height;
+		framebufferInfo.layers = 1;
+
+		VkResult res = vkCreateFramebuffer((*app).device, &framebufferInfo, NULL, &(*app).swapChainFramebuffers[i]);
+		if (res != VK_SUCCESS) 
+		{
+			printf("vkCreateFramebuffer() %d failed (%d)\n", i, res);
+			glfwDestroyWindow((*app).windowStruct.pWindow);
+			glfwTerminate();
+			exit(res);
+		}
+	}
+
+	(*app).imagesInFlight = calloc((*app).swapChainImageCount, sizeof(VkFence));
+}
+
+// Presents wait on these. The present engine may hold one until the image is
+// acquired again, so they go with the image rather than the frame slot.
+void createRenderFinishedSemaphores(vulkanApp *app)
+{
+	VkSemaphoreCreateInfo semaphoreInfo = {0};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	(*app).renderFinishedSemaphores = malloc((*app).swapChainImageCount * sizeof(VkSemaphore));
+	for (uint32_t i = 0; i < (*app).swapChainImageCount; i++)
+	{
+		VkResult res = vkCreateSemaphore((*app).device, &semaphoreInfo, NULL, &(*app).renderFinishedSemaphores[i]);
+		if (res != VK_SUCCESS)
+		{
+			printf("vkCreateSemaphore() for image %d failed (%d)\n", i, res);
+			glfwDestroyWindow((*app).windowStruct.pWindow);
+			glfwTerminate();
+			exit(res);
+		}
+	}
+}
+
+void createFrameData(vulkanApp *app)
+{
+	if ((*app).framesInFlight == 0) (*app).framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+	(*app).framesInFlight = mathClamp((*app).framesInFlight, 2, MAX_FRAMES_IN_FLIGHT);
+	(*app).currentFrame = 0;
+
+	VkCommandPoolCreateInfo poolInfo = {0};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = (*app).graphicsQueueFamily.graphicsFamily.value;
+
+	VkSemaphoreCreateInfo semaphoreInfo = {0};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	// Fences start signalled so the first wait on each slot returns immediately.
+	VkFenceCreateInfo fenceInfo = {0};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	for (uint32_t i = 0; i < (*app).framesInFlight; i++) 
+	{
+		frameData *frame = &(*app).frames[i];
+
+		VkResult res = vkCreateCommandPool((*app).device, &poolInfo, NULL, &(*frame).commandPool);
+		if (res == VK_SUCCESS)
+		{
+			VkCommandBufferAllocateInfo allocInfo = {0};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = (*frame).commandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
+
+			res = vkAllocateCommandBuffers((*app).device, &allocInfo, &(*frame).commandBuffer);
+		}
+		if (res == VK_SUCCESS) res = vkCreateSemaphore((*app).device, &semaphoreInfo, NULL, &(*frame).imageAvailableSemaphore);
+		if (res == VK_SUCCESS) res = vkCreateFence((*app).device, &fenceInfo, NULL, &(*frame).inFlightFence);
+
+		if (res != VK_SUCCESS) 
+		{
+			printf("failed to create frame %d resources (%d)\n", i, res);
+			glfwDestroyWindow((*app).windowStruct.pWindow);
+			glfwTerminate();
+			exit(res);
+		}
+	}
+}
+
+// One secondary command buffer per worker thread and frame slot pool.
+void createCommandRecorder(vulkanApp *app)
+{
+	commandRecorderCreateInfo recorderInfo = {0};
+	recorderInfo.device = (*app).device;
+	recorderInfo.queueFamily = (*app).graphicsQueueFamily.graphicsFamily.value;
+	recorderInfo.threadCount = jobWorkerCount((*app).jobs);
+	recorderInfo.framesInFlight = (*app).framesInFlight;
+
+	(*app).recorder = commandRecorderCreate(&recorderInfo);
+	if ((*app).recorder == NULL)
+	{
+		glfwDestroyWindow((*app).windowStruct.pWindow);
+		glfwTerminate();
+		exit(-1);
+	}
+}
+
+typedef struct sceneChunks
+{
+	vulkanApp *app;
+	VkCommandBufferInheritanceInfo inheritance;
+	VkCommandBuffer *commandBuffers;
+	uint32_t drawCount, chunkCount;
+} sceneChunks;
+
+// Job: records scene chunks [begin, end) into secondaries from this thread's pool.
+void recordSceneChunks(void *data, uint32_t begin, uint32_t end)
+{
+	sceneChunks *chunks = data;
+	vulkanApp *app = (*chunks).app;
+	uint32_t thread = jobWorkerIndex((*app).jobs);
+	if (thread == JOB_NOT_A_WORKER)
+	{
+		// No pool of its own; the chunks are left out of the frame.
+		printf("scene chunks %u..%u recorded outside the job workers\n", begin, end);
+		for (uint32_t i = begin; i < end; i++) (*chunks).commandBuffers[i] = VK_NULL_HANDLE;
+		return;
+	}
+
+	for (uint32_t i = begin; i < end; i++)
+	{
+		uint32_t first = (uint32_t)((uint64_t)i * (*chunks).drawCount / (*chunks).chunkCount);
+		uint32_t last = (uint32_t)((uint64_t)(i + 1) * (*chunks).drawCount / (*chunks).chunkCount);
+
+		VkCommandBuffer commandBuffer = commandRecorderBegin((*app).recorder, (*app).currentFrame, thread, &(*chunks).inheritance);
+		(*chunks).commandBuffers[i] = commandBuffer;
+		if (commandBuffer == VK_NULL_HANDLE) continue;
+
+		spriteBatchRecordDraws((*app).sprites, commandBuffer, (*app).currentFrame, (*app).swapChainExtent, 0.0f, 0.0f, first, last - first);
+		vkEndCommandBuffer(commandBuffer);
+	}
+}
+
+// Sorts the frame's sprites into draws sized for a few chunks per worker and
+// reserves their instances in the upload ring.
+uploadTicket prepareSprites(vulkanApp *app)
+{
+	uint32_t chunkCount = jobWorkerCount((*app).jobs) * SCENE_CHUNKS_PER_WORKER;
+	uint32_t drawSize = mathMax(SCENE_MIN_DRAW_SIZE, (*app).spriteCount / chunkCount + 1);
+
+	uploadTicket ticket;
+	(*app).spriteDrawCount = spriteBatchPrepare((*app).sprites, (*app).currentFrame, drawSize, &ticket);
+	return ticket;
+}
+
+// Draws are split into a few chunks per worker, recorded in parallel and executed
+// in order. With one worker everything is recorded inline.
+void recordSceneParallel(vulkanApp *app, VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo *renderPassInfo)
+{
+	uint32_t workers = jobWorkerCount((*app).jobs);
+	uint32_t drawCount = (*app).spriteDrawCount;
+	uint32_t chunkCount = mathMin(workers * SCENE_CHUNKS_PER_WORKER, drawCount);
+
+	if (workers == 1 || chunkCount <= 1)
+	{
+		vkCmdBeginRenderPass(commandBuffer, renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		spriteBatchRecordDraws((*app).sprites, commandBuffer, (*app).currentFrame, (*app).swapChainExtent, 0.0f, 0.0f, 0, drawCount);
+		vkCmdEndRenderPass(commandBuffer);
+		return;
+	}
+
+	VkCommandBuffer commandBuffers[MAX_RECORD_CHUNKS];
+	sceneChunks chunks = {app, {0}, commandBuffers, drawCount, mathMin(chunkCount, MAX_RECORD_CHUNKS)};
+	chunks.inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	chunks.inheritance.renderPass = (*renderPassInfo).renderPass;
+	chunks.inheritance.subpass = 0;
+	chunks.inheritance.framebuffer = (*renderPassInfo).framebuffer;
+
+	jobCounter recorded = {0};
+	jobParallelFor((*app).jobs, recordSceneChunks, &chunks, chunks.chunkCount, 1, &recorded);
+	jobWait((*app).jobs, &recorded);
+
+	// Chunks that failed to begin have been reported; their draws are skipped.
+	uint32_t recordedCount = 0;
+	for (uint32_t i = 0; i < chunks.chunkCount; i++)
+		if (commandBuffers[i] != VK_NULL_HANDLE) commandBuffers[recordedCount++] = commandBuffers[i];
+
+	vkCmdBeginRenderPass(commandBuffer, renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+	if (recordedCount > 0) vkCmdExecuteCommands(commandBuffer, recordedCount, commandBuffers);
+	vkCmdEndRenderPass(commandBuffer);
+}
+
+void scenePass(VkCommandBuffer commandBuffer, renderGraph *graph, void *userData)
+{
+	(void)graph;
+	vulkanApp *app = userData;
+
+	VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+
+	VkRenderPassBeginInfo renderPassInfo = {0};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = (*app).renderPass;
+	renderPassInfo.framebuffer = (*app).swapChainFramebuffers[(*app).frames[(*app).currentFrame].imageIndex];
+	renderPassInfo.renderArea.offset = (VkOffset2D){0, 0};
+	renderPassInfo.renderArea.extent = (*app).swapChainExtent;
+	renderPassInfo.clearValueCount = 1;
+	renderPassInfo.pClearValues = &clearColor;
+
+	if ((*app).sprites != NULL)
+	{
+		recordSceneParallel(app, commandBuffer, &renderPassInfo);
+		return;
+	}
+
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdEndRenderPass(commandBuffer);
+}
+
+void buildFrameGraph(vulkanApp *app)
+{
+	renderGraphCreateInfo graphInfo = {0};
+	graphInfo.device = (*app).device;
+	graphInfo.allocator = (*app).allocator;
+	graphInfo.synchronization2 = (*app).enabledFeatures.synchronization2;
+	graphInfo.framesInFlight = (*app).framesInFlight;
+	(*app).frameGraph = renderGraphCreate(&graphInfo);
+
+	// Frames start right after the acquire wait, which happens at COLOR_ATTACHMENT_OUTPUT.
+	rgImportState initial = {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, 0};
+	rgImportState final = {(*app).presentLayout, VK_PIPELINE_STAGE_2_NONE_KHR, 0};
+	(*app).backbuffer = rgImportImage((*app).frameGraph, "backbuffer", VK_IMAGE_ASPECT_COLOR_BIT, initial, final);
+
+	rgPass scene = rgAddPass((*app).frameGraph, "scene", scenePass, app);
+	rgPassUse((*app).frameGraph, scene, (*app).backbuffer, RG_ACCESS_COLOR_ATTACHMENT_WRITE);
+
+	VkResult res = rgCompile((*app).frameGraph, (*app).swapChainExtent);
+	if (res != VK_SUCCESS)
+	{
+		glfwDestroyWindow((*app).windowStruct.pWindow);
+		glfwTerminate();
+		exit(res);
+	}
+
+	if (!(*app).quiet)
+	{
+		rgStats stats = rgGetStats((*app).frameGraph);
+		printf("Frame graph: %u passes (%u culled), %u barrier batches, %u transients in %u slots\n",
+			stats.passCount, stats.culledPassCount, stats.barrierBatchCount, stats.transientCount, stats.aliasSlotCount);
+	}
+}
+
+void recordCommandBuffer(vulkanApp *app, VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	VkCommandBufferBeginInfo beginInfo = {0};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	// Uploads that finished streaming in become usable from here on, and so do this
+	// frame's atlas cells and sprite instances once drawFrame flushes the ring.
+	uploadTicket ticket = (*app).atlas != NULL ? atlasStageUploads((*app).atlas) : 0;
+	if ((*app).sprites != NULL) ticket = mathMax(ticket, prepareSprites(app));
+	(*app).frames[(*app).currentFrame].uploadWait = uploadRingAcquire((*app).uploads, commandBuffer, ticket);
+
+	(*app).frames[(*app).currentFrame].imageIndex = imageIndex;
+	rgSetImportedImage((*app).frameGraph, (*app).backbuffer, (*app).swapChainImages[imageIndex], (*app).swapChainImageViews[imageIndex]);
+	rgExecute((*app).frameGraph, commandBuffer);
+
+	vkEndCommandBuffer(commandBuffer);
+}
+
+// Queues a handle for destruction once every frame submitted so far has finished.
+// Fences signal in submission order, so waiting on the latest submission's fence
+// covers all earlier frames that may still reference the object.
+void deferDestroy(vulkanApp *app, VkObjectType type, uint64_t handle)
+{
+	frameData *frame = &(*app).frames[(*app).lastSubmittedFrame];
+
+	if ((*frame).deletionCount == (*frame).deletionCapacity)
+	{
+		(*frame).deletionCapacity = mathMax(16, 2 * (*frame).deletionCapacity);
+		(*frame).deletionQueue = realloc((*frame).deletionQueue, (*frame).deletionCapacity * sizeof(deferredDestroy));
+	}
+
+	(*frame).deletionQueue[(*frame).deletionCount++] = (deferredDestroy){type, handle};
+}
+
+void flushDeferredDestroys(vulkanApp *app, frameData *frame)
+{
+	for (uint32_t i = 0; i < (*frame).deletionCount; i++)
+	{
+		deferredDestroy object = (*frame).deletionQueue[i];
+
+		switch (object.type)
+		{
+			case VK_OBJECT_TYPE_SWAPCHAIN_KHR: vkDestroySwapchainKHR((*app).device, (VkSwapchainKHR)object.handle, NULL); break;
+			case VK_OBJECT_TYPE_IMAGE_VIEW:    vkDestroyImageView((*app).device, (VkImageView)object.handle, NULL); break;
+			case VK_OBJECT_TYPE_FRAMEBUFFER:   vkDestroyFramebuffer((*app).device, (VkFramebuffer)object.handle, NULL); break;
+			case VK_OBJECT_TYPE_RENDER_PASS:   vkDestroyRenderPass((*app).device, (VkRenderPass)object.handle, NULL); break;
+			case VK_OBJECT_TYPE_IMAGE:         vkDestroyImage((*app).device, (VkImage)object.handle, NULL); break;
+			case VK_OBJECT_TYPE_BUFFER:        vkDestroyBuffer((*app).device, (VkBuffer)object.handle, NULL); break;
+			case VK_OBJECT_TYPE_DEVICE_MEMORY: vkFreeMemory((*app).device, (VkDeviceMemory)object.handle, NULL); break;
+			case VK_OBJECT_TYPE_SEMAPHORE:     vkDestroySemaphore((*app).device, (VkSemaphore)object.handle, NULL); break;
+			case VK_OBJECT_TYPE_PIPELINE:      vkDestroyPipeline((*app).device, (VkPipeline)object.handle, NULL); break;
+			default: printf("deferDestroy: unhandled object type %d\n", object.type); break;
+		}
+	}
+
+	(*frame).deletionCount = 0;
+}
+
+// Builds a new swapchain from the old one and retires the old swapchain, its
+// views, framebuffers and present semaphores through the deletion queue. Frames
+// already in flight keep presenting from the retired swapchain. Returns false
+// while minimized.
+bool recreateSwapchain(vulkanApp *app)
+{
+	int width = (*app).windowStruct.width, height = (*app).windowStruct.height;
+	if ((*app).windowStruct.pWindow != NULL) glfwGetFramebufferSize((*app).windowStruct.pWindow, &width, &height);
+	if (width == 0 || height == 0) return false;
+
+	for (uint32_t i = 0; i < (*app).swapChainImageCount; i++)
+	{
+		deferDestroy(app, VK_OBJECT_TYPE_FRAMEBUFFER, (uint64_t)(*app).swapChainFramebuffers[i]);
+		deferDestroy(app, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)(*app).swapChainImageViews[i]);
+		deferDestroy(app, VK_OBJECT_TYPE_SEMAPHORE, (uint64_t)(*app).renderFinishedSemaphores[i]);
+	}
+	free((*app).renderFinishedSemaphores);
+	free((*app).swapChainFramebuffers);
+	free((*app).swapChainImageViews);
+	free((*app).swapChainImages);
+	free((*app).imagesInFlight);
+
+	VkSwapchainKHR oldSwapChain = (*app).swapChain;
+	VkFormat oldFormat = (*app).swapChainImageFormat;
+
+	(*app).surfaceInfo.capabilitiesValid = false;
 
-	vkGetDeviceQueue((*app).device, (*app).graphicsQueueFamily.graphicsFamily.value, 0, &(*app).graphicsQueue);
 	createSwapchain(app);
+	deferDestroy(app, VK_OBJECT_TYPE_SWAPCHAIN_KHR, (uint64_t)oldSwapChain);
+
+	createSwapchainImages(app);
+	createImageViews(app);
+
+	if ((*app).swapChainImageFormat != oldFormat)
+	{
+		deferDestroy(app, VK_OBJECT_TYPE_RENDER_PASS, (uint64_t)(*app).renderPass);
+		createRenderPass(app);
+
+		VkPipeline retired[2];
+		if ((*app).sprites != NULL && spriteBatchRebuildPipelines((*app).sprites, (*app).renderPass, retired) == VK_SUCCESS)
+		{
+			deferDestroy(app, VK_OBJECT_TYPE_PIPELINE, (uint64_t)retired[0]);
+			deferDestroy(app, VK_OBJECT_TYPE_PIPELINE, (uint64_t)retired[1]);
+		}
+	}
+	createFramebuffers(app);
+	createRenderFinishedSemaphores(app);
+	rgCompile((*app).frameGraph, (*app).swapChainExtent);
+
+	(*app).windowStruct.framebufferResized = false;
+	(*app).swapChainStale = false;
+	(*app).presentId = 0;
+	return true;
+}
+
+// Blocks until at most maxQueuedPresents presents are still pending, so input is
+// sampled as close to scan-out as possible. Bounded by a timeout so a present that
+// never completes (e.g. minimized window) cannot hang the loop.
+void waitForPresentPacing(vulkanApp *app)
+{
+	uint32_t maxQueued = presentProfiles[(*app).presentProfile].maxQueuedPresents;
+	if ((*app).waitForPresent == NULL || maxQueued == 0 || (*app).presentId <= maxQueued) return;
+
+	uint64_t target = (*app).presentId - maxQueued;
+	(*app).waitForPresent((*app).device, (*app).swapChain, target, 100 * 1000 * 1000);
+}
+
+void drawFrame(vulkanApp *app)
+{
+	frameData *frame = &(*app).frames[(*app).currentFrame];
+
+	// Only blocks when the GPU is more than framesInFlight frames behind.
+	vkWaitForFences((*app).device, 1, &(*frame).inFlightFence, VK_TRUE, UINT64_MAX);
+	flushDeferredDestroys(app, frame);
+	descriptorAllocatorBeginFrame((*app).descriptors, (*app).currentFrame);
+	commandRecorderBeginFrame((*app).recorder, (*app).currentFrame);
+	bindlessBeginFrame((*app).textures, (*app).currentFrame);
+
+	bool offscreen = (*app).surface == VK_NULL_HANDLE;
+
+	uint32_t imageIndex;
+	VkResult res = VK_SUCCESS;
+	if (offscreen)
+	{
+		imageIndex = (*app).offscreenNextImage;
+		(*app).offscreenNextImage = ((*app).offscreenNextImage + 1) % (*app).swapChainImageCount;
+	} else
+	{
+		res = vkAcquireNextImageKHR((*app).device, (*app).swapChain, UINT64_MAX, (*frame).imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+	}
+
+	if (res == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		(*app).swapChainStale = true;
+		return;
+	}
+	if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) 
+	{
+		printf("vkAcquireNextImageKHR() failed (%d)\n", res);
+		return;
+	}
+
+	// The swapchain may hand back an image that an older frame slot is still rendering to.
+	if ((*app).imagesInFlight[imageIndex] != VK_NULL_HANDLE && (*app).imagesInFlight[imageIndex] != (*frame).inFlightFence) 
+	{
+		vkWaitForFences((*app).device, 1, &(*app).imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+	}
+	(*app).imagesInFlight[imageIndex] = (*frame).inFlightFence;
+
+	vkResetFences((*app).device, 1, &(*frame).inFlightFence);
+
+	vkResetCommandPool((*app).device, (*frame).commandPool, 0);
+	double recordStart = nowSeconds();
+	recordCommandBuffer(app, (*frame).commandBuffer, imageIndex);
+	(*app).recordSeconds += nowSeconds() - recordStart;
+
+	// The frame acquired the batch its sprite instances were staged in, so it has
+	// to be submitted first.
+	uploadRingFlush((*app).uploads);
+
+	VkSemaphore waitSemaphores[2];
+	VkPipelineStageFlags waitStages[2];
+	uint64_t waitValues[2] = {0};
+	uint32_t waitCount = 0;
+
+	if (!offscreen)
+	{
+		waitSemaphores[waitCount] = (*frame).imageAvailableSemaphore;
+		waitStages[waitCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	}
+
+	// Orders the acquire barriers after the transfer queue's release. Batches up to
+	// the one flushed above may still be running; only the stages reading them wait.
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {0};
+	if ((*frame).uploadWait.semaphore != VK_NULL_HANDLE)
+	{
+		waitSemaphores[waitCount] = (*frame).uploadWait.semaphore;
+		waitStages[waitCount] = (*frame).uploadWait.stageMask;
+		waitValues[waitCount++] = (*frame).uploadWait.value;
+
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timelineInfo.waitSemaphoreValueCount = waitCount;
+		timelineInfo.pWaitSemaphoreValues = waitValues;
+	}
+
+	VkSubmitInfo submitInfo = {0};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = timelineInfo.sType ? &timelineInfo : NULL;
+	submitInfo.waitSemaphoreCount = waitCount;
+	submitInfo.pWaitSemaphores = waitSemaphores;
+	submitInfo.pWaitDstStageMask = waitStages;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &(*frame).commandBuffer;
+	submitInfo.signalSemaphoreCount = offscreen ? 0 : 1;
+	submitInfo.pSignalSemaphores = &(*app).renderFinishedSemaphores[imageIndex];
+
+	res = vkQueueSubmit((*app).graphicsQueue, 1, &submitInfo, (*frame).inFlightFence);
+	if (res != VK_SUCCESS) 
+	{
+		printf("vkQueueSubmit() failed (%d)\n", res);
+		glfwDestroyWindow((*app).windowStruct.pWindow);
+		glfwTerminate();
+		exit(res);
+	}
+	(*app).lastSubmittedFrame = (*app).currentFrame;
+	(*app).lastImageIndex = imageIndex;
+
+	if (offscreen)
+	{
+		(*app).currentFrame = ((*app).currentFrame + 1) % (*app).framesInFlight;
+		return;
+	}
+
+	VkPresentInfoKHR presentInfo = {0};
+	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	presentInfo.waitSemaphoreCount = 1;
+	presentInfo.pWaitSemaphores = &(*app).renderFinishedSemaphores[imageIndex];
+	presentInfo.swapchainCount = 1;
+	presentInfo.pSwapchains = &(*app).swapChain;
+	presentInfo.pImageIndices = &imageIndex;
+
+	VkPresentIdKHR presentIdInfo = {0};
+	if ((*app).enabledFeatures.presentId)
+	{
+		(*app).presentId++;
+		presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+		presentIdInfo.swapchainCount = 1;
+		presentIdInfo.pPresentIds = &(*app).presentId;
+		presentInfo.pNext = &presentIdInfo;
+	}
+
+	res = vkQueuePresentKHR((*app).presentQueue, &presentInfo);
+	if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR || (*app).windowStruct.framebufferResized)
+		(*app).swapChainStale = true;
+
+	(*app).currentFrame = ((*app).currentFrame + 1) % (*app).framesInFlight;
+}
+
+void createQueueCommandPools(vulkanApp *app)
+{
+	VkCommandPoolCreateInfo poolInfo = {0};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	uint32_t families[3] = {(*app).graphicsQueueFamily.graphicsFamily.value, (*app).transferFamily, (*app).computeFamily};
+	VkCommandPool *pools[3] = {&(*app).graphicsCommandPool, &(*app).transferCommandPool, &(*app).computeCommandPool};
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		poolInfo.queueFamilyIndex = families[i];
+
+		VkResult res = vkCreateCommandPool((*app).device, &poolInfo, NULL, pools[i]);
+		if (res != VK_SUCCESS) 
+		{
+			printf("vkCreateCommandPool() for queue family %d failed (%d)\n", families[i], res);
+			glfwDestroyWindow((*app).windowStruct.pWindow);
+			glfwTerminate();
+			exit(res);
+		}
+	}
+}
+
+uint32_t queueFamilyOf(vulkanApp *app, QueueType type)
+{
+	switch (type)
+	{
+		case QUEUE_TYPE_TRANSFER: return (*app).transferFamily;
+		case QUEUE_TYPE_COMPUTE:  return (*app).computeFamily;
+		default:                  return (*app).graphicsQueueFamily.graphicsFamily.value;
+	}
+}
+
+VkQueue queueOf(vulkanApp *app, QueueType type)
+{
+	switch (type)
+	{
+		case QUEUE_TYPE_TRANSFER: return (*app).transferQueue;
+		case QUEUE_TYPE_COMPUTE:  return (*app).computeQueue;
+		default:                  return (*app).graphicsQueue;
+	}
+}
+
+VkCommandPool commandPoolOf(vulkanApp *app, QueueType type)
+{
+	switch (type)
+	{
+		case QUEUE_TYPE_TRANSFER: return (*app).transferCommandPool;
+		case QUEUE_TYPE_COMPUTE:  return (*app).computeCommandPool;
+		default:                  return (*app).graphicsCommandPool;
+	}
+}
+
+// One-shot command buffer on the given queue's pool. Pools are not thread safe,
+// so these are meant to be driven from the thread that owns the app. Uploads that
+// cross queue families go through the upload ring, which records the ownership
+// release/acquire pair itself.
+VkCommandBuffer beginQueueCommands(vulkanApp *app, QueueType type)
+{
+	VkCommandBufferAllocateInfo allocInfo = {0};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = commandPoolOf(app, type);
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	if (vkAllocateCommandBuffers((*app).device, &allocInfo, &commandBuffer) != VK_SUCCESS) return VK_NULL_HANDLE;
+
+	VkCommandBufferBeginInfo beginInfo = {0};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	return commandBuffer;
+}
+
+// Ends and submits without waiting. Completion is reported through signalSemaphore
+// (for the consuming queue) and/or fence (for the CPU, before freeQueueCommands).
+VkResult submitQueueCommands(vulkanApp *app, QueueType type, VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage, VkSemaphore signalSemaphore, VkFence fence)
+{
+	vkEndCommandBuffer(commandBuffer);
+
+	VkSubmitInfo submitInfo = {0};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	if (waitSemaphore != VK_NULL_HANDLE)
+	{
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &waitSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStage;
+	}
+
+	if (signalSemaphore != VK_NULL_HANDLE)
+	{
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &signalSemaphore;
+	}
+
+	return vkQueueSubmit(queueOf(app, type), 1, &submitInfo, fence);
+}
+
+void freeQueueCommands(vulkanApp *app, QueueType type, VkCommandBuffer commandBuffer)
+{
+	vkFreeCommandBuffers((*app).device, commandPoolOf(app, type), 1, &commandBuffer);
+}
+
+void createUploadRing(vulkanApp *app)
+{
+	// Timeline semaphores let the ring run on the transfer queue; without them it
+	// falls back to the graphics queue so completion can be tracked with fences.
+	bool timeline = (*app).enabledFeatures.timelineSemaphore;
+
+	uploadRingCreateInfo ringInfo = {0};
+	ringInfo.device = (*app).device;
+	ringInfo.allocator = (*app).allocator;
+	ringInfo.queue = timeline ? (*app).transferQueue : (*app).graphicsQueue;
+	ringInfo.queueFamily = timeline ? (*app).transferFamily : (*app).graphicsQueueFamily.graphicsFamily.value;
+	ringInfo.dstQueueFamily = (*app).graphicsQueueFamily.graphicsFamily.value;
+	ringInfo.size = UPLOAD_RING_SIZE;
+	ringInfo.copyOffsetAlignment = (*(*app).deviceInfo).properties.limits.optimalBufferCopyOffsetAlignment;
+	ringInfo.timelineSemaphore = timeline;
+
+	(*app).uploads = uploadRingCreate(&ringInfo);
+	if ((*app).uploads == NULL)
+	{
+		glfwDestroyWindow((*app).windowStruct.pWindow);
+		glfwTerminate();
+		exit(-1);
+	}
+}
+
+// Soft-edged discs in assorted sizes stand in for the game's sprite art; they all
+// land in the atlas so the benchmark still draws every layer with one material.
+uint32_t spriteImageSize(uint32_t image)
+{
+	return 8 + (image * 37) % 120;
+}
+
+// Job: fills in images [begin, end), the pixel buffers are already allocated.
+void decodeSpriteImages(void *data, uint32_t begin, uint32_t end)
+{
+	uint8_t **images = data;
+
+	for (uint32_t i = begin; i < end; i++)
+	{
+		uint32_t size = spriteImageSize(i);
+		uint8_t *pixels = images[i];
+
+		float radius = 0.5f * (float)size;
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				float dx = ((float)x + 0.5f - radius) / radius, dy = ((float)y + 0.5f - radius) / radius;
+				float alpha = mathClamp(4.0f * (1.0f - (dx * dx + dy * dy)), 0.0f, 1.0f);
+
+				uint8_t *texel = pixels + ((size_t)y * size + x) * 4;
+				texel[0] = texel[1] = texel[2] = (uint8_t)(255.0f - 96.0f * dy * dy);
+				texel[3] = (uint8_t)(255.0f * alpha);
+			}
+		}
+	}
+}
+
+void createSpriteImages(vulkanApp *app)
+{
+	atlasImage images[SPRITE_BENCH_IMAGES];
+	uint8_t *pixels[SPRITE_BENCH_IMAGES];
+	(*app).spriteRegions = malloc(SPRITE_BENCH_IMAGES * sizeof(atlasRegion));
+
+	for (uint32_t i = 0; i < SPRITE_BENCH_IMAGES; i++)
+	{
+		uint32_t size = spriteImageSize(i);
+		pixels[i] = malloc((size_t)size * size * 4);
+		images[i] = (atlasImage){pixels[i], size, size, 0};
+	}
+
+	// Decoding runs on the workers; packing and staging stay serial.
+	jobCounter decoded = {0};
+	jobParallelFor((*app).jobs, decodeSpriteImages, pixels, SPRITE_BENCH_IMAGES, 1, &decoded);
+	jobWait((*app).jobs, &decoded);
+
+	uint32_t placed = atlasPack((*app).atlas, images, SPRITE_BENCH_IMAGES, (*app).spriteRegions);
+	for (uint32_t i = 0; i < SPRITE_BENCH_IMAGES; i++) free(pixels[i]);
+
+	(*app).atlasTexture = bindlessAddTexture((*app).textures, atlasImageView((*app).atlas), atlasSampler((*app).atlas), VK_IMAGE_LAYOUT_GENERAL);
+	(*app).atlasMaterial = spriteBatchAddMaterial((*app).sprites, (*app).atlasTexture);
+
+	if (!(*app).quiet)
+	{
+		atlasStats stats = atlasGetStats((*app).atlas);
+		printf("Atlas: %u/%u images on %u pages (%.1f%% of the pages used)\n", placed, SPRITE_BENCH_IMAGES, stats.pageCount,
+			100.0 * (double)stats.usedTexels / ((double)stats.pageCount * ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE));
+	}
+}
+
+// Per-frame sets are reset in bulk with their frame slot; layouts are shared by everything.
+void createDescriptorAllocator(vulkanApp *app)
+{
+	descriptorAllocatorCreateInfo allocatorInfo = {0};
+	allocatorInfo.device = (*app).device;
+	allocatorInfo.framesInFlight = (*app).framesInFlight;
+	allocatorInfo.setsPerPool = DESCRIPTOR_SETS_PER_POOL;
+
+	(*app).descriptors = descriptorAllocatorCreate(&allocatorInfo);
+	(*app).layouts = descriptorLayoutCacheCreate((*app).device);
+}
+
+// Bindless when the device negotiated descriptor indexing, classic sets otherwise.
+void createTextureTable(vulkanApp *app)
+{
+	const VkPhysicalDeviceDescriptorIndexingFeaturesEXT *indexing = &(*app).enabledFeatures.descriptorIndexingFeatures;
+
+	bindlessTableCreateInfo tableInfo = {0};
+	tableInfo.device = (*app).device;
+	tableInfo.layouts = (*app).layouts;
+	tableInfo.descriptorIndexing = (*app).enabledFeatures.descriptorIndexing;
+	tableInfo.storageBuffers = (*indexing).shaderStorageBufferArrayNonUniformIndexing && (*indexing).descriptorBindingStorageBufferUpdateAfterBind;
+	tableInfo.maxTextures = MAX_BINDLESS_TEXTURES;
+	tableInfo.maxBuffers = MAX_BINDLESS_BUFFERS;
+	tableInfo.framesInFlight = (*app).framesInFlight;
+
+	(*app).textures = bindlessCreate(&tableInfo);
+	if ((*app).textures == NULL)
+	{
+		glfwDestroyWindow((*app).windowStruct.pWindow);
+		glfwTerminate();
+		exit(-1);
+	}
+
+	if (!(*app).quiet) printf("Textures: %s descriptors\n", bindlessIsBindless((*app).textures) ? "bindless" : "classic");
+}
+
+void integrateColumns(vec2 *restrict position, vec2 *restrict velocity, uint32_t count, float step, float width, float height)
+{
+	// Branch free so the loop vectorizes.
+	for (uint32_t i = 0; i < count; i++)
+	{
+		position[i].x += velocity[i].x * step;
+		position[i].y += velocity[i].y * step;
+		velocity[i].x = position[i].x < 0.0f || position[i].x > width ? -velocity[i].x : velocity[i].x;
+		velocity[i].y = position[i].y < 0.0f || position[i].y > height ? -velocity[i].y : velocity[i].y;
+	}
+}
+
+// Sprite systems. History and extraction use the full sprite mask, so their views
+// line up with spriteQuery and spriteViewOffsets maps them into the snapshot.
+
+void recordSpriteHistory(ecsWorld *world, const ecsView *views, uint32_t begin, uint32_t end, void *userData)
+{
+	(void)world;
+	vulkanApp *app = userData;
+
+	for (uint32_t v = begin; v < end; v++)
+	{
+		const vec2 *position = ecsViewColumn(&views[v], (*app).components.position);
+		const spriteSpin *spin = ecsViewColumn(&views[v], (*app).components.spin);
+		spriteState *states = (*app).spriteSnapshot + (*app).spriteViewOffsets[v];
+
+		for (uint32_t i = 0; i < views[v].count; i++)
+		{
+			states[i].prevX = position[i].x;
+			states[i].prevY = position[i].y;
+			states[i].prevRotation = spin[i].rotation;
+		}
+	}
+}
+
+void moveSprites(ecsWorld *world, const ecsView *views, uint32_t begin, uint32_t end, void *userData)
+{
+	(void)world;
+	vulkanApp *app = userData;
+
+	for (uint32_t v = begin; v < end; v++)
+	{
+		vec2 *position = ecsViewColumn(&views[v], (*app).components.position);
+		vec2 *velocity = ecsViewColumn(&views[v], (*app).components.velocity);
+		integrateColumns(position, velocity, views[v].count, (*app).spriteStep, (*app).worldWidth, (*app).worldHeight);
+	}
+}
+
+void spinSprites(ecsWorld *world, const ecsView *views, uint32_t begin, uint32_t end, void *userData)
+{
+	(void)world;
+	vulkanApp *app = userData;
+
+	for (uint32_t v = begin; v < end; v++)
+	{
+		spriteSpin *spin = ecsViewColumn(&views[v], (*app).components.spin);
+		for (uint32_t i = 0; i < views[v].count; i++) spin[i].rotation += spin[i].spin * (*app).spriteStep;
+	}
+}
+
+void extractSprites(ecsWorld *world, const ecsView *views, uint32_t begin, uint32_t end, void *userData)
+{
+	(void)world;
+	vulkanApp *app = userData;
+
+	for (uint32_t v = begin; v < end; v++)
+	{
+		const vec2 *position = ecsViewColumn(&views[v], (*app).components.position);
+		const spriteSpin *spin = ecsViewColumn(&views[v], (*app).components.spin);
+		const spriteLook *look = ecsViewColumn(&views[v], (*app).components.look);
+		spriteState *states = (*app).spriteSnapshot + (*app).spriteViewOffsets[v];
+
+		for (uint32_t i = 0; i < views[v].count; i++)
+		{
+			states[i].x = position[i].x;
+			states[i].y = position[i].y;
+			states[i].rotation = spin[i].rotation;
+			states[i].look = look[i];
+		}
+	}
+}
+
+// Order only matters between conflicting systems: movement and spin both wait
+// for history, then overlap; extraction waits for both.
+void createSpriteSystems(vulkanApp *app)
+{
+	const spriteComponents *components = &(*app).components;
+	ecsMask position = ECS_MASK((*components).position);
+	ecsMask velocity = ECS_MASK((*components).velocity);
+	ecsMask spin = ECS_MASK((*components).spin);
+	ecsMask look = ECS_MASK((*components).look);
+	ecsMask sprite = position | velocity | spin | look;
+
+	(*app).spriteSystems = ecsSchedulerCreate((*app).world, (*app).jobs);
+
+	ecsSystemDecl history = {"history", position | spin, 0, sprite, 0, SPRITE_BENCH_CHUNK_GRAIN, recordSpriteHistory, app};
+	ecsSystemDecl movement = {"movement", 0, position | velocity, 0, 0, SPRITE_BENCH_CHUNK_GRAIN, moveSprites, app};
+	ecsSystemDecl rotation = {"spin", 0, spin, 0, 0, SPRITE_BENCH_CHUNK_GRAIN, spinSprites, app};
+	ecsSystemDecl extraction = {"extract", position | spin | look, 0, sprite, 0, SPRITE_BENCH_CHUNK_GRAIN, extractSprites, app};
+	ecsSchedulerAdd((*app).spriteSystems, &history);
+	ecsSchedulerAdd((*app).spriteSystems, &movement);
+	ecsSchedulerAdd((*app).spriteSystems, &rotation);
+	ecsSchedulerAdd((*app).spriteSystems, &extraction);
+}
+
+// Simulation thread: one fixed tick, the systems spread over the workers.
+void tickSprites(void *userData, void *snapshot, uint64_t tickIndex, double step)
+{
+	(void)tickIndex;
+	vulkanApp *app = userData;
+
+	const ecsView *views;
+	uint32_t viewCount = ecsQueryViews((*app).world, (*app).spriteQuery, &views);
+
+	// Sprites never change archetype, so the chunk list only grows at startup.
+	(*app).spriteViewOffsets = realloc((*app).spriteViewOffsets, (viewCount + 1) * sizeof(uint32_t));
+	(*app).spriteViewOffsets[0] = 0;
+	for (uint32_t v = 0; v < viewCount; v++) (*app).spriteViewOffsets[v + 1] = (*app).spriteViewOffsets[v] + views[v].count;
+
+	(*app).spriteSnapshot = snapshot;
+	(*app).spriteStep = (float)step;
+	ecsSchedulerRun((*app).spriteSystems);
+}
+
+// The world size is fixed when the simulation starts; resizing only changes the view.
+void startSimulation(vulkanApp *app)
+{
+	(*app).worldWidth = (float)(*app).swapChainExtent.width;
+	(*app).worldHeight = (float)(*app).swapChainExtent.height;
+
+	simulationCreateInfo simulationInfo = {0};
+	simulationInfo.tickRate = SIM_TICK_RATE;
+	simulationInfo.snapshotSize = (*app).spriteCount * sizeof(spriteState);
+	simulationInfo.tick = tickSprites;
+	simulationInfo.userData = app;
+	simulationInfo.lockstep = (*app).dumpFramePath != NULL;
+
+	(*app).simulation = simulationCreate(&simulationInfo);
+	if ((*app).simulation == NULL)
+	{
+		glfwDestroyWindow((*app).windowStruct.pWindow);
+		glfwTerminate();
+		exit(-1);
+	}
+}
+
+// Missing shaders only disable sprite rendering, the frame loop still runs.
+void createSpriteBatch(vulkanApp *app)
+{
+	spriteBatchCreateInfo batchInfo = {0};
+	batchInfo.device = (*app).device;
+	batchInfo.allocator = (*app).allocator;
+	batchInfo.renderPass = (*app).renderPass;
+	batchInfo.textures = (*app).textures;
+	batchInfo.uploads = (*app).uploads;
+	batchInfo.framesInFlight = (*app).framesInFlight;
+	batchInfo.maxSprites = mathMax((*app).spriteCount, SPRITE_BATCH_CAPACITY);
+	batchInfo.shaderDir = SPRITE_SHADER_DIR;
+
+	(*app).sprites = spriteBatchCreate(&batchInfo);
+	if ((*app).sprites == NULL || (*app).spriteCount == 0) return;
+
+	textureAtlasCreateInfo atlasInfo = {0};
+	atlasInfo.pageSize = ATLAS_PAGE_SIZE;
+	atlasInfo.maxPages = ATLAS_MAX_PAGES;
+	atlasInfo.device = (*app).device;
+	atlasInfo.allocator = (*app).allocator;
+	atlasInfo.uploads = (*app).uploads;
+	(*app).atlas = atlasCreate(&atlasInfo);
+	if ((*app).atlas != NULL) createSpriteImages(app);
+
+	(*app).world = ecsWorldCreate();
+	spriteComponents *components = &(*app).components;
+	(*components).position = ecsRegisterComponent((*app).world, "position", sizeof(vec2));
+	(*components).velocity = ecsRegisterComponent((*app).world, "velocity", sizeof(vec2));
+	(*components).spin = ecsRegisterComponent((*app).world, "spin", sizeof(spriteSpin));
+	(*components).look = ecsRegisterComponent((*app).world, "look", sizeof(spriteLook));
+
+	ecsMask spriteMask = ECS_MASK((*components).position) | ECS_MASK((*components).velocity) | ECS_MASK((*components).spin) | ECS_MASK((*components).look);
+	(*app).spriteQuery = ecsQueryCreate((*app).world, spriteMask, 0);
+
+	// Fixed seed so --dump-frame output stays comparable between runs.
+	srand(1);
+	for (uint32_t i = 0; i < (*app).spriteCount; i++)
+	{
+		ecsEntity entity = ecsCreate((*app).world, spriteMask);
+		vec2 *position = ecsGet((*app).world, entity, (*components).position);
+		vec2 *velocity = ecsGet((*app).world, entity, (*components).velocity);
+		spriteSpin *spin = ecsGet((*app).world, entity, (*components).spin);
+		spriteLook *look = ecsGet((*app).world, entity, (*components).look);
+
+		(*position).x = (float)(rand() % (*app).swapChainExtent.width);
+		(*position).y = (float)(rand() % (*app).swapChainExtent.height);
+		(*velocity).x = (float)(rand() % 401 - 200);
+		(*velocity).y = (float)(rand() % 401 - 200);
+		(*look).size = (float)(4 + rand() % 12);
+		(*spin).spin = (float)(rand() % 629 - 314) / 100.0f;
+		(*look).color = (uint32_t)rand() | 0xFF000000u;
+		(*look).layer = (uint16_t)(i % 4);
+		(*look).region = (uint16_t)(rand() % SPRITE_BENCH_IMAGES);
+	}
+
+	createSpriteSystems(app);
+	startSimulation(app);
+}
+
+// Builds the frame from the newest snapshot; never waits for the simulation.
+void updateSprites(vulkanApp *app)
+{
+	if ((*app).sprites == NULL) return;
+	spriteBatchBegin((*app).sprites);
+	if ((*app).simulation == NULL) return;
+
+	// Frame dumps step the simulation once per frame so the output is reproducible.
+	if ((*app).dumpFramePath != NULL) simulationAdvance((*app).simulation);
+
+	const simSnapshot *snapshot = simulationAcquire((*app).simulation);
+	if (snapshot == NULL) return;
+
+	const spriteState *states = (*snapshot).data;
+	float alpha = simulationAlpha((*app).simulation, snapshot, nowSeconds());
+
+	for (uint32_t i = 0; i < (*app).spriteCount; i++)
+	{
+		const spriteState *state = &states[i];
+		const spriteLook *look = &(*state).look;
+		float x = (*state).prevX + ((*state).x - (*state).prevX) * alpha;
+		float y = (*state).prevY + ((*state).y - (*state).prevY) * alpha;
+		float rotation = (*state).prevRotation + ((*state).rotation - (*state).prevRotation) * alpha;
+
+		spriteMaterial material = (*app).atlas != NULL ? (*app).atlasMaterial : SPRITE_MATERIAL_FLAT;
+		spriteInstance *sprite = spriteBatchAdd((*app).sprites, material, (*look).layer);
+		if (sprite == NULL) break;
+
+		*sprite = (spriteInstance){x, y, (*look).size, (*look).size, 0.0f, 0.0f, 1.0f, 1.0f, (*look).color, rotation, 0, 0};
+		if ((*app).atlas != NULL)
+		{
+			const atlasRegion *region = &(*app).spriteRegions[(*look).region];
+			(*sprite).u0 = (*region).u0;
+			(*sprite).v0 = (*region).v0;
+			(*sprite).u1 = (*region).u1;
+			(*sprite).v1 = (*region).v1;
+			(*sprite).page = (*region).page;
+		}
+	}
+}
+
+// Reads back the last offscreen frame as a binary PPM for golden-image tests.
+// Shutdown-only, so the waits here are fine.
+void dumpLastFrame(vulkanApp *app, const char *path)
+{
+	if ((*app).surface != VK_NULL_HANDLE)
+	{
+		printf("frame dumps need offscreen rendering\n");
+		return;
+	}
+
+	vkDeviceWaitIdle((*app).device);
+
+	uint32_t width = (*app).swapChainExtent.width, height = (*app).swapChainExtent.height;
+	VkDeviceSize size = (VkDeviceSize)width * height * 4;
+
+	VkBufferCreateInfo bufferInfo = {0};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	gpuAllocationCreateInfo allocInfo = {0};
+	allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	allocInfo.preferredFlags = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	allocInfo.flags = GPU_ALLOCATION_MAPPED;
+
+	VkBuffer buffer;
+	gpuAllocation memory;
+	if (gpuCreateBuffer((*app).allocator, &bufferInfo, &allocInfo, &buffer, &memory) != VK_SUCCESS) return;
+
+	VkCommandBuffer commandBuffer = beginQueueCommands(app, QUEUE_TYPE_GRAPHICS);
+
+	VkImageMemoryBarrier imageBarrier = {0};
+	imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.image = (*app).swapChainImages[(*app).lastImageIndex];
+	imageBarrier.subresourceRange = (VkImageSubresourceRange){VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &imageBarrier);
+
+	VkBufferImageCopy region = {0};
+	region.imageSubresource = (VkImageSubresourceLayers){VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+	region.imageExtent = (VkExtent3D){width, height, 1};
+	vkCmdCopyImageToBuffer(commandBuffer, imageBarrier.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+
+	VkBufferMemoryBarrier bufferBarrier = {0};
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = buffer;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &bufferBarrier, 0, NULL);
+
+	submitQueueCommands(app, QUEUE_TYPE_GRAPHICS, commandBuffer, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, VK_NULL_HANDLE);
+	vkQueueWaitIdle((*app).graphicsQueue);
+	freeQueueCommands(app, QUEUE_TYPE_GRAPHICS, commandBuffer);
+
+	uint8_t *pixels = memory.mapped;
+
+	FILE *file = fopen(path, "wb");
+	if (file != NULL)
+	{
+		fprintf(file, "P6\n%u %u\n255\n", width, height);
+		for (VkDeviceSize i = 0; i < (VkDeviceSize)width * height; i++)
+			fwrite(&pixels[4 * i], 1, 3, file);
+		fclose(file);
+		printf("Wrote frame %u to %s\n", (*app).lastImageIndex, path);
+	}
+
+	gpuDestroyBuffer((*app).allocator, buffer, &memory);
+}
+
+typedef struct defragBenchBuffer
+{
+	VkBuffer buffer;
+	gpuAllocation memory;
+	VkDeviceSize size;
+	uint32_t value;
+} defragBenchBuffer;
+
+VkBufferCreateInfo defragBenchBufferInfo(VkDeviceSize size)
+{
+	VkBufferCreateInfo bufferInfo = {0};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	return bufferInfo;
+}
+
+// Fragments a custom TLSF pool the way level streaming does (many buffers, most
+// of them freed again), compacts it with the defragmenter and checks that every
+// surviving buffer still holds its contents.
+void runDefragBenchmark(vulkanApp *app)
+{
+	VkDevice device = (*app).device;
+	gpuAllocator *allocator = (*app).allocator;
+
+	VkBuffer probe;
+	VkBufferCreateInfo probeInfo = defragBenchBufferInfo(DEFRAG_BENCH_PAGE);
+	if (vkCreateBuffer(device, &probeInfo, NULL, &probe) != VK_SUCCESS) return;
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device, probe, &requirements);
+	vkDestroyBuffer(device, probe, NULL);
+
+	gpuPoolCreateInfo poolInfo = {0};
+	poolInfo.memoryTypeIndex = gpuFindMemoryType(allocator, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+	poolInfo.strategy = GPU_ALLOC_STRATEGY_TLSF;
+	poolInfo.blockSize = DEFRAG_BENCH_BLOCK_SIZE;
+	if (poolInfo.memoryTypeIndex == UINT32_MAX) poolInfo.memoryTypeIndex = gpuFindMemoryType(allocator, requirements.memoryTypeBits, 0, 0);
+
+	gpuPool *pool = gpuPoolCreate(allocator, &poolInfo);
+	if (pool == NULL) return;
+
+	uint32_t heap = (*(*app).deviceInfo).memoryProperties.memoryTypes[poolInfo.memoryTypeIndex].heapIndex;
+	gpuHeapStats baseline[VK_MAX_MEMORY_HEAPS], before[VK_MAX_MEMORY_HEAPS], after[VK_MAX_MEMORY_HEAPS];
+	gpuGetHeapStats(allocator, baseline);
+
+	defragBenchBuffer *buffers = calloc(DEFRAG_BENCH_BUFFERS, sizeof(defragBenchBuffer));
+	gpuDefragMove *moves = malloc(DEFRAG_BENCH_BUFFERS * sizeof(gpuDefragMove));
+	VkBuffer *moved = malloc(DEFRAG_BENCH_BUFFERS * sizeof(VkBuffer));
+
+	gpuAllocationCreateInfo allocInfo = {0};
+	allocInfo.pool = pool;
+
+	srand(1);
+	VkCommandBuffer commandBuffer = beginQueueCommands(app, QUEUE_TYPE_GRAPHICS);
+	for (uint32_t i = 0; i < DEFRAG_BENCH_BUFFERS; i++)
+	{
+		defragBenchBuffer *b = &buffers[i];
+		(*b).size = DEFRAG_BENCH_PAGE * (VkDeviceSize)(1 + rand() % 8);
+		(*b).value = 0x9E3779B9u * (i + 1);
+		allocInfo.userData = b;
+
+		VkBufferCreateInfo bufferInfo = defragBenchBufferInfo((*b).size);
+		if (gpuCreateBuffer(allocator, &bufferInfo, &allocInfo, &(*b).buffer, &(*b).memory) != VK_SUCCESS) break;
+
+		vkCmdFillBuffer(commandBuffer, (*b).buffer, 0, VK_WHOLE_SIZE, (*b).value);
+	}
+	submitQueueCommands(app, QUEUE_TYPE_GRAPHICS, commandBuffer, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, VK_NULL_HANDLE);
+	vkQueueWaitIdle((*app).graphicsQueue);
+	freeQueueCommands(app, QUEUE_TYPE_GRAPHICS, commandBuffer);
+
+	// Three out of four buffers go away, scattered over every block.
+	uint32_t liveCount = 0;
+	for (uint32_t i = 0; i < DEFRAG_BENCH_BUFFERS; i++)
+	{
+		if (buffers[i].buffer == VK_NULL_HANDLE) continue;
+		if (rand() % 4 == 0) { liveCount++; continue; }
+
+		gpuDestroyBuffer(allocator, buffers[i].buffer, &buffers[i].memory);
+		buffers[i].buffer = VK_NULL_HANDLE;
+	}
+	gpuGetHeapStats(allocator, before);
+
+	uint32_t passes = 0, moveTotal = 0;
+	double planTime = 0.0, start = nowSeconds();
+	for (;;)
+	{
+		double planStart = nowSeconds();
+		uint32_t moveCount = gpuDefragmentPlan(allocator, pool, moves, DEFRAG_BENCH_BUFFERS);
+		planTime += nowSeconds() - planStart;
+		if (moveCount == 0) break;
+
+		// Buffers cannot be rebound, so every move copies into a new buffer bound to dst.
+		commandBuffer = beginQueueCommands(app, QUEUE_TYPE_GRAPHICS);
+		for (uint32_t m = 0; m < moveCount; m++)
+		{
+			defragBenchBuffer *b = moves[m].userData;
+			VkBufferCreateInfo bufferInfo = defragBenchBufferInfo((*b).size);
+			vkCreateBuffer(device, &bufferInfo, NULL, &moved[m]);
+			vkBindBufferMemory(device, moved[m], moves[m].dst.memory, moves[m].dst.offset);
+
+			VkBufferCopy region = {0, 0, (*b).size};
+			vkCmdCopyBuffer(commandBuffer, (*b).buffer, moved[m], 1, &region);
+		}
+		submitQueueCommands(app, QUEUE_TYPE_GRAPHICS, commandBuffer, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, VK_NULL_HANDLE);
+		vkQueueWaitIdle((*app).graphicsQueue);
+		freeQueueCommands(app, QUEUE_TYPE_GRAPHICS, commandBuffer);
+
+		for (uint32_t m = 0; m < moveCount; m++)
+		{
+			defragBenchBuffer *b = moves[m].userData;
+			vkDestroyBuffer(device, (*b).buffer, NULL);
+			(*b).buffer = moved[m];
+			(*b).memory = moves[m].dst;
+		}
+		gpuDefragmentCommit(allocator, moves, moveCount);
+
+		passes++;
+		moveTotal += moveCount;
+	}
+	double elapsed = nowSeconds() - start;
+	gpuGetHeapStats(allocator, after);
+
+	// Read every survivor back and compare it with its fill value.
+	VkDeviceSize readbackSize = 0;
+	for (uint32_t i = 0; i < DEFRAG_BENCH_BUFFERS; i++)
+		if (buffers[i].buffer != VK_NULL_HANDLE) readbackSize += buffers[i].size;
+
+	VkBufferCreateInfo readbackInfo = {0};
+	readbackInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	readbackInfo.size = mathMax(readbackSize, (VkDeviceSize)DEFRAG_BENCH_PAGE);
+	readbackInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	readbackInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	gpuAllocationCreateInfo readbackAlloc = {0};
+	readbackAlloc.requiredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	readbackAlloc.preferredFlags = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	readbackAlloc.flags = GPU_ALLOCATION_MAPPED;
+
+	VkBuffer readback;
+	gpuAllocation readbackMemory;
+	uint32_t corrupt = 0;
+	if (gpuCreateBuffer(allocator, &readbackInfo, &readbackAlloc, &readback, &readbackMemory) == VK_SUCCESS)
+	{
+		commandBuffer = beginQueueCommands(app, QUEUE_TYPE_GRAPHICS);
+		VkDeviceSize offset = 0;
+		for (uint32_t i = 0; i < DEFRAG_BENCH_BUFFERS; i++)
+		{
+			if (buffers[i].buffer == VK_NULL_HANDLE) continue;
+			VkBufferCopy region = {0, offset, buffers[i].size};
+			vkCmdCopyBuffer(commandBuffer, buffers[i].buffer, readback, 1, &region);
+			offset += buffers[i].size;
+		}
+
+		VkBufferMemoryBarrier barrier = {0};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = readback;
+		barrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &barrier, 0, NULL);
+
+		submitQueueCommands(app, QUEUE_TYPE_GRAPHICS, commandBuffer, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, VK_NULL_HANDLE);
+		vkQueueWaitIdle((*app).graphicsQueue);
+		freeQueueCommands(app, QUEUE_TYPE_GRAPHICS, commandBuffer);
+
+		const uint32_t *words = readbackMemory.mapped;
+		for (uint32_t i = 0; i < DEFRAG_BENCH_BUFFERS; i++)
+		{
+			if (buffers[i].buffer == VK_NULL_HANDLE) continue;
+			bool intact = true;
+			for (VkDeviceSize w = 0; w < buffers[i].size / 4; w++) intact &= words[w] == buffers[i].value;
+			corrupt += !intact;
+			words += buffers[i].size / 4;
+		}
+
+		gpuDestroyBuffer(allocator, readback, &readbackMemory);
+	}
+
+	printf("Defrag benchmark: %u of %u buffers live in %u KiB blocks\n", liveCount, DEFRAG_BENCH_BUFFERS, (uint32_t)(DEFRAG_BENCH_BLOCK_SIZE / 1024));
+	printf("  before: %u blocks, %.1f MiB allocated\n", before[heap].blockCount - baseline[heap].blockCount, (before[heap].allocatedBytes - baseline[heap].allocatedBytes) / 1048576.0);
+	printf("  after:  %u blocks, %.1f MiB allocated\n", after[heap].blockCount - baseline[heap].blockCount, (after[heap].allocatedBytes - baseline[heap].allocatedBytes) / 1048576.0);
+	printf("  %u moves in %u passes, %.3f ms (%.3f ms planning); %u buffers corrupted\n", moveTotal, passes, 1000.0 * elapsed, 1000.0 * planTime, corrupt);
+
+	for (uint32_t i = 0; i < DEFRAG_BENCH_BUFFERS; i++)
+		if (buffers[i].buffer != VK_NULL_HANDLE) gpuDestroyBuffer(allocator, buffers[i].buffer, &buffers[i].memory);
+	gpuPoolDestroy(allocator, pool);
+
+	free(moved);
+	free(moves);
+	free(buffers);
+}
+
+void createHeadlessSurface(vulkanApp *app)
+{
+	PFN_vkCreateHeadlessSurfaceEXT createHeadlessSurfaceEXT = (PFN_vkCreateHeadlessSurfaceEXT)vkGetInstanceProcAddr((*app).instance, "vkCreateHeadlessSurfaceEXT");
+
+	VkHeadlessSurfaceCreateInfoEXT surfaceInfo = {0};
+	surfaceInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+
+	if (createHeadlessSurfaceEXT == NULL || createHeadlessSurfaceEXT((*app).instance, &surfaceInfo, NULL, &(*app).surface) != VK_SUCCESS)
+	{
+		printf("Headless surface unavailable, rendering offscreen\n");
+		(*app).surface = VK_NULL_HANDLE;
+		(*app).offscreen = true;
+	}
+}
+
+void initVulkanApp(vulkanApp *app)
+{
+	startupTrace *trace = &(*app).trace;
+
+	uint32_t phase = traceBegin(trace, "instance");
+	createInstance(app);
+	traceEnd(trace, phase);
+
+	phase = traceBegin(trace, "surface");
+	if (!(*app).headless)
+	{
+		VkResult err = glfwCreateWindowSurface((*app).instance, (*app).windowStruct.pWindow, NULL, &(*app).surface);
+		if(err)
+		{
+			printf("Failed to create Window Surface\n");
+			glfwDestroyWindow((*app).windowStruct.pWindow);
+			glfwTerminate();
+			exit(-1);
+		}
+	} else if (!(*app).offscreen)
+	{
+		createHeadlessSurface(app);
+	}
+	traceEnd(trace, phase);
+
+	phase = traceBegin(trace, "selectGPU");
+	selectGPU(app);
+	traceEnd(trace, phase);
+
+	phase = traceBegin(trace, "createLogicalDevice");
+	createLogicalDevice(app);
+	traceEnd(trace, phase);
+
+	vkGetDeviceQueue((*app).device, (*app).graphicsQueueFamily.graphicsFamily.value, 0, &(*app).graphicsQueue);
+
+	gpuAllocatorCreateInfo allocatorInfo = {0};
+	allocatorInfo.physicalDevice = (*app).physicalDevice;
+	allocatorInfo.device = (*app).device;
+	allocatorInfo.memoryProperties = (*(*app).deviceInfo).memoryProperties;
+	allocatorInfo.bufferImageGranularity = (*(*app).deviceInfo).properties.limits.bufferImageGranularity;
+	allocatorInfo.maxMemoryAllocationCount = (*(*app).deviceInfo).properties.limits.maxMemoryAllocationCount;
+	allocatorInfo.useMemoryRequirements2 = (*(*app).deviceInfo).properties.apiVersion >= VK_API_VERSION_1_1;
+	(*app).allocator = gpuAllocatorCreate(&allocatorInfo);
+
+	if ((*app).enabledFeatures.presentWait)
+		(*app).waitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr((*app).device, "vkWaitForPresentKHR");
+
+	phase = traceBegin(trace, "swapchain");
+	if ((*app).surface != VK_NULL_HANDLE)
+	{
+		(*app).presentLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		createSwapchain(app);
+		createSwapchainImages(app);
+	} else
+	{
+		(*app).presentLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		createOffscreenTargets(app);
+	}
+	traceEnd(trace, phase);
+
+	phase = traceBegin(trace, "imageViews");
+	createImageViews(app);
+	traceEnd(trace, phase);
+
+	phase = traceBegin(trace, "frameResources");
+	createRenderPass(app);
+	createFramebuffers(app);
+	createRenderFinishedSemaphores(app);
+	createFrameData(app);
+	createCommandRecorder(app);
+	createQueueCommandPools(app);
+	createUploadRing(app);
+	createDescriptorAllocator(app);
+	createTextureTable(app);
+	createSpriteBatch(app);
+	buildFrameGraph(app);
+	traceEnd(trace, phase);
 }
 
-void renderLoop(vulkanApp app)
+void renderLoop(vulkanApp *app)
 {
-	glfwPollEvents();
+	waitForPresentPacing(app);
+	if (!(*app).headless) glfwPollEvents();
+
+	if ((*app).swapChainStale && !recreateSwapchain(app))
+	{
+		// Minimized, there is nothing to present to until the window comes back.
+		glfwWaitEvents();
+		return;
+	}
+
+	updateSprites(app);
+	drawFrame(app);
+
+	if ((*app).sprites != NULL)
+	{
+		spriteBatchStats stats = spriteBatchGetStats((*app).sprites);
+		(*app).spriteDrawTotal += stats.drawCount;
+		(*app).spriteInstanceTotal += stats.instanceCount;
+	}
 }
 
 void freeVulkanApp(vulkanApp *app)
 {
-	uint32_t imageCount;
-	vkGetSwapchainImagesKHR((*app).device, (*app).swapChain, &imageCount, NULL);
+	// Shutdown is the one place a full drain is fine; the frame loop itself never waits idle.
+	vkDeviceWaitIdle((*app).device);
+	simulationDestroy((*app).simulation);
+	ecsSchedulerDestroy((*app).spriteSystems);
+	ecsWorldDestroy((*app).world);
+	jobSystemDestroy((*app).jobs);
+
+	for (uint32_t i = 0; i < (*app).framesInFlight; i++)
+	{
+		frameData *frame = &(*app).frames[i];
+
+		vkDestroyFence((*app).device, (*frame).inFlightFence, NULL);
+		vkDestroySemaphore((*app).device, (*frame).imageAvailableSemaphore, NULL);
+		vkDestroyCommandPool((*app).device, (*frame).commandPool, NULL);
+
+		flushDeferredDestroys(app, frame);
+		free((*frame).deletionQueue);
+	}
+
+	uploadRingDestroy((*app).uploads);
+	commandRecorderDestroy((*app).recorder);
+	renderGraphDestroy((*app).frameGraph);
+	spriteBatchDestroy((*app).sprites);
+	atlasDestroy((*app).atlas);
+	bindlessDestroy((*app).textures);
+	descriptorAllocatorDestroy((*app).descriptors);
+	descriptorLayoutCacheDestroy((*app).layouts);
+	free((*app).spriteRegions);
+	free((*app).spriteViewOffsets);
+
+	vkDestroyCommandPool((*app).device, (*app).computeCommandPool, NULL);
+	vkDestroyCommandPool((*app).device, (*app).transferCommandPool, NULL);
+	vkDestroyCommandPool((*app).device, (*app).graphicsCommandPool, NULL);
+
+	for (uint32_t i = 0; i < (*app).swapChainImageCount; i++)
+	{
+		vkDestroyFramebuffer((*app).device, (*app).swapChainFramebuffers[i], NULL);
+		vkDestroySemaphore((*app).device, (*app).renderFinishedSemaphores[i], NULL);
+	}
+	free((*app).swapChainFramebuffers);
+	free((*app).renderFinishedSemaphores);
+	free((*app).imagesInFlight);
 
-	for (uint32_t i = 0; i < imageCount; i++)
+	vkDestroyRenderPass((*app).device, (*app).renderPass, NULL);
+
+	for (uint32_t i = 0; i < (*app).swapChainImageCount; i++)
 		vkDestroyImageView((*app).device, (*app).swapChainImageViews[i], NULL);
 	free((*app).swapChainImageViews);
 
+	if ((*app).offscreenMemory != NULL)
+	{
+		for (uint32_t i = 0; i < (*app).swapChainImageCount; i++)
+			gpuDestroyImage((*app).allocator, (*app).swapChainImages[i], &(*app).offscreenMemory[i]);
+		free((*app).offscreenMemory);
+	}
+
 	free((*app).swapChainImages);
-	vkDestroySwapchainKHR((*app).device, (*app).swapChain, NULL);
+	if ((*app).surface != VK_NULL_HANDLE) vkDestroySwapchainKHR((*app).device, (*app).swapChain, NULL);
+	freeSurfaceInfo(&(*app).surfaceInfo);
 
+	if ((*app).allocator != NULL && !(*app).quiet) gpuPrintStats((*app).allocator);
+	gpuAllocatorDestroy((*app).allocator);
 	vkDestroyDevice((*app).device, NULL);
-	vkDestroySurfaceKHR((*app).instance, (*app).surface, NULL);
+	if ((*app).surface != VK_NULL_HANDLE) vkDestroySurfaceKHR((*app).instance, (*app).surface, NULL);
 	vkDestroyInstance((*app).instance, NULL);
+	arenaFree(&(*app).deviceInfoArena);
 	
-	glfwDestroyWindow((*app).windowStruct.pWindow);
+	if (!(*app).headless)
+	{
+		glfwDestroyWindow((*app).windowStruct.pWindow);
+		glfwTerminate();
+	}
+}
+
+// A typical hand-written game object, the baseline for --ecs-bench.
+typedef struct benchObject
+{
+	float x, y, vx, vy;
+	float rotation, spin, size;
+	uint32_t color;
+	char name[32];
+	float health, armor;
+	uint32_t flags, team;
+	void *owner;
+	uint64_t lastHit;
+} benchObject;
+
+typedef struct benchStats
+{
+	char name[32];
+	float health, armor;
+	uint32_t flags, team;
+	void *owner;
+	uint64_t lastHit;
+} benchStats;
+
+// Integrates the same entities stored as an array of objects and as ECS columns,
+// then times structural changes. CPU only, no window or device.
+void runEcsBenchmark(uint32_t count)
+{
+	const float step = 1.0f / 120.0f, width = 800.0f, height = 600.0f;
+
+	benchObject *objects = calloc(count, sizeof(benchObject));
+	ecsWorld *world = ecsWorldCreate();
+	ecsComponent position = ecsRegisterComponent(world, "position", sizeof(vec2));
+	ecsComponent velocity = ecsRegisterComponent(world, "velocity", sizeof(vec2));
+	ecsComponent spin = ecsRegisterComponent(world, "spin", sizeof(spriteSpin));
+	ecsComponent look = ecsRegisterComponent(world, "look", sizeof(spriteLook));
+	ecsComponent stats = ecsRegisterComponent(world, "stats", sizeof(benchStats));
+	ecsComponent enemy = ecsRegisterComponent(world, "enemy", 0);
+
+	ecsMask mask = ECS_MASK(position) | ECS_MASK(velocity) | ECS_MASK(spin) | ECS_MASK(look) | ECS_MASK(stats);
+	ecsEntity *entities = malloc(count * sizeof(ecsEntity));
+
+	srand(1);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		benchObject *object = &objects[i];
+		(*object).x = (float)(rand() % (int)width);
+		(*object).y = (float)(rand() % (int)height);
+		(*object).vx = (float)(rand() % 401 - 200);
+		(*object).vy = (float)(rand() % 401 - 200);
+
+		// A quarter are enemies, so the query spans two archetypes.
+		entities[i] = ecsCreate(world, mask | (i % 4 == 0 ? ECS_MASK(enemy) : 0));
+		*(vec2 *)ecsGet(world, entities[i], position) = (vec2){(*object).x, (*object).y};
+		*(vec2 *)ecsGet(world, entities[i], velocity) = (vec2){(*object).vx, (*object).vy};
+	}
+
+	double start = nowSeconds();
+	for (uint32_t pass = 0; pass < ECS_BENCH_PASSES; pass++)
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			benchObject *object = &objects[i];
+			(*object).x += (*object).vx * step;
+			(*object).y += (*object).vy * step;
+			if ((*object).x < 0.0f || (*object).x > width) (*object).vx = -(*object).vx;
+			if ((*object).y < 0.0f || (*object).y > height) (*object).vy = -(*object).vy;
+		}
+	}
+	double aosTime = (nowSeconds() - start) / ECS_BENCH_PASSES;
+
+	ecsQuery *movers = ecsQueryCreate(world, ECS_MASK(position) | ECS_MASK(velocity), 0);
+	start = nowSeconds();
+	for (uint32_t pass = 0; pass < ECS_BENCH_PASSES; pass++)
+	{
+		const ecsView *views;
+		uint32_t viewCount = ecsQueryViews(world, movers, &views);
+		for (uint32_t v = 0; v < viewCount; v++)
+			integrateColumns(ecsViewColumn(&views[v], position), ecsViewColumn(&views[v], velocity), views[v].count, step, width, height);
+	}
+	double ecsTime = (nowSeconds() - start) / ECS_BENCH_PASSES;
+
+	float maxError = 0.0f;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const vec2 *p = ecsGet(world, entities[i], position);
+		maxError = mathMax(maxError, mathMax(fabsf((*p).x - objects[i].x), fabsf((*p).y - objects[i].y)));
+	}
+
+	ecsStats worldStats = ecsGetStats(world);
+	printf("ECS benchmark: %u entities, %u passes\n", count, ECS_BENCH_PASSES);
+	printf("  array of structs: %.3f ms/pass, %.2f ns/entity\n", 1000.0 * aosTime, 1e9 * aosTime / count);
+	printf("  ecs columns:      %.3f ms/pass, %.2f ns/entity (%u archetypes, %u chunks of %u KiB)\n", 1000.0 * ecsTime, 1e9 * ecsTime / count,
+		worldStats.archetypeCount, worldStats.chunkCount, ECS_CHUNK_SIZE / 1024);
+	printf("  speedup %.2fx, max position difference %g\n", aosTime / ecsTime, maxError);
+
+	// Structural changes: tag every entity, untag it again, then rebuild the world.
+	start = nowSeconds();
+	for (uint32_t i = 0; i < count; i++) ecsAdd(world, entities[i], enemy);
+	double addTime = nowSeconds() - start;
+
+	start = nowSeconds();
+	for (uint32_t i = 0; i < count; i++) ecsRemove(world, entities[i], enemy);
+	double removeTime = nowSeconds() - start;
+
+	start = nowSeconds();
+	for (uint32_t i = 0; i < count; i++) ecsDestroy(world, entities[i]);
+	double destroyTime = nowSeconds() - start;
+
+	start = nowSeconds();
+	for (uint32_t i = 0; i < count; i++) entities[i] = ecsCreate(world, mask);
+	double createTime = nowSeconds() - start;
+
+	printf("  per entity: add %.1f ns, remove %.1f ns, destroy %.1f ns, create %.1f ns\n",
+		1e9 * addTime / count, 1e9 * removeTime / count, 1e9 * destroyTime / count, 1e9 * createTime / count);
+
+	ecsWorldDestroy(world);
+	free(entities);
+	free(objects);
+}
+
+bool benchOverlap(const vec2 *position, const float *size, uint32_t a, uint32_t b)
+{
+	return position[a].x <= position[b].x + size[b] && position[b].x <= position[a].x + size[a] &&
+		position[a].y <= position[b].y + size[b] && position[b].y <= position[a].y + size[a];
+}
+
+int comparePairs(const void *a, const void *b)
+{
+	const bpPair *x = a, *y = b;
+	if ((*x).a != (*y).a) return (*x).a < (*y).a ? -1 : 1;
+	return (*x).b < (*y).b ? -1 : (*x).b > (*y).b;
+}
+
+// Bodies the size of the sprites bounce around a world that grows with the count;
+// every tick moves them all and finds the overlapping pairs. The last tick is
+// checked against the all-pairs test. CPU only, no window or device.
+void runBroadphaseBenchmark(jobSystem *jobs, uint32_t count)
+{
+	const float step = 1.0f / 120.0f;
+	const float side = 32.0f * sqrtf((float)count);
+	const uint32_t capacity = 8 * count;
+
+	broadphaseCreateInfo createInfo = {0};
+	createInfo.cellSize = BROADPHASE_CELL_SIZE;
+	createInfo.maxBodies = count;
+	createInfo.jobs = jobs;
+	broadphase *bp = broadphaseCreate(&createInfo);
+	if (bp == NULL) return;
+
+	vec2 *position = malloc(count * sizeof(vec2));
+	vec2 *velocity = malloc(count * sizeof(vec2));
+	float *size = malloc(count * sizeof(float));
+	bpBox *boxes = malloc(count * sizeof(bpBox));
+	bpPair *pairs = malloc(capacity * sizeof(bpPair));
+
+	srand(1);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		position[i].x = (float)(rand() % (int)side);
+		position[i].y = (float)(rand() % (int)side);
+		velocity[i].x = (float)(rand() % 401 - 200);
+		velocity[i].y = (float)(rand() % 401 - 200);
+		size[i] = (float)(4 + rand() % 12);
+		boxes[i] = (bpBox){position[i].x, position[i].y, position[i].x + size[i], position[i].y + size[i]};
+	}
+	broadphaseSetRange(bp, 0, count, boxes);
+
+	double updateTime = 0.0, pairTime = 0.0;
+	uint64_t cellChanges = 0, pairTotal = 0;
+	uint32_t pairCount = 0;
+	for (uint32_t tick = 0; tick < BROADPHASE_BENCH_TICKS; tick++)
+	{
+		integrateColumns(position, velocity, count, step, side, side);
+
+		for (uint32_t i = 0; i < count; i++) boxes[i] = (bpBox){position[i].x, position[i].y, position[i].x + size[i], position[i].y + size[i]};
+
+		double start = nowSeconds();
+		broadphaseSetRange(bp, 0, count, boxes);
+		double middle = nowSeconds();
+		pairCount = broadphaseFindPairs(bp, pairs, capacity);
+		double end = nowSeconds();
+
+		updateTime += middle - start;
+		pairTime += end - middle;
+		broadphaseStats stats = broadphaseGetStats(bp);
+		cellChanges += stats.cellChanges;
+		pairTotal += stats.pairCount;
+	}
+
+	// All pairs, to check the last tick and for scale.
+	double start = nowSeconds();
+	uint32_t bruteCount = 0;
+	for (uint32_t a = 0; a < count; a++)
+		for (uint32_t b = a + 1; b < count; b++)
+			if (benchOverlap(position, size, a, b)) bruteCount++;
+	double bruteTime = nowSeconds() - start;
+
+	qsort(pairs, pairCount, sizeof(bpPair), comparePairs);
+	uint32_t wrong = 0;
+	for (uint32_t i = 0; i < pairCount; i++)
+	{
+		bpPair pair = pairs[i];
+		bool duplicate = i > 0 && pair.a == pairs[i - 1].a && pair.b == pairs[i - 1].b;
+		if (duplicate || !benchOverlap(position, size, pair.a, pair.b)) wrong++;
+	}
+
+	broadphaseStats stats = broadphaseGetStats(bp);
+	printf("Broadphase benchmark: %u bodies in %.0f x %.0f, %u ticks on %u threads\n", count, side, side, BROADPHASE_BENCH_TICKS, jobWorkerCount(jobs));
+	printf("  update: %.3f ms/tick, %.1f cell changes/tick\n", 1000.0 * updateTime / BROADPHASE_BENCH_TICKS, (double)cellChanges / BROADPHASE_BENCH_TICKS);
+	printf("  pairs:  %.3f ms/tick, %.1f pairs/tick over %u cells\n", 1000.0 * pairTime / BROADPHASE_BENCH_TICKS, (double)pairTotal / BROADPHASE_BENCH_TICKS, stats.occupiedCells);
+	printf("  all pairs: %.3f ms, %u pairs; grid found %u, %u wrong, %u dropped\n", 1000.0 * bruteTime, bruteCount, pairCount, wrong, stats.droppedPairs);
+
+	broadphaseDestroy(bp);
+	free(pairs);
+	free(boxes);
+	free(size);
+	free(velocity);
+	free(position);
+}
+
+// A level of floors with gaps, pipes and platforms; mice walk, fall and jump
+// through it, all resolved with one call per tick. Long ground probes are then
+// timed against testing one cell at a time. CPU only, no window or device.
+void runTileBenchmark(uint32_t count)
+{
+	const uint32_t width = 1024, height = 512;
+	const float tileSize = 8.0f, step = 1.0f / 120.0f, gravity = 900.0f;
+
+	tileGridCreateInfo createInfo = {0};
+	createInfo.width = width;
+	createInfo.height = height;
+	createInfo.tileSize = tileSize;
+	tileGrid *grid = tileGridCreate(&createInfo);
+	if (grid == NULL) return;
+
+	srand(1);
+	tileGridFill(grid, 0, 0, width - 1, 0, true);
+	tileGridFill(grid, 0, height - 1, width - 1, height - 1, true);
+	tileGridFill(grid, 0, 0, 0, height - 1, true);
+	tileGridFill(grid, width - 1, 0, width - 1, height - 1, true);
+	for (uint32_t floor = 32; floor < height - 1; floor += 32)
+	{
+		tileGridFill(grid, 1, floor, width - 2, floor + 1, true);
+		for (uint32_t gap = 0; gap < 8; gap++)
+		{
+			int32_t x = 1 + rand() % (width - 8);
+			tileGridFill(grid, x, floor, x + 5, floor + 1, false);
+		}
+		for (uint32_t pipe = 0; pipe < 6; pipe++)
+		{
+			int32_t x = 1 + rand() % (width - 4);
+			tileGridFill(grid, x, floor - 6, x + 1, floor - 1, true);
+		}
+		for (uint32_t platform = 0; platform < 6; platform++)
+		{
+			int32_t x = 1 + rand() % (width - 24);
+			tileGridFill(grid, x, floor - 12, x + 12 + rand() % 12, floor - 12, true);
+		}
+	}
+
+	tileBody *mice = malloc(count * sizeof(tileBody));
+	for (uint32_t i = 0; i < count; i++)
+	{
+		tileBody *mouse = &mice[i];
+		*mouse = (tileBody){0};
+		(*mouse).width = 8.0f;
+		(*mouse).height = 6.0f;
+
+		// Spawn in the open air just above a floor.
+		do
+		{
+			(*mouse).x = (float)(8 + rand() % (int)(width * tileSize - 32));
+			(*mouse).y = (float)(32 * (1 + rand() % (height / 32 - 1))) * tileSize - 24.0f;
+		} while (tileGridAnySolid(grid, (int32_t)((*mouse).x / tileSize), (int32_t)((*mouse).y / tileSize),
+			(int32_t)(((*mouse).x + (*mouse).width) / tileSize), (int32_t)(((*mouse).y + (*mouse).height) / tileSize)));
+
+		(*mouse).dx = (float)(rand() % 2 ? 60 + rand() % 60 : -60 - rand() % 60);
+	}
+
+	float *speed = malloc(count * sizeof(float));
+	float *fall = calloc(count, sizeof(float));
+	for (uint32_t i = 0; i < count; i++) speed[i] = mice[i].dx;
+
+	double resolveTime = 0.0;
+	uint64_t grounded = 0, walls = 0;
+	for (uint32_t tick = 0; tick < TILE_BENCH_TICKS; tick++)
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			fall[i] = mice[i].contacts & TILE_CONTACT_GROUND ? (rand() % 256 == 0 ? -300.0f : 0.0f) : fall[i] + gravity * step;
+			if (mice[i].contacts & (TILE_CONTACT_LEFT | TILE_CONTACT_RIGHT)) speed[i] = -speed[i];
+			if (mice[i].contacts & TILE_CONTACT_CEILING) fall[i] = 0.0f;
+			mice[i].dx = speed[i] * step;
+			mice[i].dy = fall[i] * step;
+		}
 
-	glfwTerminate();
+		double start = nowSeconds();
+		tileGridResolve(grid, mice, count);
+		resolveTime += nowSeconds() - start;
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			grounded += (mice[i].contacts & TILE_CONTACT_GROUND) != 0;
+			walls += (mice[i].contacts & (TILE_CONTACT_LEFT | TILE_CONTACT_RIGHT)) != 0;
+		}
+	}
+
+	// Probes from random cells straight down, up to a quarter of the level.
+	int32_t *probes = malloc(2 * TILE_BENCH_PROBES * sizeof(int32_t));
+	for (uint32_t i = 0; i < TILE_BENCH_PROBES; i++)
+	{
+		probes[2 * i] = rand() % width;
+		probes[2 * i + 1] = rand() % height;
+	}
+
+	uint64_t sweepTotal = 0, cellTotal = 0;
+	double start = nowSeconds();
+	for (uint32_t i = 0; i < TILE_BENCH_PROBES; i++)
+		sweepTotal += tileGridSweep(grid, probes[2 * i], probes[2 * i + 1], probes[2 * i], probes[2 * i + 1], TILE_DOWN, height / 4);
+	double sweepTime = nowSeconds() - start;
+
+	start = nowSeconds();
+	for (uint32_t i = 0; i < TILE_BENCH_PROBES; i++)
+	{
+		uint32_t distance = 0;
+		while (distance < height / 4 && !tileGridSolid(grid, probes[2 * i], probes[2 * i + 1] + (int32_t)distance + 1)) distance++;
+		cellTotal += distance;
+	}
+	double cellTime = nowSeconds() - start;
+
+	printf("Tile benchmark: %u mice on a %ux%u grid, %u ticks\n", count, width, height, TILE_BENCH_TICKS);
+	printf("  resolve: %.3f ms/tick, %.1f ns/mouse; %.1f%% grounded, %.1f%% at walls\n", 1000.0 * resolveTime / TILE_BENCH_TICKS,
+		1e9 * resolveTime / ((double)TILE_BENCH_TICKS * count), 100.0 * grounded / ((double)TILE_BENCH_TICKS * count), 100.0 * walls / ((double)TILE_BENCH_TICKS * count));
+	printf("  ground probes: %.1f ns bit scan, %.1f ns cell by cell, %.1f cells on average%s\n", 1e9 * sweepTime / TILE_BENCH_PROBES,
+		1e9 * cellTime / TILE_BENCH_PROBES, (double)sweepTotal / TILE_BENCH_PROBES, sweepTotal == cellTotal ? "" : " (MISMATCH)");
+
+	tileGridDestroy(grid);
+	free(probes);
+	free(fall);
+	free(speed);
+	free(mice);
+}
+
+// Times every batch kernel level this CPU supports and checks it against the
+// scalar results bit for bit.
+void runMathBenchmark(void)
+{
+	vec4 *points = malloc(MATH_BENCH_COUNT * sizeof(vec4));
+	vec4 *expected = malloc(MATH_BENCH_COUNT * sizeof(vec4));
+	vec4 *transformed = malloc(MATH_BENCH_COUNT * sizeof(vec4));
+	aabb *boxes = malloc(MATH_BENCH_COUNT * sizeof(aabb));
+	uint32_t *expectedHits = malloc(MATH_BENCH_COUNT * sizeof(uint32_t));
+	uint32_t *hits = malloc(MATH_BENCH_COUNT * sizeof(uint32_t));
+
+	srand(1);
+	for (uint32_t i = 0; i < MATH_BENCH_COUNT; i++)
+	{
+		points[i].x = (float)(rand() % 20001 - 10000) / 7.0f;
+		points[i].y = (float)(rand() % 20001 - 10000) / 3.0f;
+		points[i].z = (float)(rand() % 1001) / 1000.0f;
+		points[i].w = 1.0f;
+
+		float x = (float)(rand() % 4096), y = (float)(rand() % 4096);
+		boxes[i] = (aabb){x, y, x + (float)(4 + rand() % 12), y + (float)(4 + rand() % 12)};
+	}
+
+	quat spin = quatFromAxisAngle((vec3){0.0f, 0.0f, 1.0f}, 0.7f);
+	mat4 rotation = mat4FromQuat(spin), translation = mat4Translation((vec3){12.5f, -3.25f, 0.5f});
+	mat4 projection = mat4Ortho(0.0f, 800.0f, 0.0f, 600.0f, 0.0f, 1.0f);
+	mat4 model = mat4Multiply(&translation, &rotation);
+	mat4 transform = mat4Multiply(&projection, &model);
+	aabb query = {1024.0f, 1024.0f, 1536.0f, 1536.0f};
+
+	mathLevel supported = mathSupportedLevel();
+	printf("Math benchmark: %u points and boxes, %u passes, up to %s\n", MATH_BENCH_COUNT, MATH_BENCH_PASSES, mathLevelName(supported));
+
+	uint32_t expectedCount = 0;
+	for (uint32_t level = MATH_LEVEL_SCALAR; level <= supported; level++)
+	{
+		mathSetLevel(level);
+
+		double start = nowSeconds();
+		for (uint32_t pass = 0; pass < MATH_BENCH_PASSES; pass++) mathTransformPoints(&transform, points, transformed, MATH_BENCH_COUNT);
+		double transformTime = (nowSeconds() - start) / MATH_BENCH_PASSES;
+
+		uint32_t hitCount = 0;
+		start = nowSeconds();
+		for (uint32_t pass = 0; pass < MATH_BENCH_PASSES; pass++) hitCount = mathOverlapBoxes(&query, boxes, MATH_BENCH_COUNT, hits);
+		double overlapTime = (nowSeconds() - start) / MATH_BENCH_PASSES;
+
+		if (level == MATH_LEVEL_SCALAR)
+		{
+			memcpy(expected, transformed, MATH_BENCH_COUNT * sizeof(vec4));
+			memcpy(expectedHits, hits, hitCount * sizeof(uint32_t));
+			expectedCount = hitCount;
+		}
+
+		bool exact = memcmp(expected, transformed, MATH_BENCH_COUNT * sizeof(vec4)) == 0 &&
+			hitCount == expectedCount && memcmp(expectedHits, hits, hitCount * sizeof(uint32_t)) == 0;
+		printf("  %-8s transform %.2f ns/point, boxes %.2f ns/box (%u hits), %s\n", mathLevelName(level),
+			1e9 * transformTime / MATH_BENCH_COUNT, 1e9 * overlapTime / MATH_BENCH_COUNT, hitCount, exact ? "bit-exact" : "MISMATCH");
+	}
+
+	mathSetLevel(supported);
+	free(hits);
+	free(expectedHits);
+	free(boxes);
+	free(transformed);
+	free(expected);
+	free(points);
 }
 
-int main()
+int main(int argc, char **argv)
 {
-	glfwInit();
 	vulkanApp app = {0};
+	uint32_t broadphaseBodies = 0;
+	bool defragBench = false;
+	mathLevel mathKernels = mathInit();
+	app.presentProfile = PRESENT_PROFILE_BALANCED;
+	app.forcedGPU = getenv(GPU_OVERRIDE_ENV);
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--gpu") == 0 && i + 1 < argc) app.forcedGPU = argv[++i];
+		else if (strcmp(argv[i], "--headless") == 0) app.headless = true;
+		else if (strcmp(argv[i], "--quiet") == 0) app.quiet = true;
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) app.trace.path = argv[++i];
+		else if (strcmp(argv[i], "--present-profile") == 0 && i + 1 < argc)
+		{
+			const char *name = argv[++i];
+			for (int p = 0; p < PRESENT_PROFILE_COUNT; p++)
+				if (strcmp(name, presentProfiles[p].name) == 0) app.presentProfile = p;
+		}
+		else if (strcmp(argv[i], "--offscreen") == 0) app.headless = app.offscreen = true;
+		else if (strcmp(argv[i], "--sprites") == 0 && i + 1 < argc) app.spriteCount = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "--ecs-bench") == 0)
+		{
+			uint32_t count = i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]) ? (uint32_t)strtoul(argv[++i], NULL, 10) : ECS_BENCH_DEFAULT_ENTITIES;
+			runEcsBenchmark(count);
+			return 0;
+		}
+		else if (strcmp(argv[i], "--math-bench") == 0)
+		{
+			runMathBenchmark();
+			return 0;
+		}
+		else if (strcmp(argv[i], "--tile-bench") == 0)
+		{
+			uint32_t count = i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]) ? (uint32_t)strtoul(argv[++i], NULL, 10) : TILE_BENCH_DEFAULT_BODIES;
+			runTileBenchmark(count);
+			return 0;
+		}
+		else if (strcmp(argv[i], "--broadphase-bench") == 0)
+			broadphaseBodies = i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]) ? (uint32_t)strtoul(argv[++i], NULL, 10) : BROADPHASE_BENCH_DEFAULT_BODIES;
+		else if (strcmp(argv[i], "--defrag-bench") == 0) defragBench = app.headless = app.offscreen = true;
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) app.threadCount = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) app.frameCount = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "--dump-frame") == 0 && i + 1 < argc) 
+		{
+			app.dumpFramePath = argv[++i];
+			app.headless = app.offscreen = true;
+		}
+	}
+
+	app.framesInFlight = presentProfiles[app.presentProfile].framesInFlight;
+	app.trace.origin = nowSeconds();
+
+	// --threads 0 (the default) runs one worker per core; this thread is worker 0.
+	app.jobs = jobSystemCreate(app.threadCount);
+	if (!app.quiet) printf("Jobs: %u workers\n", jobWorkerCount(app.jobs));
+	if (!app.quiet) printf("Math: %s kernels\n", mathLevelName(mathKernels));
+
+	// Runs after the job system so --threads applies.
+	if (broadphaseBodies > 0)
+	{
+		runBroadphaseBenchmark(app.jobs, broadphaseBodies);
+		jobSystemDestroy(app.jobs);
+		return 0;
+	}
+
+	uint32_t startupPhase = traceBegin(&app.trace, "startup");
+
+	if (app.headless)
+	{
+		app.windowStruct.width = 800;
+		app.windowStruct.height = 600;
+		app.windowStruct.windowName = "Mouse-Run";
+		if (app.frameCount == 0) app.frameCount = HEADLESS_DEFAULT_FRAMES;
+	} else
+	{
+		uint32_t phase = traceBegin(&app.trace, "glfwInit");
+		glfwInit();
+		traceEnd(&app.trace, phase);
+
+		phase = traceBegin(&app.trace, "window");
+		initWindow(&app.windowStruct, 800, 600, "Mouse-Run");
+		traceEnd(&app.trace, phase);
+	}
 
-	initWindow(&app.windowStruct, 800, 600, "Mouse-Run");
 	initVulkanApp(&app);
 
-	while(!glfwWindowShouldClose(app.windowStruct.pWindow))
+	if (defragBench)
+	{
+		runDefragBenchmark(&app);
+		freeVulkanApp(&app);
+		return 0;
+	}
+
+	traceEnd(&app.trace, startupPhase);
+	if (app.trace.path != NULL) writeStartupTrace(&app.trace);
+
+	uint32_t framesRendered = 0;
+	double startTime = nowSeconds();
+
+	while((app.frameCount == 0 || framesRendered < app.frameCount) && (app.headless || !glfwWindowShouldClose(app.windowStruct.pWindow)))
+	{
+		renderLoop(&app);
+		framesRendered++;
+	}
+
+	if (app.headless)
 	{
-		renderLoop(app);
+		vkDeviceWaitIdle(app.device);
+		double elapsed = nowSeconds() - startTime;
+		printf("%u frames in %.3f s (%.3f ms/frame)\n", framesRendered, elapsed, 1000.0 * elapsed / mathMax(framesRendered, 1u));
+		printf("record: %.3f ms/frame CPU on %u threads\n", 1000.0 * app.recordSeconds / mathMax(framesRendered, 1u), jobWorkerCount(app.jobs));
+		if (app.spriteCount > 0)
+			printf("sprites: %.1f draws, %.0f instances per frame\n",
+				(double)app.spriteDrawTotal / mathMax(framesRendered, 1u), (double)app.spriteInstanceTotal / mathMax(framesRendered, 1u));
+		if (app.simulation != NULL)
+		{
+			simulationStats stats = simulationGetStats(app.simulation);
+			printf("simulation: %llu ticks at %.0f Hz, %llu dropped\n", (unsigned long long)stats.tickCount, SIM_TICK_RATE, (unsigned long long)stats.droppedTicks);
+		}
 	}
 
+	if (app.dumpFramePath != NULL) dumpLastFrame(&app, app.dumpFramePath);
+
 	freeVulkanApp(&app);
 }
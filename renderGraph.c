@@ -0,0 +1,785 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "renderGraph.h"
+#include "growArray.h"
+
+typedef enum rgResourceKind
+{
+	RG_IMAGE_TRANSIENT,
+	RG_IMAGE_IMPORTED,
+	RG_BUFFER_IMPORTED
+} rgResourceKind;
+
+typedef struct rgAccessInfo
+{
+	VkPipelineStageFlags2KHR stage;
+	VkAccessFlags2KHR access;
+	VkImageLayout layout;
+	bool write;
+	VkImageUsageFlags usage;
+} rgAccessInfo;
+
+// Only stage/access bits that exist in the original flags are used, so the table
+// translates 1:1 when synchronization2 is unavailable.
+static const rgAccessInfo accessInfos[RG_ACCESS_COUNT] =
+{
+	[RG_ACCESS_COLOR_ATTACHMENT_WRITE]  = {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT},
+	[RG_ACCESS_DEPTH_ATTACHMENT_WRITE]  = {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT},
+	[RG_ACCESS_DEPTH_ATTACHMENT_READ]   = {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT},
+	[RG_ACCESS_FRAGMENT_SAMPLED_READ]   = {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, VK_IMAGE_USAGE_SAMPLED_BIT},
+	[RG_ACCESS_COMPUTE_SAMPLED_READ]    = {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, VK_IMAGE_USAGE_SAMPLED_BIT},
+	[RG_ACCESS_COMPUTE_STORAGE_READ]    = {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR, VK_IMAGE_LAYOUT_GENERAL, false, VK_IMAGE_USAGE_STORAGE_BIT},
+	[RG_ACCESS_COMPUTE_STORAGE_WRITE]   = {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_GENERAL, true, VK_IMAGE_USAGE_STORAGE_BIT},
+	[RG_ACCESS_TRANSFER_READ]           = {VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false, VK_IMAGE_USAGE_TRANSFER_SRC_BIT},
+	[RG_ACCESS_TRANSFER_WRITE]          = {VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true, VK_IMAGE_USAGE_TRANSFER_DST_BIT},
+	[RG_ACCESS_VERTEX_BUFFER_READ]      = {VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT_KHR, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT_KHR, VK_IMAGE_LAYOUT_UNDEFINED, false, 0},
+	[RG_ACCESS_INDEX_BUFFER_READ]       = {VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT_KHR, VK_ACCESS_2_INDEX_READ_BIT_KHR, VK_IMAGE_LAYOUT_UNDEFINED, false, 0},
+	[RG_ACCESS_INDIRECT_READ]           = {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR, VK_IMAGE_LAYOUT_UNDEFINED, false, 0},
+	[RG_ACCESS_UNIFORM_READ]            = {VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_UNIFORM_READ_BIT_KHR, VK_IMAGE_LAYOUT_UNDEFINED, false, 0},
+};
+
+// Pending hazards on a resource: the last write and every read issued since.
+typedef struct rgState
+{
+	VkPipelineStageFlags2KHR writeStage, readStages;
+	VkAccessFlags2KHR writeAccess, readAccess;
+	VkImageLayout layout;
+} rgState;
+
+typedef struct rgResourceNode
+{
+	const char *name;
+	rgResourceKind kind;
+	rgImageDesc desc;
+	rgImportState initial, final;
+
+	VkImage image;
+	VkImageView view;
+	VkBuffer buffer;
+
+	// Filled by rgCompile.
+	bool used;
+	VkImageUsageFlags usage;
+	uint32_t firstPass, lastPass;
+	VkMemoryRequirements requirements;
+	uint32_t slot;
+	rgResource nextInSlot;
+	rgResource aliasPrev;
+	bool touched;
+	rgState state;
+	rgState finalState;
+} rgResourceNode;
+
+typedef struct rgUse
+{
+	rgResource resource;
+	rgAccess access;
+} rgUse;
+
+typedef struct rgBarrierBatch
+{
+	uint32_t first, count;
+	VkMemoryBarrier2KHR memory;
+} rgBarrierBatch;
+
+typedef struct rgPassNode
+{
+	const char *name;
+	rgPassCallback execute;
+	void *userData;
+	rgUse *uses;
+	uint32_t useCount, useCapacity;
+	bool sideEffect;
+	bool alive;
+	rgBarrierBatch barriers;
+} rgPassNode;
+
+typedef struct rgBarrier
+{
+	rgResource resource;
+	VkPipelineStageFlags2KHR srcStage, dstStage;
+	VkAccessFlags2KHR srcAccess, dstAccess;
+	VkImageLayout oldLayout, newLayout;
+} rgBarrier;
+
+typedef struct rgSlot
+{
+	VkMemoryRequirements requirements;
+	gpuAllocation allocation;
+	rgResource first;
+} rgSlot;
+
+// Transients replaced by a recompile, kept until frames that used them have retired.
+typedef struct rgRetired
+{
+	VkImage image;
+	VkImageView view;
+	gpuAllocation allocation;
+	uint64_t frame;
+} rgRetired;
+
+struct renderGraph
+{
+	VkDevice device;
+	gpuAllocator *allocator;
+	bool synchronization2;
+	uint32_t framesInFlight;
+	PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2;
+
+	rgResourceNode *resources;
+	uint32_t resourceCount, resourceCapacity;
+	rgPassNode *passes;
+	uint32_t passCount, passCapacity;
+
+	uint32_t *order;
+	uint32_t orderCount;
+	rgBarrier *barriers;
+	uint32_t barrierCount, barrierCapacity;
+	rgBarrierBatch finalBarriers;
+
+	rgSlot *slots;
+	uint32_t slotCount;
+
+	rgRetired *retired;
+	uint32_t retiredCount, retiredCapacity;
+	uint64_t frameIndex;
+
+	VkExtent2D extent;
+	rgStats stats;
+
+	VkImageMemoryBarrier2KHR *scratch;
+	VkImageMemoryBarrier *legacyScratch;
+	uint32_t scratchCapacity;
+};
+
+renderGraph *renderGraphCreate(const renderGraphCreateInfo *createInfo)
+{
+	renderGraph *graph = calloc(1, sizeof(renderGraph));
+	(*graph).device = (*createInfo).device;
+	(*graph).allocator = (*createInfo).allocator;
+	(*graph).synchronization2 = (*createInfo).synchronization2;
+	(*graph).framesInFlight = (*createInfo).framesInFlight ? (*createInfo).framesInFlight : 1;
+
+	if ((*graph).synchronization2)
+	{
+		(*graph).cmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2KHR)vkGetDeviceProcAddr((*graph).device, "vkCmdPipelineBarrier2KHR");
+		if ((*graph).cmdPipelineBarrier2 == NULL) (*graph).synchronization2 = false;
+	}
+
+	return graph;
+}
+
+static void retireTransients(renderGraph *graph)
+{
+	for (uint32_t i = 0; i < (*graph).resourceCount; i++)
+	{
+		rgResourceNode *resource = &(*graph).resources[i];
+		if ((*resource).kind != RG_IMAGE_TRANSIENT || (*resource).image == VK_NULL_HANDLE) continue;
+
+		GROW((*graph).retired, (*graph).retiredCount, (*graph).retiredCapacity, 16);
+		(*graph).retired[(*graph).retiredCount++] = (rgRetired){(*resource).image, (*resource).view, {0}, (*graph).frameIndex};
+		(*resource).image = VK_NULL_HANDLE;
+		(*resource).view = VK_NULL_HANDLE;
+	}
+
+	for (uint32_t i = 0; i < (*graph).slotCount; i++)
+	{
+		GROW((*graph).retired, (*graph).retiredCount, (*graph).retiredCapacity, 16);
+		(*graph).retired[(*graph).retiredCount++] = (rgRetired){VK_NULL_HANDLE, VK_NULL_HANDLE, (*graph).slots[i].allocation, (*graph).frameIndex};
+	}
+
+	free((*graph).slots);
+	(*graph).slots = NULL;
+	(*graph).slotCount = 0;
+}
+
+static void freeRetired(renderGraph *graph, bool all)
+{
+	uint32_t kept = 0;
+
+	for (uint32_t i = 0; i < (*graph).retiredCount; i++)
+	{
+		rgRetired *retired = &(*graph).retired[i];
+		if (!all && (*retired).frame + (*graph).framesInFlight > (*graph).frameIndex)
+		{
+			(*graph).retired[kept++] = *retired;
+			continue;
+		}
+
+		vkDestroyImageView((*graph).device, (*retired).view, NULL);
+		vkDestroyImage((*graph).device, (*retired).image, NULL);
+		gpuFreeMemory((*graph).allocator, &(*retired).allocation);
+	}
+
+	(*graph).retiredCount = kept;
+}
+
+// The device must be idle.
+void renderGraphDestroy(renderGraph *graph)
+{
+	if (graph == NULL) return;
+
+	retireTransients(graph);
+	freeRetired(graph, true);
+
+	for (uint32_t i = 0; i < (*graph).passCount; i++) free((*graph).passes[i].uses);
+	free((*graph).passes);
+	free((*graph).resources);
+	free((*graph).order);
+	free((*graph).barriers);
+	free((*graph).retired);
+	free((*graph).scratch);
+	free((*graph).legacyScratch);
+	free(graph);
+}
+
+static rgResource addResource(renderGraph *graph, const char *name, rgResourceKind kind)
+{
+	GROW((*graph).resources, (*graph).resourceCount, (*graph).resourceCapacity, 16);
+
+	rgResourceNode *resource = &(*graph).resources[(*graph).resourceCount];
+	memset(resource, 0, sizeof(rgResourceNode));
+	(*resource).name = name;
+	(*resource).kind = kind;
+
+	return (*graph).resourceCount++;
+}
+
+rgResource rgCreateImage(renderGraph *graph, const char *name, const rgImageDesc *desc)
+{
+	rgResource handle = addResource(graph, name, RG_IMAGE_TRANSIENT);
+	rgResourceNode *resource = &(*graph).resources[handle];
+
+	(*resource).desc = *desc;
+	if ((*resource).desc.mipLevels == 0) (*resource).desc.mipLevels = 1;
+	if ((*resource).desc.arrayLayers == 0) (*resource).desc.arrayLayers = 1;
+	if ((*resource).desc.samples == 0) (*resource).desc.samples = VK_SAMPLE_COUNT_1_BIT;
+	if ((*resource).desc.aspect == 0) (*resource).desc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+	return handle;
+}
+
+rgResource rgImportImage(renderGraph *graph, const char *name, VkImageAspectFlags aspect, rgImportState initial, rgImportState final)
+{
+	rgResource handle = addResource(graph, name, RG_IMAGE_IMPORTED);
+	rgResourceNode *resource = &(*graph).resources[handle];
+
+	(*resource).desc.aspect = aspect;
+	(*resource).initial = initial;
+	(*resource).final = final;
+
+	return handle;
+}
+
+rgResource rgImportBuffer(renderGraph *graph, const char *name)
+{
+	return addResource(graph, name, RG_BUFFER_IMPORTED);
+}
+
+void rgSetImportedImage(renderGraph *graph, rgResource resource, VkImage image, VkImageView view)
+{
+	(*graph).resources[resource].image = image;
+	(*graph).resources[resource].view = view;
+}
+
+void rgSetImportedBuffer(renderGraph *graph, rgResource resource, VkBuffer buffer)
+{
+	(*graph).resources[resource].buffer = buffer;
+}
+
+rgPass rgAddPass(renderGraph *graph, const char *name, rgPassCallback execute, void *userData)
+{
+	GROW((*graph).passes, (*graph).passCount, (*graph).passCapacity, 16);
+
+	rgPassNode *pass = &(*graph).passes[(*graph).passCount];
+	memset(pass, 0, sizeof(rgPassNode));
+	(*pass).name = name;
+	(*pass).execute = execute;
+	(*pass).userData = userData;
+
+	return (*graph).passCount++;
+}
+
+void rgPassUse(renderGraph *graph, rgPass pass, rgResource resource, rgAccess access)
+{
+	rgPassNode *node = &(*graph).passes[pass];
+
+	GROW((*node).uses, (*node).useCount, (*node).useCapacity, 4);
+	(*node).uses[(*node).useCount++] = (rgUse){resource, access};
+}
+
+void rgPassSideEffect(renderGraph *graph, rgPass pass)
+{
+	(*graph).passes[pass].sideEffect = true;
+}
+
+// Walks the passes backwards keeping only those whose writes reach an imported
+// resource, a later live reader or a pass marked with side effects.
+static void cullPasses(renderGraph *graph)
+{
+	bool *needed = calloc((*graph).resourceCount, sizeof(bool));
+	for (uint32_t i = 0; i < (*graph).resourceCount; i++)
+		needed[i] = (*graph).resources[i].kind != RG_IMAGE_TRANSIENT;
+
+	for (uint32_t p = (*graph).passCount; p-- > 0;)
+	{
+		rgPassNode *pass = &(*graph).passes[p];
+		(*pass).alive = (*pass).sideEffect;
+
+		for (uint32_t u = 0; u < (*pass).useCount && !(*pass).alive; u++)
+			(*pass).alive = accessInfos[(*pass).uses[u].access].write && needed[(*pass).uses[u].resource];
+
+		if (!(*pass).alive) continue;
+
+		// A write fully defines transient contents, so earlier writers are only
+		// needed again if this pass also reads.
+		for (uint32_t u = 0; u < (*pass).useCount; u++)
+		{
+			rgResource r = (*pass).uses[u].resource;
+			if (accessInfos[(*pass).uses[u].access].write && (*graph).resources[r].kind == RG_IMAGE_TRANSIENT) needed[r] = false;
+		}
+		for (uint32_t u = 0; u < (*pass).useCount; u++)
+			if (!accessInfos[(*pass).uses[u].access].write) needed[(*pass).uses[u].resource] = true;
+	}
+
+	free(needed);
+
+	(*graph).order = realloc((*graph).order, ((*graph).passCount ? (*graph).passCount : 1) * sizeof(uint32_t));
+	(*graph).orderCount = 0;
+	for (uint32_t p = 0; p < (*graph).passCount; p++)
+		if ((*graph).passes[p].alive) (*graph).order[(*graph).orderCount++] = p;
+}
+
+static VkResult createTransients(renderGraph *graph)
+{
+	for (uint32_t i = 0; i < (*graph).resourceCount; i++)
+	{
+		rgResourceNode *resource = &(*graph).resources[i];
+		(*resource).used = false;
+		(*resource).usage = 0;
+		(*resource).nextInSlot = RG_RESOURCE_NONE;
+		(*resource).aliasPrev = RG_RESOURCE_NONE;
+	}
+
+	for (uint32_t o = 0; o < (*graph).orderCount; o++)
+	{
+		rgPassNode *pass = &(*graph).passes[(*graph).order[o]];
+		for (uint32_t u = 0; u < (*pass).useCount; u++)
+		{
+			rgResourceNode *resource = &(*graph).resources[(*pass).uses[u].resource];
+			if (!(*resource).used) (*resource).firstPass = o;
+			(*resource).used = true;
+			(*resource).lastPass = o;
+			(*resource).usage |= accessInfos[(*pass).uses[u].access].usage;
+		}
+	}
+
+	for (uint32_t i = 0; i < (*graph).resourceCount; i++)
+	{
+		rgResourceNode *resource = &(*graph).resources[i];
+		if ((*resource).kind != RG_IMAGE_TRANSIENT || !(*resource).used) continue;
+
+		VkExtent2D extent = (*resource).desc.extent;
+		if (extent.width == 0 || extent.height == 0) extent = (*graph).extent;
+
+		VkImageCreateInfo imageInfo = {0};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = (*resource).desc.format;
+		imageInfo.extent = (VkExtent3D){extent.width, extent.height, 1};
+		imageInfo.mipLevels = (*resource).desc.mipLevels;
+		imageInfo.arrayLayers = (*resource).desc.arrayLayers;
+		imageInfo.samples = (*resource).desc.samples;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = (*resource).usage;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VkResult res = vkCreateImage((*graph).device, &imageInfo, NULL, &(*resource).image);
+		if (res != VK_SUCCESS) return res;
+
+		vkGetImageMemoryRequirements((*graph).device, (*resource).image, &(*resource).requirements);
+		(*graph).stats.transientCount++;
+		(*graph).stats.transientBytes += (*resource).requirements.size;
+	}
+
+	return VK_SUCCESS;
+}
+
+static bool overlaps(const rgResourceNode *a, const rgResourceNode *b)
+{
+	return (*a).firstPass <= (*b).lastPass && (*b).firstPass <= (*a).lastPass;
+}
+
+// Greedy first fit, largest transients first: a transient joins the first slot
+// whose occupants are all dead before it starts or born after it ends.
+static VkResult aliasTransients(renderGraph *graph)
+{
+	uint32_t count = 0;
+	rgResource *sorted = malloc(((*graph).resourceCount ? (*graph).resourceCount : 1) * sizeof(rgResource));
+
+	for (uint32_t i = 0; i < (*graph).resourceCount; i++)
+		if ((*graph).resources[i].image != VK_NULL_HANDLE && (*graph).resources[i].kind == RG_IMAGE_TRANSIENT) sorted[count++] = i;
+
+	for (uint32_t i = 1; i < count; i++)
+	{
+		rgResource r = sorted[i];
+		uint32_t j = i;
+		for (; j > 0 && (*graph).resources[sorted[j - 1]].requirements.size < (*graph).resources[r].requirements.size; j--) sorted[j] = sorted[j - 1];
+		sorted[j] = r;
+	}
+
+	(*graph).slots = calloc(count ? count : 1, sizeof(rgSlot));
+	(*graph).slotCount = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		rgResourceNode *resource = &(*graph).resources[sorted[i]];
+		uint32_t slot = (*graph).slotCount;
+
+		for (uint32_t s = 0; s < (*graph).slotCount && slot == (*graph).slotCount; s++)
+		{
+			if (!((*graph).slots[s].requirements.memoryTypeBits & (*resource).requirements.memoryTypeBits)) continue;
+
+			bool disjoint = true;
+			for (rgResource o = (*graph).slots[s].first; o != RG_RESOURCE_NONE && disjoint; o = (*graph).resources[o].nextInSlot)
+				disjoint = !overlaps(&(*graph).resources[o], resource);
+			if (disjoint) slot = s;
+		}
+
+		rgSlot *target = &(*graph).slots[slot];
+		if (slot == (*graph).slotCount)
+		{
+			(*graph).slotCount++;
+			(*target).requirements = (*resource).requirements;
+			(*target).first = RG_RESOURCE_NONE;
+		} else
+		{
+			if ((*resource).requirements.size > (*target).requirements.size) (*target).requirements.size = (*resource).requirements.size;
+			if ((*resource).requirements.alignment > (*target).requirements.alignment) (*target).requirements.alignment = (*resource).requirements.alignment;
+			(*target).requirements.memoryTypeBits &= (*resource).requirements.memoryTypeBits;
+		}
+
+		// Occupant lists are kept sorted by first use so alias order falls out of them.
+		rgResource *link = &(*target).first;
+		while (*link != RG_RESOURCE_NONE && (*graph).resources[*link].firstPass < (*resource).firstPass) link = &(*graph).resources[*link].nextInSlot;
+		(*resource).nextInSlot = *link;
+		*link = sorted[i];
+		(*resource).slot = slot;
+	}
+
+	free(sorted);
+
+	gpuAllocationCreateInfo allocInfo = {0};
+	allocInfo.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	allocInfo.flags = GPU_ALLOCATION_OPTIMAL_IMAGE;
+
+	for (uint32_t s = 0; s < (*graph).slotCount; s++)
+	{
+		rgSlot *slot = &(*graph).slots[s];
+		VkResult res = gpuAllocateMemory((*graph).allocator, &(*slot).requirements, &allocInfo, &(*slot).allocation);
+		if (res != VK_SUCCESS) return res;
+		(*graph).stats.allocatedBytes += (*slot).requirements.size;
+
+		// Each occupant inherits the hazards of the one before it; the first one
+		// those of the last, left over from the previous frame.
+		rgResource last = (*slot).first;
+		while ((*graph).resources[last].nextInSlot != RG_RESOURCE_NONE) last = (*graph).resources[last].nextInSlot;
+
+		rgResource prev = last;
+		for (rgResource o = (*slot).first; o != RG_RESOURCE_NONE; o = (*graph).resources[o].nextInSlot)
+		{
+			rgResourceNode *resource = &(*graph).resources[o];
+			(*resource).aliasPrev = prev;
+			prev = o;
+
+			res = vkBindImageMemory((*graph).device, (*resource).image, (*slot).allocation.memory, (*slot).allocation.offset);
+			if (res != VK_SUCCESS) return res;
+
+			VkImageViewCreateInfo viewInfo = {0};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = (*resource).image;
+			viewInfo.viewType = (*resource).desc.arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = (*resource).desc.format;
+			viewInfo.subresourceRange = (VkImageSubresourceRange){(*resource).desc.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+
+			res = vkCreateImageView((*graph).device, &viewInfo, NULL, &(*resource).view);
+			if (res != VK_SUCCESS) return res;
+		}
+	}
+
+	(*graph).stats.aliasSlotCount = (*graph).slotCount;
+	return VK_SUCCESS;
+}
+
+static void addMemoryDependency(VkMemoryBarrier2KHR *memory, const rgBarrier *barrier)
+{
+	(*memory).sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+	(*memory).srcStageMask |= (*barrier).srcStage;
+	(*memory).srcAccessMask |= (*barrier).srcAccess;
+	(*memory).dstStageMask |= (*barrier).dstStage;
+	(*memory).dstAccessMask |= (*barrier).dstAccess;
+}
+
+static void pushBarrier(renderGraph *graph, rgBarrierBatch *batch, rgBarrier barrier, bool emit)
+{
+	if (!emit) return;
+
+	if ((*graph).resources[barrier.resource].kind == RG_BUFFER_IMPORTED)
+	{
+		// Buffers share one global memory barrier per batch; drivers handle that
+		// at least as well as per-buffer barriers.
+		addMemoryDependency(&(*batch).memory, &barrier);
+		return;
+	}
+
+	GROW((*graph).barriers, (*graph).barrierCount, (*graph).barrierCapacity, 32);
+	(*graph).barriers[(*graph).barrierCount++] = barrier;
+	(*batch).count++;
+}
+
+// Applies one access to the tracked state, producing a barrier only for real
+// hazards: layout changes, anything after a write and writes after reads.
+static void accessResource(renderGraph *graph, rgBarrierBatch *batch, rgResource r, const rgAccessInfo *info, bool emit)
+{
+	rgResourceNode *resource = &(*graph).resources[r];
+	rgState *state = &(*resource).state;
+
+	if ((*resource).kind == RG_IMAGE_TRANSIENT && !(*resource).touched)
+	{
+		const rgState *prev = &(*graph).resources[(*resource).aliasPrev].finalState;
+		(*state).writeStage = (*prev).writeStage | (*prev).readStages;
+		(*state).writeAccess = (*prev).writeAccess;
+		(*state).readStages = 0;
+		(*state).readAccess = 0;
+		(*state).layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+	(*resource).touched = true;
+
+	bool isImage = (*resource).kind != RG_BUFFER_IMPORTED;
+	bool layoutChange = isImage && (*info).layout != (*state).layout;
+
+	rgBarrier barrier = {r, 0, (*info).stage, 0, (*info).access, (*state).layout, isImage ? (*info).layout : VK_IMAGE_LAYOUT_UNDEFINED};
+
+	if ((*info).write || layoutChange)
+	{
+		barrier.srcStage = (*state).writeStage | (*state).readStages;
+		barrier.srcAccess = (*state).writeAccess;
+		if (barrier.srcStage != 0 || layoutChange) pushBarrier(graph, batch, barrier, emit);
+
+		if ((*info).write)
+		{
+			(*state).writeStage = (*info).stage;
+			(*state).writeAccess = (*info).access;
+			(*state).readStages = 0;
+			(*state).readAccess = 0;
+		} else
+		{
+			(*state).writeStage = 0;
+			(*state).writeAccess = 0;
+			(*state).readStages = (*info).stage;
+			(*state).readAccess = (*info).access;
+		}
+		(*state).layout = barrier.newLayout;
+		return;
+	}
+
+	// Read after read in the same layout needs nothing; read after write only once per stage.
+	if ((*state).writeAccess != 0 && (((*info).stage & ~(*state).readStages) || ((*info).access & ~(*state).readAccess)))
+	{
+		barrier.srcStage = (*state).writeStage;
+		barrier.srcAccess = (*state).writeAccess;
+		pushBarrier(graph, batch, barrier, emit);
+	}
+
+	(*state).readStages |= (*info).stage;
+	(*state).readAccess |= (*info).access;
+}
+
+static void buildBarriers(renderGraph *graph, bool emit)
+{
+	(*graph).barrierCount = 0;
+
+	for (uint32_t i = 0; i < (*graph).resourceCount; i++)
+	{
+		rgResourceNode *resource = &(*graph).resources[i];
+		(*resource).touched = false;
+		(*resource).state = (rgState){(*resource).initial.stage, 0, (*resource).initial.access, 0, (*resource).initial.layout};
+	}
+
+	for (uint32_t o = 0; o < (*graph).orderCount; o++)
+	{
+		rgPassNode *pass = &(*graph).passes[(*graph).order[o]];
+		memset(&(*pass).barriers, 0, sizeof(rgBarrierBatch));
+		(*pass).barriers.first = (*graph).barrierCount;
+
+		for (uint32_t u = 0; u < (*pass).useCount; u++)
+			accessResource(graph, &(*pass).barriers, (*pass).uses[u].resource, &accessInfos[(*pass).uses[u].access], emit);
+	}
+
+	rgBarrierBatch *final = &(*graph).finalBarriers;
+	memset(final, 0, sizeof(rgBarrierBatch));
+	(*final).first = (*graph).barrierCount;
+
+	for (uint32_t i = 0; i < (*graph).resourceCount; i++)
+	{
+		rgResourceNode *resource = &(*graph).resources[i];
+		(*resource).finalState = (*resource).state;
+		if ((*resource).kind != RG_IMAGE_IMPORTED) continue;
+
+		rgState *state = &(*resource).state;
+		VkImageLayout finalLayout = (*resource).final.layout != VK_IMAGE_LAYOUT_UNDEFINED ? (*resource).final.layout : (*state).layout;
+		if (finalLayout == (*state).layout && (*state).writeAccess == 0) continue;
+
+		rgBarrier barrier = {i, (*state).writeStage | (*state).readStages, (*resource).final.stage, (*state).writeAccess, (*resource).final.access, (*state).layout, finalLayout};
+		pushBarrier(graph, final, barrier, emit);
+	}
+}
+
+VkResult rgCompile(renderGraph *graph, VkExtent2D extent)
+{
+	retireTransients(graph);
+	memset(&(*graph).stats, 0, sizeof(rgStats));
+	(*graph).extent = extent;
+
+	cullPasses(graph);
+
+	VkResult res = createTransients(graph);
+	if (res == VK_SUCCESS) res = aliasTransients(graph);
+	if (res != VK_SUCCESS)
+	{
+		printf("render graph compile failed (%d)\n", res);
+		return res;
+	}
+
+	// The dry run settles every transient's end-of-frame state, which the first
+	// occupant of each alias slot starts from on the next frame.
+	buildBarriers(graph, false);
+	buildBarriers(graph, true);
+
+	(*graph).stats.passCount = (*graph).passCount;
+	(*graph).stats.culledPassCount = (*graph).passCount - (*graph).orderCount;
+	(*graph).stats.imageBarrierCount = (*graph).barrierCount;
+
+	for (uint32_t o = 0; o <= (*graph).orderCount; o++)
+	{
+		rgBarrierBatch *batch = o < (*graph).orderCount ? &(*graph).passes[(*graph).order[o]].barriers : &(*graph).finalBarriers;
+		if ((*batch).memory.sType != 0) (*graph).stats.memoryBarrierCount++;
+		if ((*batch).count != 0 || (*batch).memory.sType != 0) (*graph).stats.barrierBatchCount++;
+	}
+
+	return VK_SUCCESS;
+}
+
+static void recordBatch(renderGraph *graph, VkCommandBuffer commandBuffer, const rgBarrierBatch *batch)
+{
+	bool hasMemory = (*batch).memory.sType != 0;
+	if ((*batch).count == 0 && !hasMemory) return;
+
+	if ((*batch).count > (*graph).scratchCapacity)
+	{
+		(*graph).scratchCapacity = (*batch).count;
+		(*graph).scratch = realloc((*graph).scratch, (*graph).scratchCapacity * sizeof(VkImageMemoryBarrier2KHR));
+		(*graph).legacyScratch = realloc((*graph).legacyScratch, (*graph).scratchCapacity * sizeof(VkImageMemoryBarrier));
+	}
+
+	VkPipelineStageFlags srcStages = (VkPipelineStageFlags)(*batch).memory.srcStageMask;
+	VkPipelineStageFlags dstStages = (VkPipelineStageFlags)(*batch).memory.dstStageMask;
+
+	for (uint32_t i = 0; i < (*batch).count; i++)
+	{
+		const rgBarrier *barrier = &(*graph).barriers[(*batch).first + i];
+		const rgResourceNode *resource = &(*graph).resources[(*barrier).resource];
+		VkImageSubresourceRange range = {(*resource).desc.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+
+		VkImageMemoryBarrier2KHR *image = &(*graph).scratch[i];
+		memset(image, 0, sizeof(VkImageMemoryBarrier2KHR));
+		(*image).sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+		(*image).srcStageMask = (*barrier).srcStage;
+		(*image).srcAccessMask = (*barrier).srcAccess;
+		(*image).dstStageMask = (*barrier).dstStage;
+		(*image).dstAccessMask = (*barrier).dstAccess;
+		(*image).oldLayout = (*barrier).oldLayout;
+		(*image).newLayout = (*barrier).newLayout;
+		(*image).srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		(*image).dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		(*image).image = (*resource).image;
+		(*image).subresourceRange = range;
+
+		VkImageMemoryBarrier *legacy = &(*graph).legacyScratch[i];
+		memset(legacy, 0, sizeof(VkImageMemoryBarrier));
+		(*legacy).sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		(*legacy).srcAccessMask = (VkAccessFlags)(*barrier).srcAccess;
+		(*legacy).dstAccessMask = (VkAccessFlags)(*barrier).dstAccess;
+		(*legacy).oldLayout = (*barrier).oldLayout;
+		(*legacy).newLayout = (*barrier).newLayout;
+		(*legacy).srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		(*legacy).dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		(*legacy).image = (*resource).image;
+		(*legacy).subresourceRange = range;
+
+		srcStages |= (VkPipelineStageFlags)(*barrier).srcStage;
+		dstStages |= (VkPipelineStageFlags)(*barrier).dstStage;
+	}
+
+	if ((*graph).synchronization2)
+	{
+		VkDependencyInfoKHR dependency = {0};
+		dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+		dependency.memoryBarrierCount = hasMemory ? 1 : 0;
+		dependency.pMemoryBarriers = &(*batch).memory;
+		dependency.imageMemoryBarrierCount = (*batch).count;
+		dependency.pImageMemoryBarriers = (*graph).scratch;
+
+		(*graph).cmdPipelineBarrier2(commandBuffer, &dependency);
+		return;
+	}
+
+	VkMemoryBarrier memory = {0};
+	memory.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memory.srcAccessMask = (VkAccessFlags)(*batch).memory.srcAccessMask;
+	memory.dstAccessMask = (VkAccessFlags)(*batch).memory.dstAccessMask;
+
+	if (srcStages == 0) srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	if (dstStages == 0) dstStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, hasMemory ? 1 : 0, &memory, 0, NULL, (*batch).count, (*graph).legacyScratch);
+}
+
+void rgExecute(renderGraph *graph, VkCommandBuffer commandBuffer)
+{
+	freeRetired(graph, false);
+
+	for (uint32_t o = 0; o < (*graph).orderCount; o++)
+	{
+		rgPassNode *pass = &(*graph).passes[(*graph).order[o]];
+
+		recordBatch(graph, commandBuffer, &(*pass).barriers);
+		if ((*pass).execute != NULL) (*pass).execute(commandBuffer, graph, (*pass).userData);
+	}
+
+	recordBatch(graph, commandBuffer, &(*graph).finalBarriers);
+	(*graph).frameIndex++;
+}
+
+VkImage rgGetImage(renderGraph *graph, rgResource resource)
+{
+	return (*graph).resources[resource].image;
+}
+
+VkImageView rgGetImageView(renderGraph *graph, rgResource resource)
+{
+	return (*graph).resources[resource].view;
+}
+
+VkBuffer rgGetBuffer(renderGraph *graph, rgResource resource)
+{
+	return (*graph).resources[resource].buffer;
+}
+
+rgStats rgGetStats(renderGraph *graph)
+{
+	return (*graph).stats;
+}
@@ -0,0 +1,105 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "gpuAllocator.h"
+
+// Frame graph: passes declare which resources they read and write, rgCompile()
+// culls passes nothing depends on, derives the barriers between the survivors and
+// places transient images with disjoint lifetimes in the same memory. The graph is
+// declared once and recompiled when the backbuffer extent changes; per frame only
+// the imported handles are swapped in before rgExecute().
+
+#define RG_RESOURCE_NONE UINT32_MAX
+
+typedef uint32_t rgResource;
+typedef uint32_t rgPass;
+typedef struct renderGraph renderGraph;
+
+typedef enum rgAccess
+{
+	RG_ACCESS_COLOR_ATTACHMENT_WRITE,
+	RG_ACCESS_DEPTH_ATTACHMENT_WRITE,
+	RG_ACCESS_DEPTH_ATTACHMENT_READ,
+	RG_ACCESS_FRAGMENT_SAMPLED_READ,
+	RG_ACCESS_COMPUTE_SAMPLED_READ,
+	RG_ACCESS_COMPUTE_STORAGE_READ,
+	RG_ACCESS_COMPUTE_STORAGE_WRITE,
+	RG_ACCESS_TRANSFER_READ,
+	RG_ACCESS_TRANSFER_WRITE,
+	RG_ACCESS_VERTEX_BUFFER_READ,
+	RG_ACCESS_INDEX_BUFFER_READ,
+	RG_ACCESS_INDIRECT_READ,
+	RG_ACCESS_UNIFORM_READ,
+	RG_ACCESS_COUNT
+} rgAccess;
+
+typedef void (*rgPassCallback)(VkCommandBuffer commandBuffer, renderGraph *graph, void *userData);
+
+typedef struct renderGraphCreateInfo
+{
+	VkDevice device;
+	gpuAllocator *allocator;
+	bool synchronization2;               // vkCmdPipelineBarrier2KHR, otherwise translated to vkCmdPipelineBarrier
+	uint32_t framesInFlight;             // how long replaced transients are kept alive
+} renderGraphCreateInfo;
+
+typedef struct rgImageDesc
+{
+	VkFormat format;
+	VkExtent2D extent;                   // 0x0 follows the extent passed to rgCompile()
+	VkImageAspectFlags aspect;
+	uint32_t mipLevels;
+	uint32_t arrayLayers;
+	VkSampleCountFlagBits samples;
+} rgImageDesc;
+
+// State of an imported image when the frame starts and the state it has to be
+// left in, e.g. UNDEFINED after the acquire wait and PRESENT_SRC at the end.
+typedef struct rgImportState
+{
+	VkImageLayout layout;
+	VkPipelineStageFlags2KHR stage;
+	VkAccessFlags2KHR access;
+} rgImportState;
+
+typedef struct rgStats
+{
+	uint32_t passCount;
+	uint32_t culledPassCount;
+	uint32_t barrierBatchCount;
+	uint32_t imageBarrierCount;
+	uint32_t memoryBarrierCount;
+	uint32_t transientCount;
+	uint32_t aliasSlotCount;
+	VkDeviceSize transientBytes;         // what the transients would need without aliasing
+	VkDeviceSize allocatedBytes;
+} rgStats;
+
+renderGraph *renderGraphCreate(const renderGraphCreateInfo *createInfo);
+void renderGraphDestroy(renderGraph *graph);
+
+rgResource rgCreateImage(renderGraph *graph, const char *name, const rgImageDesc *desc);
+rgResource rgImportImage(renderGraph *graph, const char *name, VkImageAspectFlags aspect, rgImportState initial, rgImportState final);
+rgResource rgImportBuffer(renderGraph *graph, const char *name);
+
+void rgSetImportedImage(renderGraph *graph, rgResource resource, VkImage image, VkImageView view);
+void rgSetImportedBuffer(renderGraph *graph, rgResource resource, VkBuffer buffer);
+
+rgPass rgAddPass(renderGraph *graph, const char *name, rgPassCallback execute, void *userData);
+void rgPassUse(renderGraph *graph, rgPass pass, rgResource resource, rgAccess access);
+void rgPassSideEffect(renderGraph *graph, rgPass pass);
+
+VkResult rgCompile(renderGraph *graph, VkExtent2D extent);
+void rgExecute(renderGraph *graph, VkCommandBuffer commandBuffer);
+
+VkImage rgGetImage(renderGraph *graph, rgResource resource);
+VkImageView rgGetImageView(renderGraph *graph, rgResource resource);
+VkBuffer rgGetBuffer(renderGraph *graph, rgResource resource);
+rgStats rgGetStats(renderGraph *graph);
+
+#endif
@@ -0,0 +1,14 @@
+#version 450
+
+layout(set = 0, binding = 0) uniform sampler2DArray spriteTexture;
+
+layout(location = 0) in vec2 inUV;
+layout(location = 1) in vec4 inColor;
+layout(location = 2) flat in uint inPage;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+	outColor = texture(spriteTexture, vec3(inUV, float(inPage))) * inColor;
+}
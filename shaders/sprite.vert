@@ -0,0 +1,36 @@
+#version 450
+
+// One instance per sprite; the quad corners come from gl_VertexIndex (4-vertex strip).
+layout(location = 0) in vec4 inRect;      // center xy, size zw
+layout(location = 1) in vec4 inUV;        // u0 v0 u1 v1
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in float inRotation;
+layout(location = 4) in uint inPage;
+layout(location = 5) in uint inTexture;
+
+layout(push_constant) uniform Push
+{
+	vec2 scale;                           // 2 / viewport size
+	vec2 camera;
+} push;
+
+layout(location = 0) out vec2 outUV;
+layout(location = 1) out vec4 outColor;
+layout(location = 2) flat out uint outPage;
+layout(location = 3) flat out uint outTexture;
+
+void main()
+{
+	vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+	vec2 local = (corner - 0.5) * inRect.zw;
+
+	float s = sin(inRotation);
+	float c = cos(inRotation);
+	vec2 world = inRect.xy + vec2(c * local.x - s * local.y, s * local.x + c * local.y) - push.camera;
+
+	gl_Position = vec4(world * push.scale - 1.0, 0.0, 1.0);
+	outUV = mix(inUV.xy, inUV.zw, corner);
+	outColor = inColor;
+	outPage = inPage;
+	outTexture = inTexture;
+}
@@ -0,0 +1,18 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Every texture of the bindless table; the instance picks one, so sprites with
+// different textures share a draw.
+layout(set = 0, binding = 0) uniform sampler2DArray textures[];
+
+layout(location = 0) in vec2 inUV;
+layout(location = 1) in vec4 inColor;
+layout(location = 2) flat in uint inPage;
+layout(location = 3) flat in uint inTexture;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+	outColor = texture(textures[nonuniformEXT(inTexture)], vec3(inUV, float(inPage))) * inColor;
+}
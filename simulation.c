@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include <time.h>
+
+#include "simulation.h"
+
+#define SNAPSHOT_FRESH 4u                // set in ready when the writer published since the last acquire
+
+struct simulation
+{
+	double step;
+	uint32_t maxCatchUpTicks;
+	bool lockstep;
+	simTickCallback tick;
+	void *userData;
+
+	// Triple buffer: the writer owns write, the reader owns read and they trade
+	// through ready, which also carries the fresh flag.
+	simSnapshot snapshots[3];
+	void *data;
+	uint32_t write, read;
+	atomic_uint ready;
+	bool acquired;
+
+	uint64_t nextTick;
+	double nextTime;
+	atomic_ullong tickCount, droppedTicks;
+
+	thrd_t thread;
+	atomic_bool quit;
+};
+
+static double clockSeconds(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void runTick(simulation *sim)
+{
+	simSnapshot *snapshot = &(*sim).snapshots[(*sim).write];
+	(*sim).tick((*sim).userData, (void *)(*snapshot).data, (*sim).nextTick, (*sim).step);
+	(*snapshot).tick = (*sim).nextTick++;
+	(*snapshot).time = (*sim).nextTime;
+	(*sim).nextTime += (*sim).step;
+
+	(*sim).write = atomic_exchange_explicit(&(*sim).ready, (*sim).write | SNAPSHOT_FRESH, memory_order_acq_rel) & 3;
+	atomic_fetch_add_explicit(&(*sim).tickCount, 1, memory_order_relaxed);
+}
+
+static int simulationMain(void *argument)
+{
+	simulation *sim = argument;
+	(*sim).nextTime = clockSeconds();
+
+	while (!atomic_load(&(*sim).quit))
+	{
+		double now = clockSeconds();
+		if (now < (*sim).nextTime)
+		{
+			double wait = (*sim).nextTime - now;
+			struct timespec duration = {(time_t)wait, (long)((wait - (double)(time_t)wait) * 1e9)};
+			thrd_sleep(&duration, NULL);
+			continue;
+		}
+
+		// After a long stall (debugger, suspended laptop) give up on the lost time
+		// instead of running a burst of ticks.
+		uint64_t behind = (uint64_t)((now - (*sim).nextTime) / (*sim).step);
+		if (behind > (*sim).maxCatchUpTicks)
+		{
+			atomic_fetch_add_explicit(&(*sim).droppedTicks, behind, memory_order_relaxed);
+			(*sim).nextTime += (double)behind * (*sim).step;
+		}
+
+		runTick(sim);
+	}
+
+	return 0;
+}
+
+simulation *simulationCreate(const simulationCreateInfo *createInfo)
+{
+	simulation *sim = calloc(1, sizeof(simulation));
+	(*sim).step = 1.0 / (*createInfo).tickRate;
+	(*sim).maxCatchUpTicks = (*createInfo).maxCatchUpTicks ? (*createInfo).maxCatchUpTicks : 5;
+	(*sim).lockstep = (*createInfo).lockstep;
+	(*sim).tick = (*createInfo).tick;
+	(*sim).userData = (*createInfo).userData;
+
+	size_t size = (*createInfo).snapshotSize ? (*createInfo).snapshotSize : 1;
+	(*sim).data = calloc(3, size);
+	for (uint32_t i = 0; i < 3; i++) (*sim).snapshots[i].data = (char *)(*sim).data + i * size;
+
+	(*sim).write = 0;
+	atomic_init(&(*sim).ready, 1);
+	(*sim).read = 2;
+
+	if (!(*sim).lockstep && thrd_create(&(*sim).thread, simulationMain, sim) != thrd_success)
+	{
+		printf("failed to start the simulation thread\n");
+		free((*sim).data);
+		free(sim);
+		return NULL;
+	}
+
+	return sim;
+}
+
+void simulationDestroy(simulation *sim)
+{
+	if (sim == NULL) return;
+
+	if (!(*sim).lockstep)
+	{
+		atomic_store(&(*sim).quit, true);
+		thrd_join((*sim).thread, NULL);
+	}
+
+	free((*sim).data);
+	free(sim);
+}
+
+void simulationAdvance(simulation *sim)
+{
+	if ((*sim).lockstep) runTick(sim);
+}
+
+const simSnapshot *simulationAcquire(simulation *sim)
+{
+	if (atomic_load_explicit(&(*sim).ready, memory_order_relaxed) & SNAPSHOT_FRESH)
+	{
+		(*sim).read = atomic_exchange_explicit(&(*sim).ready, (*sim).read, memory_order_acq_rel) & 3;
+		(*sim).acquired = true;
+	}
+
+	return (*sim).acquired ? &(*sim).snapshots[(*sim).read] : NULL;
+}
+
+float simulationAlpha(simulation *sim, const simSnapshot *snapshot, double now)
+{
+	if ((*sim).lockstep) return 1.0f;
+
+	// The renderer runs one tick behind, so the snapshot's tick is reached at
+	// snapshot time + step and the previous state at snapshot time.
+	double alpha = (now - (*snapshot).time) / (*sim).step;
+	return alpha < 0.0 ? 0.0f : alpha > 1.0 ? 1.0f : (float)alpha;
+}
+
+simulationStats simulationGetStats(simulation *sim)
+{
+	simulationStats stats = {0};
+	stats.tickCount = atomic_load_explicit(&(*sim).tickCount, memory_order_relaxed);
+	stats.droppedTicks = atomic_load_explicit(&(*sim).droppedTicks, memory_order_relaxed);
+	return stats;
+}
@@ -0,0 +1,65 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed timestep simulation on its own thread. Every tick the callback advances
+// the game state and writes an immutable snapshot of what the renderer needs;
+// snapshots are handed over through a lock-free triple buffer, so neither side
+// ever waits for the other: a slow frame does not slow the simulation down and a
+// slow tick does not hold up present. The renderer draws the newest snapshot,
+// interpolated by simulationAlpha, which puts it at most one tick behind.
+// In lockstep mode there is no thread and the caller advances one tick at a time,
+// which keeps runs reproducible.
+
+typedef struct simulation simulation;
+
+// Advances one tick of step seconds and fills in snapshot (snapshotSize bytes).
+// Runs on the simulation thread, which may use the job system.
+typedef void (*simTickCallback)(void *userData, void *snapshot, uint64_t tick, double step);
+
+typedef struct simulationCreateInfo
+{
+	double tickRate;                     // ticks per second
+	size_t snapshotSize;
+	simTickCallback tick;
+	void *userData;
+	uint32_t maxCatchUpTicks;            // ticks run back to back after a stall before time is dropped, 0 for 5
+	bool lockstep;
+} simulationCreateInfo;
+
+typedef struct simSnapshot
+{
+	uint64_t tick;
+	double time;                         // when the tick was due, seconds on the timespec_get(TIME_UTC) clock
+	const void *data;
+} simSnapshot;
+
+typedef struct simulationStats
+{
+	uint64_t tickCount;
+	uint64_t droppedTicks;               // skipped to catch up after stalls
+} simulationStats;
+
+// Starts the thread unless lockstep.
+simulation *simulationCreate(const simulationCreateInfo *createInfo);
+
+// Stops and joins the thread.
+void simulationDestroy(simulation *sim);
+
+// Lockstep only: runs one tick on the calling thread and publishes it.
+void simulationAdvance(simulation *sim);
+
+// The newest published snapshot, NULL before the first tick. It stays valid and
+// unchanged until the next call. Render thread only.
+const simSnapshot *simulationAcquire(simulation *sim);
+
+// How far the renderer is between the snapshot's previous and current state,
+// 0 to 1. Always 1 in lockstep.
+float simulationAlpha(simulation *sim, const simSnapshot *snapshot, double now);
+
+simulationStats simulationGetStats(simulation *sim);
+
+#endif
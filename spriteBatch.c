@@ -0,0 +1,536 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "spriteBatch.h"
+
+#define SPRITE_MAX_MATERIALS 65536
+#define SPRITE_PIPELINE_FLAT 0
+#define SPRITE_PIPELINE_TEXTURED 1
+
+typedef struct spriteMaterialInfo
+{
+	uint32_t texture;
+	VkDescriptorSet set;                 // classic mode only
+} spriteMaterialInfo;
+
+// One instanced draw of the prepared frame.
+typedef struct spriteDraw
+{
+	uint32_t first, count;
+	uint32_t pipeline;
+	VkDescriptorSet set;
+} spriteDraw;
+
+typedef struct spritePush
+{
+	float scaleX, scaleY;
+	float cameraX, cameraY;
+} spritePush;
+
+struct spriteBatch
+{
+	VkDevice device;
+	gpuAllocator *allocator;
+	uint32_t framesInFlight;
+	uint32_t maxSprites;
+
+	bindlessTable *textures;
+	bool bindless;
+	uploadRing *uploads;
+
+	VkShaderModule vertexShader;
+	VkShaderModule fragmentShaders[2];
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipelines[2];
+
+	spriteMaterialInfo *materials;
+	uint32_t materialCount, materialCapacity;
+
+	// Per frame slot maxSprites instances, written once per frame from staged.
+	VkBuffer instanceBuffer;
+	gpuAllocation instanceMemory;
+	spriteInstance *staged;
+
+	// CPU side of the frame, keys are (layer << 16) | material.
+	spriteInstance *instances;
+	uint32_t *keys, *order;
+	uint32_t *scratchKeys, *scratchOrder;
+	uint32_t count;
+	uint32_t lastKey;
+	bool sorted;
+
+	spriteDraw *draws;
+	uint32_t drawCount, drawCapacity;
+
+	spriteBatchStats stats;
+};
+
+static VkShaderModule loadShader(VkDevice device, const char *dir, const char *name)
+{
+	char path[512];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+	FILE *file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		printf("sprite shader %s not found, compile shaders/ with glslc first\n", path);
+		return VK_NULL_HANDLE;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	uint32_t *code = malloc(size > 0 ? (size_t)size : 4);
+	size_t read = size > 0 ? fread(code, 1, (size_t)size, file) : 0;
+	fclose(file);
+
+	VkShaderModule module = VK_NULL_HANDLE;
+	if (size > 0 && read == (size_t)size && size % 4 == 0)
+	{
+		VkShaderModuleCreateInfo moduleInfo = {0};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = (size_t)size;
+		moduleInfo.pCode = code;
+
+		VkResult res = vkCreateShaderModule(device, &moduleInfo, NULL, &module);
+		if (res != VK_SUCCESS) printf("vkCreateShaderModule() for %s failed (%d)\n", path, res);
+	} else
+	{
+		printf("sprite shader %s is not valid SPIR-V\n", path);
+	}
+
+	free(code);
+	return module;
+}
+
+static VkResult createPipelines(spriteBatch *batch, VkRenderPass renderPass, VkPipeline pipelines[2])
+{
+	VkVertexInputBindingDescription binding = {0};
+	binding.binding = 0;
+	binding.stride = sizeof(spriteInstance);
+	binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	VkVertexInputAttributeDescription attributes[6] = {
+		{0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(spriteInstance, x)},
+		{1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(spriteInstance, u0)},
+		{2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(spriteInstance, color)},
+		{3, 0, VK_FORMAT_R32_SFLOAT, offsetof(spriteInstance, rotation)},
+		{4, 0, VK_FORMAT_R32_UINT, offsetof(spriteInstance, page)},
+		{5, 0, VK_FORMAT_R32_UINT, offsetof(spriteInstance, texture)}
+	};
+
+	VkPipelineVertexInputStateCreateInfo vertexInput = {0};
+	vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInput.vertexBindingDescriptionCount = 1;
+	vertexInput.pVertexBindingDescriptions = &binding;
+	vertexInput.vertexAttributeDescriptionCount = 6;
+	vertexInput.pVertexAttributeDescriptions = attributes;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {0};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+
+	VkPipelineViewportStateCreateInfo viewportState = {0};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer = {0};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.cullMode = VK_CULL_MODE_NONE;
+	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizer.lineWidth = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {0};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState blend = {0};
+	blend.blendEnable = VK_TRUE;
+	blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	blend.colorBlendOp = VK_BLEND_OP_ADD;
+	blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	blend.alphaBlendOp = VK_BLEND_OP_ADD;
+	blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending = {0};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &blend;
+
+	// Viewport and scissor are dynamic so a resize only needs new pipelines when the format changes.
+	VkDynamicState dynamicStates[2] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+	VkPipelineDynamicStateCreateInfo dynamicState = {0};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkPipelineShaderStageCreateInfo stages[2][2] = {0};
+	VkGraphicsPipelineCreateInfo pipelineInfos[2] = {0};
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		stages[i][0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stages[i][0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		stages[i][0].module = (*batch).vertexShader;
+		stages[i][0].pName = "main";
+		stages[i][1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stages[i][1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		stages[i][1].module = (*batch).fragmentShaders[i];
+		stages[i][1].pName = "main";
+
+		pipelineInfos[i].sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfos[i].stageCount = 2;
+		pipelineInfos[i].pStages = stages[i];
+		pipelineInfos[i].pVertexInputState = &vertexInput;
+		pipelineInfos[i].pInputAssemblyState = &inputAssembly;
+		pipelineInfos[i].pViewportState = &viewportState;
+		pipelineInfos[i].pRasterizationState = &rasterizer;
+		pipelineInfos[i].pMultisampleState = &multisampling;
+		pipelineInfos[i].pColorBlendState = &colorBlending;
+		pipelineInfos[i].pDynamicState = &dynamicState;
+		pipelineInfos[i].layout = (*batch).pipelineLayout;
+		pipelineInfos[i].renderPass = renderPass;
+		pipelineInfos[i].subpass = 0;
+		pipelineInfos[i].basePipelineIndex = -1;
+	}
+
+	VkResult res = vkCreateGraphicsPipelines((*batch).device, VK_NULL_HANDLE, 2, pipelineInfos, NULL, pipelines);
+	if (res != VK_SUCCESS) printf("vkCreateGraphicsPipelines() for sprites failed (%d)\n", res);
+	return res;
+}
+
+spriteBatch *spriteBatchCreate(const spriteBatchCreateInfo *createInfo)
+{
+	spriteBatch *batch = calloc(1, sizeof(spriteBatch));
+	(*batch).device = (*createInfo).device;
+	(*batch).allocator = (*createInfo).allocator;
+	(*batch).framesInFlight = (*createInfo).framesInFlight;
+	(*batch).maxSprites = (*createInfo).maxSprites;
+	(*batch).textures = (*createInfo).textures;
+	(*batch).bindless = bindlessIsBindless((*batch).textures);
+	(*batch).uploads = (*createInfo).uploads;
+
+	(*batch).materialCapacity = 16;
+	(*batch).materials = malloc((*batch).materialCapacity * sizeof(spriteMaterialInfo));
+	(*batch).materials[SPRITE_MATERIAL_FLAT] = (spriteMaterialInfo){BINDLESS_INVALID, VK_NULL_HANDLE};
+	(*batch).materialCount = 1;
+
+	uint32_t n = (*batch).maxSprites;
+	(*batch).instances = malloc(n * sizeof(spriteInstance));
+	(*batch).keys = malloc(n * sizeof(uint32_t));
+	(*batch).order = malloc(n * sizeof(uint32_t));
+	(*batch).scratchKeys = malloc(n * sizeof(uint32_t));
+	(*batch).scratchOrder = malloc(n * sizeof(uint32_t));
+	(*batch).sorted = true;
+
+	(*batch).vertexShader = loadShader((*batch).device, (*createInfo).shaderDir, "sprite.vert.spv");
+	(*batch).fragmentShaders[SPRITE_PIPELINE_FLAT] = loadShader((*batch).device, (*createInfo).shaderDir, "sprite_flat.frag.spv");
+	(*batch).fragmentShaders[SPRITE_PIPELINE_TEXTURED] = loadShader((*batch).device, (*createInfo).shaderDir, (*batch).bindless ? "sprite_bindless.frag.spv" : "sprite.frag.spv");
+
+	VkResult res = VK_SUCCESS;
+	if ((*batch).vertexShader == VK_NULL_HANDLE || (*batch).fragmentShaders[0] == VK_NULL_HANDLE || (*batch).fragmentShaders[1] == VK_NULL_HANDLE)
+		res = VK_ERROR_INITIALIZATION_FAILED;
+
+	if (res == VK_SUCCESS)
+	{
+		VkDescriptorSetLayout textureLayout = bindlessSetLayout((*batch).textures);
+
+		VkPushConstantRange pushRange = {0};
+		pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushRange.size = sizeof(spritePush);
+
+		// The flat pipeline shares the layout; it simply never reads set 0.
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {0};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &textureLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+		res = vkCreatePipelineLayout((*batch).device, &pipelineLayoutInfo, NULL, &(*batch).pipelineLayout);
+	}
+
+	if (res == VK_SUCCESS) res = createPipelines(batch, (*createInfo).renderPass, (*batch).pipelines);
+
+	if (res == VK_SUCCESS)
+	{
+		VkBufferCreateInfo bufferInfo = {0};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = (VkDeviceSize)(*batch).framesInFlight * (*batch).maxSprites * sizeof(spriteInstance);
+		bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		gpuAllocationCreateInfo allocInfo = {0};
+		allocInfo.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+		res = gpuCreateBuffer((*batch).allocator, &bufferInfo, &allocInfo, &(*batch).instanceBuffer, &(*batch).instanceMemory);
+	}
+
+	if (res != VK_SUCCESS)
+	{
+		printf("failed to create sprite batch (%d)\n", res);
+		spriteBatchDestroy(batch);
+		return NULL;
+	}
+
+	return batch;
+}
+
+// The device must be idle.
+void spriteBatchDestroy(spriteBatch *batch)
+{
+	if (batch == NULL) return;
+
+	if ((*batch).instanceBuffer != VK_NULL_HANDLE) gpuDestroyBuffer((*batch).allocator, (*batch).instanceBuffer, &(*batch).instanceMemory);
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		vkDestroyPipeline((*batch).device, (*batch).pipelines[i], NULL);
+		vkDestroyShaderModule((*batch).device, (*batch).fragmentShaders[i], NULL);
+	}
+	vkDestroyShaderModule((*batch).device, (*batch).vertexShader, NULL);
+	vkDestroyPipelineLayout((*batch).device, (*batch).pipelineLayout, NULL);
+
+	free((*batch).materials);
+	free((*batch).instances);
+	free((*batch).keys);
+	free((*batch).order);
+	free((*batch).scratchKeys);
+	free((*batch).scratchOrder);
+	free((*batch).draws);
+	free(batch);
+}
+
+spriteMaterial spriteBatchAddMaterial(spriteBatch *batch, uint32_t texture)
+{
+	if ((*batch).materialCount == SPRITE_MAX_MATERIALS)
+	{
+		printf("sprite batch is out of materials\n");
+		return SPRITE_MATERIAL_FLAT;
+	}
+
+	if ((*batch).materialCount == (*batch).materialCapacity)
+	{
+		(*batch).materialCapacity *= 2;
+		(*batch).materials = realloc((*batch).materials, (*batch).materialCapacity * sizeof(spriteMaterialInfo));
+	}
+
+	(*batch).materials[(*batch).materialCount] = (spriteMaterialInfo){texture, bindlessTextureSet((*batch).textures, texture)};
+	return (spriteMaterial)(*batch).materialCount++;
+}
+
+VkResult spriteBatchRebuildPipelines(spriteBatch *batch, VkRenderPass renderPass, VkPipeline retired[2])
+{
+	VkPipeline pipelines[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+
+	VkResult res = createPipelines(batch, renderPass, pipelines);
+	if (res != VK_SUCCESS)
+	{
+		retired[0] = retired[1] = VK_NULL_HANDLE;
+		return res;
+	}
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		retired[i] = (*batch).pipelines[i];
+		(*batch).pipelines[i] = pipelines[i];
+	}
+	return VK_SUCCESS;
+}
+
+void spriteBatchBegin(spriteBatch *batch)
+{
+	(*batch).count = 0;
+	(*batch).lastKey = 0;
+	(*batch).sorted = true;
+	(*batch).stats.droppedCount = 0;
+}
+
+spriteInstance *spriteBatchAdd(spriteBatch *batch, spriteMaterial material, uint16_t layer)
+{
+	if ((*batch).count == (*batch).maxSprites)
+	{
+		(*batch).stats.droppedCount++;
+		return NULL;
+	}
+
+	uint32_t key = (uint32_t)layer << 16 | material;
+	if (key < (*batch).lastKey) (*batch).sorted = false;
+	(*batch).lastKey = key;
+
+	uint32_t index = (*batch).count++;
+	(*batch).keys[index] = key;
+	return &(*batch).instances[index];
+}
+
+// Stable LSD radix sort of (key, index) pairs, one byte per pass. Bytes that are
+// the same for every key are skipped, so a scene with a handful of layers and
+// materials usually costs two passes.
+static void sortSprites(spriteBatch *batch)
+{
+	uint32_t n = (*batch).count;
+	uint32_t *keys = (*batch).keys, *order = (*batch).order;
+	uint32_t *tmpKeys = (*batch).scratchKeys, *tmpOrder = (*batch).scratchOrder;
+
+	for (uint32_t i = 0; i < n; i++) order[i] = i;
+
+	for (uint32_t shift = 0; shift < 32; shift += 8)
+	{
+		uint32_t histogram[256] = {0};
+		for (uint32_t i = 0; i < n; i++) histogram[(keys[i] >> shift) & 0xFF]++;
+		if (histogram[(keys[0] >> shift) & 0xFF] == n) continue;
+
+		uint32_t sum = 0;
+		for (uint32_t b = 0; b < 256; b++)
+		{
+			uint32_t bucket = histogram[b];
+			histogram[b] = sum;
+			sum += bucket;
+		}
+
+		for (uint32_t i = 0; i < n; i++)
+		{
+			uint32_t dst = histogram[(keys[i] >> shift) & 0xFF]++;
+			tmpKeys[dst] = keys[i];
+			tmpOrder[dst] = order[i];
+		}
+
+		uint32_t *swap = keys; keys = tmpKeys; tmpKeys = swap;
+		swap = order; order = tmpOrder; tmpOrder = swap;
+	}
+
+	// Hand the buffers back with the sorted data in keys/order.
+	(*batch).keys = keys;
+	(*batch).order = order;
+	(*batch).scratchKeys = tmpKeys;
+	(*batch).scratchOrder = tmpOrder;
+}
+
+uint32_t spriteBatchPrepare(spriteBatch *batch, uint32_t frameSlot, uint32_t maxInstancesPerDraw, uploadTicket *ticket)
+{
+	uint32_t n = (*batch).count;
+	(*batch).drawCount = 0;
+	(*batch).stats.drawCount = 0;
+	(*batch).stats.instanceCount = 0;
+	(*batch).stats.materialCount = (*batch).materialCount;
+
+	*ticket = 0;
+	if (n == 0) return 0;
+
+	// Only this frame's instances are staged; the ring copies them into the slot.
+	VkDeviceSize slotOffset = (VkDeviceSize)frameSlot * (*batch).maxSprites * sizeof(spriteInstance);
+	(*batch).staged = uploadBuffer((*batch).uploads, (*batch).instanceBuffer, slotOffset, n * sizeof(spriteInstance),
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, ticket);
+	if ((*batch).staged == NULL)
+	{
+		(*batch).stats.droppedCount += n;
+		return 0;
+	}
+
+	(*batch).stats.instanceCount = n;
+
+	if (!(*batch).sorted) sortSprites(batch);
+	if (maxInstancesPerDraw == 0) maxInstancesPerDraw = UINT32_MAX;
+
+	const uint32_t *keys = (*batch).keys;
+
+	// Bindless: a run only ends where flat and textured sprites meet.
+	uint32_t runMask = (*batch).bindless ? 0 : 0xFFFF;
+
+	uint32_t first = 0;
+	while (first < n)
+	{
+		uint32_t material = keys[first] & 0xFFFF;
+		bool textured = material != SPRITE_MATERIAL_FLAT;
+		uint32_t last = first + 1;
+		while (last < n && last - first < maxInstancesPerDraw && ((keys[last] & 0xFFFF) != SPRITE_MATERIAL_FLAT) == textured
+			&& ((keys[last] ^ material) & runMask) == 0) last++;
+
+		if ((*batch).drawCount == (*batch).drawCapacity)
+		{
+			(*batch).drawCapacity = (*batch).drawCapacity ? 2 * (*batch).drawCapacity : 64;
+			(*batch).draws = realloc((*batch).draws, (*batch).drawCapacity * sizeof(spriteDraw));
+		}
+
+		spriteDraw *draw = &(*batch).draws[(*batch).drawCount++];
+		(*draw).first = first;
+		(*draw).count = last - first;
+		(*draw).pipeline = textured ? SPRITE_PIPELINE_TEXTURED : SPRITE_PIPELINE_FLAT;
+		(*draw).set = !textured ? VK_NULL_HANDLE : (*batch).bindless ? bindlessFrameSet((*batch).textures, frameSlot) : (*batch).materials[material].set;
+		first = last;
+	}
+
+	(*batch).stats.drawCount = (*batch).drawCount;
+	return (*batch).drawCount;
+}
+
+void spriteBatchRecordDraws(spriteBatch *batch, VkCommandBuffer commandBuffer, uint32_t frameSlot, VkExtent2D extent, float cameraX, float cameraY,
+	uint32_t firstDraw, uint32_t drawCount)
+{
+	if (drawCount == 0) return;
+
+	const spriteDraw *draws = (*batch).draws + firstDraw;
+	uint32_t begin = draws[0].first, end = draws[drawCount - 1].first + draws[drawCount - 1].count;
+
+	VkDeviceSize slotOffset = (VkDeviceSize)frameSlot * (*batch).maxSprites * sizeof(spriteInstance);
+	spriteInstance *dst = (*batch).staged;
+
+	// Write-combined memory: fill it front to back and never read it back. Only the
+	// bindless shader reads the texture index, so the classic path can copy as is.
+	if ((*batch).bindless)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			spriteInstance instance = (*batch).instances[(*batch).sorted ? i : (*batch).order[i]];
+			instance.texture = (*batch).materials[(*batch).keys[i] & 0xFFFF].texture;
+			dst[i] = instance;
+		}
+	} else if ((*batch).sorted)
+	{
+		memcpy(dst + begin, (*batch).instances + begin, (end - begin) * sizeof(spriteInstance));
+	} else
+	{
+		for (uint32_t i = begin; i < end; i++) dst[i] = (*batch).instances[(*batch).order[i]];
+	}
+
+	VkViewport viewport = {0.0f, 0.0f, (float)extent.width, (float)extent.height, 0.0f, 1.0f};
+	VkRect2D scissor = {{0, 0}, extent};
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	spritePush push = {2.0f / (float)extent.width, 2.0f / (float)extent.height, cameraX, cameraY};
+	vkCmdPushConstants(commandBuffer, (*batch).pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(spritePush), &push);
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &(*batch).instanceBuffer, &slotOffset);
+
+	uint32_t boundPipeline = UINT32_MAX;
+	VkDescriptorSet boundSet = VK_NULL_HANDLE;
+
+	for (uint32_t i = 0; i < drawCount; i++)
+	{
+		if (draws[i].pipeline != boundPipeline)
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, (*batch).pipelines[draws[i].pipeline]);
+			boundPipeline = draws[i].pipeline;
+		}
+
+		if (draws[i].set != VK_NULL_HANDLE && draws[i].set != boundSet)
+		{
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, (*batch).pipelineLayout, 0, 1, &draws[i].set, 0, NULL);
+			boundSet = draws[i].set;
+		}
+
+		vkCmdDraw(commandBuffer, 4, draws[i].count, 0, draws[i].first);
+	}
+}
+
+spriteBatchStats spriteBatchGetStats(spriteBatch *batch)
+{
+	return (*batch).stats;
+}
@@ -0,0 +1,91 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "gpuAllocator.h"
+#include "bindlessTable.h"
+#include "uploadRing.h"
+
+// Instanced sprite renderer. Sprites are collected on the CPU each frame, radix
+// sorted by (layer, material) and staged through the upload ring into the frame
+// slot's part of one device local instance buffer; every run of sprites sharing a pipeline
+// and descriptor set becomes a single 4-vertex instanced draw. With a bindless
+// texture table all textured sprites share one set, so only flat/textured changes
+// split draws; otherwise every material switch does. Shaders are loaded from SPIR-V
+// compiled from shaders/sprite.vert, sprite_flat.frag and sprite.frag or
+// sprite_bindless.frag.
+// Not thread safe apart from spriteBatchRecordDraws: drive it from the render thread.
+
+// Material 0 is untextured: the sprite is filled with its tint. Other materials
+// are textures of the bindless table.
+#define SPRITE_MATERIAL_FLAT 0
+
+typedef uint16_t spriteMaterial;
+typedef struct spriteBatch spriteBatch;
+
+// Matches the per-instance vertex input of sprite.vert, 48 bytes.
+typedef struct spriteInstance
+{
+	float x, y;                          // center, in pixels
+	float width, height;
+	float u0, v0, u1, v1;
+	uint32_t color;                      // RGBA8, R in the low byte
+	float rotation;                      // radians
+	uint32_t page;                       // array layer of the material's texture, e.g. atlasRegion.page
+	uint32_t texture;                    // filled in from the material when recorded
+} spriteInstance;
+
+typedef struct spriteBatchCreateInfo
+{
+	VkDevice device;
+	gpuAllocator *allocator;
+	VkRenderPass renderPass;
+	bindlessTable *textures;             // supplies set 0
+	uploadRing *uploads;                 // carries the instances
+	uint32_t framesInFlight;
+	uint32_t maxSprites;                 // per frame, extra sprites are dropped
+	const char *shaderDir;
+} spriteBatchCreateInfo;
+
+typedef struct spriteBatchStats
+{
+	uint32_t drawCount;
+	uint32_t instanceCount;
+	uint32_t droppedCount;
+	uint32_t materialCount;
+} spriteBatchStats;
+
+spriteBatch *spriteBatchCreate(const spriteBatchCreateInfo *createInfo);
+void spriteBatchDestroy(spriteBatch *batch);
+
+spriteMaterial spriteBatchAddMaterial(spriteBatch *batch, uint32_t texture);
+
+// For a recreated render pass. The two replaced pipelines are handed back so the
+// caller can retire them once frames using them have finished.
+VkResult spriteBatchRebuildPipelines(spriteBatch *batch, VkRenderPass renderPass, VkPipeline retired[2]);
+
+void spriteBatchBegin(spriteBatch *batch);
+
+// Returns the instance to fill in, or NULL once maxSprites is reached. Lower
+// layers are drawn first; within a layer the submission order is kept.
+spriteInstance *spriteBatchAdd(spriteBatch *batch, spriteMaterial material, uint16_t layer);
+
+// Prepare sorts and lists the draws, splitting runs longer than maxInstancesPerDraw
+// (0 never splits), reserves the instances in the upload ring and returns how many
+// draws there are. frameSlot selects the part of the instance buffer the frame
+// owns; the caller guarantees the GPU is done with it. The ticket must be acquired
+// before the render pass and the ring flushed once the draws are recorded; when
+// the ring is full the frame's sprites are dropped.
+// Each range of draws can then be recorded into its own secondary command buffer
+// concurrently; it also stages its own instances.
+uint32_t spriteBatchPrepare(spriteBatch *batch, uint32_t frameSlot, uint32_t maxInstancesPerDraw, uploadTicket *ticket);
+void spriteBatchRecordDraws(spriteBatch *batch, VkCommandBuffer commandBuffer, uint32_t frameSlot, VkExtent2D extent, float cameraX, float cameraY,
+	uint32_t firstDraw, uint32_t drawCount);
+
+spriteBatchStats spriteBatchGetStats(spriteBatch *batch);
+
+#endif
@@ -0,0 +1,497 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "textureAtlas.h"
+
+#define ATLAS_DEFAULT_MIP_LEVELS 4
+#define ATLAS_MAX_MIP_LEVELS 16
+#define ATLAS_BANDS_PER_RING 8
+
+// One segment of the skyline: the lowest free y over [x, x + width).
+typedef struct skylineNode
+{
+	uint32_t x, y, width;
+} skylineNode;
+
+typedef struct atlasPage
+{
+	skylineNode *nodes;
+	uint32_t nodeCount, nodeCapacity;
+
+	uint8_t *pixels;                     // every mip, level k at levelOffsets[k]
+	uint32_t writtenLevels;              // bit k once level k has been uploaded to
+} atlasPage;
+
+// A cell waiting for upload, in mip 0 texels. Cells are mip aligned, so the
+// rectangle shifted right by k covers the same data on level k. level and row
+// are where the next band starts.
+typedef struct pendingCell
+{
+	uint32_t page;
+	uint32_t x, y, width, height;
+	uint32_t level, row;
+} pendingCell;
+
+struct textureAtlas
+{
+	uint32_t pageSize, maxPages, mipLevels;
+	uint32_t alignment, gutter;
+	size_t levelOffsets[ATLAS_MAX_MIP_LEVELS];
+	size_t pageBytes;
+
+	atlasPage *pages;
+	uint32_t pageCount;
+	atlasStats stats;
+
+	VkDevice device;
+	gpuAllocator *allocator;
+	uploadRing *uploads;
+
+	VkImage image;
+	gpuAllocation imageMemory;
+	VkImageView view;
+	VkSampler sampler;
+	bool concurrent;
+
+	pendingCell *pending;
+	uint32_t pendingCount, pendingCapacity;
+};
+
+static inline uint32_t alignUp(uint32_t value, uint32_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static VkResult createGpuResources(textureAtlas *atlas)
+{
+	// Shared with the upload queue so cells can be added while frames sample the rest.
+	uint32_t families[2];
+	uint32_t familyCount = uploadRingQueueFamilies((*atlas).uploads, families);
+	(*atlas).concurrent = familyCount > 1;
+
+	VkImageCreateInfo imageInfo = {0};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+	imageInfo.extent = (VkExtent3D){(*atlas).pageSize, (*atlas).pageSize, 1};
+	imageInfo.mipLevels = (*atlas).mipLevels;
+	imageInfo.arrayLayers = (*atlas).maxPages;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = (*atlas).concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.queueFamilyIndexCount = (*atlas).concurrent ? familyCount : 0;
+	imageInfo.pQueueFamilyIndices = families;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	gpuAllocationCreateInfo imageAlloc = {0};
+	imageAlloc.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	imageAlloc.flags = GPU_ALLOCATION_OPTIMAL_IMAGE;
+
+	VkResult res = gpuCreateImage((*atlas).allocator, &imageInfo, &imageAlloc, &(*atlas).image, &(*atlas).imageMemory);
+
+	if (res == VK_SUCCESS)
+	{
+		VkImageViewCreateInfo viewInfo = {0};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = (*atlas).image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewInfo.format = imageInfo.format;
+		viewInfo.subresourceRange = (VkImageSubresourceRange){VK_IMAGE_ASPECT_COLOR_BIT, 0, (*atlas).mipLevels, 0, (*atlas).maxPages};
+
+		res = vkCreateImageView((*atlas).device, &viewInfo, NULL, &(*atlas).view);
+	}
+
+	if (res == VK_SUCCESS)
+	{
+		VkSamplerCreateInfo samplerInfo = {0};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.maxLod = (float)((*atlas).mipLevels - 1);
+
+		res = vkCreateSampler((*atlas).device, &samplerInfo, NULL, &(*atlas).sampler);
+	}
+
+	return res;
+}
+
+textureAtlas *atlasCreate(const textureAtlasCreateInfo *createInfo)
+{
+	textureAtlas *atlas = calloc(1, sizeof(textureAtlas));
+	(*atlas).pageSize = (*createInfo).pageSize;
+	(*atlas).maxPages = (*createInfo).maxPages;
+	(*atlas).mipLevels = (*createInfo).mipLevels ? (*createInfo).mipLevels : ATLAS_DEFAULT_MIP_LEVELS;
+	(*atlas).device = (*createInfo).device;
+	(*atlas).allocator = (*createInfo).allocator;
+	(*atlas).uploads = (*createInfo).uploads;
+
+	uint32_t fullChain = 1;
+	while ((1u << fullChain) <= (*atlas).pageSize && fullChain < ATLAS_MAX_MIP_LEVELS) fullChain++;
+	if ((*atlas).mipLevels > fullChain) (*atlas).mipLevels = fullChain;
+
+	// A texel of the smallest mip covers alignment texels of mip 0; cells start and
+	// end on that grid so every level can be built from the cell alone.
+	(*atlas).alignment = 1u << ((*atlas).mipLevels - 1);
+	(*atlas).gutter = ((*createInfo).padding ? (*createInfo).padding : 1) * (*atlas).alignment;
+
+	for (uint32_t level = 0; level < (*atlas).mipLevels; level++)
+	{
+		size_t size = (size_t)((*atlas).pageSize >> level);
+		(*atlas).levelOffsets[level] = (*atlas).pageBytes;
+		(*atlas).pageBytes += size * size * 4;
+	}
+
+	(*atlas).pages = calloc((*atlas).maxPages, sizeof(atlasPage));
+
+	if ((*atlas).device != VK_NULL_HANDLE)
+	{
+		VkResult res = (*atlas).uploads != NULL ? createGpuResources(atlas) : VK_ERROR_INITIALIZATION_FAILED;
+		if (res != VK_SUCCESS)
+		{
+			printf("failed to create texture atlas (%d)\n", res);
+			atlasDestroy(atlas);
+			return NULL;
+		}
+	}
+
+	return atlas;
+}
+
+// The device must be idle.
+void atlasDestroy(textureAtlas *atlas)
+{
+	if (atlas == NULL) return;
+
+	if ((*atlas).device != VK_NULL_HANDLE)
+	{
+		vkDestroySampler((*atlas).device, (*atlas).sampler, NULL);
+		vkDestroyImageView((*atlas).device, (*atlas).view, NULL);
+		if ((*atlas).image != VK_NULL_HANDLE) gpuDestroyImage((*atlas).allocator, (*atlas).image, &(*atlas).imageMemory);
+	}
+
+	for (uint32_t i = 0; i < (*atlas).pageCount; i++)
+	{
+		free((*atlas).pages[i].nodes);
+		free((*atlas).pages[i].pixels);
+	}
+	free((*atlas).pages);
+	free((*atlas).pending);
+	free(atlas);
+}
+
+static void insertNode(atlasPage *page, uint32_t index, skylineNode node)
+{
+	if ((*page).nodeCount == (*page).nodeCapacity)
+	{
+		(*page).nodeCapacity = (*page).nodeCapacity ? 2 * (*page).nodeCapacity : 16;
+		(*page).nodes = realloc((*page).nodes, (*page).nodeCapacity * sizeof(skylineNode));
+	}
+
+	memmove(&(*page).nodes[index + 1], &(*page).nodes[index], ((*page).nodeCount - index) * sizeof(skylineNode));
+	(*page).nodes[index] = node;
+	(*page).nodeCount++;
+}
+
+static atlasPage *addPage(textureAtlas *atlas)
+{
+	if ((*atlas).pageCount == (*atlas).maxPages) return NULL;
+
+	atlasPage *page = &(*atlas).pages[(*atlas).pageCount++];
+	(*page).pixels = calloc(1, (*atlas).pageBytes);
+	insertNode(page, 0, (skylineNode){0, 0, (*atlas).pageSize});
+	(*atlas).stats.pageCount = (*atlas).pageCount;
+	return page;
+}
+
+// Lowest y a width x height cell can rest at when its left edge is at node index,
+// or UINT32_MAX when it does not fit there.
+static uint32_t skylineFit(textureAtlas *atlas, const atlasPage *page, uint32_t index, uint32_t width, uint32_t height)
+{
+	uint32_t x = (*page).nodes[index].x;
+	if (x + width > (*atlas).pageSize) return UINT32_MAX;
+
+	uint32_t y = 0;
+	uint32_t remaining = width;
+	for (uint32_t i = index; remaining > 0; i++)
+	{
+		if ((*page).nodes[i].y > y) y = (*page).nodes[i].y;
+		if (y + height > (*atlas).pageSize) return UINT32_MAX;
+		remaining -= remaining < (*page).nodes[i].width ? remaining : (*page).nodes[i].width;
+	}
+	return y;
+}
+
+// Bottom-left heuristic: lowest resulting top edge, ties go to the narrower segment.
+static bool skylinePlace(textureAtlas *atlas, atlasPage *page, uint32_t width, uint32_t height, uint32_t *outX, uint32_t *outY)
+{
+	uint32_t bestIndex = UINT32_MAX, bestTop = UINT32_MAX, bestWidth = UINT32_MAX, bestY = 0;
+
+	for (uint32_t i = 0; i < (*page).nodeCount; i++)
+	{
+		uint32_t y = skylineFit(atlas, page, i, width, height);
+		if (y == UINT32_MAX) continue;
+
+		if (y + height < bestTop || (y + height == bestTop && (*page).nodes[i].width < bestWidth))
+		{
+			bestIndex = i;
+			bestTop = y + height;
+			bestWidth = (*page).nodes[i].width;
+			bestY = y;
+		}
+	}
+	if (bestIndex == UINT32_MAX) return false;
+
+	uint32_t x = (*page).nodes[bestIndex].x;
+	insertNode(page, bestIndex, (skylineNode){x, bestY + height, width});
+
+	// Trim the segments now hidden under the new one.
+	for (uint32_t i = bestIndex + 1; i < (*page).nodeCount; )
+	{
+		skylineNode *node = &(*page).nodes[i];
+		uint32_t coveredEnd = x + width;
+		if ((*node).x >= coveredEnd) break;
+
+		uint32_t shrink = coveredEnd - (*node).x;
+		if (shrink < (*node).width)
+		{
+			(*node).x += shrink;
+			(*node).width -= shrink;
+			break;
+		}
+
+		memmove(node, node + 1, ((*page).nodeCount - i - 1) * sizeof(skylineNode));
+		(*page).nodeCount--;
+	}
+
+	// Merge neighbours at the same height.
+	for (uint32_t i = 0; i + 1 < (*page).nodeCount; )
+	{
+		if ((*page).nodes[i].y == (*page).nodes[i + 1].y)
+		{
+			(*page).nodes[i].width += (*page).nodes[i + 1].width;
+			memmove(&(*page).nodes[i + 1], &(*page).nodes[i + 2], ((*page).nodeCount - i - 2) * sizeof(skylineNode));
+			(*page).nodeCount--;
+		} else
+		{
+			i++;
+		}
+	}
+
+	*outX = x;
+	*outY = bestY;
+	return true;
+}
+
+// Copies the image into its cell with the border pixels extruded across the
+// gutter, then box filters the cell down every mip level.
+static void writeCell(textureAtlas *atlas, atlasPage *page, const atlasImage *image, uint32_t cellX, uint32_t cellY, uint32_t cellWidth, uint32_t cellHeight)
+{
+	uint32_t stride = (*image).stride ? (*image).stride : (*image).width * 4;
+	uint32_t gutter = (*atlas).gutter;
+	uint8_t *level0 = (*page).pixels;
+
+	for (uint32_t y = 0; y < cellHeight; y++)
+	{
+		uint32_t srcY = y < gutter ? 0 : y - gutter;
+		if (srcY >= (*image).height) srcY = (*image).height - 1;
+
+		const uint8_t *srcRow = (*image).pixels + (size_t)srcY * stride;
+		uint8_t *dstRow = level0 + ((size_t)(cellY + y) * (*atlas).pageSize + cellX) * 4;
+
+		for (uint32_t x = 0; x < cellWidth; x++)
+		{
+			uint32_t srcX = x < gutter ? 0 : x - gutter;
+			if (srcX >= (*image).width) srcX = (*image).width - 1;
+			memcpy(dstRow + x * 4, srcRow + srcX * 4, 4);
+		}
+	}
+
+	for (uint32_t level = 1; level < (*atlas).mipLevels; level++)
+	{
+		uint32_t srcSize = (*atlas).pageSize >> (level - 1), dstSize = (*atlas).pageSize >> level;
+		const uint8_t *src = (*page).pixels + (*atlas).levelOffsets[level - 1];
+		uint8_t *dst = (*page).pixels + (*atlas).levelOffsets[level];
+
+		for (uint32_t y = cellY >> level; y < (cellY + cellHeight) >> level; y++)
+		{
+			const uint8_t *row0 = src + (size_t)(2 * y) * srcSize * 4;
+			const uint8_t *row1 = row0 + (size_t)srcSize * 4;
+			uint8_t *dstRow = dst + (size_t)y * dstSize * 4;
+
+			for (uint32_t x = cellX >> level; x < (cellX + cellWidth) >> level; x++)
+			{
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					uint32_t sum = row0[8 * x + c] + row0[8 * x + 4 + c] + row1[8 * x + c] + row1[8 * x + 4 + c];
+					dstRow[4 * x + c] = (uint8_t)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	if ((*atlas).image == VK_NULL_HANDLE) return;
+
+	if ((*atlas).pendingCount == (*atlas).pendingCapacity)
+	{
+		(*atlas).pendingCapacity = (*atlas).pendingCapacity ? 2 * (*atlas).pendingCapacity : 32;
+		(*atlas).pending = realloc((*atlas).pending, (*atlas).pendingCapacity * sizeof(pendingCell));
+	}
+
+	uint32_t pageIndex = (uint32_t)(page - (*atlas).pages);
+	(*atlas).pending[(*atlas).pendingCount++] = (pendingCell){pageIndex, cellX, cellY, cellWidth, cellHeight, 0, 0};
+}
+
+bool atlasAdd(textureAtlas *atlas, const atlasImage *image, atlasRegion *region)
+{
+	memset(region, 0, sizeof(atlasRegion));
+	if ((*image).width == 0 || (*image).height == 0) return false;
+
+	uint32_t cellWidth = alignUp((*image).width + 2 * (*atlas).gutter, (*atlas).alignment);
+	uint32_t cellHeight = alignUp((*image).height + 2 * (*atlas).gutter, (*atlas).alignment);
+	if (cellWidth > (*atlas).pageSize || cellHeight > (*atlas).pageSize) return false;
+
+	uint32_t pageIndex = 0, x = 0, y = 0;
+	while (pageIndex < (*atlas).pageCount && !skylinePlace(atlas, &(*atlas).pages[pageIndex], cellWidth, cellHeight, &x, &y)) pageIndex++;
+
+	if (pageIndex == (*atlas).pageCount)
+	{
+		atlasPage *page = addPage(atlas);
+		if (page == NULL || !skylinePlace(atlas, page, cellWidth, cellHeight, &x, &y)) return false;
+	}
+
+	writeCell(atlas, &(*atlas).pages[pageIndex], image, x, y, cellWidth, cellHeight);
+
+	float scale = 1.0f / (float)(*atlas).pageSize;
+	(*region).page = pageIndex;
+	(*region).x = x + (*atlas).gutter;
+	(*region).y = y + (*atlas).gutter;
+	(*region).width = (*image).width;
+	(*region).height = (*image).height;
+	(*region).u0 = (float)(*region).x * scale;
+	(*region).v0 = (float)(*region).y * scale;
+	(*region).u1 = (float)((*region).x + (*region).width) * scale;
+	(*region).v1 = (float)((*region).y + (*region).height) * scale;
+
+	(*atlas).stats.regionCount++;
+	(*atlas).stats.usedTexels += (uint64_t)cellWidth * cellHeight;
+	return true;
+}
+
+typedef struct packOrder
+{
+	uint32_t height, index;
+} packOrder;
+
+static int compareTallestFirst(const void *a, const void *b)
+{
+	const packOrder *left = a, *right = b;
+	if ((*left).height != (*right).height) return (*left).height > (*right).height ? -1 : 1;
+	return (*left).index < (*right).index ? -1 : 1;
+}
+
+uint32_t atlasPack(textureAtlas *atlas, const atlasImage *images, uint32_t count, atlasRegion *regions)
+{
+	packOrder *order = malloc(count * sizeof(packOrder));
+	for (uint32_t i = 0; i < count; i++) order[i] = (packOrder){images[i].height, i};
+	qsort(order, count, sizeof(packOrder), compareTallestFirst);
+
+	uint32_t placed = 0;
+	for (uint32_t i = 0; i < count; i++)
+		if (atlasAdd(atlas, &images[order[i].index], &regions[order[i].index])) placed++;
+
+	free(order);
+	return placed;
+}
+
+const uint8_t *atlasPagePixels(textureAtlas *atlas, uint32_t page, uint32_t mipLevel)
+{
+	if (page >= (*atlas).pageCount || mipLevel >= (*atlas).mipLevels) return NULL;
+	return (*atlas).pages[page].pixels + (*atlas).levelOffsets[mipLevel];
+}
+
+atlasStats atlasGetStats(textureAtlas *atlas)
+{
+	return (*atlas).stats;
+}
+
+VkImageView atlasImageView(textureAtlas *atlas)
+{
+	return (*atlas).view;
+}
+
+VkSampler atlasSampler(textureAtlas *atlas)
+{
+	return (*atlas).sampler;
+}
+
+// Stages the rest of a cell in bands of rows, false once the ring is out of room.
+// The first upload to a page level discards it; texels outside cells are never
+// sampled, so they may stay undefined.
+static bool stageCell(textureAtlas *atlas, pendingCell *cell, VkDeviceSize bandBytes, uploadTicket *ticket)
+{
+	atlasPage *page = &(*atlas).pages[(*cell).page];
+
+	for (; (*cell).level < (*atlas).mipLevels; (*cell).level++, (*cell).row = 0)
+	{
+		uint32_t level = (*cell).level;
+		uint32_t x = (*cell).x >> level, y = (*cell).y >> level;
+		uint32_t width = (*cell).width >> level, height = (*cell).height >> level;
+		uint32_t levelSize = (*atlas).pageSize >> level;
+		VkDeviceSize rowBytes = (VkDeviceSize)width * 4;
+		uint32_t bandRows = bandBytes > rowBytes ? (uint32_t)(bandBytes / rowBytes) : 1;
+		const uint8_t *src = (*page).pixels + (*atlas).levelOffsets[level];
+
+		while ((*cell).row < height)
+		{
+			uint32_t rows = height - (*cell).row < bandRows ? height - (*cell).row : bandRows;
+
+			uploadImageInfo info = {0};
+			info.image = (*atlas).image;
+			info.subresource = (VkImageSubresourceLayers){VK_IMAGE_ASPECT_COLOR_BIT, level, (*cell).page, 1};
+			info.offset = (VkOffset3D){(int32_t)x, (int32_t)(y + (*cell).row), 0};
+			info.extent = (VkExtent3D){width, rows, 1};
+			info.size = (VkDeviceSize)width * rows * 4;
+			info.oldLayout = ((*page).writtenLevels >> level) & 1 ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+			info.finalLayout = VK_IMAGE_LAYOUT_GENERAL;
+			info.dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			info.dstAccess = VK_ACCESS_SHADER_READ_BIT;
+			info.concurrent = (*atlas).concurrent;
+
+			uploadTicket staged;
+			uint8_t *staging = uploadImage((*atlas).uploads, &info, &staged);
+			if (staging == NULL) return false;
+
+			for (uint32_t row = 0; row < rows; row++)
+				memcpy(staging + (size_t)row * width * 4, src + ((size_t)(y + (*cell).row + row) * levelSize + x) * 4, (size_t)width * 4);
+
+			(*page).writtenLevels |= 1u << level;
+			(*cell).row += rows;
+			(*atlas).stats.uploadedBytes += info.size;
+			*ticket = staged;
+		}
+	}
+
+	return true;
+}
+
+// Cells the ring has no room for this frame resume where they stopped on the next call.
+uploadTicket atlasStageUploads(textureAtlas *atlas)
+{
+	if ((*atlas).pendingCount == 0) return 0;
+
+	VkDeviceSize bandBytes = uploadRingCapacity((*atlas).uploads) / ATLAS_BANDS_PER_RING;
+	uploadTicket ticket = 0;
+
+	uint32_t done = 0;
+	while (done < (*atlas).pendingCount && stageCell(atlas, &(*atlas).pending[done], bandBytes, &ticket)) done++;
+
+	memmove((*atlas).pending, (*atlas).pending + done, ((*atlas).pendingCount - done) * sizeof(pendingCell));
+	(*atlas).pendingCount -= done;
+	return ticket;
+}
@@ -0,0 +1,80 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "gpuAllocator.h"
+#include "uploadRing.h"
+
+// Skyline packer that places RGBA8 images into square atlas pages, each page one
+// layer of a 2D array texture so every atlas sprite can share one texture.
+// Cells are aligned to the smallest mip's texel size and surrounded by a gutter
+// of extruded edge pixels, so neither bilinear filtering nor mipmapping bleeds a
+// neighbour in. Without a device the atlas is CPU only, for packing at cook time;
+// with one, new cells are streamed through the upload ring by atlasStageUploads().
+// Not thread safe.
+
+typedef struct textureAtlas textureAtlas;
+
+typedef struct atlasRegion
+{
+	uint32_t page;
+	uint32_t x, y, width, height;        // image pixels on mip 0, gutter excluded
+	float u0, v0, u1, v1;
+} atlasRegion;
+
+typedef struct atlasImage
+{
+	const uint8_t *pixels;               // RGBA8
+	uint32_t width, height;
+	uint32_t stride;                     // bytes per row, 0 for tightly packed
+} atlasImage;
+
+typedef struct textureAtlasCreateInfo
+{
+	uint32_t pageSize;                   // power of two
+	uint32_t maxPages;
+	uint32_t mipLevels;                  // 0 = down to 1/8th, mip 3
+	uint32_t padding;                    // gutter width in texels of the smallest mip, at least 1
+
+	// Optional, for the GPU copy.
+	VkDevice device;
+	gpuAllocator *allocator;
+	uploadRing *uploads;
+} textureAtlasCreateInfo;
+
+typedef struct atlasStats
+{
+	uint32_t pageCount;
+	uint32_t regionCount;
+	uint64_t usedTexels;                 // mip 0 texels covered by cells, gutters included
+	uint64_t uploadedBytes;
+} atlasStats;
+
+textureAtlas *atlasCreate(const textureAtlasCreateInfo *createInfo);
+void atlasDestroy(textureAtlas *atlas);
+
+// Runtime path, e.g. glyphs and decals as they appear. False when no page has room.
+bool atlasAdd(textureAtlas *atlas, const atlasImage *image, atlasRegion *region);
+
+// Cook-time path: packs tallest first, which wastes less space than arrival order.
+// Returns how many images were placed; regions of the rest have width 0.
+uint32_t atlasPack(textureAtlas *atlas, const atlasImage *images, uint32_t count, atlasRegion *regions);
+
+// RGBA8 pixels of a page mip, (pageSize >> mipLevel) texels square.
+const uint8_t *atlasPagePixels(textureAtlas *atlas, uint32_t page, uint32_t mipLevel);
+atlasStats atlasGetStats(textureAtlas *atlas);
+
+// GPU side. The texture is sampled in GENERAL: cells are copied in place while
+// earlier frames may still sample the rest of the page, so there is no layout to
+// switch. Stages the cells added since the last call, split into bands that fit
+// the ring, and returns the ticket covering them for uploadRingAcquire(), 0 when
+// nothing was staged. A region is only defined once its ticket has been acquired.
+VkImageView atlasImageView(textureAtlas *atlas);
+VkSampler atlasSampler(textureAtlas *atlas);
+uploadTicket atlasStageUploads(textureAtlas *atlas);
+
+#endif
@@ -0,0 +1,343 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define TILE_X86 1
+#endif
+
+#include "tileGrid.h"
+#include "vectorMath.h"
+
+#define LINE_ALIGN 32                    // bytes; lines are padded to 256 bits
+#define CELL_EPSILON (1.0f / 1024.0f)    // bodies closer than this to a cell edge do not enter the cell
+
+// First or last set bit of a line between two cells.
+typedef int32_t (*scanKernel)(const uint64_t *words, int32_t begin, int32_t end);
+
+struct tileGrid
+{
+	int32_t width, height;
+	float tileSize, inverseTileSize;
+
+	// Bit x of row y and bit y of column x are the same cell.
+	uint32_t rowStride, columnStride;    // in words
+	uint64_t *rows;
+	uint64_t *columns;
+
+	scanKernel firstSet, lastSet;
+};
+
+// Each level tests blocks of words aligned to their size; lines are padded so a
+// block never crosses into the next line.
+static inline bool blockEmptyScalar(const uint64_t *words)
+{
+	return words[0] == 0;
+}
+
+#if TILE_X86
+
+static inline bool blockEmptySse2(const uint64_t *words)
+{
+	__m128i v = _mm_load_si128((const __m128i *)words);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xFFFF;
+}
+
+__attribute__((target("avx2")))
+static inline bool blockEmptyAvx2(const uint64_t *words)
+{
+	__m256i v = _mm256_load_si256((const __m256i *)words);
+	return _mm256_testz_si256(v, v);
+}
+
+#endif
+
+// firstSet: first set bit in [begin, end), or end.
+// lastSet: last set bit in [begin, end), or begin - 1.
+#define SCAN_KERNELS(suffix, blockWords, target) \
+	target static int32_t firstSet##suffix(const uint64_t *words, int32_t begin, int32_t end) \
+	{ \
+		int32_t w = begin >> 6, last = (end - 1) >> 6; \
+		uint64_t bits = words[w] & (~0ull << (begin & 63)); \
+		while (bits == 0) \
+		{ \
+			if (++w > last) return end; \
+			while (w % (blockWords) == 0 && w + (blockWords) - 1 <= last && blockEmpty##suffix(words + w)) w += (blockWords); \
+			if (w > last) return end; \
+			bits = words[w]; \
+		} \
+		return mathMin(w * 64 + __builtin_ctzll(bits), end); \
+	} \
+	target static int32_t lastSet##suffix(const uint64_t *words, int32_t begin, int32_t end) \
+	{ \
+		int32_t w = (end - 1) >> 6, first = begin >> 6; \
+		uint64_t bits = words[w] & (~0ull >> (63 - ((end - 1) & 63))); \
+		while (bits == 0) \
+		{ \
+			if (--w < first) return begin - 1; \
+			while ((w + 1) % (blockWords) == 0 && w - ((blockWords) - 1) >= first && blockEmpty##suffix(words + w - ((blockWords) - 1))) w -= (blockWords); \
+			if (w < first) return begin - 1; \
+			bits = words[w]; \
+		} \
+		return mathMax(w * 64 + 63 - __builtin_clzll(bits), begin - 1); \
+	}
+
+SCAN_KERNELS(Scalar, 1, )
+
+#if TILE_X86
+SCAN_KERNELS(Sse2, 2, )
+SCAN_KERNELS(Avx2, 4, __attribute__((target("avx2"))))
+#endif
+
+static inline void setBit(uint64_t *words, int32_t bit, bool value)
+{
+	uint64_t mask = 1ull << (bit & 63);
+	words[bit >> 6] = value ? words[bit >> 6] | mask : words[bit >> 6] & ~mask;
+}
+
+static inline int32_t floorToCell(float v)
+{
+	int32_t i = (int32_t)v;
+	return i - (v < (float)i);
+}
+
+// Cells covered by the span [start, end) in world units.
+static inline int32_t firstCell(const tileGrid *grid, float start)
+{
+	return floorToCell(start * (*grid).inverseTileSize + CELL_EPSILON);
+}
+
+static inline int32_t lastCell(const tileGrid *grid, float end)
+{
+	return -floorToCell(-end * (*grid).inverseTileSize + CELL_EPSILON) - 1;
+}
+
+static uint64_t *allocateLines(uint32_t lineCount, uint32_t stride)
+{
+	size_t size = (size_t)mathMax(lineCount, 1u) * stride * sizeof(uint64_t);
+	uint64_t *lines = aligned_alloc(LINE_ALIGN, size);
+	if (lines != NULL) memset(lines, 0, size);
+	return lines;
+}
+
+tileGrid *tileGridCreate(const tileGridCreateInfo *createInfo)
+{
+	if ((*createInfo).width == 0 || (*createInfo).height == 0 || (*createInfo).width > INT32_MAX / 2 || (*createInfo).height > INT32_MAX / 2)
+	{
+		printf("invalid tile grid size %ux%u\n", (*createInfo).width, (*createInfo).height);
+		return NULL;
+	}
+
+	tileGrid *grid = calloc(1, sizeof(tileGrid));
+	if (grid == NULL)
+	{
+		printf("failed to allocate tile grid\n");
+		return NULL;
+	}
+
+	(*grid).width = (int32_t)(*createInfo).width;
+	(*grid).height = (int32_t)(*createInfo).height;
+	(*grid).tileSize = (*createInfo).tileSize;
+	(*grid).inverseTileSize = 1.0f / (*createInfo).tileSize;
+	(*grid).firstSet = firstSetScalar;
+	(*grid).lastSet = lastSetScalar;
+#if TILE_X86
+	mathLevel level = mathGetLevel();
+	if (level >= MATH_LEVEL_AVX2)
+	{
+		(*grid).firstSet = firstSetAvx2;
+		(*grid).lastSet = lastSetAvx2;
+	} else if (level >= MATH_LEVEL_SSE2)
+	{
+		(*grid).firstSet = firstSetSse2;
+		(*grid).lastSet = lastSetSse2;
+	}
+#endif
+
+	const uint32_t lineBits = LINE_ALIGN * 8;
+	(*grid).rowStride = ((*createInfo).width + lineBits - 1) / lineBits * (lineBits / 64);
+	(*grid).columnStride = ((*createInfo).height + lineBits - 1) / lineBits * (lineBits / 64);
+	(*grid).rows = allocateLines((*createInfo).height, (*grid).rowStride);
+	(*grid).columns = allocateLines((*createInfo).width, (*grid).columnStride);
+	if ((*grid).rows == NULL || (*grid).columns == NULL)
+	{
+		printf("failed to allocate tile grid\n");
+		tileGridDestroy(grid);
+		return NULL;
+	}
+
+	if ((*createInfo).tiles != NULL)
+		for (int32_t y = 0; y < (*grid).height; y++)
+			for (int32_t x = 0; x < (*grid).width; x++)
+				if ((*createInfo).tiles[(size_t)y * (*grid).width + x] != 0) tileGridFill(grid, x, y, x, y, true);
+
+	return grid;
+}
+
+void tileGridDestroy(tileGrid *grid)
+{
+	if (grid == NULL) return;
+
+	free((*grid).rows);
+	free((*grid).columns);
+	free(grid);
+}
+
+void tileGridFill(tileGrid *grid, int32_t x0, int32_t y0, int32_t x1, int32_t y1, bool solid)
+{
+	x0 = mathMax(x0, 0);
+	y0 = mathMax(y0, 0);
+	x1 = mathMin(x1, (*grid).width - 1);
+	y1 = mathMin(y1, (*grid).height - 1);
+
+	for (int32_t y = y0; y <= y1; y++)
+		for (int32_t x = x0; x <= x1; x++)
+		{
+			setBit((*grid).rows + (size_t)y * (*grid).rowStride, x, solid);
+			setBit((*grid).columns + (size_t)x * (*grid).columnStride, y, solid);
+		}
+}
+
+bool tileGridSolid(const tileGrid *grid, int32_t x, int32_t y)
+{
+	if (x < 0 || y < 0 || x >= (*grid).width || y >= (*grid).height) return true;
+	return ((*grid).rows[(size_t)y * (*grid).rowStride + (x >> 6)] >> (x & 63)) & 1;
+}
+
+bool tileGridAnySolid(const tileGrid *grid, int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+	if (x0 > x1 || y0 > y1) return false;
+	if (x0 < 0 || y0 < 0 || x1 >= (*grid).width || y1 >= (*grid).height) return true;
+
+	// Scan along the longer side so each line covers as many cells as possible.
+	if (x1 - x0 >= y1 - y0)
+	{
+		for (int32_t y = y0; y <= y1; y++)
+			if ((*grid).firstSet((*grid).rows + (size_t)y * (*grid).rowStride, x0, x1 + 1) <= x1) return true;
+	} else
+	{
+		for (int32_t x = x0; x <= x1; x++)
+			if ((*grid).firstSet((*grid).columns + (size_t)x * (*grid).columnStride, y0, y1 + 1) <= y1) return true;
+	}
+
+	return false;
+}
+
+// Lines first..last of length cells each are scanned past edge, forwards or
+// backwards, and the nearest solid cell in any of them ends the sweep.
+static uint32_t sweepLines(const tileGrid *grid, const uint64_t *lines, uint32_t stride, int32_t lineCount, int32_t length,
+	int32_t first, int32_t last, int32_t edge, bool forward, uint32_t maxCells)
+{
+	if (first < 0 || last >= lineCount) return 0;
+
+	if (forward)
+	{
+		int64_t begin = (int64_t)edge + 1, end = begin + maxCells;
+		if (begin < 0) return 0;
+
+		// The grid edge is solid; every line only needs scanning up to the nearest hit so far.
+		int64_t hit = mathMin(end, (int64_t)length);
+		for (int32_t line = first; line <= last && hit > begin; line++)
+			hit = (*grid).firstSet(lines + (size_t)line * stride, (int32_t)begin, (int32_t)hit);
+
+		return hit > begin ? (uint32_t)(hit - begin) : 0;
+	}
+
+	int64_t begin = (int64_t)edge - 1, end = begin - maxCells;
+	if (begin >= length) return 0;
+
+	int64_t hit = mathMax(end, (int64_t)-1);
+	for (int32_t line = first; line <= last && hit < begin; line++)
+		hit = (*grid).lastSet(lines + (size_t)line * stride, (int32_t)hit + 1, (int32_t)begin + 1);
+
+	return hit < begin ? (uint32_t)(begin - hit) : 0;
+}
+
+uint32_t tileGridSweep(const tileGrid *grid, int32_t x0, int32_t y0, int32_t x1, int32_t y1, tileDirection direction, uint32_t maxCells)
+{
+	if (maxCells == 0) return 0;
+
+	switch (direction)
+	{
+		case TILE_LEFT:
+			return sweepLines(grid, (*grid).rows, (*grid).rowStride, (*grid).height, (*grid).width, y0, y1, x0, false, maxCells);
+		case TILE_RIGHT:
+			return sweepLines(grid, (*grid).rows, (*grid).rowStride, (*grid).height, (*grid).width, y0, y1, x1, true, maxCells);
+		case TILE_UP:
+			return sweepLines(grid, (*grid).columns, (*grid).columnStride, (*grid).width, (*grid).height, x0, x1, y0, false, maxCells);
+		case TILE_DOWN:
+			return sweepLines(grid, (*grid).columns, (*grid).columnStride, (*grid).width, (*grid).height, x0, x1, y1, true, maxCells);
+	}
+
+	return 0;
+}
+
+static inline void resolveBody(const tileGrid *grid, tileBody *body)
+{
+	float tileSize = (*grid).tileSize;
+	uint32_t contacts = 0;
+
+	int32_t x0 = firstCell(grid, (*body).x), x1 = lastCell(grid, (*body).x + (*body).width);
+	int32_t y0 = firstCell(grid, (*body).y), y1 = lastCell(grid, (*body).y + (*body).height);
+
+	// Moves within the cells already covered need no scan.
+	if ((*body).dx > 0.0f)
+	{
+		int32_t target = lastCell(grid, (*body).x + (*body).width + (*body).dx);
+		uint32_t free = target > x1 ? tileGridSweep(grid, x0, y0, x1, y1, TILE_RIGHT, (uint32_t)(target - x1)) : 0;
+		if (target > x1 && free < (uint32_t)(target - x1))
+		{
+			(*body).x = (float)(x1 + (int32_t)free + 1) * tileSize - (*body).width;
+			contacts |= TILE_CONTACT_RIGHT;
+		} else (*body).x += (*body).dx;
+	} else if ((*body).dx < 0.0f)
+	{
+		int32_t target = firstCell(grid, (*body).x + (*body).dx);
+		uint32_t free = target < x0 ? tileGridSweep(grid, x0, y0, x1, y1, TILE_LEFT, (uint32_t)(x0 - target)) : 0;
+		if (target < x0 && free < (uint32_t)(x0 - target))
+		{
+			(*body).x = (float)(x0 - (int32_t)free) * tileSize;
+			contacts |= TILE_CONTACT_LEFT;
+		} else (*body).x += (*body).dx;
+	}
+
+	x0 = firstCell(grid, (*body).x);
+	x1 = lastCell(grid, (*body).x + (*body).width);
+
+	if ((*body).dy > 0.0f)
+	{
+		int32_t target = lastCell(grid, (*body).y + (*body).height + (*body).dy);
+		uint32_t free = target > y1 ? tileGridSweep(grid, x0, y0, x1, y1, TILE_DOWN, (uint32_t)(target - y1)) : 0;
+		if (target > y1 && free < (uint32_t)(target - y1))
+		{
+			(*body).y = (float)(y1 + (int32_t)free + 1) * tileSize - (*body).height;
+			contacts |= TILE_CONTACT_GROUND;
+		} else (*body).y += (*body).dy;
+	} else if ((*body).dy < 0.0f)
+	{
+		int32_t target = firstCell(grid, (*body).y + (*body).dy);
+		uint32_t free = target < y0 ? tileGridSweep(grid, x0, y0, x1, y1, TILE_UP, (uint32_t)(y0 - target)) : 0;
+		if (target < y0 && free < (uint32_t)(y0 - target))
+		{
+			(*body).y = (float)(y0 - (int32_t)free) * tileSize;
+			contacts |= TILE_CONTACT_CEILING;
+		} else (*body).y += (*body).dy;
+	}
+
+	// Ground probe for bodies resting on a cell edge.
+	if (!(contacts & TILE_CONTACT_GROUND) && (*body).dy >= 0.0f)
+	{
+		float bottom = ((*body).y + (*body).height) * (*grid).inverseTileSize;
+		int32_t below = floorToCell(bottom + 0.5f);
+		if (bottom - (float)below < CELL_EPSILON && (float)below - bottom < CELL_EPSILON &&
+			tileGridAnySolid(grid, x0, below, x1, below)) contacts |= TILE_CONTACT_GROUND;
+	}
+
+	(*body).contacts = contacts;
+}
+
+void tileGridResolve(const tileGrid *grid, tileBody *bodies, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) resolveBody(grid, &bodies[i]);
+}
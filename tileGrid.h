@@ -0,0 +1,64 @@
+#ifndef TILE_GRID_H
+#define TILE_GRID_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Static level geometry as packed solid bits. Every row is stored as 64-bit
+// words and every column again in a transposed copy, so horizontal and vertical
+// scans both walk contiguous bits: a word answers 64 cells at once. Inside a
+// scan, empty words on a 128 or 256-bit boundary are skipped a block per test
+// with SSE2 or AVX2, chosen when the grid is created from mathGetLevel(), so
+// call mathInit() first. Cells outside the grid count as solid.
+// Queries never write, so any number of threads may run them at once.
+
+typedef struct tileGrid tileGrid;
+
+typedef enum tileDirection
+{
+	TILE_LEFT,
+	TILE_RIGHT,
+	TILE_UP,                             // -y
+	TILE_DOWN                            // +y, towards the ground
+} tileDirection;
+
+#define TILE_CONTACT_LEFT 1u
+#define TILE_CONTACT_RIGHT 2u
+#define TILE_CONTACT_CEILING 4u
+#define TILE_CONTACT_GROUND 8u
+
+typedef struct tileGridCreateInfo
+{
+	uint32_t width, height;              // in cells
+	float tileSize;                      // world units per cell
+	const uint8_t *tiles;                // width * height, row major, nonzero is solid; NULL for empty
+} tileGridCreateInfo;
+
+// An axis-aligned body covering [x, x + width) by [y, y + height) in world units.
+typedef struct tileBody
+{
+	float x, y, width, height;
+	float dx, dy;                        // movement this step
+	uint32_t contacts;                   // TILE_CONTACT_* from the last resolve
+} tileBody;
+
+tileGrid *tileGridCreate(const tileGridCreateInfo *createInfo);
+void tileGridDestroy(tileGrid *grid);
+
+void tileGridFill(tileGrid *grid, int32_t x0, int32_t y0, int32_t x1, int32_t y1, bool solid);
+
+bool tileGridSolid(const tileGrid *grid, int32_t x, int32_t y);
+
+// Cell rectangles are inclusive.
+bool tileGridAnySolid(const tileGrid *grid, int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+
+// How many whole cells the rectangle can move in direction before touching a
+// solid cell, at most maxCells. A ground probe is a sweep down.
+uint32_t tileGridSweep(const tileGrid *grid, int32_t x0, int32_t y0, int32_t x1, int32_t y1, tileDirection direction, uint32_t maxCells);
+
+// Moves every body by (dx, dy), first along x then along y, stopping flush
+// against solid cells, and sets its contacts. Bodies must start clear of solid
+// cells. Touching the ground without moving down still reports it.
+void tileGridResolve(const tileGrid *grid, tileBody *bodies, uint32_t count);
+
+#endif
@@ -0,0 +1,520 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "uploadRing.h"
+
+#define UPLOAD_IMAGE_OFFSET_ALIGNMENT 16
+
+typedef enum uploadBatchState
+{
+	UPLOAD_BATCH_IDLE,
+	UPLOAD_BATCH_RECORDING,
+	UPLOAD_BATCH_SUBMITTED
+} uploadBatchState;
+
+// One destination touched by a batch, replayed as release/acquire barriers.
+typedef struct uploadTarget
+{
+	VkBuffer buffer;
+	VkDeviceSize offset, size;
+	VkImage image;
+	VkImageSubresourceRange range;
+	VkImageLayout copyLayout, finalLayout;
+	VkPipelineStageFlags dstStage;
+	VkAccessFlags dstAccess;
+	bool concurrent;
+} uploadTarget;
+
+typedef struct uploadBatch
+{
+	uploadBatchState state;
+	bool acquired;                       // a submitted batch is reused once it is also complete
+	VkCommandBuffer commandBuffer;
+	VkFence fence;
+	uint64_t value;
+	uint64_t ringEnd;
+
+	uploadTarget *targets;
+	uint32_t targetCount, targetCapacity;
+} uploadBatch;
+
+struct uploadRing
+{
+	VkDevice device;
+	gpuAllocator *allocator;
+	VkQueue queue;
+	uint32_t queueFamily, dstQueueFamily;
+
+	VkBuffer buffer;
+	gpuAllocation memory;
+	VkDeviceSize capacity, alignment;
+
+	// Virtual offsets that only grow; the physical offset is offset & (capacity - 1).
+	uint64_t head, tail;
+
+	VkCommandPool commandPool;
+	uploadBatch batches[UPLOAD_RING_MAX_BATCHES];
+
+	bool timeline;
+	VkSemaphore semaphore;
+	PFN_vkGetSemaphoreCounterValueKHR getCounterValue;
+
+	uint64_t nextValue;
+	uint64_t completedValue;
+	uint64_t acquiredValue;
+
+	VkBufferMemoryBarrier *bufferBarriers;
+	VkImageMemoryBarrier *imageBarriers;
+	uint32_t barrierCapacity;
+};
+
+static inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static inline uploadBatch *batchOf(uploadRing *ring, uint64_t value)
+{
+	return &(*ring).batches[value % UPLOAD_RING_MAX_BATCHES];
+}
+
+uploadRing *uploadRingCreate(const uploadRingCreateInfo *createInfo)
+{
+	uploadRing *ring = calloc(1, sizeof(uploadRing));
+	(*ring).device = (*createInfo).device;
+	(*ring).allocator = (*createInfo).allocator;
+	(*ring).queue = (*createInfo).queue;
+	(*ring).queueFamily = (*createInfo).queueFamily;
+	(*ring).dstQueueFamily = (*createInfo).dstQueueFamily;
+	(*ring).timeline = (*createInfo).timelineSemaphore;
+	(*ring).nextValue = 1;
+
+	(*ring).capacity = 1;
+	while ((*ring).capacity < (*createInfo).size) (*ring).capacity <<= 1;
+	(*ring).alignment = (*createInfo).copyOffsetAlignment > 4 ? (*createInfo).copyOffsetAlignment : 4;
+
+	VkBufferCreateInfo bufferInfo = {0};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = (*ring).capacity;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	gpuAllocationCreateInfo allocInfo = {0};
+	allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	allocInfo.flags = GPU_ALLOCATION_MAPPED | GPU_ALLOCATION_DEDICATED;
+
+	VkResult res = gpuCreateBuffer((*ring).allocator, &bufferInfo, &allocInfo, &(*ring).buffer, &(*ring).memory);
+
+	if (res == VK_SUCCESS)
+	{
+		VkCommandPoolCreateInfo poolInfo = {0};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = (*ring).queueFamily;
+
+		res = vkCreateCommandPool((*ring).device, &poolInfo, NULL, &(*ring).commandPool);
+	}
+
+	if (res == VK_SUCCESS)
+	{
+		VkCommandBufferAllocateInfo commandInfo = {0};
+		commandInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandInfo.commandPool = (*ring).commandPool;
+		commandInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandInfo.commandBufferCount = 1;
+
+		for (uint32_t i = 0; i < UPLOAD_RING_MAX_BATCHES && res == VK_SUCCESS; i++)
+			res = vkAllocateCommandBuffers((*ring).device, &commandInfo, &(*ring).batches[i].commandBuffer);
+	}
+
+	if (res == VK_SUCCESS && (*ring).timeline)
+	{
+		VkSemaphoreTypeCreateInfoKHR typeInfo = {0};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo = {0};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+
+		res = vkCreateSemaphore((*ring).device, &semaphoreInfo, NULL, &(*ring).semaphore);
+		(*ring).getCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr((*ring).device, "vkGetSemaphoreCounterValueKHR");
+		if ((*ring).getCounterValue == NULL) res = VK_ERROR_EXTENSION_NOT_PRESENT;
+	} else if (res == VK_SUCCESS)
+	{
+		VkFenceCreateInfo fenceInfo = {0};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		for (uint32_t i = 0; i < UPLOAD_RING_MAX_BATCHES && res == VK_SUCCESS; i++)
+			res = vkCreateFence((*ring).device, &fenceInfo, NULL, &(*ring).batches[i].fence);
+	}
+
+	if (res != VK_SUCCESS)
+	{
+		printf("failed to create upload ring (%d)\n", res);
+		uploadRingDestroy(ring);
+		return NULL;
+	}
+
+	return ring;
+}
+
+// The device must be idle.
+void uploadRingDestroy(uploadRing *ring)
+{
+	if (ring == NULL) return;
+
+	for (uint32_t i = 0; i < UPLOAD_RING_MAX_BATCHES; i++)
+	{
+		vkDestroyFence((*ring).device, (*ring).batches[i].fence, NULL);
+		free((*ring).batches[i].targets);
+	}
+
+	vkDestroySemaphore((*ring).device, (*ring).semaphore, NULL);
+	vkDestroyCommandPool((*ring).device, (*ring).commandPool, NULL);
+	if ((*ring).buffer != VK_NULL_HANDLE) gpuDestroyBuffer((*ring).allocator, (*ring).buffer, &(*ring).memory);
+
+	free((*ring).bufferBarriers);
+	free((*ring).imageBarriers);
+	free(ring);
+}
+
+// Advances completedValue and hands the ring space of finished batches back. Never blocks.
+static void pollCompletion(uploadRing *ring)
+{
+	uint64_t completed = (*ring).completedValue;
+
+	if ((*ring).timeline)
+	{
+		(*ring).getCounterValue((*ring).device, (*ring).semaphore, &completed);
+	} else
+	{
+		while (completed + 1 < (*ring).nextValue && (*batchOf(ring, completed + 1)).state == UPLOAD_BATCH_SUBMITTED
+			&& vkGetFenceStatus((*ring).device, (*batchOf(ring, completed + 1)).fence) == VK_SUCCESS)
+			completed++;
+	}
+
+	for (uint64_t value = (*ring).completedValue + 1; value <= completed; value++)
+	{
+		uploadBatch *batch = batchOf(ring, value);
+		(*ring).tail = (*batch).ringEnd;
+		if ((*batch).acquired) (*batch).state = UPLOAD_BATCH_IDLE;
+	}
+
+	(*ring).completedValue = completed;
+}
+
+static bool allocRing(uploadRing *ring, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset)
+{
+	uint64_t start = alignUp((*ring).head, alignment);
+
+	// Never straddle the end; skip to the start of the next lap instead.
+	if ((start & ((*ring).capacity - 1)) + size > (*ring).capacity) start = alignUp(start, (*ring).capacity);
+	if (start + size - (*ring).tail > (*ring).capacity) return false;
+
+	(*ring).head = start + size;
+	*offset = start & ((*ring).capacity - 1);
+	return true;
+}
+
+// NULL while the slot's previous batch is still in use, or once the open batch
+// has been acquired.
+static uploadBatch *openBatch(uploadRing *ring)
+{
+	uploadBatch *batch = batchOf(ring, (*ring).nextValue);
+	if ((*batch).state == UPLOAD_BATCH_SUBMITTED) pollCompletion(ring);
+	if ((*batch).state == UPLOAD_BATCH_RECORDING) return (*batch).acquired ? NULL : batch;
+	if ((*batch).state != UPLOAD_BATCH_IDLE) return NULL;
+
+	vkResetCommandBuffer((*batch).commandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo = {0};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VkResult res = vkBeginCommandBuffer((*batch).commandBuffer, &beginInfo);
+	if (res != VK_SUCCESS)
+	{
+		printf("vkBeginCommandBuffer() for upload batch %llu failed (%d)\n", (unsigned long long)(*ring).nextValue, res);
+		return NULL;
+	}
+
+	(*batch).state = UPLOAD_BATCH_RECORDING;
+	(*batch).acquired = false;
+	(*batch).value = (*ring).nextValue;
+	(*batch).targetCount = 0;
+	return batch;
+}
+
+static void *stage(uploadRing *ring, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset)
+{
+	if (size > (*ring).capacity)
+	{
+		printf("upload of %llu bytes does not fit the %llu byte upload ring\n", (unsigned long long)size, (unsigned long long)(*ring).capacity);
+		return NULL;
+	}
+
+	if (!allocRing(ring, size, alignment, offset))
+	{
+		pollCompletion(ring);
+		if (!allocRing(ring, size, alignment, offset)) return NULL;
+	}
+
+	return (uint8_t *)(*ring).memory.mapped + *offset;
+}
+
+static void addTarget(uploadBatch *batch, uploadTarget target)
+{
+	if (target.dstStage == 0) target.dstStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+	if ((*batch).targetCount == (*batch).targetCapacity)
+	{
+		(*batch).targetCapacity = (*batch).targetCapacity ? 2 * (*batch).targetCapacity : 32;
+		(*batch).targets = realloc((*batch).targets, (*batch).targetCapacity * sizeof(uploadTarget));
+	}
+
+	(*batch).targets[(*batch).targetCount++] = target;
+}
+
+uint32_t uploadRingQueueFamilies(uploadRing *ring, uint32_t families[2])
+{
+	families[0] = (*ring).queueFamily;
+	families[1] = (*ring).dstQueueFamily;
+	return (*ring).queueFamily == (*ring).dstQueueFamily ? 1 : 2;
+}
+
+VkDeviceSize uploadRingCapacity(uploadRing *ring)
+{
+	return (*ring).capacity;
+}
+
+void *uploadBuffer(uploadRing *ring, VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, uploadTicket *ticket)
+{
+	*ticket = 0;
+
+	uploadBatch *batch = openBatch(ring);
+	VkDeviceSize offset;
+	void *staging = batch != NULL ? stage(ring, size, (*ring).alignment, &offset) : NULL;
+	if (staging == NULL) return NULL;
+
+	VkBufferCopy region = {offset, dstOffset, size};
+	vkCmdCopyBuffer((*batch).commandBuffer, (*ring).buffer, dst, 1, &region);
+
+	uploadTarget target = {0};
+	target.buffer = dst;
+	target.offset = dstOffset;
+	target.size = size;
+	target.dstStage = dstStage;
+	target.dstAccess = dstAccess;
+	addTarget(batch, target);
+
+	*ticket = (*batch).value;
+	return staging;
+}
+
+void *uploadImage(uploadRing *ring, const uploadImageInfo *info, uploadTicket *ticket)
+{
+	*ticket = 0;
+
+	// An exclusive image changing queue family loses whatever the ring did not write.
+	if ((*info).oldLayout != VK_IMAGE_LAYOUT_UNDEFINED && !(*info).concurrent && (*ring).queueFamily != (*ring).dstQueueFamily)
+	{
+		printf("keeping an image's contents across queue families needs a concurrent image\n");
+		return NULL;
+	}
+
+	uploadBatch *batch = openBatch(ring);
+	VkDeviceSize alignment = (*ring).alignment > UPLOAD_IMAGE_OFFSET_ALIGNMENT ? (*ring).alignment : UPLOAD_IMAGE_OFFSET_ALIGNMENT;
+	VkDeviceSize offset;
+	void *staging = batch != NULL ? stage(ring, (*info).size, alignment, &offset) : NULL;
+	if (staging == NULL) return NULL;
+
+	VkImageSubresourceLayers subresource = (*info).subresource;
+	VkImageSubresourceRange range = {subresource.aspectMask, subresource.mipLevel, 1, subresource.baseArrayLayer, subresource.layerCount};
+	VkImageLayout copyLayout = (*info).finalLayout == VK_IMAGE_LAYOUT_GENERAL ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+	if ((*info).oldLayout != copyLayout)
+	{
+		VkImageMemoryBarrier toTransfer = {0};
+		toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		toTransfer.srcAccessMask = 0;
+		toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		toTransfer.oldLayout = (*info).oldLayout;
+		toTransfer.newLayout = copyLayout;
+		toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toTransfer.image = (*info).image;
+		toTransfer.subresourceRange = range;
+
+		VkPipelineStageFlags srcStage = (*info).oldLayout == VK_IMAGE_LAYOUT_UNDEFINED ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		vkCmdPipelineBarrier((*batch).commandBuffer, srcStage, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &toTransfer);
+	}
+
+	VkBufferImageCopy region = {0};
+	region.bufferOffset = offset;
+	region.imageSubresource = subresource;
+	region.imageOffset = (*info).offset;
+	region.imageExtent = (*info).extent;
+	vkCmdCopyBufferToImage((*batch).commandBuffer, (*ring).buffer, (*info).image, copyLayout, 1, &region);
+
+	uploadTarget target = {0};
+	target.image = (*info).image;
+	target.range = range;
+	target.copyLayout = copyLayout;
+	target.finalLayout = (*info).finalLayout;
+	target.dstStage = (*info).dstStage;
+	target.dstAccess = (*info).dstAccess;
+	target.concurrent = (*info).concurrent;
+	addTarget(batch, target);
+
+	*ticket = (*batch).value;
+	return staging;
+}
+
+static void reserveBarriers(uploadRing *ring, uint32_t count)
+{
+	if (count <= (*ring).barrierCapacity) return;
+
+	while ((*ring).barrierCapacity < count) (*ring).barrierCapacity = (*ring).barrierCapacity ? 2 * (*ring).barrierCapacity : 64;
+	(*ring).bufferBarriers = realloc((*ring).bufferBarriers, (*ring).barrierCapacity * sizeof(VkBufferMemoryBarrier));
+	(*ring).imageBarriers = realloc((*ring).imageBarriers, (*ring).barrierCapacity * sizeof(VkImageMemoryBarrier));
+}
+
+// Fills the scratch barrier arrays for one side of the upload. Exclusive targets
+// changing family get the release/acquire pair, both sides describing the same
+// families and layouts. Concurrent images finish their layout change on the upload
+// queue and are then covered by the semaphore alone.
+static void buildBarriers(uploadRing *ring, const uploadBatch *batch, bool release, uint32_t *bufferCount, uint32_t *imageCount, VkPipelineStageFlags *dstStages)
+{
+	bool sameFamily = (*ring).queueFamily == (*ring).dstQueueFamily;
+	reserveBarriers(ring, *bufferCount + *imageCount + (*batch).targetCount);
+
+	for (uint32_t i = 0; i < (*batch).targetCount; i++)
+	{
+		const uploadTarget *target = &(*batch).targets[i];
+		*dstStages |= (*target).dstStage;
+
+		bool ownership = !sameFamily && !(*target).concurrent;
+		bool layoutChange = (*target).copyLayout != (*target).finalLayout;
+		if (release ? !ownership && (sameFamily || !layoutChange) : !ownership && !sameFamily) continue;
+
+		VkAccessFlags srcAccess = (release || sameFamily) ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+		VkAccessFlags dstAccess = release ? 0 : (*target).dstAccess;
+		uint32_t srcFamily = ownership ? (*ring).queueFamily : VK_QUEUE_FAMILY_IGNORED;
+		uint32_t dstFamily = ownership ? (*ring).dstQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+
+		if ((*target).image != VK_NULL_HANDLE)
+		{
+			VkImageMemoryBarrier *barrier = &(*ring).imageBarriers[(*imageCount)++];
+			memset(barrier, 0, sizeof(VkImageMemoryBarrier));
+			(*barrier).sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			(*barrier).srcAccessMask = srcAccess;
+			(*barrier).dstAccessMask = dstAccess;
+			(*barrier).oldLayout = (*target).copyLayout;
+			(*barrier).newLayout = (*target).finalLayout;
+			(*barrier).srcQueueFamilyIndex = srcFamily;
+			(*barrier).dstQueueFamilyIndex = dstFamily;
+			(*barrier).image = (*target).image;
+			(*barrier).subresourceRange = (*target).range;
+		} else
+		{
+			VkBufferMemoryBarrier *barrier = &(*ring).bufferBarriers[(*bufferCount)++];
+			memset(barrier, 0, sizeof(VkBufferMemoryBarrier));
+			(*barrier).sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			(*barrier).srcAccessMask = srcAccess;
+			(*barrier).dstAccessMask = dstAccess;
+			(*barrier).srcQueueFamilyIndex = srcFamily;
+			(*barrier).dstQueueFamilyIndex = dstFamily;
+			(*barrier).buffer = (*target).buffer;
+			(*barrier).offset = (*target).offset;
+			(*barrier).size = (*target).size;
+		}
+	}
+}
+
+void uploadRingFlush(uploadRing *ring)
+{
+	uploadBatch *batch = batchOf(ring, (*ring).nextValue);
+	if ((*batch).state != UPLOAD_BATCH_RECORDING || (*batch).targetCount == 0) return;
+
+	// Release half of the queue family transfer; same-family uploads need nothing here.
+	uint32_t bufferCount = 0, imageCount = 0;
+	VkPipelineStageFlags dstStages = 0;
+	buildBarriers(ring, batch, true, &bufferCount, &imageCount, &dstStages);
+	if (bufferCount + imageCount > 0)
+		vkCmdPipelineBarrier((*batch).commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, bufferCount, (*ring).bufferBarriers, imageCount, (*ring).imageBarriers);
+
+	vkEndCommandBuffer((*batch).commandBuffer);
+
+	VkSubmitInfo submitInfo = {0};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &(*batch).commandBuffer;
+
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {0};
+	VkFence fence = VK_NULL_HANDLE;
+	if ((*ring).timeline)
+	{
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &(*batch).value;
+
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &(*ring).semaphore;
+	} else
+	{
+		fence = (*batch).fence;
+		vkResetFences((*ring).device, 1, &fence);
+	}
+
+	VkResult res = vkQueueSubmit((*ring).queue, 1, &submitInfo, fence);
+	if (res != VK_SUCCESS) printf("upload batch %llu failed to submit (%d)\n", (unsigned long long)(*batch).value, res);
+
+	(*batch).state = UPLOAD_BATCH_SUBMITTED;
+	(*batch).ringEnd = (*ring).head;
+	(*ring).nextValue++;
+}
+
+uploadWait uploadRingAcquire(uploadRing *ring, VkCommandBuffer commandBuffer, uploadTicket ticket)
+{
+	uploadWait wait = {0};
+
+	pollCompletion(ring);
+
+	// Only tickets of submitted batches or the open one can be waited for.
+	uint64_t last = (*ring).completedValue;
+	if (ticket > (*ring).nextValue) ticket = (*ring).nextValue;
+	if (ticket == (*ring).nextValue && (*batchOf(ring, ticket)).state != UPLOAD_BATCH_RECORDING) ticket--;
+	if (ticket > last) last = ticket;
+	if (last <= (*ring).acquiredValue) return wait;
+
+	uint32_t bufferCount = 0, imageCount = 0;
+	VkPipelineStageFlags dstStages = 0;
+
+	for (uint64_t value = (*ring).acquiredValue + 1; value <= last; value++)
+	{
+		uploadBatch *batch = batchOf(ring, value);
+		buildBarriers(ring, batch, false, &bufferCount, &imageCount, &dstStages);
+		(*batch).acquired = true;
+		if (value <= (*ring).completedValue) (*batch).state = UPLOAD_BATCH_IDLE;
+	}
+
+	// Cross-family acquires are ordered by the semaphore wait; same-family ones by the barrier itself.
+	VkPipelineStageFlags srcStage = (*ring).queueFamily == (*ring).dstQueueFamily ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	if (bufferCount + imageCount > 0)
+		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStages, 0, 0, NULL, bufferCount, (*ring).bufferBarriers, imageCount, (*ring).imageBarriers);
+
+	(*ring).acquiredValue = last;
+
+	if ((*ring).timeline)
+	{
+		wait.semaphore = (*ring).semaphore;
+		wait.value = (*ring).acquiredValue;
+		wait.stageMask = dstStages;
+	}
+
+	return wait;
+}
@@ -0,0 +1,92 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "gpuAllocator.h"
+
+// Streams buffer and image data to the GPU through one persistently mapped
+// staging ring. Copies are batched into one command buffer per frame and
+// submitted on the upload queue by uploadRingFlush(); ring space is reclaimed as
+// batches complete, polled without waiting. With timeline semaphores the batches
+// go to the transfer queue and the frame waits on the batch's timeline value;
+// without them the graphics queue and a fence per batch are used instead.
+// Not thread safe: drive it from the render thread. Memory handed out by the
+// reserve calls may be filled from any thread until the next flush.
+
+#define UPLOAD_RING_MAX_BATCHES 8
+
+// Handed back by every upload. 0 means nothing was queued: either the ring is out
+// of space or batches (try again after a later flush) or the upload is larger
+// than the whole ring, which is reported and never fits; split those.
+typedef uint64_t uploadTicket;
+
+typedef struct uploadRing uploadRing;
+
+typedef struct uploadRingCreateInfo
+{
+	VkDevice device;
+	gpuAllocator *allocator;
+	VkQueue queue;                       // transfer queue when timelineSemaphore, otherwise graphics
+	uint32_t queueFamily;
+	uint32_t dstQueueFamily;             // family that consumes the uploads
+	VkDeviceSize size;                   // rounded up to a power of two
+	VkDeviceSize copyOffsetAlignment;    // optimalBufferCopyOffsetAlignment
+	bool timelineSemaphore;
+} uploadRingCreateInfo;
+
+typedef struct uploadImageInfo
+{
+	VkImage image;
+	VkImageSubresourceLayers subresource;
+	VkOffset3D offset;
+	VkExtent3D extent;
+	VkDeviceSize size;                   // bytes, rows tightly packed
+
+	// UNDEFINED discards the rest of the subresource. Other layouts keep it, which
+	// across queue families needs an image shared by uploadRingQueueFamilies().
+	VkImageLayout oldLayout;
+	VkImageLayout finalLayout;           // GENERAL copies in place without a transition
+	VkPipelineStageFlags dstStage;
+	VkAccessFlags dstAccess;
+	bool concurrent;                     // created with VK_SHARING_MODE_CONCURRENT
+} uploadImageInfo;
+
+// What the consuming submit has to wait on before it may touch acquired uploads.
+typedef struct uploadWait
+{
+	VkSemaphore semaphore;               // VK_NULL_HANDLE when nothing to wait for
+	uint64_t value;
+	VkPipelineStageFlags stageMask;
+} uploadWait;
+
+uploadRing *uploadRingCreate(const uploadRingCreateInfo *createInfo);
+void uploadRingDestroy(uploadRing *ring);
+
+// The families a resource must list to be written by the ring and read by the
+// consumer without ownership transfers; returns 1 when they are the same family.
+uint32_t uploadRingQueueFamilies(uploadRing *ring, uint32_t families[2]);
+VkDeviceSize uploadRingCapacity(uploadRing *ring);
+
+// Both hand back the staging memory for the caller to fill before the next flush,
+// or NULL with a 0 ticket when nothing was queued. Buffer uploads move ownership of
+// just the written range, so the consumer may keep using the rest of the buffer.
+void *uploadBuffer(uploadRing *ring, VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, uploadTicket *ticket);
+void *uploadImage(uploadRing *ring, const uploadImageInfo *info, uploadTicket *ticket);
+
+// Submits the copies recorded since the last flush. Call once per frame, before
+// submitting the command buffer that acquired them.
+void uploadRingFlush(uploadRing *ring);
+
+// Records the acquire side (ownership transfer and layout change) into the
+// consumer's command buffer for every batch that has completed on the upload
+// queue, and for every batch up to ticket even if it is still in flight or not
+// flushed yet; the returned wait then covers it. Uploads become resident once that
+// command buffer is submitted with the returned wait. After the open batch has
+// been acquired, further uploads fail until the next flush.
+uploadWait uploadRingAcquire(uploadRing *ring, VkCommandBuffer commandBuffer, uploadTicket ticket);
+
+#endif
@@ -0,0 +1,230 @@
+// Fusing a multiply and add into FMA rounds once instead of twice, which would
+// make the levels disagree; GNU C contracts by default and Clang within each
+// expression, so this file turns it off, header inlines included.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#include "vectorMath.h"
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define MATH_X86 1
+#endif
+
+typedef void (*transformPointsKernel)(const mat4 *m, const vec4 *points, vec4 *out, uint32_t count);
+typedef uint32_t (*overlapBoxesKernel)(const aabb *box, const aabb *boxes, uint32_t count, uint32_t *hits);
+
+static const char *levelNames[MATH_LEVEL_COUNT] = {"scalar", "SSE2", "AVX2", "AVX-512"};
+
+static void transformPointsScalar(const mat4 *m, const vec4 *points, vec4 *out, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) out[i] = mat4Transform(m, points[i]);
+}
+
+static uint32_t overlapBoxesScalar(const aabb *box, const aabb *boxes, uint32_t count, uint32_t *hits)
+{
+	// Branch free: always write the index, only advance past hits.
+	uint32_t hitCount = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		hits[hitCount] = i;
+		hitCount += aabbOverlap(box, &boxes[i]);
+	}
+	return hitCount;
+}
+
+#if MATH_X86
+
+static inline __m128 transformSse(__m128 c0, __m128 c1, __m128 c2, __m128 c3, __m128 v)
+{
+	__m128 x = _mm_shuffle_ps(v, v, 0x00), y = _mm_shuffle_ps(v, v, 0x55);
+	__m128 z = _mm_shuffle_ps(v, v, 0xAA), w = _mm_shuffle_ps(v, v, 0xFF);
+	__m128 r = _mm_add_ps(_mm_mul_ps(c0, x), _mm_mul_ps(c1, y));
+	r = _mm_add_ps(r, _mm_mul_ps(c2, z));
+	return _mm_add_ps(r, _mm_mul_ps(c3, w));
+}
+
+static void transformPointsSse2(const mat4 *m, const vec4 *points, vec4 *out, uint32_t count)
+{
+	__m128 c0 = _mm_loadu_ps((*m).m), c1 = _mm_loadu_ps((*m).m + 4);
+	__m128 c2 = _mm_loadu_ps((*m).m + 8), c3 = _mm_loadu_ps((*m).m + 12);
+	for (uint32_t i = 0; i < count; i++)
+		_mm_storeu_ps(&out[i].x, transformSse(c0, c1, c2, c3, _mm_loadu_ps(&points[i].x)));
+}
+
+// Lanes 0-1 must not exceed the query's max, lanes 2-3 must reach its min.
+static uint32_t overlapBoxesSse2(const aabb *box, const aabb *boxes, uint32_t count, uint32_t *hits)
+{
+	__m128 upper = _mm_setr_ps((*box).maxX, (*box).maxY, INFINITY, INFINITY);
+	__m128 lower = _mm_setr_ps(-INFINITY, -INFINITY, (*box).minX, (*box).minY);
+	uint32_t hitCount = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		__m128 v = _mm_loadu_ps(&boxes[i].minX);
+		int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmple_ps(v, upper), _mm_cmpge_ps(v, lower)));
+		hits[hitCount] = i;
+		hitCount += mask == 0xF;
+	}
+	return hitCount;
+}
+
+__attribute__((target("avx2")))
+static void transformPointsAvx2(const mat4 *m, const vec4 *points, vec4 *out, uint32_t count)
+{
+	__m256 c0 = _mm256_broadcast_ps((const __m128 *)(*m).m), c1 = _mm256_broadcast_ps((const __m128 *)((*m).m + 4));
+	__m256 c2 = _mm256_broadcast_ps((const __m128 *)((*m).m + 8)), c3 = _mm256_broadcast_ps((const __m128 *)((*m).m + 12));
+
+	// Two points per register; the permutes broadcast within each 128-bit half.
+	uint32_t i = 0;
+	for (; i + 2 <= count; i += 2)
+	{
+		__m256 v = _mm256_loadu_ps(&points[i].x);
+		__m256 r = _mm256_add_ps(_mm256_mul_ps(c0, _mm256_permute_ps(v, 0x00)), _mm256_mul_ps(c1, _mm256_permute_ps(v, 0x55)));
+		r = _mm256_add_ps(r, _mm256_mul_ps(c2, _mm256_permute_ps(v, 0xAA)));
+		r = _mm256_add_ps(r, _mm256_mul_ps(c3, _mm256_permute_ps(v, 0xFF)));
+		_mm256_storeu_ps(&out[i].x, r);
+	}
+
+	transformPointsSse2(m, points + i, out + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static uint32_t overlapBoxesAvx2(const aabb *box, const aabb *boxes, uint32_t count, uint32_t *hits)
+{
+	__m256 upper = _mm256_setr_ps((*box).maxX, (*box).maxY, INFINITY, INFINITY, (*box).maxX, (*box).maxY, INFINITY, INFINITY);
+	__m256 lower = _mm256_setr_ps(-INFINITY, -INFINITY, (*box).minX, (*box).minY, -INFINITY, -INFINITY, (*box).minX, (*box).minY);
+	uint32_t hitCount = 0, i = 0;
+	for (; i + 2 <= count; i += 2)
+	{
+		__m256 v = _mm256_loadu_ps(&boxes[i].minX);
+		int mask = _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(v, upper, _CMP_LE_OQ), _mm256_cmp_ps(v, lower, _CMP_GE_OQ)));
+		hits[hitCount] = i;
+		hitCount += (mask & 0xF) == 0xF;
+		hits[hitCount] = i + 1;
+		hitCount += mask >> 4 == 0xF;
+	}
+
+	uint32_t tail = overlapBoxesSse2(box, boxes + i, count - i, hits + hitCount);
+	for (uint32_t t = 0; t < tail; t++) hits[hitCount + t] += i;
+	return hitCount + tail;
+}
+
+__attribute__((target("avx512f")))
+static void transformPointsAvx512(const mat4 *m, const vec4 *points, vec4 *out, uint32_t count)
+{
+	__m512 c0 = _mm512_broadcast_f32x4(_mm_loadu_ps((*m).m)), c1 = _mm512_broadcast_f32x4(_mm_loadu_ps((*m).m + 4));
+	__m512 c2 = _mm512_broadcast_f32x4(_mm_loadu_ps((*m).m + 8)), c3 = _mm512_broadcast_f32x4(_mm_loadu_ps((*m).m + 12));
+
+	uint32_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m512 v = _mm512_loadu_ps(&points[i].x);
+		__m512 r = _mm512_add_ps(_mm512_mul_ps(c0, _mm512_permute_ps(v, 0x00)), _mm512_mul_ps(c1, _mm512_permute_ps(v, 0x55)));
+		r = _mm512_add_ps(r, _mm512_mul_ps(c2, _mm512_permute_ps(v, 0xAA)));
+		r = _mm512_add_ps(r, _mm512_mul_ps(c3, _mm512_permute_ps(v, 0xFF)));
+		_mm512_storeu_ps(&out[i].x, r);
+	}
+
+	transformPointsSse2(m, points + i, out + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+static uint32_t overlapBoxesAvx512(const aabb *box, const aabb *boxes, uint32_t count, uint32_t *hits)
+{
+	__m512 upper = _mm512_broadcast_f32x4(_mm_setr_ps((*box).maxX, (*box).maxY, INFINITY, INFINITY));
+	__m512 lower = _mm512_broadcast_f32x4(_mm_setr_ps(-INFINITY, -INFINITY, (*box).minX, (*box).minY));
+	uint32_t hitCount = 0, i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m512 v = _mm512_loadu_ps(&boxes[i].minX);
+		__mmask16 inside = _mm512_cmp_ps_mask(v, upper, _CMP_LE_OQ) & _mm512_cmp_ps_mask(v, lower, _CMP_GE_OQ);
+		for (uint32_t b = 0; b < 4; b++)
+		{
+			hits[hitCount] = i + b;
+			hitCount += ((inside >> (4 * b)) & 0xF) == 0xF;
+		}
+	}
+
+	uint32_t tail = overlapBoxesSse2(box, boxes + i, count - i, hits + hitCount);
+	for (uint32_t t = 0; t < tail; t++) hits[hitCount + t] += i;
+	return hitCount + tail;
+}
+
+static mathLevel detectLevel(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(edx & bit_SSE2)) return MATH_LEVEL_SCALAR;
+
+	// AVX state must also be enabled by the OS (XCR0), not just present.
+	if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) return MATH_LEVEL_SSE2;
+	uint32_t xcr0Low, xcr0High;
+	__asm__("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+	if ((xcr0Low & 0x6) != 0x6) return MATH_LEVEL_SSE2;
+
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) || !(ebx & bit_AVX2)) return MATH_LEVEL_SSE2;
+	if (!(ebx & bit_AVX512F) || (xcr0Low & 0xE0) != 0xE0) return MATH_LEVEL_AVX2;
+	return MATH_LEVEL_AVX512;
+}
+
+static const transformPointsKernel transformKernels[MATH_LEVEL_COUNT] = {transformPointsScalar, transformPointsSse2, transformPointsAvx2, transformPointsAvx512};
+static const overlapBoxesKernel overlapKernels[MATH_LEVEL_COUNT] = {overlapBoxesScalar, overlapBoxesSse2, overlapBoxesAvx2, overlapBoxesAvx512};
+
+#else
+
+static mathLevel detectLevel(void)
+{
+	return MATH_LEVEL_SCALAR;
+}
+
+static const transformPointsKernel transformKernels[MATH_LEVEL_COUNT] = {transformPointsScalar, transformPointsScalar, transformPointsScalar, transformPointsScalar};
+static const overlapBoxesKernel overlapKernels[MATH_LEVEL_COUNT] = {overlapBoxesScalar, overlapBoxesScalar, overlapBoxesScalar, overlapBoxesScalar};
+
+#endif
+
+static mathLevel supportedLevel = MATH_LEVEL_SCALAR;
+static mathLevel currentLevel = MATH_LEVEL_SCALAR;
+static transformPointsKernel transformPoints = transformPointsScalar;
+static overlapBoxesKernel overlapBoxes = overlapBoxesScalar;
+
+mathLevel mathInit(void)
+{
+	supportedLevel = detectLevel();
+	return mathSetLevel(supportedLevel);
+}
+
+mathLevel mathSetLevel(mathLevel level)
+{
+	currentLevel = level < supportedLevel ? level : supportedLevel;
+	transformPoints = transformKernels[currentLevel];
+	overlapBoxes = overlapKernels[currentLevel];
+	return currentLevel;
+}
+
+mathLevel mathGetLevel(void)
+{
+	return currentLevel;
+}
+
+mathLevel mathSupportedLevel(void)
+{
+	return supportedLevel;
+}
+
+const char *mathLevelName(mathLevel level)
+{
+	return level < MATH_LEVEL_COUNT ? levelNames[level] : "unknown";
+}
+
+void mathTransformPoints(const mat4 *m, const vec4 *points, vec4 *out, uint32_t count)
+{
+	transformPoints(m, points, out, count);
+}
+
+uint32_t mathOverlapBoxes(const aabb *box, const aabb *boxes, uint32_t count, uint32_t *hits)
+{
+	return overlapBoxes(box, boxes, count, hits);
+}
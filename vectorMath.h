@@ -0,0 +1,255 @@
+#ifndef VECTOR_MATH_H
+#define VECTOR_MATH_H
+
+#include <stdint.h>
+#include <math.h>
+
+// Small vector, matrix and quaternion types with inline scalar operations, plus
+// batch kernels picked once at startup from what CPUID reports: SSE2 on every
+// x86-64, then AVX2 and AVX-512 where the CPU and OS support them. Every kernel
+// performs the scalar path's operations in the same order and vectorMath.c is
+// built without FMA contraction, so all levels give bit-identical results. The
+// inline functions below are compiled with the caller's settings: with GNU C's
+// default -ffp-contract=fast and an FMA target they may differ from the kernels
+// in the last bit.
+// Matrices are column major, as the shaders expect.
+
+typedef struct vec2
+{
+	float x, y;
+} vec2;
+
+typedef struct vec3
+{
+	float x, y, z;
+} vec3;
+
+typedef struct vec4
+{
+	float x, y, z, w;
+} vec4;
+
+typedef struct quat
+{
+	float x, y, z, w;
+} quat;
+
+typedef struct mat3
+{
+	float m[9];
+} mat3;
+
+typedef struct mat4
+{
+	float m[16];
+} mat4;
+
+typedef struct aabb
+{
+	float minX, minY, maxX, maxY;
+} aabb;
+
+// Single-evaluation min, max and clamp for any arithmetic type; arguments
+// convert to their common type first, as with the operators.
+#define MATH_MIN_MAX(suffix, type) \
+	static inline type mathMin##suffix(type a, type b) { return a < b ? a : b; } \
+	static inline type mathMax##suffix(type a, type b) { return a > b ? a : b; } \
+	static inline type mathClamp##suffix(type x, type lo, type hi) { type r = lo > x ? lo : x; return hi < r ? hi : r; }
+
+MATH_MIN_MAX(I, int)
+MATH_MIN_MAX(U, unsigned int)
+MATH_MIN_MAX(L, long)
+MATH_MIN_MAX(UL, unsigned long)
+MATH_MIN_MAX(LL, long long)
+MATH_MIN_MAX(ULL, unsigned long long)
+MATH_MIN_MAX(F, float)
+MATH_MIN_MAX(D, double)
+
+#define MATH_SELECT(name, type) _Generic((type), \
+	int: name##I, unsigned int: name##U, long: name##L, unsigned long: name##UL, \
+	long long: name##LL, unsigned long long: name##ULL, float: name##F, double: name##D)
+
+#define mathMin(a, b) MATH_SELECT(mathMin, (a) + (b))(a, b)
+#define mathMax(a, b) MATH_SELECT(mathMax, (a) + (b))(a, b)
+#define mathClamp(x, lo, hi) MATH_SELECT(mathClamp, (x) + (lo) + (hi))(x, lo, hi)
+
+static inline vec2 vec2Add(vec2 a, vec2 b) { return (vec2){a.x + b.x, a.y + b.y}; }
+static inline vec2 vec2Sub(vec2 a, vec2 b) { return (vec2){a.x - b.x, a.y - b.y}; }
+static inline vec2 vec2Scale(vec2 v, float s) { return (vec2){v.x * s, v.y * s}; }
+static inline float vec2Dot(vec2 a, vec2 b) { return a.x * b.x + a.y * b.y; }
+static inline float vec2Length(vec2 v) { return sqrtf(vec2Dot(v, v)); }
+static inline vec2 vec2Lerp(vec2 a, vec2 b, float t) { return (vec2){a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t}; }
+
+static inline vec2 vec2Normalize(vec2 v)
+{
+	float length = vec2Length(v);
+	return length > 0.0f ? vec2Scale(v, 1.0f / length) : v;
+}
+
+static inline vec3 vec3Add(vec3 a, vec3 b) { return (vec3){a.x + b.x, a.y + b.y, a.z + b.z}; }
+static inline vec3 vec3Sub(vec3 a, vec3 b) { return (vec3){a.x - b.x, a.y - b.y, a.z - b.z}; }
+static inline vec3 vec3Scale(vec3 v, float s) { return (vec3){v.x * s, v.y * s, v.z * s}; }
+static inline float vec3Dot(vec3 a, vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static inline vec3 vec3Cross(vec3 a, vec3 b) { return (vec3){a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+static inline float vec3Length(vec3 v) { return sqrtf(vec3Dot(v, v)); }
+static inline vec3 vec3Lerp(vec3 a, vec3 b, float t) { return (vec3){a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t}; }
+
+static inline vec3 vec3Normalize(vec3 v)
+{
+	float length = vec3Length(v);
+	return length > 0.0f ? vec3Scale(v, 1.0f / length) : v;
+}
+
+static inline vec4 vec4Add(vec4 a, vec4 b) { return (vec4){a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w}; }
+static inline vec4 vec4Sub(vec4 a, vec4 b) { return (vec4){a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w}; }
+static inline vec4 vec4Scale(vec4 v, float s) { return (vec4){v.x * s, v.y * s, v.z * s, v.w * s}; }
+static inline float vec4Dot(vec4 a, vec4 b) { return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w; }
+
+static inline quat quatIdentity(void) { return (quat){0.0f, 0.0f, 0.0f, 1.0f}; }
+
+// Angle in radians around a unit axis.
+static inline quat quatFromAxisAngle(vec3 axis, float angle)
+{
+	float s = sinf(0.5f * angle);
+	return (quat){axis.x * s, axis.y * s, axis.z * s, cosf(0.5f * angle)};
+}
+
+// Applies b first, then a.
+static inline quat quatMultiply(quat a, quat b)
+{
+	return (quat){
+		a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+		a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+		a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+		a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z};
+}
+
+static inline quat quatNormalize(quat q)
+{
+	float length = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+	float s = length > 0.0f ? 1.0f / length : 0.0f;
+	return (quat){q.x * s, q.y * s, q.z * s, q.w * s};
+}
+
+static inline vec3 quatRotate(quat q, vec3 v)
+{
+	// v + 2w(u x v) + 2u x (u x v), u being the vector part.
+	vec3 u = {q.x, q.y, q.z};
+	vec3 t = vec3Scale(vec3Cross(u, v), 2.0f);
+	return vec3Add(vec3Add(v, vec3Scale(t, q.w)), vec3Cross(u, t));
+}
+
+// Normalized lerp along the shorter arc; close to slerp for nearby rotations.
+static inline quat quatNlerp(quat a, quat b, float t)
+{
+	float sign = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w < 0.0f ? -1.0f : 1.0f;
+	return quatNormalize((quat){
+		a.x + (sign * b.x - a.x) * t, a.y + (sign * b.y - a.y) * t,
+		a.z + (sign * b.z - a.z) * t, a.w + (sign * b.w - a.w) * t});
+}
+
+static inline mat3 mat3Identity(void) { return (mat3){{1, 0, 0, 0, 1, 0, 0, 0, 1}}; }
+
+static inline mat3 mat3Multiply(const mat3 *a, const mat3 *b)
+{
+	mat3 r;
+	for (int c = 0; c < 3; c++)
+		for (int row = 0; row < 3; row++)
+			r.m[3 * c + row] = (*a).m[row] * (*b).m[3 * c] + (*a).m[3 + row] * (*b).m[3 * c + 1] + (*a).m[6 + row] * (*b).m[3 * c + 2];
+	return r;
+}
+
+// 2D transform: scale, then rotate (radians), then translate.
+static inline mat3 mat3FromTransform2D(vec2 translation, float rotation, vec2 scale)
+{
+	float c = cosf(rotation), s = sinf(rotation);
+	return (mat3){{c * scale.x, s * scale.x, 0, -s * scale.y, c * scale.y, 0, translation.x, translation.y, 1}};
+}
+
+static inline vec2 mat3TransformPoint(const mat3 *m, vec2 p)
+{
+	return (vec2){(*m).m[0] * p.x + (*m).m[3] * p.y + (*m).m[6], (*m).m[1] * p.x + (*m).m[4] * p.y + (*m).m[7]};
+}
+
+static inline mat4 mat4Identity(void) { return (mat4){{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1}}; }
+
+static inline mat4 mat4Multiply(const mat4 *a, const mat4 *b)
+{
+	mat4 r;
+	for (int c = 0; c < 4; c++)
+		for (int row = 0; row < 4; row++)
+			r.m[4 * c + row] = (*a).m[row] * (*b).m[4 * c] + (*a).m[4 + row] * (*b).m[4 * c + 1] +
+				(*a).m[8 + row] * (*b).m[4 * c + 2] + (*a).m[12 + row] * (*b).m[4 * c + 3];
+	return r;
+}
+
+// The order every batch kernel reproduces: ((c0 x + c1 y) + c2 z) + c3 w.
+static inline vec4 mat4Transform(const mat4 *m, vec4 v)
+{
+	const float *c = (*m).m;
+	return (vec4){
+		c[0] * v.x + c[4] * v.y + c[8] * v.z + c[12] * v.w,
+		c[1] * v.x + c[5] * v.y + c[9] * v.z + c[13] * v.w,
+		c[2] * v.x + c[6] * v.y + c[10] * v.z + c[14] * v.w,
+		c[3] * v.x + c[7] * v.y + c[11] * v.z + c[15] * v.w};
+}
+
+static inline mat4 mat4Translation(vec3 t) { return (mat4){{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, t.x, t.y, t.z, 1}}; }
+static inline mat4 mat4Scale(vec3 s) { return (mat4){{s.x, 0, 0, 0, 0, s.y, 0, 0, 0, 0, s.z, 0, 0, 0, 0, 1}}; }
+
+static inline mat4 mat4FromQuat(quat q)
+{
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+	return (mat4){{
+		1 - 2 * (yy + zz), 2 * (xy + wz), 2 * (xz - wy), 0,
+		2 * (xy - wz), 1 - 2 * (xx + zz), 2 * (yz + wx), 0,
+		2 * (xz + wy), 2 * (yz - wx), 1 - 2 * (xx + yy), 0,
+		0, 0, 0, 1}};
+}
+
+// Vulkan clip space: y down, depth 0 to 1.
+static inline mat4 mat4Ortho(float left, float right, float top, float bottom, float zNear, float zFar)
+{
+	return (mat4){{
+		2 / (right - left), 0, 0, 0,
+		0, 2 / (bottom - top), 0, 0,
+		0, 0, 1 / (zFar - zNear), 0,
+		-(right + left) / (right - left), -(bottom + top) / (bottom - top), -zNear / (zFar - zNear), 1}};
+}
+
+static inline int aabbOverlap(const aabb *a, const aabb *b)
+{
+	return (*b).minX <= (*a).maxX && (*a).minX <= (*b).maxX && (*b).minY <= (*a).maxY && (*a).minY <= (*b).maxY;
+}
+
+// Batch kernels.
+
+typedef enum mathLevel
+{
+	MATH_LEVEL_SCALAR,
+	MATH_LEVEL_SSE2,
+	MATH_LEVEL_AVX2,
+	MATH_LEVEL_AVX512,
+	MATH_LEVEL_COUNT
+} mathLevel;
+
+// Detects the widest supported level and selects it. Call once at startup;
+// batch calls before that run the scalar code.
+mathLevel mathInit(void);
+
+// Selects at most level, for benchmarks and tests; returns the level in effect.
+mathLevel mathSetLevel(mathLevel level);
+mathLevel mathGetLevel(void);
+mathLevel mathSupportedLevel(void);
+const char *mathLevelName(mathLevel level);
+
+// out[i] = m * points[i]; out may alias points.
+void mathTransformPoints(const mat4 *m, const vec4 *points, vec4 *out, uint32_t count);
+
+// Writes the indices of the boxes overlapping box (edges touching count) to
+// hits, which must hold count entries, and returns how many there are.
+uint32_t mathOverlapBoxes(const aabb *box, const aabb *boxes, uint32_t count, uint32_t *hits);
+
+#endif